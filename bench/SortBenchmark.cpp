@@ -0,0 +1,222 @@
+#include "MortonSort.hpp"
+#include <atlas/core/Timer.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Measures what the spatial sort of the falling flakes costs and what it
+// gains: the time of every pass of the sort, and the throughput and cache
+// misses of a trilinear lookup in a wind grid, like the one every flake
+// makes every step, with the flakes in spawn order and in Morton order.
+//
+//     sortBenchmark [flakes] [repeats]
+
+// Half size of the range the flakes are sorted over, as in the SnowFall.
+static const float kInstanceExtent = 16.0f;
+
+// Resolution of the grid the flakes look up.
+static const int kGridSize = 128;
+
+// Counts the cache misses of the calling thread, where the kernel allows it.
+class CacheMissCounter
+{
+    public:
+
+        CacheMissCounter() :
+            m_File(-1)
+        {
+#if defined(__linux__)
+            perf_event_attr attributes;
+            std::memset(&attributes, 0, sizeof(attributes));
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.size = sizeof(attributes);
+            attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+            attributes.disabled = 1;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            m_File = (int)syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+#endif
+        }
+
+        ~CacheMissCounter()
+        {
+#if defined(__linux__)
+            if (m_File >= 0)
+            {
+                close(m_File);
+            }
+#endif
+        }
+
+        bool isAvailable() const
+        {
+            return m_File >= 0;
+        }
+
+        void start()
+        {
+#if defined(__linux__)
+            if (m_File >= 0)
+            {
+                ioctl(m_File, PERF_EVENT_IOC_RESET, 0);
+                ioctl(m_File, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        std::uint64_t stop()
+        {
+            std::uint64_t count = 0;
+#if defined(__linux__)
+            if (m_File >= 0)
+            {
+                ioctl(m_File, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(m_File, &count, sizeof(count)) != (ssize_t)sizeof(count))
+                {
+                    count = 0;
+                }
+            }
+#endif
+            return count;
+        }
+
+    private:
+
+        int m_File;
+};
+
+// Trilinear lookup of every point in a grid over the sort range.
+static float sampleGrid(std::vector<glm::vec4> const &grid, std::vector<glm::vec3> const &points,
+    std::vector<glm::vec3> &samples)
+{
+    float scale = (kGridSize - 1) / (2.0f * kInstanceExtent);
+    float sum = 0.0f;
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+        glm::vec3 p = glm::clamp((points[i] + kInstanceExtent) * scale, 0.0f, kGridSize - 1.001f);
+        glm::ivec3 c(p);
+        glm::vec3 f = p - glm::vec3(c);
+        std::size_t base = (std::size_t)c.x + kGridSize * ((std::size_t)c.y + kGridSize * c.z);
+        std::size_t dy = kGridSize, dz = (std::size_t)kGridSize * kGridSize;
+
+        glm::vec4 x00 = glm::mix(grid[base], grid[base + 1], f.x);
+        glm::vec4 x10 = glm::mix(grid[base + dy], grid[base + dy + 1], f.x);
+        glm::vec4 x01 = glm::mix(grid[base + dz], grid[base + dz + 1], f.x);
+        glm::vec4 x11 = glm::mix(grid[base + dy + dz], grid[base + dy + dz + 1], f.x);
+        glm::vec4 value = glm::mix(glm::mix(x00, x10, f.y), glm::mix(x01, x11, f.y), f.z);
+        samples[i] = glm::vec3(value);
+        sum += value.w;
+    }
+    return sum;
+}
+
+// Runs the lookup a few times and reports the best time and the cache
+// misses of that run.
+static void reportLookup(const char *name, std::vector<glm::vec4> const &grid,
+    std::vector<glm::vec3> const &points, int repeats, CacheMissCounter &counter)
+{
+    std::vector<glm::vec3> samples(points.size());
+    float best = 1e30f, sum = 0.0f;
+    std::uint64_t misses = 0;
+    for (int r = 0; r < repeats; ++r)
+    {
+        atlas::core::Timer<float> timer;
+        counter.start();
+        timer.start();
+        sum += sampleGrid(grid, points, samples);
+        float elapsed = timer.elapsed();
+        std::uint64_t runMisses = counter.stop();
+        if (elapsed < best)
+        {
+            best = elapsed;
+            misses = runMisses;
+        }
+    }
+
+    std::printf("%-14s %10.3f ms %10.1f Mflakes/s", name, best * 1000.0f, points.size() / best * 1e-6f);
+    if (counter.isAvailable())
+    {
+        std::printf(" %12llu misses %8.3f per flake", (unsigned long long)misses, (double)misses / points.size());
+    }
+    else
+    {
+        std::printf("   cache misses unavailable");
+    }
+    std::printf("   checksum %g\n", sum);
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t count = argc > 1 ? (std::size_t)std::atoll(argv[1]) : 1000000;
+    int repeats = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+    // Flakes scattered over the lower half of the range, in no order, as
+    // they are once the wind has mixed them up.
+    std::default_random_engine random(1);
+    std::uniform_real_distribution<float> across(-10.5f, 10.5f), height(0.0f, 12.0f);
+    std::vector<glm::vec3> points(count);
+    for (auto &point : points)
+    {
+        point = glm::vec3(across(random), height(random), across(random));
+    }
+
+    std::vector<glm::vec4> grid((std::size_t)kGridSize * kGridSize * kGridSize);
+    for (std::size_t i = 0; i < grid.size(); ++i)
+    {
+        grid[i] = glm::vec4((float)(i % 7), (float)(i % 11), (float)(i % 13), 1.0f);
+    }
+
+    std::printf("%zu flakes, best of %d runs\n\n", count, repeats);
+
+    // The sort, one pass per call as the SnowFall runs it.
+    MortonSort sort;
+    float total = 1e30f, longest = 0.0f;
+    int steps = 0;
+    for (int r = 0; r < repeats; ++r)
+    {
+        atlas::core::Timer<float> timer;
+        timer.start();
+        sort.start(points.data(), points.size(), glm::vec3(0.0f), kInstanceExtent);
+        float slowest = timer.elapsed(), sum = slowest;
+        int passes = 1;
+        for (bool done = false; !done; ++passes)
+        {
+            timer.start();
+            done = sort.step();
+            float elapsed = timer.elapsed();
+            slowest = std::max(slowest, elapsed);
+            sum += elapsed;
+        }
+        if (sum < total)
+        {
+            total = sum;
+            longest = slowest;
+            steps = passes;
+        }
+    }
+    std::printf("sort           %10.3f ms over %d steps, longest step %.3f ms\n\n", total * 1000.0f, steps,
+        longest * 1000.0f);
+
+    std::vector<glm::vec3> sorted(count);
+    std::vector<std::uint32_t> const &order = sort.getOrder();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        sorted[i] = points[order[i]];
+    }
+
+    CacheMissCounter counter;
+    reportLookup("spawn order", grid, points, repeats, counter);
+    reportLookup("Morton order", grid, sorted, repeats, counter);
+    return 0;
+}
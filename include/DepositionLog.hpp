@@ -0,0 +1,112 @@
+#ifndef DepositionLog_hpp
+#define DepositionLog_hpp
+
+#include <atlas/math/Math.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Append-only history of the snow deposited on the accumulation grid. Every
+// frame's deposits and shifts are stored as one batch of (cell, amount)
+// events, sorted by cell and delta/varint encoded; frames without any are
+// not stored. A full copy of the grid is kept whenever the history since the
+// last one has grown by the given number of bytes, so any past time can be
+// rebuilt by replaying a bounded amount from the nearest copy.
+// Scrolls of the grid are logged with the cells they bring in, and replayed
+// like batches.
+class DepositionLog
+{
+    public:
+
+        DepositionLog(int gridSize, int tileSize, std::size_t keyframeBytes);
+
+        // Drops the history and starts over from the given grid.
+        void reset(float time, std::vector<glm::vec4> const &grid);
+
+        // Adds a deposit to the open batch. Returns the amount actually
+        // recorded, which the caller should apply so replay matches exactly.
+        float record(std::uint32_t cell, float amount);
+
+        // Adds a change in height that leaves the coverage alone, as made by
+        // snow sliding or drifting. Returns the amount actually recorded.
+        float recordShift(std::uint32_t cell, float height);
+
+        // Closes the open batch, if it has any events. The grid is the state
+        // after the batch.
+        void commit(float time, std::vector<glm::vec4> const &grid);
+
+        // Moves the grid by whole cells, cell (row, col) taking the snow of
+        // (row + shift.y, col + shift.x). The cells moving in are copied
+        // from the grid, which is the state after the move, and the open
+        // batch follows its cells.
+        void scroll(float time, glm::ivec2 const &shift, std::vector<glm::vec4> const &grid);
+
+        float getStartTime() const;
+        float getLatestTime() const;
+        std::size_t getSizeInBytes() const;
+
+        int getTileCount() const;
+        void getTileBounds(int tile, int &firstRow, int &firstCol, int &endRow, int &endCol) const;
+
+        // Rebuilds the height and alpha of the cells inside the given tiles
+        // as they were at the given time, on the grid as it is now. Cells
+        // that were off the grid at that time get the values they came in
+        // with. Tiles are replayed in parallel.
+        void reconstruct(float time, std::vector<int> const &tiles, std::vector<glm::vec4> &grid) const;
+
+        // Applies a deposit or a shift to a single cell.
+        static void deposit(glm::vec4 &cell, float amount);
+        static void shift(glm::vec4 &cell, float height);
+
+    private:
+
+        // The lowest bit of the amount tells a shift, stored zigzag encoded
+        // in the bits above, from a deposit.
+        struct Event
+        {
+            std::uint32_t cell;
+            std::uint32_t amount;
+        };
+
+        struct Batch
+        {
+            float time;
+            std::size_t offset;
+        };
+
+        // Cells are addressed on the grid placed at the origin of the
+        // keyframe or scroll, in cells from where the history started.
+        struct Keyframe
+        {
+            float time;
+            std::size_t batch, scroll;
+            glm::ivec2 origin;
+            std::vector<glm::vec2> cells;
+        };
+
+        // A move of the grid, before the given batch, and the height and
+        // alpha of the cells it brought in.
+        struct Scroll
+        {
+            float time;
+            std::size_t batch;
+            glm::ivec2 origin;
+            std::vector<std::uint32_t> cells;
+            std::vector<glm::vec2> values;
+        };
+
+        void addKeyframe(float time, std::vector<glm::vec4> const &grid);
+
+        int m_GridSize, m_TileSize, m_TilesPerSide;
+        std::size_t m_KeyframeBytes, m_BytesSinceKeyframe;
+        float m_LatestTime;
+
+        std::vector<Event> m_Pending;
+        std::vector<std::uint8_t> m_Data;
+        std::vector<Batch> m_Batches;
+        std::vector<Keyframe> m_Keyframes;
+        std::vector<Scroll> m_Scrolls;
+        glm::ivec2 m_Origin;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef FlakeGrid_hpp
+#define FlakeGrid_hpp
+
+#include <atlas/math/Math.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Finds the flakes near a point without testing every pair. The bounding box
+// of the flakes is split into cubic cells, x fastest, and the flakes are
+// counting sorted by their cell, so every cell is one contiguous range of a
+// single array and so is every row of cells. The grid is built again from
+// scratch every step; once built it is only read, so queries can run from
+// any number of threads.
+class FlakeGrid
+{
+    public:
+
+        FlakeGrid(float cellSize);
+
+        // Size of the cells of the last build. Flakes spread over a large
+        // volume get larger cells to bound the memory used.
+        float getCellSize() const;
+
+        void build(glm::vec3 const *positions, std::size_t count);
+
+        // Calls the function with the index and position of every flake in
+        // the cells that overlap the cube of the given half size around the
+        // point, so some flakes further away than that are visited too.
+        template <typename Function>
+        void forEachNear(glm::vec3 const &position, float radius, Function const &function) const;
+
+    private:
+
+        glm::ivec3 findCell(glm::vec3 const &position) const;
+
+        float m_MinCellSize, m_CellSize, m_InvCellSize;
+        glm::vec3 m_Origin;
+        glm::ivec3 m_Resolution;
+
+        // Cell of every flake, the flakes sorted by cell with their
+        // positions, and where each cell starts in that order with one extra
+        // entry past the end.
+        std::vector<std::uint32_t> m_Cells, m_Indices;
+        std::vector<glm::vec3> m_Points;
+        std::vector<std::uint32_t> m_Starts;
+        std::vector<std::atomic<std::uint32_t>> m_Counts;
+};
+
+template <typename Function>
+void FlakeGrid::forEachNear(glm::vec3 const &position, float radius, Function const &function) const
+{
+    if (m_Indices.empty())
+    {
+        return;
+    }
+
+    glm::ivec3 lo = findCell(position - radius);
+    glm::ivec3 hi = findCell(position + radius);
+    for (int z = lo.z; z <= hi.z; ++z)
+    {
+        for (int y = lo.y; y <= hi.y; ++y)
+        {
+            std::size_t row = (std::size_t)m_Resolution.x * (y + (std::size_t)m_Resolution.y * z);
+            for (std::uint32_t k = m_Starts[row + lo.x]; k < m_Starts[row + hi.x + 1]; ++k)
+            {
+                function(m_Indices[k], m_Points[k]);
+            }
+        }
+    }
+}
+
+#endif
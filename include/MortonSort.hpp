@@ -0,0 +1,45 @@
+#ifndef MortonSort_hpp
+#define MortonSort_hpp
+
+#include <atlas/math/Math.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Orders points along a Morton curve through their cells in a 1024^3 grid
+// over a cube, a little at a time. Starting takes the key of every point,
+// and every step then runs one byte of a stable LSD radix sort over the keys,
+// reading one copy of the keys and the order and writing the other. Once the
+// last byte is done the order lists the points, by their index when the keys
+// were taken, along the curve. Every pass is split over the hardware threads.
+class MortonSort
+{
+    public:
+
+        MortonSort();
+
+        // Takes the keys of the points, over the cube of the given half size
+        // around the centre. Points outside it are clamped to its faces.
+        void start(glm::vec3 const *positions, std::size_t count, glm::vec3 const &centre, float extent);
+
+        // Runs the next pass, returning true once the order is complete.
+        bool step();
+
+        // Drops the sort in progress.
+        void reset();
+
+        // Whether the sort has been started and is not complete.
+        bool isSorting() const;
+
+        std::vector<std::uint32_t> const &getOrder() const;
+
+    private:
+
+        // Lowest bit of the next pass, or -1 when no sort is in progress.
+        int m_Shift;
+
+        std::vector<std::uint32_t> m_Keys, m_Order, m_ScratchKeys, m_ScratchOrder;
+        std::vector<std::size_t> m_Offsets;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef SkyExposure_hpp
+#define SkyExposure_hpp
+
+#include <atlas/utils/BVH.hpp>
+#include <atlas/gl/GL.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Bakes how much of the sky each ground cell can see into a small texture.
+// A bundle of rays is cast up from every cell towards where the snow comes
+// from, tilted against the wind and jittered, and traced in packets against
+// the static occluders. Bakes run on a worker thread and only recast the
+// cells an edit can reach, so nothing has to be redrawn per frame.
+class SkyExposure
+{
+    public:
+
+        SkyExposure(int resolution = 128, float extent = 10.0f, int raysPerCell = 16);
+        ~SkyExposure();
+
+        // Marks the cells whose rays can pass through the region for rebaking.
+        void invalidate(atlas::utils::BBox const &region);
+        void invalidateAll();
+
+        // Uploads a finished bake, then starts baking any dirty cells against
+        // a copy of the occluders. Must be called with the GL context current.
+        void update(std::vector<atlas::utils::BVH const *> const &occluders, glm::vec3 const &wind);
+
+        bool isBaking() const;
+
+        // Moves the square baked for. The centre snaps to whole cells, so
+        // the baked values move with the square and only the cells coming
+        // in are rebaked; until then they copy the nearest baked cell.
+        void setCentre(glm::vec2 const &centre);
+
+        // Exposure in [0, 1] for the ground square of the given extent
+        // around the centre.
+        GLuint getTexture() const;
+        float getExtent() const;
+        glm::vec2 getCentre() const;
+
+        // Exposure at a point on the ground from the last finished bake,
+        // filtered like the texture.
+        float sample(float x, float z) const;
+
+    private:
+
+        void bake(std::vector<atlas::utils::BVH> occluders, glm::vec3 wind, glm::vec2 centre);
+
+        // Direction the snow arrives from, and how far the ray bundle
+        // spreads sideways per unit of height.
+        static glm::vec3 getSourceDirection(glm::vec3 const &wind);
+        static float getMaxSlope(glm::vec3 const &wind);
+
+        int m_Resolution, m_RaysPerCell;
+        float m_Extent;
+        GLuint m_Texture;
+
+        std::vector<float> m_Exposure;
+        std::vector<char> m_Dirty;
+        glm::vec3 m_Wind;
+
+        // Centre the exposure values and dirty cells are for, the one the
+        // bake in progress is for, and the one the texture is for.
+        glm::vec2 m_Centre, m_BakeCentre, m_TextureCentre;
+        bool m_Upload;
+
+        // Cells handed to the worker and the values it computed for them.
+        std::thread m_Worker;
+        std::atomic<bool> m_Done;
+        std::vector<int> m_BakeCells;
+        std::vector<float> m_BakeValues;
+};
+
+#endif
@@ -2,23 +2,26 @@
 #define Snow_hpp
 
 #include <atlas/utils/Geometry.hpp>
-#include <set>
-#include <vector>
-#include <random>
+#include <cstdint>
 
-class Snow : public atlas::utils::Geometry
+// Compact per-flake record that the SnowFall renders from. The components are
+// signed normalized values: the position is scaled by the instance extent,
+// the size by the largest flake size and the rotation is a unit quaternion.
+struct SnowInstance
+{
+    std::int16_t position[3];
+    std::int16_t size;
+    std::int16_t rotation[4];
+};
+
+// Describes a single snowflake as it is spawned. Once added to the SnowFall
+// the flake only lives in the SnowFall's per-particle arrays.
+class Snow
 {
     public:
 
         Snow();
-        ~Snow();        
-
-        void computeGeometry(atlas::core::Time<> const &t);
 
-        void updateGeometry(atlas::core::Time<> const &t) override;
-        
-        void applyTransformations();        
-        
         void setMass(float mass);
         float getMass() const;
 
@@ -26,33 +29,28 @@ class Snow : public atlas::utils::Geometry
         glm::vec3 getPos() const;
 
         void setVeloc(glm::vec3 const &velocity);
-		glm::vec3 getVeloc() const;
+        glm::vec3 getVeloc() const;
 
-		void setAccel(glm::vec3 const &acceleration);
+        void setAccel(glm::vec3 const &acceleration);
         glm::vec3 getAccel() const;
-        
-        void setModel(glm::mat4 const &model);
 
         glm::mat4 getRotation() const;
-        void setRotation(glm::mat4 const &rotation);        
-        
-        static int getSnowAmount();
-        
+        void setRotation(glm::mat4 const &rotation);
+
+        // Acceleration of a flake from gravity, air drag, wind and a random
+        // horizontal offset force.
+        static glm::vec3 computeAcceleration(glm::vec3 const &velocity, float mass,
+            glm::vec3 const &wind, glm::vec3 const &offset);
+
+        // Velocity the drag settles a flake at in a steady wind, whatever
+        // its mass, which it reaches within a fraction of a second.
+        static glm::vec3 computeTerminalVelocity(glm::vec3 const &wind);
+
     private:
 
         float m_size;
         glm::vec3 mPosition, mVelocity, mAcceleration;
-        glm::vec3 computeVelocity(float deltaTime, glm::vec3 const &velocity);
-        glm::vec3 computeVelocity(float deltaTime);        
-		glm::vec3 computeAcceleration(float deltaTime, glm::vec3 const &velocity);		
-        glm::vec3 computeAcceleration(glm::vec3 const &position, glm::vec3 const &velocity);
-        
-        std::default_random_engine m_Gen;
-        std::normal_distribution<float> m_NormDistr;  
-        std::uniform_real_distribution<float> m_UniDistr;  
-                
-        static int amountSnow;
         glm::mat4 mRotMat;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,9 +1,18 @@
 #ifndef SnowAccum_hpp
 #define SnowAccum_hpp
 
+#include "DepositionLog.hpp"
+#include "SkyExposure.hpp"
+#include "SnowTransport.hpp"
 #include <atlas/utils/Geometry.hpp>
+#include <atlas/utils/HeightfieldExporter.hpp>
+#include <random>
 #include <vector>
 
+class CheckpointWriter;
+class CheckpointReader;
+class Terrain;
+
 class SnowAccum : public atlas::utils::Geometry
 {
     public:
@@ -17,8 +26,76 @@ class SnowAccum : public atlas::utils::Geometry
         void drawGui() override;         
 
         void refreshNearestVert(glm::vec3 const &query);        
+
+        // Deposits the snow that falls over the given span of time starting
+        // at the given time, without simulating any flakes. The expected
+        // number of flakes landing around every cell comes from the spawn
+        // rate, the wind carrying them from the spawn box and the exposure
+        // of the cell, and the actual number is drawn from it, in steps much
+        // longer than a frame.
+        void fastForward(double time, float duration);
+
+        // The four cells around a point of the ground, clamped to the grid,
+        // and their bilinear weights.
+        struct Footprint
+        {
+            int cells[4];
+            float weights[4];
+        };
+
+        Footprint getFootprint(float x, float z) const;
+
+        // Height of the snow surface at a point, interpolated bilinearly
+        // between the cells, and the normal of that interpolated surface.
+        float sampleHeight(float x, float z, glm::vec3 &normal) const;
+
+        int getCellCount() const;
+        glm::vec3 getCellPosition(int cell) const;
+        float getCellArea() const;
+        float getSnowDepth(int cell) const;
+
+        // Lowers the snow of every cell by the given depth, as dug out by
+        // something rolling through it. Logged like a shift.
+        void removeSnow(std::vector<float> const &depths);
+
+        // Checkpointing of the accumulated snow heights and alpha.
+        // checkState tells whether loadState would succeed without changing
+        // anything, so a scene can check every part before loading any.
+        void saveState(CheckpointWriter &writer) const;
+        bool checkState(CheckpointReader const &reader) const;
+        bool loadState(CheckpointReader const &reader);
+
+        // Restarts the deposition history from the current surface.
+        void resetHistory(float time);
+
+        // Scrolls the grid, with its snow, transport and exposure, to stay
+        // centred on the given point, in steps of a few cells. Snow scrolled
+        // off the grid is dropped and new cells start bare. The move is
+        // logged, so the history carries on across it.
+        void setCentre(glm::vec2 const &centre);
+
+        // Writes the current surface to a mesh file in the background.
+        bool exportSurface(std::string const &filename, atlas::utils::HeightfieldFormat format, bool skirt);
                         
     private:
+
+        void updateHistory(glm::mat4 const &viewProj);
+        void updateNormals();
+
+        // Runs the snow transport, logging its moves like deposits.
+        void moveSnow(double time);
+
+        // Flakes expected to land per second in the square around each cell
+        // of the grid and of a border reaching as far as a flake deposits.
+        void computeLandingRates(std::vector<float> &rates, int border) const;
+        void uploadPositions(std::vector<glm::vec4> const &positions);
+
+        // Moves every cell by the change in the terrain under it, keeping
+        // the depth of the snow there.
+        void followGround(Terrain const &terrain);
+
+        // Places the solid rim around the edges of the grid on the terrain.
+        void placeRim(Terrain const &terrain);
         
         GLuint m_VAO;
         GLuint m_AlphaBuffPos, mNormBuff, mTexCoordBuff, m_IdxBuff;  
@@ -33,6 +110,36 @@ class SnowAccum : public atlas::utils::Geometry
         std::vector<GLuint> mIndices;
         
         bool m_snowAccum;
+
+        // How much snow can reach each part of the ground past the scenery.
+        SkyExposure m_Exposure;
+
+        // Sliding and drifting of the snow that has landed.
+        SnowTransport m_Transport;
+
+        // Deposition history and the surface rebuilt from it for inspection.
+        DepositionLog m_Log;
+        std::vector<glm::vec4> m_History;
+        std::vector<char> m_TileValid;
+
+        // Highest each cell has been since the history started. Snow that
+        // slid or drifted away leaves the live surface lower than the past.
+        std::vector<float> m_PeakHeights;
+
+        // Revision of the terrain the cells last followed.
+        std::uint64_t m_GroundRevision;
+
+        // Corner of the grid with the lowest x and z.
+        glm::vec2 m_GridOrigin;
+
+        bool m_Inspect;
+        float m_InspectTime, m_HistoryTime;
+
+        // Draws the flakes landing in each fast-forward step.
+        std::default_random_engine m_Random;
+
+        atlas::utils::HeightfieldExporter m_Exporter;
+        bool m_ExportSkirt;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef SnowCache_hpp
+#define SnowCache_hpp
+
+#include "Snow.hpp"
+#include <atlas/core/MappedFile.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Animation caches hold the SnowInstance records of every recorded frame.
+// Frames are appended as 64 byte aligned blocks while recording and a frame
+// index is written at the end, so playback can jump to any frame directly
+// and draw it from the mapped file without copying it first.
+
+// Bump whenever the layout of the cache changes.
+const std::uint32_t kSnowCacheVersion = 2;
+
+struct SnowCacheHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t instanceSize;
+    std::uint64_t frameCount;
+    std::uint64_t indexOffset;
+    std::uint8_t reserved[32];
+};
+
+// The instances of a frame are quantized around its origin.
+struct SnowCacheFrame
+{
+    std::uint64_t offset;
+    std::uint32_t count;
+    float time;
+    float origin[3];
+    float reserved;
+};
+
+class SnowCacheWriter
+{
+    public:
+
+        SnowCacheWriter();
+        ~SnowCacheWriter();
+
+        bool open(std::string const &filename);
+        bool close();
+        bool isOpen() const;
+
+        void appendFrame(float time, glm::vec3 const &origin, std::vector<SnowInstance> const &instances);
+        std::size_t getFrameCount() const;
+
+    private:
+
+        std::FILE *m_File;
+        std::uint64_t m_Offset;
+        std::vector<SnowCacheFrame> m_Frames;
+};
+
+class SnowCacheReader
+{
+    public:
+
+        SnowCacheReader();
+
+        bool open(std::string const &filename);
+        void close();
+        bool isOpen() const;
+
+        std::size_t getFrameCount() const;
+        float getFrameTime(std::size_t frame) const;
+        glm::vec3 getFrameOrigin(std::size_t frame) const;
+
+        // Returns the instances of a frame inside the mapped file.
+        SnowInstance const *getFrame(std::size_t frame, std::size_t &count) const;
+
+    private:
+
+        atlas::core::MappedFile m_File;
+        const SnowCacheHeader *m_Header;
+        const SnowCacheFrame *m_Frames;
+};
+
+#endif
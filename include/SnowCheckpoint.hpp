@@ -0,0 +1,137 @@
+#ifndef SnowCheckpoint_hpp
+#define SnowCheckpoint_hpp
+
+#include <atlas/core/MappedFile.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Checkpoints are a flat binary file: a 64 byte header, a list of sections
+// and a section table at the end. Every section starts on a 64 byte boundary
+// and holds a tightly packed array, so once the file is mapped a section can
+// be copied straight into the matching std::vector with a single memcpy.
+
+// Builds the four character tag that identifies a section.
+constexpr std::uint32_t checkpointTag(char const (&name)[5])
+{
+    return (std::uint32_t)(unsigned char)name[0] |
+        ((std::uint32_t)(unsigned char)name[1] << 8) |
+        ((std::uint32_t)(unsigned char)name[2] << 16) |
+        ((std::uint32_t)(unsigned char)name[3] << 24);
+}
+
+// Bump whenever the layout of any section changes.
+const std::uint32_t kCheckpointVersion = 1;
+
+// Positions are stored as 16-bit offsets inside their bounding box.
+const std::uint32_t kCheckpointQuantized = 1 << 0;
+
+struct CheckpointHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t flags;
+    std::uint64_t sectionCount;
+    std::uint64_t tableOffset;
+    std::uint8_t reserved[32];
+};
+
+struct CheckpointSection
+{
+    std::uint32_t tag;
+    std::uint32_t elementSize;
+    std::uint64_t count;
+    std::uint64_t offset;
+    std::uint64_t reserved;
+};
+
+class CheckpointWriter
+{
+    public:
+
+        CheckpointWriter();
+        ~CheckpointWriter();
+
+        bool open(std::string const &filename, std::uint32_t flags);
+        bool close();
+
+        std::uint32_t getFlags() const;
+
+        void writeSection(std::uint32_t tag, std::uint32_t elementSize, std::size_t count, const void *data);
+
+        template <typename T>
+        void writeSection(std::uint32_t tag, std::vector<T> const &data)
+        {
+            writeSection(tag, sizeof(T), data.size(), data.data());
+        }
+
+        template <typename T>
+        void writeValue(std::uint32_t tag, T const &value)
+        {
+            writeSection(tag, sizeof(T), 1, &value);
+        }
+
+    private:
+
+        // Pads the file up to the next section boundary, returning it.
+        std::uint64_t pad();
+
+        std::FILE *m_File;
+        std::uint32_t m_Flags;
+        std::uint64_t m_Offset;
+        std::vector<CheckpointSection> m_Sections;
+};
+
+class CheckpointReader
+{
+    public:
+
+        CheckpointReader();
+
+        bool open(std::string const &filename);
+
+        std::uint32_t getFlags() const;
+
+        // Returns the mapped section data, or null if the section is missing
+        // or its elements are not elementSize bytes.
+        const void *findSection(std::uint32_t tag, std::uint32_t elementSize, std::size_t &count) const;
+
+        template <typename T>
+        bool readSection(std::uint32_t tag, std::vector<T> &data) const
+        {
+            std::size_t count;
+            const void *src = findSection(tag, sizeof(T), count);
+            if (!src)
+            {
+                return false;
+            }
+
+            data.resize(count);
+            std::memcpy(data.data(), src, count * sizeof(T));
+            return true;
+        }
+
+        template <typename T>
+        bool readValue(std::uint32_t tag, T &value) const
+        {
+            std::size_t count;
+            const void *src = findSection(tag, sizeof(T), count);
+            if (!src || count != 1)
+            {
+                return false;
+            }
+
+            std::memcpy(&value, src, sizeof(T));
+            return true;
+        }
+
+    private:
+
+        atlas::core::MappedFile m_File;
+        const CheckpointHeader *m_Header;
+        std::vector<CheckpointSection> m_Table;
+};
+
+#endif
@@ -1,9 +1,16 @@
 #ifndef SnowFall_hpp
 #define SnowFall_hpp
 
+#include "FlakeGrid.hpp"
+#include "MortonSort.hpp"
 #include "Snow.hpp"
 #include <atlas/utils/Geometry.hpp>
+#include <cstdint>
 #include <vector>
+#include <random>
+
+class CheckpointWriter;
+class CheckpointReader;
 
 class SnowFall : public atlas::utils::Geometry
 {
@@ -14,26 +21,147 @@ class SnowFall : public atlas::utils::Geometry
 
         void updateGeometry(atlas::core::Time<> const &t) override;        
         void renderGeometry(atlas::math::Matrix4 const &projection, atlas::math::Matrix4 const &view) override;    
+        void drawGui() override;
+
+        void addSnow(Snow const &snowflake); 
+        int getSnowAmount() const;
+
+        // Drops every falling flake, as when the snowfall is fast-forwarded
+        // and the flakes are not simulated.
+        void clear();
+
+        // Instances built from the simulated flakes on the last update, and
+        // the point their positions are quantized around.
+        std::vector<SnowInstance> const &getInstances() const;
+        glm::vec3 getInstanceOrigin() const;
+
+        // Sets the flakes to draw, quantized around the given origin. The
+        // data is read straight from the given memory when the flakes are
+        // drawn, so it can point into a mapped animation cache, and has to
+        // stay valid until then.
+        void showInstances(SnowInstance const *instances, std::size_t count, glm::vec3 const &origin);
+
+        // The region in x and z the flakes live in. With wrapping on, a flake
+        // leaving it through one side comes back in through the opposite one,
+        // so the region can move with the camera without losing flakes or
+        // gathering new ones. The instances are quantized around its centre.
+        void setDomain(glm::vec2 const &lo, glm::vec2 const &hi, bool wrap);
 
-        void addSnow(std::unique_ptr<Snow> snowflake); 
-        GLuint getSnowDepthTexture() const;       
+        // Whether only the flakes near the camera are simulated, and how far
+        // from it horizontally. The rest are settled straight away and left
+        // to the impostor layers to draw.
+        bool isNearFieldEnabled() const;
+        float getNearRadius() const;
+
+        // Checkpointing of the falling flakes.
+        // checkState tells whether loadState would succeed without changing
+        // anything, so a scene can check every part before loading any.
+        void saveState(CheckpointWriter &writer) const;
+        bool checkState(CheckpointReader const &reader) const;
+        bool loadState(CheckpointReader const &reader);
                 
     private:
 
-        int m_MapRes;
-        GLuint m_SnowFBO;
-        GLuint m_DepthTex;
-        
+        glm::vec3 computeOffset();
+
+        // Reorders the flakes along a Morton curve through their positions,
+        // so flakes close in space are close in memory. Every call runs one
+        // pass of the sort, and the order is applied once it is complete.
+        void sortBySpace();
+        void cancelSort();
+
+        template <typename T>
+        void permute(std::vector<T> &values) const;
+
+        // Moves a flake to a lower index while removing flakes, and sets the
+        // number of flakes once they are removed.
+        void moveFlake(std::size_t from, std::size_t to);
+        void resizeFlakes(std::size_t count);
+
+        // Merges flakes that touch into heavier clumps.
+        void clump();
+
+        // Lands a flake that is not simulated where it would come to rest,
+        // walking it down from the position at its terminal velocity.
+        void settle(glm::vec3 position, float mass);
+        bool isNear(glm::vec3 const &position, glm::vec3 const &camera, float margin) const;
+
+        // Uploads the shown flakes that are inside the view frustum.
+        void cullInstances(glm::mat4 const &viewProj);
+
         GLuint m_VAO;
-        GLuint m_PosBuff, m_ColBuff, m_IdxBuff;        
+        GLuint m_PosBuff, m_IdxBuff, m_InstBuff;        
         
-        std::vector<glm::vec3> m_VertPos, m_VertColors;
-        std::vector<GLint> mVertexIndices;
+        std::vector<SnowInstance> m_Instances;
+        GLsizei m_InstanceCount;
+
+        // Flakes set to be drawn, and the ones of them in view on the last
+        // frame with their bands, the count of each band found in each
+        // chunk culled, and the visible flakes ordered by band as uploaded.
+        SnowInstance const *m_Shown;
+        std::size_t m_ShownCount;
+        glm::vec3 m_ShownOrigin;
+        bool m_CullEnabled;
+        std::vector<SnowInstance> m_Visible, m_Drawn;
+        std::vector<std::uint8_t> m_VisibleBands;
+        std::vector<std::size_t> m_CullCounts;
+        std::size_t m_BandStarts[3];
+        GLsizei m_BandCounts[3];
+        float m_CullTime;
+
+        // Level of detail: where flakes turn from hexagons into quads and
+        // from quads into points, how far past those a flake has to be to
+        // change, the camera on the last frame, and the band of every flake
+        // and of every instance of the last step.
+        float m_QuadDistance, m_PointDistance, m_LodMargin;
+        glm::vec3 m_Eye;
+        std::vector<std::uint8_t> m_Bands, m_InstanceBands;
+
+        // Region the flakes live in, whether they wrap around it, and the
+        // point the simulated flakes are quantized around.
+        glm::vec2 m_DomainMin, m_DomainMax;
+        bool m_Wrap;
+        glm::vec3 m_InstanceOrigin;
+
+        // Near field mode, and the number of flakes settled outside it.
+        bool m_NearField;
+        float m_NearRadius;
+        int m_SettledCount;
+
+        // Falling flakes, one entry per flake in each array.
+        std::vector<glm::vec3> m_Positions, m_Velocities, m_Accelerations;
+        std::vector<float> m_Masses;
+        std::vector<glm::quat> m_Rotations;
+
+        // Whether each flake touched the dome or a prop this step.
+        std::vector<std::uint8_t> m_Landed;
+
+        // Wind at each flake, sampled once per step.
+        std::vector<glm::vec3> m_Winds;
+
+        // Spatial sorting every few steps, with the cost of the last sort
+        // and the number of steps it took, and the same for the sort in
+        // progress. While it runs, every flake keeps its index from when the
+        // keys were taken, and once it is done every one of those flakes
+        // gets its index now, and the flakes are gathered in the new order.
+        bool m_SortEnabled;
+        int m_SortInterval, m_StepsSinceSort;
+        float m_SortTime, m_SortElapsed;
+        int m_SortSteps, m_SortStepCount;
+        MortonSort m_Sort;
+        std::vector<std::uint32_t> m_SortSources, m_SortTargets, m_SortOrder;
 
-        std::vector<std::unique_ptr<Snow>> m_Snowflakes;     
+        // Clumping of touching flakes, with the flake each one merges into
+        // on this step and the size and cost of the last step's merging.
+        bool m_ClumpEnabled;
+        FlakeGrid m_Grid;
+        std::vector<std::uint32_t> m_Partners;
+        int m_MergeCount;
+        float m_ClumpTime;
         
         std::default_random_engine m_Gen;        
-        std::normal_distribution<float> m_SnowSizeDistr;                  
+        std::normal_distribution<float> m_OffsetDistr;
+        std::uniform_real_distribution<float> m_AngleDistr;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,39 @@
+#ifndef SnowImpostor_hpp
+#define SnowImpostor_hpp
+
+#include <atlas/utils/Geometry.hpp>
+
+// Draws the snow falling outside the near field, when only the flakes near
+// the camera are simulated. The far field is cut into a few shells around
+// the camera, and each shell is drawn as one cylinder textured with flakes
+// that scroll down and along with the wind. A shell stands for all the
+// snow in its slab, so its texture shows as many flakes per square metre as
+// the slab holds: the spawn rate over the fall speed, times the slab depth.
+// The textures come in levels of doubling density, every level holding the
+// flakes of the one below, and each shell blends the two around its own.
+class SnowImpostor : public atlas::utils::Geometry
+{
+    public:
+
+        SnowImpostor();
+        ~SnowImpostor();
+
+        void updateGeometry(atlas::core::Time<> const &t) override;
+        void renderGeometry(atlas::math::Matrix4 const &projection, atlas::math::Matrix4 const &view) override;
+        void drawGui() override;
+
+    private:
+
+        void createTexture();
+        void createMesh();
+        void loadAndCompileShaders();
+
+        float m_Time;
+        int m_LayerCount;
+        float m_DensityScale;
+
+        GLuint m_VAO, m_VertexBuffer, m_Texture;
+        GLsizei m_VertexCount;
+};
+
+#endif
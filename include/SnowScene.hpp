@@ -5,7 +5,15 @@
 #include "SnowfallGenerator.hpp"
 #include "SnowFall.hpp"
 #include "SnowAccum.hpp"
+#include "SnowVolume.hpp"
+#include "Snowballs.hpp"
+#include "SnowImpostor.hpp"
+#include "SnowCache.hpp"
+#include "WindField.hpp"
 #include <atlas/utils/Scene.hpp>
+#include <string>
+
+class Surface;
 
 class SnowScene : public atlas::utils::Scene
 {
@@ -27,26 +35,57 @@ class SnowScene : public atlas::utils::Scene
 		glm::vec3 getCameraPosition() const;
 		glm::vec3 getLightPosition() const;
 		
-		void addSnow(std::unique_ptr<Snow> snowflake);
+		void addSnow(Snow const &snowflake);
 		SnowFall const& getSnowFall() const;
+		SnowfallGenerator const &getGenerator() const;
 		SnowAccum & getSnowAccum();
+		SnowVolume & getSnowVolume();
+		Surface & getSurface();
 		glm::vec3 getForceWind();	
+		WindField const &getWindField() const;
+
+		bool saveCheckpoint(std::string const &filename, bool quantize);
+		bool loadCheckpoint(std::string const &filename);
 		
 	private:
+		// Moves the spawn box, the region the flakes wrap around and the
+		// ground they land on with the camera, or back over the scene.
+		void updateDomain();
+
 		glm::mat4 mProjection;
 		float mWidth, mHeight;
 
 		bool m_snowPause;
 
+		// Skipping through the snowfall without simulating the flakes, and
+		// how many seconds of it pass each second.
+		bool m_FastForward;
+		float m_FastForwardRate;
+
+		// Whether the snowfall follows the camera.
+		bool m_FollowCamera;
+
 		SnowFall m_SnowFall;
 		SnowAccum m_SnowAccum;
+		SnowVolume m_SnowVolume;
+		Snowballs m_Snowballs;
+		SnowImpostor m_Impostor;
 
 		float mTheta, mRow;
 
 		glm::vec3 m_forceDir;
+		WindField m_WindField;
 
 		glm::vec3 m_LightCoords;
 
+		SnowfallGenerator *m_Generator;
+		Surface *m_Surface;
+		bool m_QuantizeCheckpoint;
+
+		SnowCacheWriter m_CacheWriter;
+		SnowCacheReader m_CacheReader;
+		int m_CacheFrame;
+
 };
 
 #endif
@@ -0,0 +1,85 @@
+#ifndef SnowTransport_hpp
+#define SnowTransport_hpp
+
+#include <atlas/math/Math.hpp>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// Moves snow that has already landed on the accumulation grid. Snow on
+// slopes steeper than the angle of repose slides downhill, and exposed snow
+// is blown downwind once the wind is strong enough to lift it. Both are
+// Jacobi passes over the heights that move snow across the edges between
+// cells, so the amount of snow is kept. Only tiles that received snow or
+// changed in the last pass are processed, together with their neighbours,
+// and the passes run at their own rate rather than every frame.
+class SnowTransport
+{
+    public:
+
+        // A change in height of one cell, for the caller to log and apply.
+        struct Shift
+        {
+            int cell;
+            float height;
+        };
+
+        SnowTransport(int gridSize, float spacing, int tileSize);
+
+        // Heights of the bare ground, which no pass digs below.
+        void setGround(std::vector<glm::vec4> const &grid);
+        void setGround(int cell, float height);
+        float getGround(int cell) const;
+
+        void markDirty(int cell);
+        void markAllDirty();
+
+        // Wind at a batch of points, and the exposure of a point on the
+        // ground.
+        typedef std::function<void(glm::vec3 const *, std::size_t, glm::vec3 *)> WindSampler;
+        typedef std::function<float(float, float)> ExposureSampler;
+
+        // Runs a pass over the dirty tiles if one is due. The grid holds the
+        // position and coverage of every cell, x and z fixed, y the height.
+        void update(double time, std::vector<glm::vec4> const &grid, WindSampler const &wind,
+            ExposureSampler const &exposure);
+
+        // Height changes made by the last pass.
+        std::vector<Shift> const &getShifts() const;
+
+        // Widgets for the current ImGui window.
+        void drawGui();
+
+    private:
+
+        void collectTiles();
+        void loadHeights(std::vector<glm::vec4> const &grid);
+        void drift(float dt, std::vector<glm::vec4> const &grid, WindSampler const &wind,
+            ExposureSampler const &exposure, float const *from, float *to);
+        void slide(float const *from, float *to);
+        void storeShifts(std::vector<glm::vec4> const &grid, float const *heights);
+
+        // Whether the neighbouring cell across each side of a tile can
+        // exchange snow: inside the grid and in a tile of this pass.
+        void getOpenSides(int tile, bool &left, bool &right, bool &down, bool &up) const;
+
+        int m_GridSize, m_TileSize, m_TilesPerSide;
+        float m_Spacing;
+
+        bool m_Avalanche, m_Drift;
+        float m_ReposeAngle, m_Rate;
+        double m_PassTime;
+
+        std::vector<float> m_Ground;
+        std::vector<char> m_Dirty, m_Active;
+        std::vector<int> m_Tiles;
+
+        // Ping-pong heights, and the snow each cell sends along x and z
+        // in a drift pass.
+        std::vector<float> m_Heights[2];
+        std::vector<float> m_DriftX, m_DriftZ;
+
+        std::vector<Shift> m_Shifts;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef SnowVolume_hpp
+#define SnowVolume_hpp
+
+#include <atlas/utils/Geometry.hpp>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Snow resting on the dome and props, which the ground heightfield can't
+// hold: caps on top of the cubes, drifts against their sides and ledges that
+// grow out over the gaps. The snow is stored in sparse 8^3 bricks of voxel
+// densities, found through a hash of the brick coordinates, so memory
+// follows the snow surface rather than the scene volume. Bricks that change
+// are meshed with surface nets on a worker thread and only their meshes are
+// uploaded again.
+class SnowVolume : public atlas::utils::Geometry
+{
+    public:
+
+        SnowVolume(float voxelSize = 0.1f);
+        ~SnowVolume();
+
+        void renderGeometry(atlas::math::Matrix4 const &projection, atlas::math::Matrix4 const &view) override;
+        void drawGui() override;
+
+        // Whether flakes that land on the scenery are deposited here
+        // instead of on the nearest ground vertex.
+        bool isEnabled() const;
+
+        // Adds a flake landed at a point of the scenery, with the normal of
+        // the surface it landed on.
+        void deposit(glm::vec3 const &position, glm::vec3 const &normal);
+
+        // Removes all the snow.
+        void clear();
+
+    private:
+
+        static const int kBrickSize = 8;
+        static const int kBrickVoxels = kBrickSize * kBrickSize * kBrickSize;
+
+        // Densities from 0 (empty) to 255 (packed), and a bit per voxel
+        // telling whether it holds any snow, one word per z slice.
+        struct Brick
+        {
+            glm::ivec3 coord;
+            std::uint64_t occupancy[kBrickSize];
+            std::uint8_t density[kBrickVoxels];
+            bool dirty;
+        };
+
+        struct BrickMesh
+        {
+            GLuint vao, vertexBuffer, indexBuffer;
+            GLsizei indexCount;
+        };
+
+        struct MeshVertex
+        {
+            glm::vec3 position;
+            glm::vec3 normal;
+        };
+
+        // The densities a brick is meshed from, with one voxel of its
+        // neighbours on every side, and the mesh made from them.
+        struct MeshJob
+        {
+            std::size_t brick;
+            glm::ivec3 coord;
+            std::vector<std::uint8_t> samples;
+            std::vector<MeshVertex> vertices;
+            std::vector<GLuint> indices;
+        };
+
+        Brick *findBrick(glm::ivec3 const &coord);
+        std::size_t getBrick(glm::ivec3 const &coord);
+        void markDirty(std::size_t brick);
+        void touchVoxel(glm::ivec3 const &voxel);
+
+        // Gathers the dirty bricks on this thread and meshes them on the
+        // worker; uploads the meshes of the last batch once it is done.
+        void update();
+        void gatherSamples(MeshJob &job);
+        void meshBrick(MeshJob &job) const;
+        void meshAll();
+        void upload(MeshJob const &job);
+
+        void loadAndCompileShaders();
+
+        float m_VoxelSize;
+        bool m_Enabled;
+
+        std::unordered_map<std::uint64_t, std::size_t> m_Lookup;
+        std::vector<Brick> m_Bricks;
+        std::vector<BrickMesh> m_Meshes;
+        std::vector<std::size_t> m_Dirty;
+
+        std::thread m_Worker;
+        std::atomic<bool> m_Done;
+        std::vector<MeshJob> m_Jobs;
+        float m_BatchTime;
+
+        // Size and cost of the last finished batch, for display.
+        int m_MeshedBricks;
+        float m_MeshTime;
+};
+
+#endif
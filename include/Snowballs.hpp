@@ -0,0 +1,76 @@
+#ifndef Snowballs_hpp
+#define Snowballs_hpp
+
+#include "FlakeGrid.hpp"
+#include "SnowAccum.hpp"
+#include <atlas/math/RandomGenerator.hpp>
+#include <atlas/utils/DistanceField.hpp>
+#include <atlas/utils/Geometry.hpp>
+#include <vector>
+
+// Snowballs rolling over the accumulated snow. Every ball is a rigid sphere
+// stored across a set of per-ball arrays, and every stage of a step is a
+// parallel loop in which a ball only writes its own entries: the contacts
+// with the heightfield and the scenery, the collisions between balls found
+// through a broadphase grid, and the snow the balls pick up. A cell of the
+// heightfield can be under several balls, so the snow taken from it is
+// gathered per cell and shared out between the balls afterwards. The balls
+// are drawn as instances of a single sphere.
+class Snowballs : public atlas::utils::Geometry
+{
+    public:
+
+        Snowballs();
+        ~Snowballs();
+
+        void updateGeometry(atlas::core::Time<> const &t) override;
+        void renderGeometry(atlas::math::Matrix4 const &projection, atlas::math::Matrix4 const &view) override;
+        void drawGui() override;
+
+        // Throws new balls in above the ground.
+        void spawn(int count);
+        void clear();
+
+        int getCount() const;
+
+    private:
+
+        void step(float dt, SnowAccum &accum, atlas::utils::DistanceField const &field);
+        void collideBalls();
+        void collideScene(float dt, SnowAccum const &accum, atlas::utils::DistanceField const &field);
+        void pickUpSnow(float dt, SnowAccum &accum);
+
+        void loadAndCompileShaders();
+
+        std::vector<glm::vec3> m_Positions, m_Velocities, m_Spins;
+        std::vector<float> m_Radii;
+
+        // Whether each ball rests on the snow on this step, and its
+        // footprint there.
+        std::vector<char> m_Grounded;
+        std::vector<SnowAccum::Footprint> m_Footprints;
+
+        // Scratch of the stages: corrections from the collisions between
+        // balls, the volume of snow each ball tries to pick up and where on
+        // the ground it is, and per cell the share of the requests it can
+        // meet and the depth taken.
+        std::vector<glm::vec3> m_PositionFixes, m_VelocityFixes;
+        std::vector<float> m_Requests;
+        std::vector<glm::vec3> m_GroundPoints;
+        std::vector<float> m_CellShares, m_CellDepths;
+
+        // Balls by position for the collisions between them, and by their
+        // position on the ground for the heightfield cells.
+        FlakeGrid m_Grid, m_GroundGrid;
+
+        atlas::math::RandomGenerator<float> m_Random;
+        int m_SpawnCount;
+        float m_StepTime;
+
+        GLuint m_VAO;
+        GLuint m_VertexBuffer, m_IndexBuffer, m_InstanceBuffer;
+        GLsizei m_IndexCount;
+        std::vector<glm::vec4> m_Instances;
+};
+
+#endif
@@ -2,7 +2,11 @@
 #define SnowfallGenerator_hpp
 
 #include <atlas/utils/Geometry.hpp>
-#include <random>
+#include <atlas/math/RandomGenerator.hpp>
+#include <vector>
+
+class CheckpointWriter;
+class CheckpointReader;
 
 class SnowfallGenerator : public atlas::utils::Geometry
 {
@@ -12,16 +16,39 @@ class SnowfallGenerator : public atlas::utils::Geometry
 
         void updateGeometry(atlas::core::Time<> const &t) override;
         void drawGui();
+
+        // Fills the air with the flakes a steady snowfall at the given
+        // terminal velocity would have falling, each part of the way down
+        // its path, so the snowfall goes on from where a fast-forward left
+        // it rather than starting over from the top.
+        void reseed(glm::vec3 const &velocity);
                 
         void setBBox(glm::vec3 const &a, glm::vec3 const &b);
+
+        // Moves the bounding box by the given offset, as when it follows
+        // the camera. The box returned includes the offset.
+        void setOffset(glm::vec3 const &offset);
+        glm::vec3 getBBoxMin() const;
+        glm::vec3 getBBoxMax() const;
+
+        // Flakes spawned per second.
+        float getRate() const;
+
+        // checkState tells whether loadState would succeed without changing
+        // anything, so a scene can check every part before loading any.
+        void saveState(CheckpointWriter &writer) const;
+        bool checkState(CheckpointReader const &reader) const;
+        bool loadState(CheckpointReader const &reader);
         
     private:
 
-        glm::vec3 m_BBoxA, m_BBoxB;
+        glm::vec3 m_BBoxA, m_BBoxB, m_Offset;
+
+        atlas::math::RandomGenerator<float> m_Random;
 
-        std::default_random_engine m_Gen;
-        std::uniform_real_distribution<float> m_UniDistrX, m_UniDistrY, m_UniDistrZ;
-        std::uniform_real_distribution<float> m_UniDistrVec, m_UniDistrAngle;        
+        // Variates for the flakes spawned this frame, drawn in bulk.
+        std::vector<glm::vec3> m_SpawnPositions, m_SpawnAxes;
+        std::vector<float> m_SpawnAngles;
 
         int m_SnowingRate;
         
@@ -1,40 +1,81 @@
 #ifndef Surface_hpp
 #define Surface_hpp
 
+#include "Terrain.hpp"
 #include <atlas/utils/Geometry.hpp>
+#include <atlas/gl/StaticBatch.hpp>
+#include <atlas/utils/BVH.hpp>
+#include <atlas/utils/DistanceField.hpp>
 
 class Surface : public atlas::utils::Geometry
 {
     public:
 
-        Surface();
+        Surface(float domeRadius = 4.0f, float domeHeight = 3.0f, int domeLayers = 15, float cubeSize = 0.5f);
 
         void renderGeometry(atlas::math::Matrix4 const &proj, atlas::math::Matrix4 const &view) override;    
+        void drawGui() override;
 
-        struct Cube {
-            std::vector<glm::vec3> vertexColors;
-            std::vector<glm::vec2> texCoords;
-            std::vector<glm::vec3> vertexPos;
-            std::vector<glm::vec3> vertexNorm;
-        };
+        // Rebuilds the dome of cubes with the given shape.
+        void setDome(float radius, float height, int layers, float cubeSize);
+
+        // Adds another static mesh drawn with the scene shader.
+        std::size_t addProp(std::vector<atlas::gl::BatchVertex> const &vertices, std::vector<GLuint> const &indices,
+            std::vector<glm::vec4> const &instances = { glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) });
+
+        // Signed distance to the dome and props, for colliding particles.
+        atlas::utils::DistanceField const &getDistanceField() const;
+
+        // Hash of the collision geometry, which changes whenever the
+        // distance field does.
+        std::uint64_t getGeometryKey() const;
+
+        // Ground under the scene when a terrain file is present, flat
+        // otherwise.
+        Terrain const &getTerrain() const;
+
+        // Keeps the full resolution terrain under the simulated region
+        // around the given point.
+        void setSimulatedCentre(glm::vec2 const &centre);
+
+        // Hierarchies of everything that can shelter the ground from snow.
+        std::vector<atlas::utils::BVH const *> getOccluders() const;
+
+        // Returns the region covered by geometry that changed since the last
+        // call, old and new, or false if nothing changed.
+        bool takeChangedRegion(atlas::utils::BBox &region);
                         
     private:
-        
-        GLuint m_VAO;
-        GLuint m_PosBuff, m_NormBuff, m_ColBuff, m_TexCoordBuff;
 
-        GLuint m_Snowball_VAO;
-        GLuint m_Snowball_PosBuff, m_Snowball_NormBuff, m_Snowball_ColBuff, m_Snowball_TexCoordBuff;
+        // All static geometry shares the scene shader, so it is drawn as one batch.
+        atlas::gl::StaticBatch m_Batch;
+        std::size_t m_GroundMesh, m_DomeMesh;
+        Terrain m_Terrain;
+
+        // Collision geometry: one box per dome cube, and the prop triangles.
+        // The hierarchies are only used to build the distance field quickly.
+        std::vector<atlas::utils::BBox> m_DomeBoxes;
+        std::vector<glm::vec3> m_PropVertices;
+        std::vector<std::uint32_t> m_PropIndices;
+        atlas::utils::BVH m_DomeBVH, m_PropBVH;
+        atlas::utils::DistanceField m_Field;
+        std::uint64_t m_FieldKey;
+        atlas::utils::BBox m_ChangedRegion;
+
+        float m_DomeRadius, m_DomeHeight, m_CubeSize;
+        int m_DomeLayers;
 
         static GLfloat vertexPos[][3], vertexNorm[][3], vertexColors[][3], texCoords[][2];
-        // static GLfloat snowball_vertexPos[][3], snowball_vertexNorm[][3], snowball_vertexColors[][3], snowball_texCoords[][2];
 
         void loadAndCompileShaders();
-        void bufferAndSetTextureCoords(GLuint buffer, GLuint index, GLint size, const GLfloat data[][2], GLint dataSize);
-        void bufferAndSetAttribute(GLuint buffer, GLuint index, GLint size, const GLfloat data[][3], GLint dataSize);
 
-        Cube populateCubeData(glm::vec3 center, float length);
-        void makeFace(glm::vec3 topLeft, glm::vec3 topRight, glm::vec3 bottomLeft, glm::vec3 bottomRight, Surface::Cube &cubeData);
+        // Loads the distance field from the disk cache, or rebuilds it if
+        // the geometry has changed since it was saved.
+        void updateDistanceField();
+        float distanceTo(glm::vec3 const &p) const;
+
+        void makeFace(glm::vec3 topLeft, glm::vec3 topRight, glm::vec3 bottomLeft, glm::vec3 bottomRight,
+            std::vector<atlas::gl::BatchVertex> &vertices, std::vector<GLuint> &indices);
 };
 
 #endif
\ No newline at end of file
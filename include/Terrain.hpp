@@ -0,0 +1,121 @@
+#ifndef Terrain_hpp
+#define Terrain_hpp
+
+#include <atlas/utils/Geometry.hpp>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Ground built from a 16-bit heightmap, too large to keep in memory. The
+// heightmap is converted once into a file of square tiles of 65x65 samples,
+// a quadtree of them from one tile over everything down to the full
+// resolution, where every level takes every other sample of the one below.
+// Only the tiles the view needs are read, on a worker thread, and tiles out
+// of view distance are dropped again. Each frame the quadtree is walked for
+// the tiles in the frustum at a detail that falls off with distance; where a
+// tile borders a coarser one its edge vertices are snapped onto the coarser
+// edge, so no cracks open between levels. The finest tiles under a pinned
+// region are always kept, so the simulation there sees the full detail.
+class Terrain : public atlas::utils::Geometry
+{
+    public:
+
+        Terrain();
+        ~Terrain();
+
+        // Converts a binary PGM (P5) or little-endian square RAW heightmap to
+        // tiles. The spacing is between samples and the height scale is the
+        // height of the largest sample value, both in metres.
+        static bool convert(std::string const &heightmap, std::string const &filename, float spacing,
+            float heightScale);
+
+        // Opens a tile file. The ground is placed so the heightmap centre
+        // is at the origin.
+        bool open(std::string const &filename);
+        void close();
+        bool isOpen() const;
+
+        // Keeps the full detail under the rectangle in x and z.
+        void pinRegion(glm::vec2 const &lo, glm::vec2 const &hi);
+
+        void renderGeometry(atlas::math::Matrix4 const &projection, atlas::math::Matrix4 const &view) override;
+        void drawGui() override;
+
+        // Height and normal of the ground at a point, from the finest tile
+        // that has been loaded there. Zero before anything is open.
+        float getHeight(float x, float z) const;
+        float getHeight(float x, float z, glm::vec3 &normal) const;
+
+        // Changes whenever the loaded tiles change, and with them the
+        // heights returned.
+        std::uint64_t getRevision() const;
+
+    private:
+
+        struct Tile
+        {
+            std::vector<std::uint16_t> samples;
+            GLuint texture;
+            std::uint64_t lastUsed;
+        };
+
+        struct LoadJob
+        {
+            std::uint64_t key;
+            std::vector<std::uint16_t> samples;
+        };
+
+        // A tile picked for drawing and how many of its samples each edge
+        // steps over to meet its neighbour, in -x, +x, -z, +z order.
+        struct DrawTile
+        {
+            std::uint64_t key;
+            glm::vec4 steps;
+        };
+
+        static std::uint64_t makeKey(int depth, int x, int z);
+        static void splitKey(std::uint64_t key, int &depth, int &x, int &z);
+
+        void getTileBounds(std::uint64_t key, glm::vec3 &lo, glm::vec3 &hi) const;
+        Tile const *findFinest(float u, float v, int &depth, int &x, int &z) const;
+        float sampleTile(Tile const &tile, int depth, int x, int z, float u, float v, glm::vec3 *normal) const;
+
+        void select(std::uint64_t key, glm::mat4 const &viewProj, glm::vec3 const &eye);
+        void stitch();
+        void request(std::uint64_t key);
+        void stream(glm::vec3 const &eye);
+        void loadAll();
+        void evict(glm::vec3 const &eye);
+
+        void createMesh();
+        void loadAndCompileShaders();
+
+        // Layout of the open file.
+        std::string m_Filename;
+        int m_Size, m_Depth;
+        float m_Spacing, m_HeightScale, m_BaseHeight;
+        std::vector<std::uint16_t> m_Ranges;
+        glm::vec2 m_Origin;
+
+        std::unordered_map<std::uint64_t, Tile> m_Tiles;
+        std::vector<std::uint64_t> m_Requests, m_Pinned;
+        std::vector<DrawTile> m_Draw;
+        std::uint64_t m_Frame, m_Revision;
+
+        std::ifstream m_File;
+        std::thread m_Worker;
+        std::atomic<bool> m_Done;
+        std::vector<LoadJob> m_Jobs;
+
+        float m_ViewDistance, m_Detail;
+        int m_LoadedTiles;
+
+        GLuint m_VAO, m_VertexBuffer, m_IndexBuffer;
+        GLsizei m_IndexCount;
+};
+
+#endif
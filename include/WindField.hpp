@@ -0,0 +1,98 @@
+#ifndef WindField_hpp
+#define WindField_hpp
+
+#include "WindSolver.hpp"
+#include <atlas/math/Math.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A region of stronger wind. The push fades out smoothly towards the edge of
+// the sphere and, with a period set, pulses on and off over time.
+struct WindGust
+{
+    glm::vec3 center;
+    float radius;
+    glm::vec3 velocity;
+    float period;
+};
+
+// Wind that varies over space and time: the scene wind, turbulence from curl
+// noise and any gust volumes. Evaluating the noise is far too slow to do per
+// flake, so the field is baked into a coarse grid that flakes sample with a
+// single trilinear lookup. The next grid is filled a few slices per update
+// while flakes keep reading the last complete one, then the two are swapped.
+// Optionally the grid only drives a fluid solve around the scene geometry,
+// run at a lower rate than the flakes, and flakes sample its flow instead.
+class WindField
+{
+    public:
+
+        WindField(glm::vec3 const &origin = glm::vec3(-12.0f, -1.0f, -12.0f),
+            glm::vec3 const &size = glm::vec3(24.0f, 15.0f, 24.0f), float cellSize = 1.0f);
+
+        void setBaseWind(glm::vec3 const &wind);
+        void setTurbulence(float strength, float scale);
+
+        // Geometry the simulated wind flows around. The key identifies the
+        // geometry, so it is only voxelized again when the key changes.
+        void setObstacles(atlas::utils::DistanceField const *field, std::uint64_t key);
+        void setSimulated(bool simulated);
+
+        void addGust(WindGust const &gust);
+        void clearGusts();
+        std::vector<WindGust> const &getGusts() const;
+
+        // Fills the next part of the pending grid and swaps it in once done.
+        // Nothing is regenerated while the field is constant in time. Steps
+        // the solver when it is due.
+        void update(double time);
+
+        // Wind at a point, clamped to the grid.
+        glm::vec3 sample(glm::vec3 const &p) const;
+        void sample(glm::vec3 const *points, std::size_t count, glm::vec3 *winds) const;
+
+        void drawGui();
+
+    private:
+
+        // Everything the field is built from, copied when a grid is started
+        // so edits only show up in the next one.
+        struct Settings
+        {
+            glm::vec3 baseWind;
+            float strength, scale;
+            std::vector<WindGust> gusts;
+            double time;
+        };
+
+        void updateGrid(double time);
+        glm::vec3 evaluate(Settings const &settings, glm::vec3 const &p) const;
+        void fillSlices(int begin, int end);
+        bool isAnimated() const;
+
+        glm::vec4 lookup(glm::vec3 const &p) const;
+
+        glm::vec3 m_Origin;
+        float m_CellSize;
+        glm::ivec3 m_Resolution;
+
+        Settings m_Settings, m_Pending;
+        bool m_Dirty, m_Building, m_Ready;
+
+        // Wind in xyz for every node, x fastest. The front grid is complete
+        // and read by the flakes, the back grid is being filled.
+        std::vector<glm::vec4> m_Front, m_Back;
+        int m_FilledSlices;
+        double m_StartTime;
+
+        WindSolver m_Solver;
+        bool m_Simulated;
+        float m_SolverRate;
+        double m_SolveTime;
+        atlas::utils::DistanceField const *m_Obstacles;
+        std::uint64_t m_ObstacleKey;
+        bool m_Voxelized;
+};
+
+#endif
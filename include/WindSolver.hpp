@@ -0,0 +1,94 @@
+#ifndef WindSolver_hpp
+#define WindSolver_hpp
+
+#include <atlas/math/Math.hpp>
+#include <atlas/utils/DistanceField.hpp>
+#include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Stable fluids on a coarse MAC grid, so the wind flows around the dome and
+// props instead of through them and leaves shelter and eddies behind. Each
+// step relaxes towards the ambient wind, advects semi-Lagrangian and projects
+// with a preconditioned conjugate gradient solve. The sides and top of the
+// domain are open to the ambient wind; the bottom and the voxelized scene
+// geometry are walls.
+class WindSolver
+{
+    public:
+
+        WindSolver(glm::vec3 const &origin, glm::vec3 const &size, int resolution = 64);
+        ~WindSolver();
+
+        // Cells along the longest side of the domain. Clears the obstacles
+        // except the ground, so voxelize again afterwards.
+        void setResolution(int resolution);
+        int getResolution() const;
+
+        // Marks the cells whose centre is inside the geometry or below the
+        // ground as solid.
+        void voxelize(atlas::utils::DistanceField const &field);
+
+        // Advances the flow, pulling it towards the ambient wind.
+        void step(float dt, std::function<glm::vec3(glm::vec3 const &)> const &ambient);
+
+        glm::vec3 sample(glm::vec3 const &p) const;
+        void sample(glm::vec3 const *points, std::size_t count, glm::vec3 *winds) const;
+
+        // Cost of the last step, for display.
+        float getStepTime() const;
+        int getIterations() const;
+
+    private:
+
+        void resize();
+
+        // Work of one thread on the z slices [begin, end) of a step.
+        class Step;
+
+        // The workers live as long as the solver and sleep between steps.
+        // Worker t runs slab t + 1 of each step; the caller runs slab 0.
+        void startWorkers(int count);
+        void stopWorkers();
+        void workerLoop(int thread, unsigned generation);
+
+        glm::vec3 m_Origin, m_Size;
+        int m_Resolution;
+        glm::ivec3 m_Cells;
+        float m_CellSize;
+
+        // Face velocities, the x faces of cell (i, j, k) at index i, and the
+        // same after advection.
+        std::vector<float> m_Faces[3], m_Advected[3];
+
+        // Per cell: solid flags, the number of neighbours that are not
+        // walls and its inverse, and the pressure kept to warm start the
+        // next solve. Per face: whether it is a wall, open or in the fluid.
+        std::vector<std::uint8_t> m_Solid, m_FaceKinds[3];
+        std::vector<float> m_Diagonal, m_InverseDiagonal;
+        std::vector<float> m_Pressure;
+
+        // Scratch vectors of the solve, and the ambient wind per cell.
+        std::vector<float> m_Residual, m_Search, m_Product, m_Preconditioned;
+        std::vector<glm::vec4> m_Ambient;
+
+        // Cell centred velocities that flakes sample, x fastest.
+        std::vector<glm::vec4> m_Velocity;
+
+        float m_StepTime;
+        int m_Iterations;
+
+        std::vector<std::thread> m_Workers;
+        std::mutex m_Mutex;
+        std::condition_variable m_Wake, m_Done;
+        Step *m_Work;
+        unsigned m_Generation;
+        int m_Running;
+        bool m_Stopping;
+};
+
+#endif
@@ -13,3 +13,6 @@ find_package(OpenGL REQUIRED)
 if (NOT OPENGL_FOUND)
     message(STATUS "Atlas requires OpenGL to run.")
 endif()
+
+# The frame capture encoder and parallelFor run on std::thread.
+find_package(Threads REQUIRED)
@@ -0,0 +1,109 @@
+/**
+ * \file MappedFile.hpp
+ * \brief Defines a read-only memory mapping of a file.
+ */
+
+#ifndef ATLAS_INCLUDE_ATLAS_CORE_MAPPED_FILE_HPP
+#define ATLAS_INCLUDE_ATLAS_CORE_MAPPED_FILE_HPP
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace atlas
+{
+    namespace core
+    {
+        /**
+         * \class MappedFile
+         * \brief Maps the contents of a file into the address space.
+         *
+         * The pages are brought in by the operating system as they are
+         * touched, so opening a large file is essentially free and reading
+         * from it is a plain memory access. On platforms where mapping is not
+         * available (or fails) the file is read into memory instead, so the
+         * interface behaves the same either way.
+         */
+        class MappedFile
+        {
+        public:
+            /**
+             * Standard constructor. No file is opened.
+             */
+            MappedFile();
+
+            /**
+             * Opens and maps the specified file.
+             *
+             * \param[in] filename The file to map.
+             */
+            MappedFile(std::string const& filename);
+
+            /**
+             * Move constructor. The mapping is transferred to the new object.
+             *
+             * \param[in] rhs The mapping to move.
+             */
+            MappedFile(MappedFile&& rhs);
+
+            /**
+             * Move assignment operator.
+             *
+             * \param[in] rhs The mapping to move.
+             *
+             * \return The moved mapping.
+             */
+            MappedFile& operator=(MappedFile&& rhs);
+
+            /**
+             * Unmaps the file.
+             */
+            ~MappedFile();
+
+            /**
+             * Opens and maps the specified file, closing any file that was
+             * previously open.
+             *
+             * \param[in] filename The file to map.
+             *
+             * \return True if the file could be opened, false otherwise.
+             */
+            bool open(std::string const& filename);
+
+            /**
+             * Unmaps the file. Any pointers returned by \c data become
+             * invalid.
+             */
+            void close();
+
+            /**
+             * Returns whether a file is currently mapped.
+             *
+             * \return True if a file is open, false otherwise.
+             */
+            bool isOpen() const;
+
+            /**
+             * Returns a pointer to the first byte of the file.
+             *
+             * \return The file contents, or null if no file is open.
+             */
+            const unsigned char* data() const;
+
+            /**
+             * Returns the size of the mapped file in bytes.
+             *
+             * \return The size of the file.
+             */
+            std::size_t size() const;
+
+        private:
+            struct MappedFileImpl;
+            std::unique_ptr<MappedFileImpl> mImpl;
+        };
+    }
+}
+
+#endif
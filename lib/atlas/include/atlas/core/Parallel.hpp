@@ -0,0 +1,117 @@
+/**
+ *	\file Parallel.hpp
+ *	\brief Defines a pool of worker threads and a parallel loop over a range
+ *	of indices that runs on it.
+ */
+
+#ifndef ATLAS_INCLUDE_ATLAS_CORE_PARALLEL_HPP
+#define ATLAS_INCLUDE_ATLAS_CORE_PARALLEL_HPP
+
+#pragma once
+
+#include "Core.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace atlas
+{
+    namespace core
+    {
+        /**
+         * \class ThreadPool
+         * \brief A fixed set of worker threads that stay alive between jobs.
+         *
+         * Starting a thread costs far more than the small loops that are run
+         * every frame, so the workers are started once and sleep until there
+         * is work. A job is split into blocks, which the workers and the
+         * calling thread take in turn until none are left. Jobs submitted
+         * from several threads at once share the workers, while a job
+         * started from inside a job runs on the calling thread alone.
+         */
+        class ThreadPool
+        {
+        public:
+            /**
+             * Returns the pool shared by parallelFor, with a worker for every
+             * hardware thread besides the calling one.
+             */
+            static ThreadPool& getInstance();
+
+            /**
+             * Starts the given number of workers.
+             *
+             * \param[in] workers The number of worker threads.
+             */
+            ThreadPool(std::size_t workers);
+
+            /**
+             * Stops the workers once they finish the blocks they are running.
+             */
+            ~ThreadPool();
+
+            ThreadPool(ThreadPool const&) = delete;
+            ThreadPool& operator=(ThreadPool const&) = delete;
+
+            /**
+             * Returns the number of threads a job runs on, which is one more
+             * than the number of workers.
+             */
+            std::size_t getThreadCount() const;
+
+            /**
+             * Calls \c task once for every block in [0, blocks) and returns
+             * once every block has been processed.
+             *
+             * \param[in] blocks The number of blocks.
+             * \param[in] task The callable invoked with each block.
+             */
+            void run(std::size_t blocks,
+                std::function<void(std::size_t)> const& task);
+
+        private:
+            struct ThreadPoolImpl;
+            std::unique_ptr<ThreadPoolImpl> mImpl;
+        };
+
+        /**
+         * Calls \c function once for every index in [begin, end). The range
+         * is split into contiguous blocks, one per thread of the shared
+         * ThreadPool, and the blocks are run concurrently. The call returns
+         * once every index has been processed, so the function must not
+         * depend on the order in which indices are visited.
+         *
+         * \param[in] begin The first index.
+         * \param[in] end One past the last index.
+         * \param[in] function The callable invoked with each index.
+         */
+        template <typename Function>
+        void parallelFor(std::size_t begin, std::size_t end,
+            Function const& function)
+        {
+            if (end <= begin)
+            {
+                return;
+            }
+
+            ThreadPool& pool = ThreadPool::getInstance();
+            std::size_t count = end - begin;
+            std::size_t blocks = std::min(count, pool.getThreadCount());
+            std::size_t block = (count + blocks - 1) / blocks;
+
+            pool.run(blocks, [&](std::size_t b)
+            {
+                std::size_t first = begin + b * block;
+                std::size_t last = std::min(end, first + block);
+                for (std::size_t i = first; i < last; ++i)
+                {
+                    function(i);
+                }
+            });
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,130 @@
+/**
+ * \file FrameCapture.hpp
+ * \brief Defines an asynchronous framebuffer capture for image sequences.
+ */
+
+#ifndef ATLAS_INCLUDE_ATLAS_GL_FRAME_CAPTURE_HPP
+#define ATLAS_INCLUDE_ATLAS_GL_FRAME_CAPTURE_HPP
+
+#pragma once
+
+#include "GL.hpp"
+
+#include <memory>
+#include <string>
+
+namespace atlas
+{
+    namespace gl
+    {
+        /**
+         * \enum CaptureFormat
+         * The image formats that a FrameCapture can write.
+         * \var PPM
+         * Binary (P6) portable pixmap. Cheapest to encode.
+         * \var PNG
+         * RGBA PNG written with stored (uncompressed) deflate blocks.
+         * \var Raw
+         * Tightly packed RGBA8 rows, bottom row first, exactly as read back.
+         */
+        enum class CaptureFormat : int
+        {
+            PPM = 0,
+            PNG,
+            Raw
+        };
+
+        /**
+         * \class FrameCapture
+         * \brief Reads back rendered frames without stalling the pipeline.
+         *
+         * A synchronous \c glReadPixels forces the CPU to wait until the GPU
+         * has finished the frame. Instead, each call to \c captureFrame
+         * issues the read into one of a small ring of pixel buffer objects
+         * and fences it. The buffer is only mapped once the ring wraps
+         * around (a few frames later), by which point the transfer has
+         * completed. The pixels are then handed to a background thread that
+         * writes the image files, so neither the transfer nor the encoding
+         * appear on the render thread.
+         *
+         * All functions must be called from the thread that owns the
+         * rendering context.
+         */
+        class FrameCapture
+        {
+        public:
+            /**
+             * Standard constructor. No GL objects are created until
+             * \c start is called.
+             */
+            FrameCapture();
+
+            /**
+             * Stops any capture in progress and joins the encoder thread.
+             */
+            ~FrameCapture();
+
+            FrameCapture(FrameCapture const&) = delete;
+            FrameCapture& operator=(FrameCapture const&) = delete;
+
+            /**
+             * Begins a new capture. Every frame is written as
+             * <tt>prefix_000000.ext</tt>, numbered from zero.
+             *
+             * \param[in] prefix The path prefix for the image files.
+             * \param[in] format The file format to write.
+             * \param[in] framebuffer The framebuffer to read from. 0 reads
+             * the back buffer of the default framebuffer.
+             * \param[in] ringSize The number of pixel buffers in flight.
+             * Clamped to [2, 8].
+             */
+            void start(std::string const& prefix,
+                CaptureFormat format = CaptureFormat::PPM,
+                GLuint framebuffer = 0, int ringSize = 4);
+
+            /**
+             * Flushes the frames still in flight, waits for the encoder to
+             * finish writing them and releases the pixel buffers.
+             */
+            void stop();
+
+            /**
+             * Returns whether a capture is in progress.
+             *
+             * \return True if capturing, false otherwise.
+             */
+            bool isCapturing() const;
+
+            /**
+             * Queues the read back of the current frame. Call this after the
+             * scene has rendered and before the buffers are swapped.
+             *
+             * \param[in] width The width of the region to read.
+             * \param[in] height The height of the region to read.
+             */
+            void captureFrame(int width, int height);
+
+            /**
+             * Returns the number of frames that have been queued since the
+             * last call to \c start.
+             *
+             * \return The number of captured frames.
+             */
+            std::size_t getFramesCaptured() const;
+
+            /**
+             * Returns the number of frames the encoder has written to disk
+             * since the last call to \c start.
+             *
+             * \return The number of written frames.
+             */
+            std::size_t getFramesWritten() const;
+
+        private:
+            struct FrameCaptureImpl;
+            std::unique_ptr<FrameCaptureImpl> mImpl;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * \file StaticBatch.hpp
+ * \brief Defines a batch that draws many static meshes with one submission.
+ */
+
+#ifndef ATLAS_INCLUDE_ATLAS_GL_STATIC_BATCH_HPP
+#define ATLAS_INCLUDE_ATLAS_GL_STATIC_BATCH_HPP
+
+#pragma once
+
+#include "GL.hpp"
+#include "atlas/math/Math.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace atlas
+{
+    namespace gl
+    {
+        /**
+         * \struct BatchVertex
+         * \brief The interleaved vertex format used by a StaticBatch.
+         *
+         * The attributes are bound to locations 0 (position), 1 (normal),
+         * 2 (color) and 3 (texture coordinates). Location 4 receives the
+         * per-instance offset (xyz) and scale (w).
+         */
+        struct BatchVertex
+        {
+            math::Point position;
+            math::Normal normal;
+            math::Vector color;
+            math::Point2 texCoord;
+        };
+
+        /**
+         * \class StaticBatch
+         * \brief Merges immutable meshes that share a shader into one draw.
+         *
+         * Every mesh added to the batch is appended to a single vertex and
+         * index buffer and gets one indirect draw command, together with
+         * its instances. The whole batch is then submitted with a single
+         * \c glMultiDrawElementsIndirect. On contexts older than 4.3 the
+         * commands are issued one by one from the same buffers instead, so
+         * the batch still works (with one draw per mesh) on OpenGL 4.1.
+         *
+         * All functions must be called with the rendering context current.
+         */
+        class StaticBatch
+        {
+        public:
+            /**
+             * Standard constructor. No GL objects are created until
+             * \c build is called.
+             */
+            StaticBatch();
+
+            /**
+             * Releases the GL objects of the batch.
+             */
+            ~StaticBatch();
+
+            StaticBatch(StaticBatch const&) = delete;
+            StaticBatch& operator=(StaticBatch const&) = delete;
+
+            /**
+             * Adds a mesh made of triangles to the batch. The batch must be
+             * rebuilt before the mesh is drawn.
+             *
+             * \param[in] vertices The vertices of the mesh.
+             * \param[in] indices The triangle indices, relative to the mesh.
+             * \param[in] instances The offset (xyz) and scale (w) of every
+             * copy of the mesh to draw.
+             *
+             * \return The index of the mesh within the batch.
+             */
+            std::size_t addMesh(std::vector<BatchVertex> const& vertices,
+                std::vector<GLuint> const& indices,
+                std::vector<math::Vector4> const& instances =
+                { math::Vector4(0.0f, 0.0f, 0.0f, 1.0f) });
+
+            /**
+             * Replaces the instances of a mesh. The batch must be rebuilt
+             * for the change to show.
+             *
+             * \param[in] mesh The index returned by \c addMesh.
+             * \param[in] instances The new instances.
+             */
+            void setInstances(std::size_t mesh,
+                std::vector<math::Vector4> const& instances);
+
+            /**
+             * Removes every mesh from the batch.
+             */
+            void clear();
+
+            /**
+             * Uploads the vertices, indices, instances and draw commands.
+             */
+            void build();
+
+            /**
+             * Draws every mesh in the batch. The shader must already be
+             * enabled.
+             */
+            void draw() const;
+
+            /**
+             * Returns the number of meshes in the batch.
+             *
+             * \return The number of draw commands.
+             */
+            std::size_t getDrawCount() const;
+
+            /**
+             * Returns whether the batch is submitted with a single
+             * multi-draw call.
+             *
+             * \return True if multi-draw indirect is available.
+             */
+            bool isMultiDraw() const;
+
+        private:
+            struct StaticBatchImpl;
+            std::unique_ptr<StaticBatchImpl> mImpl;
+        };
+    }
+}
+
+#endif
@@ -8,6 +8,11 @@
 
 #include "Math.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <random>
 #include <limits>
 
@@ -15,16 +20,205 @@ namespace atlas
 {
     namespace math
     {
+        /**
+         *	The number of independent streams the bulk fill functions of
+         *	RandomGenerator advance together.
+         */
+        const int kRandomLanes = 8;
+
+        /**
+         *	\class Xoshiro256
+         *	\brief The xoshiro256** generator by Blackman and Vigna.
+         *	
+         *	A small and fast 64-bit generator with a period of 
+         *	\f$ 2^{256} - 1 \f$ and 32 bytes of state. It satisfies the
+         *	standard uniform random bit generator requirements, so it can
+         *	drive any of the <tt> \<random\> </tt> distributions.
+         */
+        class Xoshiro256
+        {
+        public:
+            using result_type = std::uint64_t;
+
+            /**
+             *	The raw generator state.
+             */
+            using State = std::array<std::uint64_t, 4>;
+
+            /**
+             *	Constructor with a seed initialization.
+             *	
+             *	@param[in] seed The seed, expanded into the full state.
+             */
+            explicit Xoshiro256(std::uint64_t seed = 0x853C49E6748FEA9Bull)
+            {
+                this->seed(seed);
+            }
+
+            /**
+             *	Resets the state from a single value with splitmix64, which
+             *	never produces the invalid all zero state.
+             *	
+             *	@param[in] seed The seed.
+             */
+            void seed(std::uint64_t seed)
+            {
+                for (std::uint64_t& word : mState)
+                {
+                    word = splitMix(seed);
+                }
+            }
+
+            /**
+             *	Returns the next 64 random bits.
+             */
+            inline result_type operator()()
+            {
+                return step(mState[0], mState[1], mState[2], mState[3]);
+            }
+
+            /**
+             *	Advances one step of the generator held in four words. Used
+             *	directly by the bulk fills to keep the state in registers.
+             */
+            static inline std::uint64_t step(std::uint64_t& s0,
+                std::uint64_t& s1, std::uint64_t& s2, std::uint64_t& s3)
+            {
+                std::uint64_t result = rotl(s1 * 5, 7) * 9;
+                std::uint64_t t = s1 << 17;
+
+                s2 ^= s0;
+                s3 ^= s1;
+                s1 ^= s2;
+                s0 ^= s3;
+                s2 ^= t;
+                s3 = rotl(s3, 45);
+
+                return result;
+            }
+
+            /**
+             *	Returns the next value of a splitmix64 sequence.
+             *	
+             *	@param[in,out] x The sequence position.
+             */
+            static inline std::uint64_t splitMix(std::uint64_t& x)
+            {
+                std::uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                return z ^ (z >> 31);
+            }
+
+            State const& getState() const
+            {
+                return mState;
+            }
+
+            void setState(State const& state)
+            {
+                mState = state;
+            }
+
+            static constexpr result_type min()
+            {
+                return 0;
+            }
+
+            static constexpr result_type max()
+            {
+                return std::numeric_limits<result_type>::max();
+            }
+
+        private:
+            static inline std::uint64_t rotl(std::uint64_t x, int k)
+            {
+                return (x << k) | (x >> (64 - k));
+            }
+
+            State mState;
+        };
+
+        namespace detail
+        {
+            // Maps the top bits of a 64-bit draw to [0, 1).
+            inline float unitReal(std::uint64_t x, float)
+            {
+                return (float)(x >> 40) * (1.0f / 16777216.0f);
+            }
+
+            inline double unitReal(std::uint64_t x, double)
+            {
+                return (double)(x >> 11) * (1.0 / 9007199254740992.0);
+            }
+
+            template <typename GenType>
+            GenType unitReal(std::uint64_t x)
+            {
+                return unitReal(x, GenType(0));
+            }
+
+            // Layers of the ziggurat for the normal distribution, following
+            // the ZIGNOR variant of Marsaglia and Tsang's method by Doornik.
+            template <typename GenType>
+            struct Ziggurat
+            {
+                static const int kLayers = 128;
+                static constexpr double kTail = 3.442619855899;
+                static constexpr double kArea = 9.91256303526217e-3;
+
+                Ziggurat()
+                {
+                    double f = std::exp(-0.5 * kTail * kTail);
+                    double x[kLayers + 1];
+                    x[0] = kArea / f;
+                    x[1] = kTail;
+                    x[kLayers] = 0.0;
+                    for (int i = 2; i < kLayers; ++i)
+                    {
+                        x[i] = std::sqrt(-2.0 * std::log(kArea / x[i - 1] + f));
+                        f = std::exp(-0.5 * x[i] * x[i]);
+                    }
+
+                    for (int i = 0; i < kLayers; ++i)
+                    {
+                        width[i] = GenType(x[i]);
+                        ratio[i] = GenType(x[i + 1] / x[i]);
+                    }
+                    width[kLayers] = GenType(0);
+                }
+
+                static Ziggurat const& get()
+                {
+                    static const Ziggurat table;
+                    return table;
+                }
+
+                GenType width[kLayers + 1];
+                GenType ratio[kLayers];
+            };
+
+            template <typename GenType>
+            constexpr double Ziggurat<GenType>::kTail;
+
+            template <typename GenType>
+            constexpr double Ziggurat<GenType>::kArea;
+        }
+
         /**
          *	\class RandomGenerator
          *	\brief Defines a simple random number generator.
          *	
-         *	This class wraps around the new STD <tt> \<random\> </tt>
-         *	functionality by providing a simple way of getting a random
-         *	number generator running quickly. This is based on the 
-         *	mt19937 generator, which should be sufficient for most
-         *	applications. The class is templated to allow switching
-         *	between floats and doubles.
+         *	This class provides a simple way of getting a random number
+         *	generator running quickly. It is based on the xoshiro256**
+         *	generator, which is much faster and smaller than the mt19937
+         *	and should be sufficient for most applications. The class is
+         *	templated to allow switching between floats and doubles.
+         *	
+         *	Besides single draws, the fill functions write whole buffers of
+         *	variates. They run kRandomLanes generators side by side, seeded
+         *	from the main one on every call, so the inner loops carry no
+         *	dependency between lanes and vectorize.
          *	
          *	@tparam GenType The precision for the generator.
          */
@@ -33,22 +227,25 @@ namespace atlas
         {
         public:
             /**
-             *	Standard constructor initializes everything to default.
+             *	Standard constructor seeds from the random device.
              */
-            RandomGenerator() = default;
+            RandomGenerator() :
+                mEngine(((std::uint64_t)std::random_device{}() << 32) ^
+                    std::random_device{}())
+            { }
 
             /**
              *	Constructor with a seed initialization.
              *	
              *	@param[in] seed The seed for the random number generation.
              */
-            RandomGenerator(std::mt19937::result_type seed) :
+            RandomGenerator(std::uint64_t seed) :
                 mEngine(seed)
             { }
 
             /**
              *	Returns a random real number \f$x\f$ in the range \f$ 
-             *	[min, max] \f$. 
+             *	[min, max) \f$. 
              *	
              *	@param[in] min The minimum range for the random real.
              *	@param[in] max The maximum range for the random real.
@@ -56,8 +253,7 @@ namespace atlas
              */
             inline GenType getRandomReal(GenType min, GenType max)
             {
-                std::uniform_real_distribution<GenType> dist(min, max);
-                return dist(mEngine);
+                return min + (max - min) * detail::unitReal<GenType>(mEngine());
             }
 
             /**
@@ -80,7 +276,19 @@ namespace atlas
              */
             inline GenType getRandomRealOne()
             {
-                return getRandomReal(GenType(0.0), GenType(1.0));
+                return detail::unitReal<GenType>(mEngine());
+            }
+
+            /**
+             *	Returns a normally distributed real number.
+             *	
+             *	@param[in] mean The mean of the distribution.
+             *	@param[in] stddev The standard deviation of the distribution.
+             *	@return A random real number.
+             */
+            inline GenType getRandomNormal(GenType mean, GenType stddev)
+            {
+                return mean + stddev * normalFrom(mEngine());
             }
 
             /**
@@ -108,8 +316,222 @@ namespace atlas
                 return getRandomInt(0, std::numeric_limits<int>::max());
             }
 
+            /**
+             *	Fills a buffer with real numbers in the range 
+             *	\f$ [min, max) \f$.
+             *	
+             *	@param[out] out The buffer to fill.
+             *	@param[in] count The number of values to write.
+             *	@param[in] min The minimum range for the random reals.
+             *	@param[in] max The maximum range for the random reals.
+             */
+            void fillUniform(GenType* out, std::size_t count, GenType min,
+                GenType max)
+            {
+                GenType scale = max - min;
+                generate(out, count, [min, scale](std::uint64_t x)
+                {
+                    return min + scale * detail::unitReal<GenType>(x);
+                });
+            }
+
+            /**
+             *	Fills a buffer with normally distributed real numbers using
+             *	the ziggurat method. The test of the ziggurat rectangles runs
+             *	across the lanes; the rare draws that fall outside of them
+             *	are finished one at a time.
+             *	
+             *	@param[out] out The buffer to fill.
+             *	@param[in] count The number of values to write.
+             *	@param[in] mean The mean of the distribution.
+             *	@param[in] stddev The standard deviation of the distribution.
+             */
+            void fillNormal(GenType* out, std::size_t count, GenType mean,
+                GenType stddev)
+            {
+                using Table = detail::Ziggurat<GenType>;
+                Table const& table = Table::get();
+
+                Lanes lanes(mEngine);
+                std::uint64_t x[kRandomLanes];
+                for (std::size_t i = 0; i < count; i += kRandomLanes)
+                {
+                    lanes.next(x);
+                    int n = (int)std::min<std::size_t>(kRandomLanes, count - i);
+
+                    bool accepted = true;
+                    for (int k = 0; k < kRandomLanes; ++k)
+                    {
+                        int layer = (int)(x[k] & (Table::kLayers - 1));
+                        GenType u = 2 * detail::unitReal<GenType>(x[k]) - 1;
+                        accepted &= std::abs(u) < table.ratio[layer];
+                        if (k < n)
+                        {
+                            out[i + k] = mean + stddev * u * table.width[layer];
+                        }
+                    }
+
+                    if (accepted)
+                    {
+                        continue;
+                    }
+
+                    // Finish the draws that missed their rectangle.
+                    for (int k = 0; k < n; ++k)
+                    {
+                        int layer = (int)(x[k] & (Table::kLayers - 1));
+                        GenType u = 2 * detail::unitReal<GenType>(x[k]) - 1;
+                        if (!(std::abs(u) < table.ratio[layer]))
+                        {
+                            out[i + k] = mean + stddev * normalFrom(x[k]);
+                        }
+                    }
+                }
+            }
+
+            /**
+             *	Fills a buffer with directions uniformly distributed on the
+             *	unit sphere.
+             *	
+             *	@param[out] out The buffer to fill.
+             *	@param[in] count The number of directions to write.
+             */
+            void fillUnitSphere(glm::tvec3<GenType, glm::defaultp>* out,
+                std::size_t count)
+            {
+                generate(out, count, [](std::uint64_t x)
+                {
+                    // Both coordinates come from one draw: z from the high
+                    // 32 bits and the azimuth from the low 32.
+                    GenType z = 2 * detail::unitReal<GenType>(
+                        x & 0xFFFFFFFF00000000ull) - 1;
+                    GenType phi = glm::two_pi<GenType>() *
+                        detail::unitReal<GenType>(x << 32);
+                    GenType r = std::sqrt(std::max(GenType(0), 1 - z * z));
+                    return glm::tvec3<GenType, glm::defaultp>(
+                        r * std::cos(phi), r * std::sin(phi), z);
+                });
+            }
+
+            /**
+             *	Returns the underlying generator, for use with the standard
+             *	distributions or to save and restore its state.
+             */
+            Xoshiro256& getEngine()
+            {
+                return mEngine;
+            }
+
+            Xoshiro256 const& getEngine() const
+            {
+                return mEngine;
+            }
+
         private:
-            std::mt19937 mEngine{ std::random_device{} () };
+            // kRandomLanes generators seeded from the main one, stepped
+            // together.
+            struct Lanes
+            {
+                explicit Lanes(Xoshiro256& engine)
+                {
+                    for (int k = 0; k < kRandomLanes; ++k)
+                    {
+                        std::uint64_t seed = engine();
+                        s0[k] = Xoshiro256::splitMix(seed);
+                        s1[k] = Xoshiro256::splitMix(seed);
+                        s2[k] = Xoshiro256::splitMix(seed);
+                        s3[k] = Xoshiro256::splitMix(seed);
+                    }
+                }
+
+                inline void next(std::uint64_t* x)
+                {
+                    for (int k = 0; k < kRandomLanes; ++k)
+                    {
+                        x[k] = Xoshiro256::step(s0[k], s1[k], s2[k], s3[k]);
+                    }
+                }
+
+                std::uint64_t s0[kRandomLanes], s1[kRandomLanes];
+                std::uint64_t s2[kRandomLanes], s3[kRandomLanes];
+            };
+
+            // Writes transform(x) for one 64-bit draw x per output value.
+            template <typename T, typename Transform>
+            void generate(T* out, std::size_t count, Transform transform)
+            {
+                Lanes lanes(mEngine);
+                std::uint64_t x[kRandomLanes];
+
+                std::size_t i = 0;
+                for (; i + kRandomLanes <= count; i += kRandomLanes)
+                {
+                    lanes.next(x);
+                    for (int k = 0; k < kRandomLanes; ++k)
+                    {
+                        out[i + k] = transform(x[k]);
+                    }
+                }
+
+                if (i < count)
+                {
+                    lanes.next(x);
+                    int rest = (int)(count - i);
+                    for (int k = 0; k < rest && k < kRandomLanes; ++k)
+                    {
+                        out[i + k] = transform(x[k]);
+                    }
+                }
+            }
+
+            // One standard normal variate by the full ziggurat algorithm,
+            // starting from the draw x.
+            GenType normalFrom(std::uint64_t x)
+            {
+                using Table = detail::Ziggurat<GenType>;
+                Table const& table = Table::get();
+
+                for (;; x = mEngine())
+                {
+                    int i = (int)(x & (Table::kLayers - 1));
+                    GenType u = 2 * detail::unitReal<GenType>(x) - 1;
+                    if (std::abs(u) < table.ratio[i])
+                    {
+                        return u * table.width[i];
+                    }
+
+                    if (i == 0)
+                    {
+                        return normalTail(u < 0);
+                    }
+
+                    GenType z = u * table.width[i];
+                    GenType f0 = std::exp(GenType(-0.5) *
+                        (table.width[i] * table.width[i] - z * z));
+                    GenType f1 = std::exp(GenType(-0.5) *
+                        (table.width[i + 1] * table.width[i + 1] - z * z));
+                    if (f1 + getRandomRealOne() * (f0 - f1) < GenType(1))
+                    {
+                        return z;
+                    }
+                }
+            }
+
+            // Samples beyond the base layer with Marsaglia's tail method.
+            GenType normalTail(bool negative)
+            {
+                GenType tail = GenType(detail::Ziggurat<GenType>::kTail);
+                GenType x, y;
+                do
+                {
+                    x = std::log(1 - getRandomRealOne()) / tail;
+                    y = std::log(1 - getRandomRealOne());
+                } while (-2 * y < x * x);
+
+                return negative ? x - tail : tail - x;
+            }
+
+            Xoshiro256 mEngine;
         };
     }
 }
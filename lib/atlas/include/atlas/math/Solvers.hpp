@@ -31,6 +31,12 @@
  *                correct but multiple roots might be reported more
  *                than once.
  * 
+ * Every solver comes in three forms: one taking \c std::vector for
+ * compatibility, one taking fixed size \c std::array that never allocates,
+ * and a batched form that solves kSolverLanes equations at once with the
+ * lanes laid out side by side so the arithmetic vectorizes. All three run
+ * the same sequence of operations and return identical roots.
+ * 
  * \warning
  * As of the time of this writing, this code is still experimental as it 
  * hasn't been fully tested.
@@ -41,9 +47,10 @@
 
 #pragma once
 
-#include "Math.h"
+#include "Math.hpp"
 #include "atlas/core/Float.hpp"
 
+#include <array>
 #include <vector>
 #include <cmath>
 
@@ -51,6 +58,264 @@ namespace atlas
 {
     namespace math
     {
+        namespace detail
+        {
+            // Values this close to zero are taken as zero, like EQN_EPS in
+            // the original. The relative comparison of core::isZero only
+            // accepts an exact zero, which drops double roots and splits
+            // quartics whose resolvent leaves u or v a rounding error below
+            // zero.
+            template <typename GenType>
+            constexpr GenType zeroTolerance()
+            {
+                return GenType(1e-9);
+            }
+
+            template <>
+            constexpr float zeroTolerance<float>()
+            {
+                return 1e-6f;
+            }
+
+            template <typename GenType>
+            bool isZero(GenType x)
+            {
+                return x > -zeroTolerance<GenType>() &&
+                    x < zeroTolerance<GenType>();
+            }
+
+            template <typename GenType>
+            int solveQuadric(GenType const* coeffs, GenType* roots)
+            {
+                using detail::isZero;
+
+                // Quadratic: x^2 + px + q = 0
+                GenType p, q, D;
+                p = coeffs[1] / (2 * coeffs[2]);
+                q = coeffs[0] / coeffs[2];
+
+                D = p * p - q;
+
+                if (isZero<GenType>(D))
+                {
+                    roots[0] = -p;
+                    return 1;
+                }
+                else if (D > GenType(0.0))
+                {
+                    GenType sqrtD = glm::sqrt(D);
+                    roots[0] = sqrtD - p;
+                    roots[1] = -sqrtD - p;
+                    return 2;
+                }
+                else
+                {
+                    return 0;
+                }
+            }
+
+            // The depressed cubic y^3 + py + q = 0 with discriminant D. This
+            // is the part of the solve that needs transcendental functions,
+            // so the batched solver runs it one lane at a time.
+            template <typename GenType>
+            int solveDepressedCubic(GenType p, GenType q, GenType cbP,
+                GenType D, GenType* roots)
+            {
+                using detail::isZero;
+
+                if (isZero<GenType>(D))
+                {
+                    if (isZero<GenType>(q))
+                    {
+                        // Multiplicity 3.
+                        roots[0] = 0;
+                        return 1;
+                    }
+                    else
+                    {
+                        // Multiplicity 2 and 1.
+                        GenType u = std::cbrt(-q);
+                        roots[0] = 2 * u;
+                        roots[1] = -u;
+                        return 2;
+                    }
+                }
+                else if (D < 0)
+                {
+                    // Multiplicity 1 all.
+                    GenType phi = GenType(1.0) / GenType(3.0) *
+                        glm::acos(-q / glm::sqrt(-cbP));
+                    GenType t = 2 * glm::sqrt(-p);
+
+                    roots[0] = t * glm::cos(phi);
+                    roots[1] = -t * glm::cos(phi + glm::pi<GenType>() /
+                        GenType(3));
+                    roots[2] = -t * glm::cos(phi - glm::pi<GenType>() /
+                        GenType(3));
+                    return 3;
+                }
+                else
+                {
+                    // One real solution.
+                    GenType sqrtD = glm::sqrt(D);
+                    GenType u = std::cbrt(sqrtD - q);
+                    GenType v = -std::cbrt(sqrtD + q);
+
+                    roots[0] = u + v;
+                    return 1;
+                }
+            }
+
+            template <typename GenType>
+            int solveCubic(GenType const* coeffs, GenType* roots)
+            {
+                GenType sub;
+                GenType A, B, C;
+                GenType sqA, p, q;
+                GenType cbP, D;
+
+                // Cubic: x^3 + Ax^2 + Bx + C = 0
+                A = coeffs[2] / coeffs[3];
+                B = coeffs[1] / coeffs[3];
+                C = coeffs[0] / coeffs[3];
+
+                // Substitute x = y - A/3 to eliminate quadric term:
+                // x^3 + px + q = 0
+                sqA = A * A;
+                p = GenType(1.0) / GenType(3.0) * (-GenType(1.0) /
+                    GenType(3.0) * sqA + B);
+                q = GenType(1.0) / GenType(2.0) * (GenType(2.0) /
+                    GenType(27) * A * sqA -
+                    GenType(1.0) / GenType(3.0) * A * B + C);
+
+                // Use Cardano's formula.
+                cbP = p * p * p;
+                D = q * q + cbP;
+
+                int num = solveDepressedCubic<GenType>(p, q, cbP, D, roots);
+
+                // Resubstitute.
+                sub = GenType(1.0) / GenType(3) * A;
+
+                for (int i = 0; i < num; ++i)
+                {
+                    roots[i] -= sub;
+                }
+
+                return num;
+            }
+
+            template <typename GenType>
+            int solveQuartic(GenType const* coeffs, GenType* roots)
+            {
+                using detail::isZero;
+
+                GenType c[4];
+                GenType z, u, v, sub;
+                GenType A, B, C, D;
+                GenType sqA, p, q, r;
+                int num;
+
+                // Quartic: x^4 + Ax^3 + Bx^2 + Cx + D = 0.
+                A = coeffs[3] / coeffs[4];
+                B = coeffs[2] / coeffs[4];
+                C = coeffs[1] / coeffs[4];
+                D = coeffs[0] / coeffs[4];
+
+                // Substitute x = y - A / 4 to eliminate cubic term:
+                // x^4 + px^2 + qx + r = 0.
+
+                sqA = A * A;
+                p = -GenType(3.0) / GenType(8) * sqA + B;
+                q = GenType(1.0) / GenType(8) * sqA * A - GenType(1.0) /
+                    GenType(2) * A * B + C;
+                r = -GenType(3.0) / GenType(256) * sqA * sqA + GenType(1.0) /
+                    GenType(16) * sqA * B - GenType(1.0) / GenType(4) * A * C + D;
+
+                if (isZero<GenType>(r))
+                {
+                    // No absolute term: y(y^3 + py + q) = 0.
+                    c[0] = q;
+                    c[1] = p;
+                    c[2] = 0;
+                    c[3] = 1;
+
+                    num = solveCubic<GenType>(c, roots);
+                    roots[num++] = 0;
+                }
+                else
+                {
+                    // Solve the resolvent cubic...
+                    c[0] = GenType(1.0) / GenType(2) * r * p - GenType(1.0) /
+                        GenType(8) * q * q;
+                    c[1] = -r;
+                    c[2] = -GenType(1.0) / GenType(2) * p;
+                    c[3] = 1;
+
+                    solveCubic<GenType>(c, roots);
+
+                    // And take the one real solution
+                    z = roots[0];
+
+                    // To build two quadratics.
+                    u = z * z - r;
+                    v = 2 * z - p;
+
+                    if (isZero<GenType>(u))
+                    {
+                        u = 0;
+                    }
+                    else if (u > 0)
+                    {
+                        u = glm::sqrt(u);
+                    }
+                    else
+                    {
+                        return 0;
+                    }
+
+                    if (isZero<GenType>(v))
+                    {
+                        v = 0;
+                    }
+                    else if (v > 0)
+                    {
+                        v = glm::sqrt(v);
+                    }
+                    else
+                    {
+                        return 0;
+                    }
+
+                    c[0] = z - u;
+                    c[1] = (q < 0) ? -v : v;
+                    c[2] = 1;
+
+                    num = solveQuadric<GenType>(c, roots);
+
+                    c[0] = z + u;
+                    c[1] = (q < 0) ? v : -v;
+                    c[2] = 1;
+
+                    GenType s[2] = { 0, 0 };
+                    int tmp = num;
+                    num += solveQuadric<GenType>(c, s);
+                    roots[tmp] = s[0];
+                    roots[tmp + 1] = s[1];
+                }
+
+                // Resubstitute.
+                sub = GenType(1.0) / GenType(4) * A;
+
+                for (int i = 0; i < num; ++i)
+                {
+                    roots[i] -= sub;
+                }
+
+                return num;
+            }
+        }
+
         /**
          *	Solves equations of degree 2. The coefficients are specified from
          *	lowest to highest degree.
@@ -64,31 +329,7 @@ namespace atlas
         int solveQuadric(std::vector<GenType>& coeffs,
             std::vector<GenType>& roots)
         {
-            using atlas::core::isZero;
-
-            // Quadratic: x^2 + px + q = 0
-            GenType p, q, D;
-            p = coeffs[1] / (2 * coeffs[2]);
-            q = coeffs[0] / coeffs[2];
-
-            D = p * p - q;
-
-            if (isZero<GenType>(D))
-            {
-                roots[0] = -p;
-                return 1;
-            }
-            else if (D > GenType(0.0))
-            {
-                GenType sqrtD = glm::sqrt(D);
-                roots[0] = sqrtD - p;
-                roots[1] = -sqrtD - p;
-                return 2;
-            }
-            else
-            {
-                return 0;
-            }
+            return detail::solveQuadric<GenType>(coeffs.data(), roots.data());
         }
 
         /**
@@ -103,207 +344,289 @@ namespace atlas
         int solveCubic(std::vector<GenType>& coeffs, 
             std::vector<GenType>& roots)
         {
-            using atlas::core::isZero;
-
-            int num;
-            GenType sub;
-            GenType A, B, C;
-            GenType sqA, p, q;
-            GenType cbP, D;
-
-            // Cubic: x^3 + Ax^2 + Bx + C = 0
-            A = coeffs[2] / coeffs[3];
-            B = coeffs[1] / coeffs[3];
-            C = coeffs[0] / coeffs[3];
-
-            // Substitute x = y - A/3 to eliminate quadric term:
-            // x^3 + px + q = 0
-            sqA = A * A;
-            p = GenType(1.0) / GenType(3.0) * (-GenType(1.0) /
-                GenType(3.0) * sqA + B);
-            q = GenType(1.0) / GenType(3.0) * (GenType(2.0) /
-                GenType(27) * A * sqA -
-                GenType(1.0) / GenType(3.0) * A * B + C);
-
-            // Use Cardano's formula.
-            cbP = p * p * p;
-            D = q * q + cbP;
-
-            if (isZero<GenType>(D))
+            return detail::solveCubic<GenType>(coeffs.data(), roots.data());
+        }
+
+        /**
+         *	Solves equations of degree 4. The coefficients are specified from
+         *	lowest to highest exponent as above. The roots list must hold at
+         *	least 4 values.
+         *	
+         *	@tparam GenType The precision to use.	
+         *	@param[in] coeffs The coefficient list.
+         *	@param[out] roots The roots of the equation (if any).
+         *	@return The number of roots it could find.
+         */
+        template <typename GenType = float>
+        int solveQuartic(std::vector<GenType>& coeffs,
+            std::vector<GenType>& roots)
+        {
+            return detail::solveQuartic<GenType>(coeffs.data(), roots.data());
+        }
+
+        /**
+         *	Solves equations of degree 2 without allocating.
+         *	
+         *	@tparam GenType The precision to use.
+         *	@param[in] coeffs The coefficients, lowest degree first.
+         *	@param[out] roots The roots of the equation (if any).
+         *	@return The number of roots it could find.
+         */
+        template <typename GenType = float>
+        int solveQuadric(std::array<GenType, 3> const& coeffs,
+            std::array<GenType, 2>& roots)
+        {
+            return detail::solveQuadric<GenType>(coeffs.data(), roots.data());
+        }
+
+        /**
+         *	Solves equations of degree 3 without allocating.
+         *	
+         *	@tparam GenType The precision to use.
+         *	@param[in] coeffs The coefficients, lowest degree first.
+         *	@param[out] roots The roots of the equation (if any).
+         *	@return The number of roots it could find.
+         */
+        template <typename GenType = float>
+        int solveCubic(std::array<GenType, 4> const& coeffs,
+            std::array<GenType, 3>& roots)
+        {
+            return detail::solveCubic<GenType>(coeffs.data(), roots.data());
+        }
+
+        /**
+         *	Solves equations of degree 4 without allocating.
+         *	
+         *	@tparam GenType The precision to use.
+         *	@param[in] coeffs The coefficients, lowest degree first.
+         *	@param[out] roots The roots of the equation (if any).
+         *	@return The number of roots it could find.
+         */
+        template <typename GenType = float>
+        int solveQuartic(std::array<GenType, 5> const& coeffs,
+            std::array<GenType, 4>& roots)
+        {
+            return detail::solveQuartic<GenType>(coeffs.data(), roots.data());
+        }
+
+        /**
+         *	The number of equations solved together by the batched solvers.
+         */
+        const int kSolverLanes = 8;
+
+        /**
+         *	One value for every equation of a batch.
+         *	
+         *	@tparam GenType The precision to use.
+         */
+        template <typename GenType = float>
+        using SolverLanes = std::array<GenType, kSolverLanes>;
+
+        /**
+         *	Solves kSolverLanes equations of degree 2 at once. Coefficients
+         *	and roots are stored by term, so <tt>coeffs[i][k]</tt> is the
+         *	coefficient of x^i in equation k. Root slots past the count of an
+         *	equation are left unspecified.
+         *	
+         *	@tparam GenType The precision to use.
+         *	@param[in] coeffs The coefficients, lowest degree first.
+         *	@param[out] roots The roots of every equation.
+         *	@param[out] counts The number of roots of every equation.
+         */
+        template <typename GenType = float>
+        void solveQuadrics(std::array<SolverLanes<GenType>, 3> const& coeffs,
+            std::array<SolverLanes<GenType>, 2>& roots,
+            std::array<int, kSolverLanes>& counts)
+        {
+            using detail::isZero;
+
+            // Both branches are evaluated and selected per lane.
+            for (int k = 0; k < kSolverLanes; ++k)
             {
-                if (isZero<GenType>(q))
-                {
-                    // Multiplicity 3.
-                    roots[0] = 0;
-                    num = 1;
-                }
-                else
-                {
-                    // Multiplicity 2 and 1.
-                    GenType u = std::cbrt(-q);
-                    roots[0] = 2 * u;
-                    roots[1] = -u;
-                    num = 2;
-                }
+                GenType p = coeffs[1][k] / (2 * coeffs[2][k]);
+                GenType q = coeffs[0][k] / coeffs[2][k];
+                GenType D = p * p - q;
+
+                bool zero = isZero<GenType>(D);
+                bool positive = !zero && D > GenType(0.0);
+                GenType sqrtD = glm::sqrt(positive ? D : GenType(0.0));
+
+                roots[0][k] = positive ? sqrtD - p : -p;
+                roots[1][k] = -sqrtD - p;
+                counts[k] = positive ? 2 : (zero ? 1 : 0);
             }
-            else if (D < 0)
+        }
+
+        /**
+         *	Solves kSolverLanes equations of degree 3 at once, with the same
+         *	layout as solveQuadrics. The reduction to a depressed cubic and
+         *	the resubstitution run across the lanes; the trigonometric and
+         *	cube root step runs lane by lane.
+         *	
+         *	@tparam GenType The precision to use.
+         *	@param[in] coeffs The coefficients, lowest degree first.
+         *	@param[out] roots The roots of every equation.
+         *	@param[out] counts The number of roots of every equation.
+         */
+        template <typename GenType = float>
+        void solveCubics(std::array<SolverLanes<GenType>, 4> const& coeffs,
+            std::array<SolverLanes<GenType>, 3>& roots,
+            std::array<int, kSolverLanes>& counts)
+        {
+            SolverLanes<GenType> p, q, cbP, D, sub;
+            for (int k = 0; k < kSolverLanes; ++k)
             {
-                // Multiplicity 1 all.
-                GenType phi = GenType(1.0) / GenType(3.0) *
-                    glm::acos(-q / glm::sqrt(-cbP));
-                GenType t = 2 * glm::sqrt(-p);
-
-                roots[0] = t * glm::cos(phi);
-                roots[1] = -t * glm::cos(phi + glm::pi<GenType>() /
-                    GenType(3));
-                roots[2] = -t * glm::cos(phi - glm::pi<GenType>() /
-                    GenType(3));
-                num = 3;
+                GenType A = coeffs[2][k] / coeffs[3][k];
+                GenType B = coeffs[1][k] / coeffs[3][k];
+                GenType C = coeffs[0][k] / coeffs[3][k];
+
+                GenType sqA = A * A;
+                p[k] = GenType(1.0) / GenType(3.0) * (-GenType(1.0) /
+                    GenType(3.0) * sqA + B);
+                q[k] = GenType(1.0) / GenType(2.0) * (GenType(2.0) /
+                    GenType(27) * A * sqA -
+                    GenType(1.0) / GenType(3.0) * A * B + C);
+
+                cbP[k] = p[k] * p[k] * p[k];
+                D[k] = q[k] * q[k] + cbP[k];
+                sub[k] = GenType(1.0) / GenType(3) * A;
             }
-            else
-            {
-                // One real solution.
-                GenType sqrtD = glm::sqrt(D);
-                GenType u = std::cbrt(sqrtD - q);
-                GenType v = -std::cbrt(sqrtD + q);
 
-                roots[0] = u + v;
-                num = 1;
+            for (int k = 0; k < kSolverLanes; ++k)
+            {
+                GenType lane[3] = { 0, 0, 0 };
+                counts[k] = detail::solveDepressedCubic<GenType>(p[k], q[k],
+                    cbP[k], D[k], lane);
+                roots[0][k] = lane[0];
+                roots[1][k] = lane[1];
+                roots[2][k] = lane[2];
             }
 
-            // Resubstitute.
-            sub = GenType(1.0) / GenType(3) * A;
-
-            for (int i = 0; i < num; ++i)
+            for (int i = 0; i < 3; ++i)
             {
-                roots[i] -= sub;
+                for (int k = 0; k < kSolverLanes; ++k)
+                {
+                    roots[i][k] -= (i < counts[k]) ? sub[k] : GenType(0);
+                }
             }
-
-            return num;
         }
 
         /**
-         *	Solves equations of degree 4. The coefficients are specified from
-         *	lowest to highest exponent as above.
+         *	Solves kSolverLanes equations of degree 4 at once, with the same
+         *	layout as solveQuadrics. The resolvent cubics and the two
+         *	quadratics of every lane are solved as batches.
          *	
-         *	@tparam GenType The precision to use.	
-         *	@param[in] coeffs The coefficient list.
-         *	@param[out] roots The roots of the equation (if any).
-         *	@return The number of roots it could find.
+         *	@tparam GenType The precision to use.
+         *	@param[in] coeffs The coefficients, lowest degree first.
+         *	@param[out] roots The roots of every equation.
+         *	@param[out] counts The number of roots of every equation.
          */
         template <typename GenType = float>
-        int solveQuartic(std::vector<GenType>& coeffs,
-            std::vector<GenType>& roots)
+        void solveQuartics(std::array<SolverLanes<GenType>, 5> const& coeffs,
+            std::array<SolverLanes<GenType>, 4>& roots,
+            std::array<int, kSolverLanes>& counts)
         {
-            using atlas::core::isZero;
-
-            std::vector<GenType> c(4);
-            GenType z, u, v, sub;
-            GenType A, B, C, D;
-            GenType sqA, p, q, r;
-            int num;
-
-            // Quartic: x^4 + Ax^3 + Bx^2 + Cx + D = 0.
-            A = coeffs[3] / coeffs[4];
-            B = coeffs[2] / coeffs[4];
-            C = coeffs[1] / coeffs[4];
-            D = coeffs[0] / coeffs[4];
-
-            // Substitute x = y - A / 4 to eliminate cubic term:
-            // x^4 + px^2 + qx + r = 0.
-
-            sqA = A * A;
-            p = GenType(3.0) / GenType(8) * sqA + B;
-            q = GenType(1.0) / GenType(8) * sqA * A - GenType(1.0) /
-                GenType(2) * A * B + C;
-            r = -GenType(3.0) / GenType(256) * sqA * sqA + GenType(1.0) /
-                GenType(16) * sqA * B - GenType(1.0) / GenType(4) * A * C + D;
-
-            if (isZero<GenType>(r))
+            using detail::isZero;
+
+            SolverLanes<GenType> p, q, r, sub;
+            std::array<SolverLanes<GenType>, 4> cubic;
+            for (int k = 0; k < kSolverLanes; ++k)
             {
-                // No absolute term: y(y^3 + py + q) = 0.
-                c[0] = p;
-                c[1] = 1;
-                c[2] = 0;
-                c[3] = 1;
-
-                num = solveCubic<GenType>(c, roots);
-                roots[num++] = 0;
+                GenType A = coeffs[3][k] / coeffs[4][k];
+                GenType B = coeffs[2][k] / coeffs[4][k];
+                GenType C = coeffs[1][k] / coeffs[4][k];
+                GenType D = coeffs[0][k] / coeffs[4][k];
+
+                GenType sqA = A * A;
+                p[k] = -GenType(3.0) / GenType(8) * sqA + B;
+                q[k] = GenType(1.0) / GenType(8) * sqA * A - GenType(1.0) /
+                    GenType(2) * A * B + C;
+                r[k] = -GenType(3.0) / GenType(256) * sqA * sqA + GenType(1.0) /
+                    GenType(16) * sqA * B - GenType(1.0) / GenType(4) * A * C +
+                    D;
+                sub[k] = GenType(1.0) / GenType(4) * A;
+
+                // Either y^3 + py + q when there is no absolute term, or the
+                // resolvent cubic.
+                bool noAbsolute = isZero<GenType>(r[k]);
+                cubic[0][k] = noAbsolute ? q[k] : GenType(1.0) / GenType(2) *
+                    r[k] * p[k] - GenType(1.0) / GenType(8) * q[k] * q[k];
+                cubic[1][k] = noAbsolute ? p[k] : -r[k];
+                cubic[2][k] = noAbsolute ? GenType(0) :
+                    -GenType(1.0) / GenType(2) * p[k];
+                cubic[3][k] = 1;
             }
-            else
-            {
-                // Solve the resolvent cubic...
-                c[0] = GenType(1.0) / GenType(2) * r * p - GenType(1.0) /
-                    GenType(8) * q * q;
-                c[1] = -r;
-                c[2] = -GenType(1.0) / GenType(2) * p;
-                c[3] = 1;
 
-                solveCubic<GenType>(c, roots);
+            std::array<SolverLanes<GenType>, 3> cubicRoots;
+            std::array<int, kSolverLanes> cubicCounts;
+            solveCubics<GenType>(cubic, cubicRoots, cubicCounts);
 
-                // And take the one real solution
-                z = roots[0];
+            // Split every quartic with a nonzero absolute term into two
+            // quadratics.
+            std::array<SolverLanes<GenType>, 3> first, second;
+            std::array<bool, kSolverLanes> real;
+            for (int k = 0; k < kSolverLanes; ++k)
+            {
+                GenType z = cubicRoots[0][k];
+                GenType u = z * z - r[k];
+                GenType v = 2 * z - p[k];
+
+                bool zeroU = isZero<GenType>(u);
+                bool zeroV = isZero<GenType>(v);
+                real[k] = (zeroU || u > 0) && (zeroV || v > 0);
+                u = (zeroU || !real[k]) ? GenType(0) : glm::sqrt(u);
+                v = (zeroV || !real[k]) ? GenType(0) : glm::sqrt(v);
+
+                first[0][k] = z - u;
+                first[1][k] = (q[k] < 0) ? -v : v;
+                first[2][k] = 1;
+                second[0][k] = z + u;
+                second[1][k] = (q[k] < 0) ? v : -v;
+                second[2][k] = 1;
+            }
 
-                // To build two quadratics.
-                u = z * z - r;
-                v = 2 * z - p;
+            std::array<SolverLanes<GenType>, 2> firstRoots, secondRoots;
+            std::array<int, kSolverLanes> firstCounts, secondCounts;
+            solveQuadrics<GenType>(first, firstRoots, firstCounts);
+            solveQuadrics<GenType>(second, secondRoots, secondCounts);
 
-                if (isZero<GenType>(u))
+            for (int k = 0; k < kSolverLanes; ++k)
+            {
+                GenType lane[5] = { 0, 0, 0, 0, 0 };
+                int num;
+                if (isZero<GenType>(r[k]))
                 {
-                    u = 0;
+                    num = cubicCounts[k];
+                    for (int i = 0; i < num; ++i)
+                    {
+                        lane[i] = cubicRoots[i][k];
+                    }
+                    lane[num++] = 0;
                 }
-                else if (u > 0)
+                else if (real[k])
                 {
-                    u = glm::sqrt(u);
+                    num = firstCounts[k];
+                    for (int i = 0; i < num; ++i)
+                    {
+                        lane[i] = firstRoots[i][k];
+                    }
+                    lane[num] = secondRoots[0][k];
+                    lane[num + 1] = secondRoots[1][k];
+                    num += secondCounts[k];
                 }
                 else
                 {
-                    return 0;
+                    num = 0;
                 }
 
-                if (isZero<GenType>(v))
+                counts[k] = num;
+                for (int i = 0; i < 4; ++i)
                 {
-                    v = 0;
-                }
-                else if (v > 0)
-                {
-                    v = glm::sqrt(v);
-                }
-                else
-                {
-                    return 0;
+                    roots[i][k] = lane[i] - ((i < num) ? sub[k] : GenType(0));
                 }
-
-                c[0] = z - u;
-                c[1] = (q < 0) ? -v : v;
-                c[2] = 1;
-
-                num = solveQuadric<GenType>(c, roots);
-
-                c[0] = z + u;
-                c[1] = (q < 0) ? v : -v;
-                c[2] = 1;
-
-
-                std::vector<GenType> s(2);
-                int tmp = num;
-                num += solveQuadric<GenType>(c, s);
-                roots[tmp] = s[0];
-                roots[tmp + 1] = s[1];
             }
-
-            // Resubstitute.
-            sub = GenType(1.0) / GenType(4) * A;
-
-            for (int i = 0; i < num; ++i)
-            {
-                roots[i] -= sub;
-            }
-
-            return num;
-
         }
     }
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -10,6 +10,7 @@
 
 #include "Utils.hpp"
 #include "atlas/gl/GL.hpp"
+#include "atlas/gl/FrameCapture.hpp"
 #include "atlas/core/GLFW.hpp"
 
 #include <string>
@@ -174,6 +175,31 @@ namespace atlas
              */
             GLFWwindow* getCurrentWindow() const;
 
+            /**
+             * Starts writing every rendered frame of the current window to
+             * an image sequence. The frames are read back asynchronously
+             * right before the buffers are swapped, so this does not stall
+             * the main loop. See gl::FrameCapture for details.
+             * 
+             * \param[in] prefix The path prefix for the image files.
+             * \param[in] format The file format to write.
+             */
+            void startFrameCapture(std::string const& prefix,
+                gl::CaptureFormat format = gl::CaptureFormat::PPM);
+
+            /**
+             * Stops the current frame capture (if any) and waits for the
+             * remaining frames to be written.
+             */
+            void stopFrameCapture();
+
+            /**
+             * Returns whether frames are currently being captured.
+             * 
+             * \return True if capturing, false otherwise.
+             */
+            bool isCapturingFrames() const;
+
         private:
             struct ApplicationImpl;
             std::unique_ptr<ApplicationImpl> mImpl;
@@ -1,44 +1,316 @@
+/**
+ * \file BVH.hpp
+ * \brief Defines a bounding volume hierarchy over boxes or triangles.
+ */
+
 #ifndef ATLAS_INCLUDE_ATLAS_UTILS_BVH_HPP
 #define ATLAS_INCLUDE_ATLAS_UTILS_BVH_HPP
 
 #pragma once
 
 #include "Utils.hpp"
+#include "BBox.hpp"
+#include "BVNode.hpp"
 
 #include "atlas/math/Math.hpp"
 
-#include <memory>
+#include <cstdint>
 #include <vector>
 
 namespace atlas
 {
     namespace utils
     {
-        template <class NodeType, class BVType>
+        /**
+         * \struct SegmentHit
+         * \brief The closest intersection of a segment with a BVH.
+         */
+        struct SegmentHit
+        {
+            /**
+             * The parameter of the hit along the segment, in [0, 1].
+             */
+            float t;
+
+            /**
+             * The primitive that was hit, or \c BVH::kNoHit.
+             */
+            std::uint32_t primitive;
+
+            /**
+             * The surface normal at the hit, facing the segment origin.
+             */
+            atlas::math::Normal normal;
+        };
+
+        /**
+         * \class BVH
+         * \brief A bounding volume hierarchy built with the binned surface
+         * area heuristic.
+         *
+         * The tree is stored as a flat array of \c BVNode in a cache aligned
+         * buffer and the primitives are reordered so each leaf covers a
+         * contiguous range. Large builds split the top of the tree on the
+         * calling thread and build the remaining subtrees in parallel. When
+         * primitives move without changing topology the tree can be refit in
+         * a single pass instead of being rebuilt.
+         *
+         * All queries traverse with a fixed size stack and never allocate,
+         * so the batched versions can be run over hundreds of thousands of
+         * queries per frame. Primitives are reported by the index they had in
+         * the arrays passed to \c build.
+         */
         class BVH
         {
         public:
-            BVH() :
-                mRoot(std::make_shared<BVNode<NodeType, BVType>>())
-            { }
+            /**
+             * The primitive index reported when a query finds nothing.
+             */
+            static const std::uint32_t kNoHit = 0xFFFFFFFF;
+
+            /**
+             * The number of segments traced together by \c occluded.
+             */
+            static const int kPacketSize = 8;
+
+            /**
+             * Standard constructor. The hierarchy is empty.
+             */
+            BVH();
+
+            /**
+             * Builds the hierarchy over a set of boxes.
+             *
+             * \param[in] bounds The bounds of each primitive.
+             */
+            void build(std::vector<BBox> const& bounds);
+
+            /**
+             * Builds the hierarchy over an indexed triangle mesh. Segment
+             * queries are resolved against the triangles themselves.
+             *
+             * \param[in] vertices The mesh vertices.
+             * \param[in] indices Three indices per triangle.
+             */
+            void build(std::vector<atlas::math::Point> const& vertices,
+                std::vector<std::uint32_t> const& indices);
+
+            /**
+             * Updates the node bounds after the primitive boxes have moved.
+             * The boxes must be given in the same order as in \c build.
+             *
+             * \param[in] bounds The new bounds of each primitive.
+             */
+            void refit(std::vector<BBox> const& bounds);
+
+            /**
+             * Updates the triangles and node bounds after the mesh vertices
+             * have moved. The indices given to \c build are reused.
+             *
+             * \param[in] vertices The new mesh vertices.
+             */
+            void refit(std::vector<atlas::math::Point> const& vertices);
+
+            /**
+             * Removes every node and primitive.
+             */
+            void clear();
+
+            /**
+             * Returns whether the hierarchy holds any primitives.
+             *
+             * \return True if the hierarchy is empty.
+             */
+            bool empty() const;
+
+            /**
+             * Returns the bounds of the whole hierarchy.
+             *
+             * \return The root bounds.
+             */
+            BBox getGlobalVolume() const;
+
+            /**
+             * Returns the number of nodes in the tree.
+             *
+             * \return The node count.
+             */
+            std::size_t getNodeCount() const;
+
+            /**
+             * Returns the number of primitives in the tree.
+             *
+             * \return The primitive count.
+             */
+            std::size_t getPrimitiveCount() const;
+
+            /**
+             * Calls \c visitor with the index of every primitive whose
+             * bounds contain the point. Traversal stops as soon as the
+             * visitor returns false.
+             *
+             * \param[in] p The query point.
+             * \param[in] visitor Callable taking a primitive index and
+             * returning a bool.
+             */
+            template <class Visitor>
+            void visit(atlas::math::Point const& p, Visitor&& visitor) const
+            {
+                visitNodes(BBox(p), visitor);
+            }
+
+            /**
+             * Calls \c visitor with the index of every primitive whose
+             * bounds overlap the box. Traversal stops as soon as the visitor
+             * returns false.
+             *
+             * \param[in] box The query box.
+             * \param[in] visitor Callable taking a primitive index and
+             * returning a bool.
+             */
+            template <class Visitor>
+            void visit(BBox const& box, Visitor&& visitor) const
+            {
+                visitNodes(box, visitor);
+            }
+
+            /**
+             * Finds the closest primitive crossed by a segment.
+             *
+             * \param[in] from The start of the segment.
+             * \param[in] to The end of the segment.
+             * \param[out] hit The closest hit.
+             *
+             * \return True if the segment hits anything.
+             */
+            bool intersect(atlas::math::Point const& from,
+                atlas::math::Point const& to, SegmentHit& hit) const;
+
+            /**
+             * For every point, finds a primitive whose bounds contain it.
+             *
+             * \param[in] points The query points.
+             * \param[in] count The number of points.
+             * \param[out] hits One primitive index (or \c kNoHit) per point.
+             */
+            void queryPoints(atlas::math::Point const* points,
+                std::size_t count, std::uint32_t* hits) const;
+
+            /**
+             * For every box, finds a primitive whose bounds overlap it.
+             *
+             * \param[in] boxes The query boxes.
+             * \param[in] count The number of boxes.
+             * \param[out] hits One primitive index (or \c kNoHit) per box.
+             */
+            void queryBoxes(BBox const* boxes, std::size_t count,
+                std::uint32_t* hits) const;
+
+            /**
+             * Finds the closest hit of every segment.
+             *
+             * \param[in] from The start of each segment.
+             * \param[in] to The end of each segment.
+             * \param[in] count The number of segments.
+             * \param[out] hits The closest hit of each segment.
+             */
+            void intersectSegments(atlas::math::Point const* from,
+                atlas::math::Point const* to, std::size_t count,
+                SegmentHit* hits) const;
+
+            /**
+             * Tests whether each segment is blocked by any primitive. The
+             * segments are traced in packets of \c kPacketSize that share
+             * one traversal, which suits coherent bundles such as rays cast
+             * from the same point. Segments already marked as occluded are
+             * skipped, so several hierarchies can be tested in turn. Runs on
+             * the calling thread.
+             *
+             * \param[in] from The start of each segment.
+             * \param[in] to The end of each segment.
+             * \param[in] count The number of segments.
+             * \param[in,out] occluded One flag per segment, set to 1 when
+             * the segment is blocked.
+             */
+            void occluded(atlas::math::Point const* from,
+                atlas::math::Point const* to, std::size_t count,
+                std::uint8_t* occluded) const;
+
+        private:
+            static const int kStackSize = 64;
+
+            template <class Visitor>
+            void visitNodes(BBox const& box, Visitor& visitor) const
+            {
+                if (mNodes.empty())
+                {
+                    return;
+                }
+
+                std::uint32_t stack[kStackSize];
+                int top = 0;
+                stack[top++] = 0;
+
+                while (top > 0)
+                {
+                    BVNode const& node = mNodes[stack[--top]];
+                    if (!overlaps(node, box))
+                    {
+                        continue;
+                    }
+
+                    if (!node.isLeaf())
+                    {
+                        stack[top++] = node.offset + 1;
+                        stack[top++] = node.offset;
+                        continue;
+                    }
+
+                    for (std::uint32_t i = node.offset;
+                        i < node.offset + node.count; ++i)
+                    {
+                        if (overlaps(mBounds[i], box) &&
+                            !visitor(mIndices[i]))
+                        {
+                            return;
+                        }
+                    }
+                }
+            }
 
-            virtual ~BVH()
-            { }
+            static bool overlaps(BVNode const& node, BBox const& box)
+            {
+                return node.pMin.x <= box.pMax.x && node.pMax.x >= box.pMin.x &&
+                    node.pMin.y <= box.pMax.y && node.pMax.y >= box.pMin.y &&
+                    node.pMin.z <= box.pMax.z && node.pMax.z >= box.pMin.z;
+            }
 
-            virtual void construct(std::vector<NodeType> const& leaves) = 0;
+            static bool overlaps(BBox const& a, BBox const& b)
+            {
+                return a.pMin.x <= b.pMax.x && a.pMax.x >= b.pMin.x &&
+                    a.pMin.y <= b.pMax.y && a.pMax.y >= b.pMin.y &&
+                    a.pMin.z <= b.pMax.z && a.pMax.z >= b.pMin.z;
+            }
 
-            virtual std::vector<NodeType> 
-                traverse(atlas::math::Point const& p) const = 0;
+            void occludedPacket(atlas::math::Point const* from,
+                atlas::math::Point const* to, int lanes,
+                std::uint8_t* occluded) const;
 
-            virtual std::vector<NodeType> traverse(BVType const& bv) const = 0;
+            void buildNodes(std::vector<BBox> const& bounds);
+            void refitNodes();
 
-            virtual BVType getGlobalVolume() const = 0;
+            std::vector<BVNode, CacheAlignedAllocator<BVNode>> mNodes;
 
-        protected:
-            std::shared_ptr<BVNode<NodeType>> mRoot;
+            // Primitive data in leaf order, with the original index of each.
+            std::vector<BBox> mBounds;
+            std::vector<std::uint32_t> mIndices;
 
+            // Only filled for triangle meshes: three corners per primitive in
+            // leaf order, and the original vertex indices used by refit.
+            std::vector<atlas::math::Point> mTriangles;
+            std::vector<std::uint32_t> mTriangleIndices;
         };
     }
 }
 
-#endif
\ No newline at end of file
+#endif
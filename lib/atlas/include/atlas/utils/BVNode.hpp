@@ -1,3 +1,8 @@
+/**
+ * \file BVNode.hpp
+ * \brief Defines the node layout of a flattened BVH.
+ */
+
 #ifndef ATLAS_INCLUDE_ATLAS_UTILS_BV_NODE_HPP
 #define ATLAS_INCLUDE_ATLAS_UTILS_BV_NODE_HPP
 
@@ -6,36 +11,94 @@
 #include "Utils.hpp"
 #include "atlas/math/Math.hpp"
 
-#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
 
 namespace atlas
 {
     namespace utils
     {
-        enum class NodeType : int
+        /**
+         * \struct BVNode
+         * \brief A node of a flattened bounding volume hierarchy.
+         *
+         * Nodes are 32 bytes. The two children of an interior node are
+         * stored next to each other starting at an even index, so with a
+         * cache-aligned array both children share one cache line.
+         */
+        struct BVNode
         {
-            Node = 0,
-            Leaf
+            /**
+             * Returns whether the node is a leaf.
+             */
+            bool isLeaf() const
+            {
+                return count != 0;
+            }
+
+            atlas::math::Point pMin;
+
+            /**
+             * For leaves, the first primitive of the leaf. For interior
+             * nodes, the index of the first child (the second child follows
+             * it).
+             */
+            std::uint32_t offset;
+
+            atlas::math::Point pMax;
+
+            /**
+             * The number of primitives in a leaf, or 0 for interior nodes.
+             */
+            std::uint32_t count;
         };
 
-        template <class Type, class BVType>
-        class BVNode
+        /**
+         * \class CacheAlignedAllocator
+         * \brief Allocates storage aligned to a 64 byte cache line.
+         */
+        template <class Type>
+        class CacheAlignedAllocator
         {
-            BVNode()
-            { }
+        public:
+            using value_type = Type;
+
+            CacheAlignedAllocator() = default;
 
-            virtual ~BVNode()
+            template <class Other>
+            CacheAlignedAllocator(CacheAlignedAllocator<Other> const&)
             { }
 
-            virtual BVNodePtr<NodeType, BVType> cloneShared() = 0;
+            Type* allocate(std::size_t n)
+            {
+                // Over-allocate and keep the original pointer just in front
+                // of the aligned block.
+                void* raw = ::operator new(n * sizeof(Type) + 64 + sizeof(void*));
+                std::uintptr_t aligned =
+                    ((std::uintptr_t)raw + sizeof(void*) + 63) & ~(std::uintptr_t)63;
+                ((void**)aligned)[-1] = raw;
+                return (Type*)aligned;
+            }
+
+            void deallocate(Type* p, std::size_t)
+            {
+                ::operator delete(((void**)p)[-1]);
+            }
+
+            template <class Other>
+            bool operator==(CacheAlignedAllocator<Other> const&) const
+            {
+                return true;
+            }
 
-            virtual NodeType getType() const = 0;
-            virtual std::vector<Type> visit(
-                atlas::math::Point const& p) const = 0;
-            virtual std::vector<Type> visit(BVType const& bv) const = 0;
-            virtual BVType getVolume() const = 0;
+            template <class Other>
+            bool operator!=(CacheAlignedAllocator<Other> const&) const
+            {
+                return false;
+            }
         };
     }
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,158 @@
+/**
+ * \file DistanceField.hpp
+ * \brief Defines a sampled signed distance field.
+ */
+
+#ifndef ATLAS_INCLUDE_ATLAS_UTILS_DISTANCE_FIELD_HPP
+#define ATLAS_INCLUDE_ATLAS_UTILS_DISTANCE_FIELD_HPP
+
+#pragma once
+
+#include "Utils.hpp"
+#include "BBox.hpp"
+
+#include "atlas/math/Math.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace atlas
+{
+    namespace utils
+    {
+        /**
+         * \class DistanceField
+         * \brief A signed distance field sampled on a regular grid.
+         *
+         * Every grid node stores the distance together with its gradient, so
+         * a single trilinear lookup returns both and the cost of a query does
+         * not depend on the geometry the field was built from. Distances are
+         * clamped to a narrow band around the surface; everything outside
+         * the grid reads as the band distance with a zero gradient.
+         *
+         * Building a field can be expensive, so it can be written to disk
+         * together with a key describing the geometry and read back on the
+         * next run if the key still matches.
+         */
+        class DistanceField
+        {
+        public:
+            /**
+             * Standard constructor. The field is empty.
+             */
+            DistanceField();
+
+            /**
+             * Samples \c distance at every node of a grid covering
+             * \c domain. The cell size is increased if needed to keep the
+             * grid under \c maxNodes nodes.
+             *
+             * \param[in] domain The region covered by the field.
+             * \param[in] cellSize The requested spacing between nodes.
+             * \param[in] band The largest distance stored in the field.
+             * \param[in] distance Returns the signed distance to the surface
+             * at a point, negative inside. Called concurrently.
+             * \param[in] maxNodes The largest number of nodes to allocate.
+             */
+            void build(BBox const& domain, float cellSize, float band,
+                std::function<float(atlas::math::Point const&)> const& distance,
+                std::size_t maxNodes = 1 << 21);
+
+            /**
+             * Removes the field.
+             */
+            void clear();
+
+            /**
+             * Returns whether the field holds any nodes.
+             *
+             * \return True if the field is empty.
+             */
+            bool empty() const;
+
+            /**
+             * Writes the field to disk.
+             *
+             * \param[in] filename The file to write.
+             * \param[in] key Identifies the geometry the field was built from.
+             *
+             * \return True if the file was written.
+             */
+            bool save(std::string const& filename, std::uint64_t key) const;
+
+            /**
+             * Reads a field written by \c save.
+             *
+             * \param[in] filename The file to read.
+             * \param[in] key The key the field must have been saved with.
+             *
+             * \return True if the file exists and matches the key.
+             */
+            bool load(std::string const& filename, std::uint64_t key);
+
+            /**
+             * Returns the interpolated distance at a point.
+             *
+             * \param[in] p The query point.
+             *
+             * \return The signed distance, clamped to the band.
+             */
+            float sample(atlas::math::Point const& p) const;
+
+            /**
+             * Returns the interpolated distance and unit gradient at a point.
+             * Moving a point by \c -distance*gradient projects it onto the
+             * surface.
+             *
+             * \param[in] p The query point.
+             * \param[out] gradient The direction away from the surface.
+             *
+             * \return The signed distance, clamped to the band.
+             */
+            float sample(atlas::math::Point const& p,
+                atlas::math::Normal& gradient) const;
+
+            /**
+             * Returns the signed distance from a point to an axis aligned
+             * box.
+             *
+             * \param[in] box The box.
+             * \param[in] p The query point.
+             *
+             * \return The distance, negative inside the box.
+             */
+            static float distanceToBox(BBox const& box,
+                atlas::math::Point const& p);
+
+            /**
+             * Returns the distance from a point to a triangle, signed by
+             * the side of the counter-clockwise face the point is on.
+             *
+             * \param[in] a The first corner.
+             * \param[in] b The second corner.
+             * \param[in] c The third corner.
+             * \param[in] p The query point.
+             *
+             * \return The distance, negative behind the triangle.
+             */
+            static float distanceToTriangle(atlas::math::Point const& a,
+                atlas::math::Point const& b, atlas::math::Point const& c,
+                atlas::math::Point const& p);
+
+        private:
+            glm::vec4 lookup(atlas::math::Point const& p) const;
+
+            atlas::math::Point mOrigin;
+            float mCellSize;
+            float mBand;
+            glm::ivec3 mResolution;
+
+            // Gradient in xyz and distance in w for every node, x fastest.
+            std::vector<glm::vec4> mNodes;
+        };
+    }
+}
+
+#endif
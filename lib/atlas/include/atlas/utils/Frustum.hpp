@@ -0,0 +1,61 @@
+/**
+ * \file Frustum.hpp
+ * \brief Defines tests against the view frustum.
+ */
+
+#ifndef ATLAS_INCLUDE_ATLAS_UTILS_FRUSTUM_HPP
+#define ATLAS_INCLUDE_ATLAS_UTILS_FRUSTUM_HPP
+
+#pragma once
+
+#include "Utils.hpp"
+
+#include "atlas/math/Math.hpp"
+
+namespace atlas
+{
+    namespace utils
+    {
+        /**
+         * Tests an axis aligned box against the clip planes. The box is
+         * only reported hidden when all eight of its corners lie outside the
+         * same plane, so boxes near the edges of the frustum may be reported
+         * visible when they are not.
+         *
+         * \param[in] viewProj The matrix taking the box to clip space.
+         * \param[in] lo The lowest corner of the box.
+         * \param[in] hi The highest corner of the box.
+         * \return False if the box lies entirely outside one of the planes.
+         */
+        inline bool isBoxVisible(glm::mat4 const& viewProj,
+            glm::vec3 const& lo, glm::vec3 const& hi)
+        {
+            glm::vec4 corners[8];
+            for (int i = 0; i < 8; ++i)
+            {
+                glm::vec3 corner((i & 1) ? hi.x : lo.x, (i & 2) ? hi.y : lo.y,
+                    (i & 4) ? hi.z : lo.z);
+                corners[i] = viewProj * glm::vec4(corner, 1.0f);
+            }
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                bool below = true, above = true;
+                for (auto const& c : corners)
+                {
+                    below = below && c[axis] < -c.w;
+                    above = above && c[axis] > c.w;
+                }
+
+                if (below || above)
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+    }
+}
+
+#endif
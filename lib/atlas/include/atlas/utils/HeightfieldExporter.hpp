@@ -0,0 +1,128 @@
+/**
+ * \file HeightfieldExporter.hpp
+ * \brief Defines an exporter that writes heightfields to PLY and OBJ files.
+ */
+
+#ifndef ATLAS_INCLUDE_ATLAS_UTILS_HEIGHTFIELD_EXPORTER_HPP
+#define ATLAS_INCLUDE_ATLAS_UTILS_HEIGHTFIELD_EXPORTER_HPP
+
+#pragma once
+
+#include "atlas/math/Math.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace atlas
+{
+    namespace utils
+    {
+        /**
+         * \enum HeightfieldFormat
+         * \brief The file formats a heightfield can be exported to.
+         */
+        enum class HeightfieldFormat : int
+        {
+            PLY = 0,    /**< Binary little endian PLY. */
+            OBJ         /**< Wavefront OBJ. */
+        };
+
+        /**
+         * \struct Heightfield
+         * \brief A regular grid of vertices stored row by row.
+         */
+        struct Heightfield
+        {
+            Heightfield() :
+                rows(0),
+                cols(0)
+            { }
+
+            std::size_t rows, cols;
+            std::vector<atlas::math::Point> positions;
+
+            /**
+             * Optional. When present there must be one normal per position.
+             */
+            std::vector<atlas::math::Normal> normals;
+        };
+
+        /**
+         * \class HeightfieldExporter
+         * \brief Writes heightfields to disk as quad meshes.
+         *
+         * The grid is encoded in blocks of rows that are formatted in
+         * parallel and then written out in order, so only a few blocks are
+         * ever held in memory at once. Exports can run on a background
+         * thread from a snapshot of the grid, which lets the caller keep
+         * modifying its own copy while the file is written.
+         */
+        class HeightfieldExporter
+        {
+        public:
+            /**
+             * Standard constructor.
+             */
+            HeightfieldExporter();
+
+            /**
+             * Waits for any running export to finish.
+             */
+            ~HeightfieldExporter();
+
+            HeightfieldExporter(HeightfieldExporter const&) = delete;
+            HeightfieldExporter& operator=(HeightfieldExporter const&) = delete;
+
+            /**
+             * Writes the heightfield to a file and returns once it is done.
+             *
+             * \param[in] filename The file to write.
+             * \param[in] field The heightfield to export.
+             * \param[in] format The file format.
+             * \param[in] skirt Whether to close the sides of the grid with
+             * walls down to \c skirtBase.
+             * \param[in] skirtBase The height of the bottom of the skirt.
+             *
+             * \return True if the file was written, false otherwise.
+             */
+            static bool write(std::string const& filename,
+                Heightfield const& field, HeightfieldFormat format,
+                bool skirt = false, float skirtBase = 0.0f);
+
+            /**
+             * Starts writing the heightfield on a background thread. The
+             * exporter takes ownership of the heightfield.
+             *
+             * \param[in] filename The file to write.
+             * \param[in] field The heightfield to export.
+             * \param[in] format The file format.
+             * \param[in] skirt Whether to add the skirt.
+             * \param[in] skirtBase The height of the bottom of the skirt.
+             *
+             * \return False if an export is already running.
+             */
+            bool exportAsync(std::string const& filename, Heightfield&& field,
+                HeightfieldFormat format, bool skirt = false,
+                float skirtBase = 0.0f);
+
+            /**
+             * Returns whether a background export is still running.
+             *
+             * \return True while an export is in progress.
+             */
+            bool isBusy() const;
+
+            /**
+             * Blocks until the background export has finished.
+             */
+            void wait();
+
+        private:
+            struct HeightfieldExporterImpl;
+            std::unique_ptr<HeightfieldExporterImpl> mImpl;
+        };
+    }
+}
+
+#endif
@@ -39,15 +39,8 @@ namespace atlas
         using ContextVersion = std::tuple<int, int>;
 
         class BBox;
-        
-        template <class Type, class BVType>
-        class BVNode;
-
-        template <class Type, class BVType>
+        struct BVNode;
         class BVH;
-
-        template <class Type, class BVType>
-        using BVNodePtr = std::shared_ptr<BVNode<Type, BVType>>;
     }
 }
 
@@ -0,0 +1,194 @@
+#include "atlas/core/MappedFile.hpp"
+#include "atlas/core/Platform.hpp"
+#include "atlas/core/Log.hpp"
+
+#ifdef ATLAS_PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <fstream>
+#include <vector>
+
+namespace atlas
+{
+    namespace core
+    {
+        struct MappedFile::MappedFileImpl
+        {
+            MappedFileImpl() :
+                data(nullptr),
+                size(0),
+                mapped(false)
+            { }
+
+            bool map(std::string const& filename)
+            {
+#ifdef ATLAS_PLATFORM_WINDOWS
+                HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ,
+                    FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                    FILE_ATTRIBUTE_NORMAL, NULL);
+                if (file == INVALID_HANDLE_VALUE)
+                {
+                    return false;
+                }
+
+                LARGE_INTEGER fileSize;
+                GetFileSizeEx(file, &fileSize);
+                HANDLE mapping = (fileSize.QuadPart > 0) ?
+                    CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) :
+                    NULL;
+                CloseHandle(file);
+                if (mapping == NULL)
+                {
+                    return false;
+                }
+
+                void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                CloseHandle(mapping);
+                if (view == NULL)
+                {
+                    return false;
+                }
+
+                data = (const unsigned char*)view;
+                size = (std::size_t)fileSize.QuadPart;
+#else
+                int fd = ::open(filename.c_str(), O_RDONLY);
+                if (fd < 0)
+                {
+                    return false;
+                }
+
+                struct stat info;
+                if (fstat(fd, &info) != 0 || info.st_size == 0)
+                {
+                    ::close(fd);
+                    return false;
+                }
+
+                void* view = mmap(nullptr, (std::size_t)info.st_size,
+                    PROT_READ, MAP_PRIVATE, fd, 0);
+                ::close(fd);
+                if (view == MAP_FAILED)
+                {
+                    return false;
+                }
+
+                data = (const unsigned char*)view;
+                size = (std::size_t)info.st_size;
+#endif
+                mapped = true;
+                return true;
+            }
+
+            bool read(std::string const& filename)
+            {
+                std::ifstream file(filename, std::ios::binary | std::ios::ate);
+                if (!file)
+                {
+                    return false;
+                }
+
+                buffer.resize((std::size_t)file.tellg());
+                file.seekg(0);
+                file.read((char*)buffer.data(), buffer.size());
+
+                data = buffer.data();
+                size = buffer.size();
+                return !buffer.empty();
+            }
+
+            void unmap()
+            {
+                if (mapped)
+                {
+#ifdef ATLAS_PLATFORM_WINDOWS
+                    UnmapViewOfFile(data);
+#else
+                    munmap((void*)data, size);
+#endif
+                }
+
+                buffer.clear();
+                buffer.shrink_to_fit();
+                data = nullptr;
+                size = 0;
+                mapped = false;
+            }
+
+            const unsigned char* data;
+            std::size_t size;
+            bool mapped;
+            std::vector<unsigned char> buffer;
+        };
+
+        MappedFile::MappedFile() :
+            mImpl(std::make_unique<MappedFileImpl>())
+        { }
+
+        MappedFile::MappedFile(std::string const& filename) :
+            mImpl(std::make_unique<MappedFileImpl>())
+        {
+            open(filename);
+        }
+
+        MappedFile::MappedFile(MappedFile&& rhs) :
+            mImpl(std::move(rhs.mImpl))
+        {
+            rhs.mImpl = std::make_unique<MappedFileImpl>();
+        }
+
+        MappedFile& MappedFile::operator=(MappedFile&& rhs)
+        {
+            close();
+            std::swap(mImpl, rhs.mImpl);
+
+            return *this;
+        }
+
+        MappedFile::~MappedFile()
+        {
+            close();
+        }
+
+        bool MappedFile::open(std::string const& filename)
+        {
+            close();
+
+            if (mImpl->map(filename) || mImpl->read(filename))
+            {
+                return true;
+            }
+
+            ERROR_LOG("Could not open " + filename + ".");
+            mImpl->unmap();
+            return false;
+        }
+
+        void MappedFile::close()
+        {
+            mImpl->unmap();
+        }
+
+        bool MappedFile::isOpen() const
+        {
+            return mImpl->data != nullptr;
+        }
+
+        const unsigned char* MappedFile::data() const
+        {
+            return mImpl->data;
+        }
+
+        std::size_t MappedFile::size() const
+        {
+            return mImpl->size;
+        }
+    }
+}
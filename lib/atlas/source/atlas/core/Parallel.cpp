@@ -0,0 +1,194 @@
+#include "atlas/core/Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace atlas
+{
+    namespace core
+    {
+        // Set on the workers, and on the calling thread while it runs a job,
+        // so a job started from within a job runs inline instead of waiting
+        // on workers that are busy with the outer one.
+        static thread_local bool tInsideJob = false;
+
+        namespace
+        {
+            // A job submitted to the pool. It lives on the stack of the thread
+            // that submitted it, which waits until no worker is running it.
+            struct Job
+            {
+                Job(std::function<void(std::size_t)> const& t, std::size_t count) :
+                    task(t),
+                    blocks(count),
+                    next(0),
+                    finished(0),
+                    busy(0)
+                { }
+
+                // Takes blocks until none are left, and returns the number it
+                // ran.
+                std::size_t runBlocks()
+                {
+                    std::size_t ran = 0;
+                    for (std::size_t b = next++; b < blocks; b = next++)
+                    {
+                        task(b);
+                        ++ran;
+                    }
+                    return ran;
+                }
+
+                // The task, the number of blocks, the next block to take, the
+                // blocks finished and the workers running it.
+                std::function<void(std::size_t)> const& task;
+                std::size_t blocks;
+                std::atomic<std::size_t> next;
+                std::size_t finished, busy;
+            };
+        }
+
+        struct ThreadPool::ThreadPoolImpl
+        {
+            ThreadPoolImpl() :
+                stopping(false)
+            { }
+
+            // Drops the job from the queue once all of its blocks are
+            // taken, so no worker starts on it again.
+            void retire(Job* job)
+            {
+                auto it = std::find(jobs.begin(), jobs.end(), job);
+                if (it != jobs.end())
+                {
+                    jobs.erase(it);
+                }
+            }
+
+            void work()
+            {
+                tInsideJob = true;
+                std::unique_lock<std::mutex> lock(mutex);
+                while (true)
+                {
+                    wake.wait(lock, [&]
+                    {
+                        return stopping || !jobs.empty();
+                    });
+                    if (stopping)
+                    {
+                        return;
+                    }
+
+                    // Join the job with the fewest workers, so concurrent
+                    // submitters share the pool.
+                    Job* job = *std::min_element(jobs.begin(), jobs.end(),
+                        [](Job const* a, Job const* b)
+                    {
+                        return a->busy < b->busy;
+                    });
+                    if (job->next >= job->blocks)
+                    {
+                        retire(job);
+                        continue;
+                    }
+
+                    ++job->busy;
+                    lock.unlock();
+
+                    std::size_t ran = job->runBlocks();
+
+                    lock.lock();
+                    retire(job);
+                    job->finished += ran;
+                    if (--job->busy == 0 && job->finished == job->blocks)
+                    {
+                        done.notify_all();
+                    }
+                }
+            }
+
+            std::vector<std::thread> workers;
+
+            // The jobs that still have blocks to take, oldest first.
+            std::mutex mutex;
+            std::condition_variable wake, done;
+            std::vector<Job*> jobs;
+            bool stopping;
+        };
+
+        ThreadPool& ThreadPool::getInstance()
+        {
+            static ThreadPool pool(std::max(1u,
+                std::thread::hardware_concurrency()) - 1);
+            return pool;
+        }
+
+        ThreadPool::ThreadPool(std::size_t workers) :
+            mImpl(std::make_unique<ThreadPoolImpl>())
+        {
+            for (std::size_t i = 0; i < workers; ++i)
+            {
+                mImpl->workers.emplace_back(&ThreadPoolImpl::work,
+                    mImpl.get());
+            }
+        }
+
+        ThreadPool::~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mImpl->mutex);
+                mImpl->stopping = true;
+            }
+            mImpl->wake.notify_all();
+
+            for (auto& worker : mImpl->workers)
+            {
+                worker.join();
+            }
+        }
+
+        std::size_t ThreadPool::getThreadCount() const
+        {
+            return mImpl->workers.size() + 1;
+        }
+
+        void ThreadPool::run(std::size_t blocks,
+            std::function<void(std::size_t)> const& task)
+        {
+            if (tInsideJob || mImpl->workers.empty() || blocks <= 1)
+            {
+                for (std::size_t b = 0; b < blocks; ++b)
+                {
+                    task(b);
+                }
+                return;
+            }
+
+            Job job(task, blocks);
+            {
+                std::lock_guard<std::mutex> lock(mImpl->mutex);
+                mImpl->jobs.push_back(&job);
+            }
+            mImpl->wake.notify_all();
+
+            // The calling thread takes blocks as well, then waits for the
+            // workers still running theirs.
+            tInsideJob = true;
+            std::size_t ran = job.runBlocks();
+            tInsideJob = false;
+
+            std::unique_lock<std::mutex> lock(mImpl->mutex);
+            mImpl->retire(&job);
+            job.finished += ran;
+            mImpl->done.wait(lock, [&]
+            {
+                return job.busy == 0 && job.finished == job.blocks;
+            });
+        }
+    }
+}
@@ -0,0 +1,493 @@
+#include "atlas/gl/FrameCapture.hpp"
+#include "atlas/core/Log.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace atlas
+{
+    namespace gl
+    {
+        namespace
+        {
+            typedef std::vector<unsigned char> PixelBuffer;
+
+            struct EncodeJob
+            {
+                std::size_t frame;
+                int width;
+                int height;
+                PixelBuffer pixels;
+            };
+
+            std::uint32_t crc32(std::uint32_t crc, const unsigned char* data,
+                std::size_t length)
+            {
+                static const std::vector<std::uint32_t> table = []()
+                {
+                    std::vector<std::uint32_t> t(256);
+                    for (std::uint32_t n = 0; n < 256; ++n)
+                    {
+                        std::uint32_t c = n;
+                        for (int k = 0; k < 8; ++k)
+                        {
+                            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                        }
+                        t[n] = c;
+                    }
+                    return t;
+                }();
+
+                crc = ~crc;
+                for (std::size_t i = 0; i < length; ++i)
+                {
+                    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+                }
+                return ~crc;
+            }
+
+            void putBigEndian(unsigned char* out, std::uint32_t value)
+            {
+                out[0] = (unsigned char)(value >> 24);
+                out[1] = (unsigned char)(value >> 16);
+                out[2] = (unsigned char)(value >> 8);
+                out[3] = (unsigned char)(value);
+            }
+
+            // Writes a chunk whose payload is split across two pieces so that
+            // the (large) image data never has to be copied into one block.
+            void writeChunk(std::FILE* file, const char* type,
+                const unsigned char* head, std::size_t headLength,
+                const unsigned char* body = nullptr, std::size_t bodyLength = 0)
+            {
+                unsigned char word[4];
+                putBigEndian(word, (std::uint32_t)(headLength + bodyLength));
+                std::fwrite(word, 1, 4, file);
+                std::fwrite(type, 1, 4, file);
+
+                std::uint32_t crc = crc32(0, (const unsigned char*)type, 4);
+                if (headLength)
+                {
+                    std::fwrite(head, 1, headLength, file);
+                    crc = crc32(crc, head, headLength);
+                }
+                if (bodyLength)
+                {
+                    std::fwrite(body, 1, bodyLength, file);
+                    crc = crc32(crc, body, bodyLength);
+                }
+
+                putBigEndian(word, crc);
+                std::fwrite(word, 1, 4, file);
+            }
+
+            void writePNG(std::FILE* file, EncodeJob const& job)
+            {
+                static const unsigned char signature[] =
+                { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+                std::fwrite(signature, 1, sizeof(signature), file);
+
+                unsigned char header[13];
+                putBigEndian(header, (std::uint32_t)job.width);
+                putBigEndian(header + 4, (std::uint32_t)job.height);
+                header[8] = 8;      // Bit depth.
+                header[9] = 6;      // RGBA.
+                header[10] = 0;     // Deflate.
+                header[11] = 0;     // Adaptive filtering.
+                header[12] = 0;     // No interlacing.
+                writeChunk(file, "IHDR", header, sizeof(header));
+
+                // Scanlines go top to bottom with a "None" filter byte in
+                // front, so flip the GL rows while building the stream.
+                std::size_t rowBytes = 4 * (std::size_t)job.width;
+                std::size_t rawLength = (rowBytes + 1) * job.height;
+                std::size_t numBlocks = (rawLength + 65534) / 65535;
+                PixelBuffer stream;
+                stream.reserve(2 + 5 * numBlocks + rawLength + 4);
+
+                PixelBuffer raw(rawLength);
+                for (int y = 0; y < job.height; ++y)
+                {
+                    unsigned char* dst = &raw[(rowBytes + 1) * y];
+                    dst[0] = 0;
+                    std::memcpy(dst + 1,
+                        &job.pixels[rowBytes * (job.height - 1 - y)],
+                        rowBytes);
+                }
+
+                // zlib stream made of stored blocks: the encoder's job is to
+                // keep up with the frame rate, not to minimise file size.
+                stream.push_back(0x78);
+                stream.push_back(0x01);
+                std::uint32_t a = 1, b = 0;
+                for (std::size_t offset = 0; offset < rawLength;)
+                {
+                    std::size_t length = std::min<std::size_t>(65535,
+                        rawLength - offset);
+                    bool last = (offset + length == rawLength);
+                    stream.push_back(last ? 1 : 0);
+                    stream.push_back((unsigned char)(length & 0xFF));
+                    stream.push_back((unsigned char)(length >> 8));
+                    stream.push_back((unsigned char)(~length & 0xFF));
+                    stream.push_back((unsigned char)((~length >> 8) & 0xFF));
+                    stream.insert(stream.end(), raw.begin() + offset,
+                        raw.begin() + offset + length);
+
+                    // 5552 is the longest run for which the Adler-32 sums
+                    // cannot overflow before the modulo is taken.
+                    for (std::size_t i = offset; i < offset + length;)
+                    {
+                        std::size_t end = std::min(i + 5552, offset + length);
+                        for (; i < end; ++i)
+                        {
+                            a += raw[i];
+                            b += a;
+                        }
+                        a %= 65521;
+                        b %= 65521;
+                    }
+                    offset += length;
+                }
+
+                unsigned char adler[4];
+                putBigEndian(adler, (b << 16) | a);
+                stream.insert(stream.end(), adler, adler + 4);
+
+                writeChunk(file, "IDAT", nullptr, 0, stream.data(),
+                    stream.size());
+                writeChunk(file, "IEND", nullptr, 0);
+            }
+
+            void writePPM(std::FILE* file, EncodeJob const& job)
+            {
+                std::fprintf(file, "P6\n%d %d\n255\n", job.width, job.height);
+
+                PixelBuffer row(3 * (std::size_t)job.width);
+                for (int y = job.height - 1; y >= 0; --y)
+                {
+                    const unsigned char* src =
+                        &job.pixels[4 * (std::size_t)job.width * y];
+                    for (int x = 0; x < job.width; ++x)
+                    {
+                        row[3 * x + 0] = src[4 * x + 0];
+                        row[3 * x + 1] = src[4 * x + 1];
+                        row[3 * x + 2] = src[4 * x + 2];
+                    }
+                    std::fwrite(row.data(), 1, row.size(), file);
+                }
+            }
+        }
+
+        struct FrameCapture::FrameCaptureImpl
+        {
+            struct Slot
+            {
+                Slot() :
+                    handle(0),
+                    fence(nullptr),
+                    capacity(0),
+                    width(0),
+                    height(0),
+                    frame(0),
+                    pending(false)
+                { }
+
+                GLuint handle;
+                GLsync fence;
+                std::size_t capacity;
+                int width, height;
+                std::size_t frame;
+                bool pending;
+            };
+
+            FrameCaptureImpl() :
+                format(CaptureFormat::PPM),
+                framebuffer(0),
+                head(0),
+                framesCaptured(0),
+                framesWritten(0),
+                capturing(false),
+                quit(false)
+            { }
+
+            void encoderLoop()
+            {
+                for (;;)
+                {
+                    EncodeJob job;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        jobReady.wait(lock, [this]()
+                        {
+                            return quit || !jobs.empty();
+                        });
+
+                        if (jobs.empty())
+                        {
+                            return;
+                        }
+
+                        job = std::move(jobs.front());
+                        jobs.pop_front();
+                    }
+                    jobTaken.notify_all();
+
+                    encode(job);
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    pool.push_back(std::move(job.pixels));
+                    ++framesWritten;
+                }
+            }
+
+            void encode(EncodeJob const& job)
+            {
+                const char* extension =
+                    (format == CaptureFormat::PNG) ? "png" :
+                    (format == CaptureFormat::PPM) ? "ppm" : "raw";
+
+                std::vector<char> name(prefix.size() + 32);
+                std::snprintf(name.data(), name.size(), "%s_%06lu.%s",
+                    prefix.c_str(), (unsigned long)job.frame, extension);
+
+                std::FILE* file = std::fopen(name.data(), "wb");
+                if (!file)
+                {
+                    ERROR_LOG(std::string("Could not open ") + name.data() +
+                        " for writing.");
+                    return;
+                }
+
+                std::vector<char> ioBuffer(1 << 20);
+                std::setvbuf(file, ioBuffer.data(), _IOFBF, ioBuffer.size());
+
+                switch (format)
+                {
+                case CaptureFormat::PNG:
+                    writePNG(file, job);
+                    break;
+
+                case CaptureFormat::PPM:
+                    writePPM(file, job);
+                    break;
+
+                case CaptureFormat::Raw:
+                    std::fwrite(job.pixels.data(), 1, job.pixels.size(), file);
+                    break;
+                }
+
+                std::fclose(file);
+            }
+
+            // Maps a slot whose transfer was issued a full ring ago and hands
+            // the pixels over to the encoder.
+            void retire(Slot& slot)
+            {
+                if (!slot.pending)
+                {
+                    return;
+                }
+
+                glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                    GL_TIMEOUT_IGNORED);
+                glDeleteSync(slot.fence);
+                slot.fence = nullptr;
+                slot.pending = false;
+
+                std::size_t bytes = 4 * (std::size_t)slot.width * slot.height;
+
+                EncodeJob job;
+                job.frame = slot.frame;
+                job.width = slot.width;
+                job.height = slot.height;
+                {
+                    // Throttle the render thread if the disk can't keep up,
+                    // rather than dropping frames or growing without bound.
+                    std::unique_lock<std::mutex> lock(mutex);
+                    jobTaken.wait(lock, [this]()
+                    {
+                        return jobs.size() < 2 * slots.size();
+                    });
+
+                    if (!pool.empty())
+                    {
+                        job.pixels = std::move(pool.back());
+                        pool.pop_back();
+                    }
+                }
+                job.pixels.resize(bytes);
+
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.handle);
+                void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes,
+                    GL_MAP_READ_BIT);
+                if (data)
+                {
+                    std::memcpy(job.pixels.data(), data, bytes);
+                    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                }
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+                if (!data)
+                {
+                    ERROR_LOG("Unable to map capture buffer; frame dropped.");
+                    return;
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    jobs.push_back(std::move(job));
+                }
+                jobReady.notify_one();
+            }
+
+            std::string prefix;
+            CaptureFormat format;
+            GLuint framebuffer;
+
+            std::vector<Slot> slots;
+            std::size_t head;
+            std::size_t framesCaptured;
+
+            std::thread encoder;
+            std::mutex mutex;
+            std::condition_variable jobReady, jobTaken;
+            std::deque<EncodeJob> jobs;
+            std::vector<PixelBuffer> pool;
+            std::size_t framesWritten;
+
+            bool capturing;
+            bool quit;
+        };
+
+        FrameCapture::FrameCapture() :
+            mImpl(std::make_unique<FrameCaptureImpl>())
+        { }
+
+        FrameCapture::~FrameCapture()
+        {
+            stop();
+        }
+
+        void FrameCapture::start(std::string const& prefix,
+            CaptureFormat format, GLuint framebuffer, int ringSize)
+        {
+            stop();
+
+            ringSize = (ringSize < 2) ? 2 : (ringSize > 8) ? 8 : ringSize;
+
+            mImpl->prefix = prefix;
+            mImpl->format = format;
+            mImpl->framebuffer = framebuffer;
+            mImpl->slots.assign(ringSize, FrameCaptureImpl::Slot());
+            for (auto& slot : mImpl->slots)
+            {
+                glGenBuffers(1, &slot.handle);
+            }
+
+            mImpl->head = 0;
+            mImpl->framesCaptured = 0;
+            mImpl->framesWritten = 0;
+            mImpl->quit = false;
+            mImpl->encoder = std::thread(&FrameCaptureImpl::encoderLoop,
+                mImpl.get());
+            mImpl->capturing = true;
+        }
+
+        void FrameCapture::stop()
+        {
+            if (!mImpl->capturing)
+            {
+                return;
+            }
+
+            // Drain the ring in submission order.
+            std::size_t numSlots = mImpl->slots.size();
+            for (std::size_t i = 0; i < numSlots; ++i)
+            {
+                mImpl->retire(mImpl->slots[(mImpl->head + i) % numSlots]);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mImpl->mutex);
+                mImpl->quit = true;
+            }
+            mImpl->jobReady.notify_one();
+            mImpl->encoder.join();
+
+            for (auto& slot : mImpl->slots)
+            {
+                glDeleteBuffers(1, &slot.handle);
+            }
+            mImpl->slots.clear();
+            mImpl->pool.clear();
+            mImpl->capturing = false;
+
+            INFO_LOG("Frame capture wrote " +
+                std::to_string(mImpl->framesWritten) + " frames.");
+        }
+
+        bool FrameCapture::isCapturing() const
+        {
+            return mImpl->capturing;
+        }
+
+        void FrameCapture::captureFrame(int width, int height)
+        {
+            if (!mImpl->capturing || width < 1 || height < 1)
+            {
+                return;
+            }
+
+            auto& slot = mImpl->slots[mImpl->head];
+            mImpl->retire(slot);
+
+            std::size_t bytes = 4 * (std::size_t)width * height;
+
+            GLint prevReadFBO, prevPackAlignment;
+            glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prevReadFBO);
+            glGetIntegerv(GL_PACK_ALIGNMENT, &prevPackAlignment);
+
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, mImpl->framebuffer);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.handle);
+            if (slot.capacity < bytes)
+            {
+                glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr,
+                    GL_STREAM_READ);
+                slot.capacity = bytes;
+            }
+
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+                (GLvoid*)0);
+            slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            slot.width = width;
+            slot.height = height;
+            slot.frame = mImpl->framesCaptured++;
+            slot.pending = true;
+
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            glPixelStorei(GL_PACK_ALIGNMENT, prevPackAlignment);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, prevReadFBO);
+
+            mImpl->head = (mImpl->head + 1) % mImpl->slots.size();
+        }
+
+        std::size_t FrameCapture::getFramesCaptured() const
+        {
+            return mImpl->framesCaptured;
+        }
+
+        std::size_t FrameCapture::getFramesWritten() const
+        {
+            std::lock_guard<std::mutex> lock(mImpl->mutex);
+            return mImpl->framesWritten;
+        }
+    }
+}
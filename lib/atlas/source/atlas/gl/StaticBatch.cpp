@@ -0,0 +1,217 @@
+#include "atlas/gl/StaticBatch.hpp"
+
+#include <cstddef>
+
+namespace atlas
+{
+    namespace gl
+    {
+        // Layout of one command in the indirect buffer, as defined by the
+        // OpenGL specification.
+        struct DrawElementsCommand
+        {
+            GLuint count;
+            GLuint instanceCount;
+            GLuint firstIndex;
+            GLint baseVertex;
+            GLuint baseInstance;
+        };
+
+        struct BatchMesh
+        {
+            std::vector<BatchVertex> vertices;
+            std::vector<GLuint> indices;
+            std::vector<math::Vector4> instances;
+        };
+
+        struct StaticBatch::StaticBatchImpl
+        {
+            StaticBatchImpl() :
+                vao(0),
+                vertexBuffer(0),
+                indexBuffer(0),
+                instanceBuffer(0),
+                indirectBuffer(0),
+                multiDraw(false)
+            { }
+
+            void setInstanceOffset(GLuint baseInstance) const
+            {
+                glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+                glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE,
+                    sizeof(math::Vector4),
+                    (GLvoid*)(baseInstance * sizeof(math::Vector4)));
+            }
+
+            GLuint vao;
+            GLuint vertexBuffer, indexBuffer, instanceBuffer, indirectBuffer;
+            bool multiDraw;
+
+            std::vector<BatchMesh> meshes;
+            std::vector<DrawElementsCommand> commands;
+        };
+
+        StaticBatch::StaticBatch() :
+            mImpl(std::make_unique<StaticBatchImpl>())
+        { }
+
+        StaticBatch::~StaticBatch()
+        {
+            if (mImpl->vao != 0)
+            {
+                GLuint buffers[] = { mImpl->vertexBuffer, mImpl->indexBuffer,
+                    mImpl->instanceBuffer, mImpl->indirectBuffer };
+                glDeleteBuffers(4, buffers);
+                glDeleteVertexArrays(1, &mImpl->vao);
+            }
+        }
+
+        std::size_t StaticBatch::addMesh(
+            std::vector<BatchVertex> const& vertices,
+            std::vector<GLuint> const& indices,
+            std::vector<math::Vector4> const& instances)
+        {
+            mImpl->meshes.push_back({ vertices, indices, instances });
+            return mImpl->meshes.size() - 1;
+        }
+
+        void StaticBatch::setInstances(std::size_t mesh,
+            std::vector<math::Vector4> const& instances)
+        {
+            mImpl->meshes[mesh].instances = instances;
+        }
+
+        void StaticBatch::clear()
+        {
+            mImpl->meshes.clear();
+            mImpl->commands.clear();
+        }
+
+        void StaticBatch::build()
+        {
+            if (mImpl->vao == 0)
+            {
+                glGenVertexArrays(1, &mImpl->vao);
+                glGenBuffers(1, &mImpl->vertexBuffer);
+                glGenBuffers(1, &mImpl->indexBuffer);
+                glGenBuffers(1, &mImpl->instanceBuffer);
+                glGenBuffers(1, &mImpl->indirectBuffer);
+
+                // Multi-draw indirect is core in 4.3. Check the context
+                // version as well, since loaders may return pointers for
+                // functions the context does not support.
+                mImpl->multiDraw = gl3wIsSupported(4, 3) &&
+                    glMultiDrawElementsIndirect != nullptr;
+            }
+
+            // Concatenate the meshes and record a command for each one.
+            std::vector<BatchVertex> vertices;
+            std::vector<GLuint> indices;
+            std::vector<math::Vector4> instances;
+            mImpl->commands.clear();
+            for (auto const& mesh : mImpl->meshes)
+            {
+                DrawElementsCommand command;
+                command.count = (GLuint)mesh.indices.size();
+                command.instanceCount = (GLuint)mesh.instances.size();
+                command.firstIndex = (GLuint)indices.size();
+                command.baseVertex = (GLint)vertices.size();
+                command.baseInstance = (GLuint)instances.size();
+                mImpl->commands.push_back(command);
+
+                vertices.insert(vertices.end(), mesh.vertices.begin(),
+                    mesh.vertices.end());
+                indices.insert(indices.end(), mesh.indices.begin(),
+                    mesh.indices.end());
+                instances.insert(instances.end(), mesh.instances.begin(),
+                    mesh.instances.end());
+            }
+
+            glBindVertexArray(mImpl->vao);
+
+            glBindBuffer(GL_ARRAY_BUFFER, mImpl->vertexBuffer);
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(BatchVertex),
+                vertices.data(), GL_STATIC_DRAW);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex),
+                (GLvoid*)offsetof(BatchVertex, position));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex),
+                (GLvoid*)offsetof(BatchVertex, normal));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex),
+                (GLvoid*)offsetof(BatchVertex, color));
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(BatchVertex),
+                (GLvoid*)offsetof(BatchVertex, texCoord));
+
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mImpl->indexBuffer);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+                indices.data(), GL_STATIC_DRAW);
+
+            glBindBuffer(GL_ARRAY_BUFFER, mImpl->instanceBuffer);
+            glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(math::Vector4),
+                instances.data(), GL_STATIC_DRAW);
+            glEnableVertexAttribArray(4);
+            mImpl->setInstanceOffset(0);
+            glVertexAttribDivisor(4, 1);
+
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+            if (mImpl->multiDraw)
+            {
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mImpl->indirectBuffer);
+                glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                    mImpl->commands.size() * sizeof(DrawElementsCommand),
+                    mImpl->commands.data(), GL_STATIC_DRAW);
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            }
+        }
+
+        void StaticBatch::draw() const
+        {
+            if (mImpl->commands.empty())
+            {
+                return;
+            }
+
+            glBindVertexArray(mImpl->vao);
+
+            if (mImpl->multiDraw)
+            {
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mImpl->indirectBuffer);
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                    (void*)0, (GLsizei)mImpl->commands.size(), 0);
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            }
+            else
+            {
+                // Without base instances, point the instance attribute at
+                // each command's first instance before drawing it.
+                for (auto const& command : mImpl->commands)
+                {
+                    mImpl->setInstanceOffset(command.baseInstance);
+                    glDrawElementsInstancedBaseVertex(GL_TRIANGLES,
+                        command.count, GL_UNSIGNED_INT,
+                        (GLvoid*)(command.firstIndex * sizeof(GLuint)),
+                        command.instanceCount, command.baseVertex);
+                }
+                mImpl->setInstanceOffset(0);
+                glBindBuffer(GL_ARRAY_BUFFER, 0);
+            }
+
+            glBindVertexArray(0);
+        }
+
+        std::size_t StaticBatch::getDrawCount() const
+        {
+            return mImpl->commands.size();
+        }
+
+        bool StaticBatch::isMultiDraw() const
+        {
+            return mImpl->multiDraw;
+        }
+    }
+}
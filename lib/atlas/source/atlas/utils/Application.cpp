@@ -69,6 +69,7 @@ namespace atlas
             }
 
             GLFWwindow* currentWindow;
+            gl::FrameCapture frameCapture;
             std::vector<ScenePointer> sceneList;
             std::vector<double> sceneTicks;
             size_t currentScene;
@@ -175,6 +176,8 @@ namespace atlas
         {
             if (mImpl->currentWindow)
             {
+                glfwMakeContextCurrent(mImpl->currentWindow);
+                mImpl->frameCapture.stop();
                 glfwDestroyWindow(mImpl->currentWindow);
             }
 
@@ -308,10 +311,18 @@ namespace atlas
                 mImpl->sceneList[mImpl->currentScene]->updateScene(currentTime);
                 mImpl->sceneList[mImpl->currentScene]->renderScene();
 
+                if (mImpl->frameCapture.isCapturing())
+                {
+                    glfwGetFramebufferSize(mImpl->currentWindow, &width,
+                        &height);
+                    mImpl->frameCapture.captureFrame(width, height);
+                }
+
                 glfwSwapBuffers(mImpl->currentWindow);
                 glfwPollEvents();
             }
 
+            mImpl->frameCapture.stop();
             mImpl->sceneList[mImpl->currentScene]->onSceneExit();
         }
 
@@ -348,5 +359,27 @@ namespace atlas
         {
             return mImpl->currentWindow;
         }
+
+        void Application::startFrameCapture(std::string const& prefix,
+            gl::CaptureFormat format)
+        {
+            if (mImpl->currentWindow == nullptr)
+            {
+                WARN_LOG("Cannot capture frames without a window.");
+                return;
+            }
+
+            mImpl->frameCapture.start(prefix, format);
+        }
+
+        void Application::stopFrameCapture()
+        {
+            mImpl->frameCapture.stop();
+        }
+
+        bool Application::isCapturingFrames() const
+        {
+            return mImpl->frameCapture.isCapturing();
+        }
     }
 }
\ No newline at end of file
@@ -0,0 +1,877 @@
+#include "atlas/utils/BVH.hpp"
+#include "atlas/core/Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+namespace atlas
+{
+    namespace utils
+    {
+        namespace
+        {
+            using NodeArray = std::vector<BVNode, CacheAlignedAllocator<BVNode>>;
+
+            const int kBinCount = 16;
+            const std::uint32_t kMaxLeafSize = 4;
+            const float kTraversalCost = 1.0f;
+
+            // Keeps the traversal stack in BVH.hpp from overflowing.
+            const int kMaxDepth = 48;
+
+            // Below these sizes spawning threads costs more than it saves.
+            const std::uint32_t kMinParallelBuild = 4096;
+            const std::size_t kMinParallelQueries = 4096;
+
+            // BBox lives in another translation unit, so the builder works on
+            // this inline copy to keep its inner loops free of calls.
+            struct Box
+            {
+                Box() :
+                    pMin(std::numeric_limits<float>::max()),
+                    pMax(-std::numeric_limits<float>::max())
+                { }
+
+                Box(BBox const& box) :
+                    pMin(box.pMin),
+                    pMax(box.pMax)
+                { }
+
+                void grow(atlas::math::Point const& p)
+                {
+                    pMin = glm::min(pMin, p);
+                    pMax = glm::max(pMax, p);
+                }
+
+                void grow(Box const& box)
+                {
+                    pMin = glm::min(pMin, box.pMin);
+                    pMax = glm::max(pMax, box.pMax);
+                }
+
+                float area() const
+                {
+                    atlas::math::Vector d = pMax - pMin;
+                    if (d.x < 0.0f || d.y < 0.0f || d.z < 0.0f)
+                    {
+                        return 0.0f;
+                    }
+
+                    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+                }
+
+                atlas::math::Point pMin, pMax;
+            };
+
+            struct Subtree
+            {
+                std::uint32_t node;
+                std::uint32_t begin;
+                std::uint32_t end;
+                int depth;
+                NodeArray nodes;
+            };
+
+            template <class BoxType>
+            void setBounds(BVNode& node, BoxType const& box)
+            {
+                node.pMin = box.pMin;
+                node.pMax = box.pMax;
+            }
+
+            BBox getBounds(BVNode const& node)
+            {
+                BBox box;
+                box.pMin = node.pMin;
+                box.pMax = node.pMax;
+                return box;
+            }
+
+            // Clips [0, tMax] against the box slabs and returns the entry
+            // parameter and the axis it was found on.
+            bool clipSegment(atlas::math::Point const& pMin,
+                atlas::math::Point const& pMax,
+                atlas::math::Point const& origin,
+                atlas::math::Vector const& invDir, float tMax,
+                float& tEntry, int& entryAxis)
+            {
+                float t0 = 0.0f;
+                float t1 = tMax;
+                entryAxis = -1;
+
+                for (int a = 0; a < 3; ++a)
+                {
+                    float tNear = (pMin[a] - origin[a]) * invDir[a];
+                    float tFar = (pMax[a] - origin[a]) * invDir[a];
+                    if (tNear > tFar)
+                    {
+                        std::swap(tNear, tFar);
+                    }
+
+                    if (tNear > t0)
+                    {
+                        t0 = tNear;
+                        entryAxis = a;
+                    }
+
+                    t1 = (tFar < t1) ? tFar : t1;
+                    if (t0 > t1)
+                    {
+                        return false;
+                    }
+                }
+
+                tEntry = t0;
+                return true;
+            }
+
+            bool intersectTriangle(atlas::math::Point const* corners,
+                atlas::math::Point const& origin,
+                atlas::math::Vector const& dir, float tMax, float& t,
+                atlas::math::Normal& normal)
+            {
+                atlas::math::Vector e1 = corners[1] - corners[0];
+                atlas::math::Vector e2 = corners[2] - corners[0];
+                atlas::math::Vector p = glm::cross(dir, e2);
+                float det = glm::dot(e1, p);
+                if (std::abs(det) < 1e-12f)
+                {
+                    return false;
+                }
+
+                float invDet = 1.0f / det;
+                atlas::math::Vector s = origin - corners[0];
+                float u = glm::dot(s, p) * invDet;
+                if (u < 0.0f || u > 1.0f)
+                {
+                    return false;
+                }
+
+                atlas::math::Vector q = glm::cross(s, e1);
+                float v = glm::dot(dir, q) * invDet;
+                if (v < 0.0f || u + v > 1.0f)
+                {
+                    return false;
+                }
+
+                float hit = glm::dot(e2, q) * invDet;
+                if (hit < 0.0f || hit > tMax)
+                {
+                    return false;
+                }
+
+                t = hit;
+                normal = glm::normalize(glm::cross(e1, e2));
+                if (glm::dot(normal, dir) > 0.0f)
+                {
+                    normal = -normal;
+                }
+
+                return true;
+            }
+
+            class Builder
+            {
+            public:
+                Builder(std::vector<Box> const& bounds,
+                    std::vector<atlas::math::Point> const& centroids,
+                    std::vector<std::uint32_t>& order, NodeArray& nodes,
+                    std::uint32_t deferSize, std::vector<Subtree>* deferred) :
+                    mBounds(bounds),
+                    mCentroids(centroids),
+                    mOrder(order),
+                    mNodes(nodes),
+                    mDeferSize(deferSize),
+                    mDeferred(deferred)
+                { }
+
+                void build(std::uint32_t nodeIndex, std::uint32_t begin,
+                    std::uint32_t end, int depth)
+                {
+                    Box box;
+                    Box centroidBox;
+                    for (std::uint32_t i = begin; i < end; ++i)
+                    {
+                        box.grow(mBounds[mOrder[i]]);
+                        centroidBox.grow(mCentroids[mOrder[i]]);
+                    }
+
+                    setBounds(mNodes[nodeIndex], box);
+                    std::uint32_t count = end - begin;
+
+                    if (mDeferred && count <= mDeferSize)
+                    {
+                        Subtree subtree;
+                        subtree.node = nodeIndex;
+                        subtree.begin = begin;
+                        subtree.end = end;
+                        subtree.depth = depth;
+                        mDeferred->push_back(std::move(subtree));
+                        return;
+                    }
+
+                    if (count <= 1 || depth >= kMaxDepth)
+                    {
+                        makeLeaf(nodeIndex, begin, count);
+                        return;
+                    }
+
+                    int axis = -1;
+                    int split = 0;
+                    float bestCost = std::numeric_limits<float>::max();
+                    findSplit(begin, end, centroidBox, axis, split, bestCost);
+
+                    float parentArea = box.area();
+                    float splitCost = kTraversalCost +
+                        ((parentArea > 0.0f) ? bestCost / parentArea : 0.0f);
+                    if (count <= kMaxLeafSize &&
+                        (axis < 0 || splitCost >= (float)count))
+                    {
+                        makeLeaf(nodeIndex, begin, count);
+                        return;
+                    }
+
+                    std::uint32_t mid = begin + count / 2;
+                    if (axis >= 0)
+                    {
+                        float origin = centroidBox.pMin[axis];
+                        float scale = kBinCount /
+                            (centroidBox.pMax[axis] - origin);
+                        auto it = std::partition(
+                            mOrder.begin() + begin, mOrder.begin() + end,
+                            [&](std::uint32_t prim)
+                            {
+                                return binIndex(mCentroids[prim][axis],
+                                    origin, scale) < split;
+                            });
+                        mid = (std::uint32_t)(it - mOrder.begin());
+                    }
+
+                    // Every centroid coincides: split by count instead.
+                    if (mid == begin || mid == end)
+                    {
+                        mid = begin + count / 2;
+                    }
+
+                    std::uint32_t child = (std::uint32_t)mNodes.size();
+                    mNodes.resize(child + 2);
+                    mNodes[nodeIndex].offset = child;
+                    mNodes[nodeIndex].count = 0;
+
+                    build(child, begin, mid, depth + 1);
+                    build(child + 1, mid, end, depth + 1);
+                }
+
+            private:
+                struct Bin
+                {
+                    Box box;
+                    std::uint32_t count = 0;
+                };
+
+                static int binIndex(float c, float origin, float scale)
+                {
+                    int bin = (int)((c - origin) * scale);
+                    return std::min(std::max(bin, 0), kBinCount - 1);
+                }
+
+                void makeLeaf(std::uint32_t nodeIndex, std::uint32_t begin,
+                    std::uint32_t count)
+                {
+                    mNodes[nodeIndex].offset = begin;
+                    mNodes[nodeIndex].count = count;
+                }
+
+                void findSplit(std::uint32_t begin, std::uint32_t end,
+                    Box const& centroidBox, int& bestAxis, int& bestSplit,
+                    float& bestCost) const
+                {
+                    // Bin all three axes in one pass over the primitives.
+                    Bin bins[3][kBinCount];
+                    float scale[3];
+                    for (int a = 0; a < 3; ++a)
+                    {
+                        float extent = centroidBox.pMax[a] - centroidBox.pMin[a];
+                        scale[a] = (extent > 0.0f) ? kBinCount / extent : 0.0f;
+                    }
+
+                    for (std::uint32_t i = begin; i < end; ++i)
+                    {
+                        std::uint32_t prim = mOrder[i];
+                        for (int a = 0; a < 3; ++a)
+                        {
+                            Bin& bin = bins[a][binIndex(mCentroids[prim][a],
+                                centroidBox.pMin[a], scale[a])];
+                            bin.box.grow(mBounds[prim]);
+                            ++bin.count;
+                        }
+                    }
+
+                    for (int a = 0; a < 3; ++a)
+                    {
+                        if (scale[a] == 0.0f)
+                        {
+                            continue;
+                        }
+
+                        // Sweep from the right to get the cost of every
+                        // suffix, then from the left to combine them.
+                        float rightArea[kBinCount];
+                        std::uint32_t rightCount[kBinCount];
+                        Box acc;
+                        std::uint32_t n = 0;
+                        for (int b = kBinCount - 1; b > 0; --b)
+                        {
+                            acc.grow(bins[a][b].box);
+                            n += bins[a][b].count;
+                            rightArea[b] = acc.area();
+                            rightCount[b] = n;
+                        }
+
+                        acc = Box();
+                        n = 0;
+                        for (int b = 0; b < kBinCount - 1; ++b)
+                        {
+                            acc.grow(bins[a][b].box);
+                            n += bins[a][b].count;
+                            if (n == 0 || rightCount[b + 1] == 0)
+                            {
+                                continue;
+                            }
+
+                            float cost = n * acc.area() +
+                                rightCount[b + 1] * rightArea[b + 1];
+                            if (cost < bestCost)
+                            {
+                                bestCost = cost;
+                                bestAxis = a;
+                                bestSplit = b + 1;
+                            }
+                        }
+                    }
+                }
+
+                std::vector<Box> const& mBounds;
+                std::vector<atlas::math::Point> const& mCentroids;
+                std::vector<std::uint32_t>& mOrder;
+                NodeArray& mNodes;
+                std::uint32_t mDeferSize;
+                std::vector<Subtree>* mDeferred;
+            };
+
+            template <typename Function>
+            void forEachQuery(std::size_t count, Function const& function)
+            {
+                if (count < kMinParallelQueries)
+                {
+                    for (std::size_t i = 0; i < count; ++i)
+                    {
+                        function(i);
+                    }
+                }
+                else
+                {
+                    atlas::core::parallelFor(0, count, function);
+                }
+            }
+        }
+
+        BVH::BVH()
+        { }
+
+        void BVH::build(std::vector<BBox> const& bounds)
+        {
+            mTriangles.clear();
+            mTriangleIndices.clear();
+            buildNodes(bounds);
+
+            mBounds.resize(mIndices.size());
+            for (std::size_t i = 0; i < mIndices.size(); ++i)
+            {
+                mBounds[i] = bounds[mIndices[i]];
+            }
+        }
+
+        void BVH::build(std::vector<atlas::math::Point> const& vertices,
+            std::vector<std::uint32_t> const& indices)
+        {
+            std::size_t triangles = indices.size() / 3;
+            std::vector<BBox> bounds(triangles);
+            for (std::size_t i = 0; i < triangles; ++i)
+            {
+                BBox box(vertices[indices[3 * i]]);
+                box = join(box, BBox(vertices[indices[3 * i + 1]]));
+                bounds[i] = join(box, BBox(vertices[indices[3 * i + 2]]));
+            }
+
+            buildNodes(bounds);
+
+            // Store the triangles in leaf order so a leaf reads one
+            // contiguous block.
+            mBounds.resize(triangles);
+            mTriangles.resize(3 * triangles);
+            mTriangleIndices.resize(3 * triangles);
+            for (std::size_t i = 0; i < triangles; ++i)
+            {
+                std::uint32_t prim = mIndices[i];
+                mBounds[i] = bounds[prim];
+                for (std::size_t k = 0; k < 3; ++k)
+                {
+                    mTriangleIndices[3 * i + k] = indices[3 * prim + k];
+                    mTriangles[3 * i + k] = vertices[indices[3 * prim + k]];
+                }
+            }
+        }
+
+        void BVH::refit(std::vector<BBox> const& bounds)
+        {
+            if (bounds.size() != mIndices.size() || !mTriangles.empty())
+            {
+                return;
+            }
+
+            for (std::size_t i = 0; i < mIndices.size(); ++i)
+            {
+                mBounds[i] = bounds[mIndices[i]];
+            }
+
+            refitNodes();
+        }
+
+        void BVH::refit(std::vector<atlas::math::Point> const& vertices)
+        {
+            if (mTriangles.empty())
+            {
+                return;
+            }
+
+            for (std::size_t i = 0; i < mBounds.size(); ++i)
+            {
+                BBox box;
+                for (std::size_t k = 0; k < 3; ++k)
+                {
+                    mTriangles[3 * i + k] = vertices[mTriangleIndices[3 * i + k]];
+                    box = join(box, BBox(mTriangles[3 * i + k]));
+                }
+
+                mBounds[i] = box;
+            }
+
+            refitNodes();
+        }
+
+        void BVH::clear()
+        {
+            mNodes.clear();
+            mBounds.clear();
+            mIndices.clear();
+            mTriangles.clear();
+            mTriangleIndices.clear();
+        }
+
+        bool BVH::empty() const
+        {
+            return mIndices.empty();
+        }
+
+        BBox BVH::getGlobalVolume() const
+        {
+            return mNodes.empty() ? BBox() : getBounds(mNodes[0]);
+        }
+
+        std::size_t BVH::getNodeCount() const
+        {
+            return mNodes.size();
+        }
+
+        std::size_t BVH::getPrimitiveCount() const
+        {
+            return mIndices.size();
+        }
+
+        bool BVH::intersect(atlas::math::Point const& from,
+            atlas::math::Point const& to, SegmentHit& hit) const
+        {
+            hit.t = 1.0f;
+            hit.primitive = kNoHit;
+            hit.normal = atlas::math::Normal(0.0f);
+
+            if (mNodes.empty())
+            {
+                return false;
+            }
+
+            atlas::math::Vector dir = to - from;
+            atlas::math::Vector invDir = 1.0f / dir;
+
+            float tEntry;
+            int axis;
+            if (!clipSegment(mNodes[0].pMin, mNodes[0].pMax, from, invDir,
+                hit.t, tEntry, axis))
+            {
+                return false;
+            }
+
+            std::uint32_t stack[kStackSize];
+            float entries[kStackSize];
+            int top = 0;
+            stack[top] = 0;
+            entries[top++] = tEntry;
+
+            while (top > 0)
+            {
+                --top;
+                if (entries[top] > hit.t)
+                {
+                    continue;
+                }
+
+                BVNode const& node = mNodes[stack[top]];
+                if (node.isLeaf())
+                {
+                    for (std::uint32_t i = node.offset;
+                        i < node.offset + node.count; ++i)
+                    {
+                        float t;
+                        atlas::math::Normal normal;
+                        if (!mTriangles.empty())
+                        {
+                            if (!intersectTriangle(&mTriangles[3 * i], from,
+                                dir, hit.t, t, normal))
+                            {
+                                continue;
+                            }
+                        }
+                        else
+                        {
+                            if (!clipSegment(mBounds[i].pMin, mBounds[i].pMax,
+                                from, invDir, hit.t, t, axis))
+                            {
+                                continue;
+                            }
+
+                            // Starting inside a box pushes straight back out.
+                            normal = atlas::math::Normal(0.0f);
+                            if (axis >= 0)
+                            {
+                                normal[axis] = (dir[axis] > 0.0f) ? -1.0f : 1.0f;
+                            }
+                            else if (glm::dot(dir, dir) > 0.0f)
+                            {
+                                normal = -glm::normalize(dir);
+                            }
+                        }
+
+                        hit.t = t;
+                        hit.primitive = mIndices[i];
+                        hit.normal = normal;
+                    }
+
+                    continue;
+                }
+
+                // Visit the nearer child first so the far one is culled by
+                // the closest hit more often.
+                float t0, t1;
+                BVNode const& left = mNodes[node.offset];
+                BVNode const& right = mNodes[node.offset + 1];
+                bool hitLeft = clipSegment(left.pMin, left.pMax, from,
+                    invDir, hit.t, t0, axis);
+                bool hitRight = clipSegment(right.pMin, right.pMax, from,
+                    invDir, hit.t, t1, axis);
+
+                if (hitLeft && hitRight)
+                {
+                    bool leftFirst = t0 <= t1;
+                    stack[top] = leftFirst ? node.offset + 1 : node.offset;
+                    entries[top++] = leftFirst ? t1 : t0;
+                    stack[top] = leftFirst ? node.offset : node.offset + 1;
+                    entries[top++] = leftFirst ? t0 : t1;
+                }
+                else if (hitLeft)
+                {
+                    stack[top] = node.offset;
+                    entries[top++] = t0;
+                }
+                else if (hitRight)
+                {
+                    stack[top] = node.offset + 1;
+                    entries[top++] = t1;
+                }
+            }
+
+            return hit.primitive != kNoHit;
+        }
+
+        void BVH::queryPoints(atlas::math::Point const* points,
+            std::size_t count, std::uint32_t* hits) const
+        {
+            forEachQuery(count, [&](std::size_t i)
+            {
+                hits[i] = kNoHit;
+                visit(points[i], [&](std::uint32_t prim)
+                {
+                    hits[i] = prim;
+                    return false;
+                });
+            });
+        }
+
+        void BVH::queryBoxes(BBox const* boxes, std::size_t count,
+            std::uint32_t* hits) const
+        {
+            forEachQuery(count, [&](std::size_t i)
+            {
+                hits[i] = kNoHit;
+                visit(boxes[i], [&](std::uint32_t prim)
+                {
+                    hits[i] = prim;
+                    return false;
+                });
+            });
+        }
+
+        void BVH::intersectSegments(atlas::math::Point const* from,
+            atlas::math::Point const* to, std::size_t count,
+            SegmentHit* hits) const
+        {
+            forEachQuery(count, [&](std::size_t i)
+            {
+                intersect(from[i], to[i], hits[i]);
+            });
+        }
+
+        void BVH::occluded(atlas::math::Point const* from,
+            atlas::math::Point const* to, std::size_t count,
+            std::uint8_t* occluded) const
+        {
+            for (std::size_t i = 0; i < count; i += kPacketSize)
+            {
+                int lanes = (int)std::min<std::size_t>(kPacketSize, count - i);
+                occludedPacket(from + i, to + i, lanes, occluded + i);
+            }
+        }
+
+        void BVH::occludedPacket(atlas::math::Point const* from,
+            atlas::math::Point const* to, int lanes,
+            std::uint8_t* occluded) const
+        {
+            if (mNodes.empty())
+            {
+                return;
+            }
+
+            // Lanes are stored as separate arrays so the node test below is
+            // a straight loop the compiler can vectorize.
+            float ox[kPacketSize], oy[kPacketSize], oz[kPacketSize];
+            float ix[kPacketSize], iy[kPacketSize], iz[kPacketSize];
+            int active[kPacketSize];
+            int remaining = 0;
+            for (int k = 0; k < kPacketSize; ++k)
+            {
+                atlas::math::Point origin(0.0f);
+                atlas::math::Vector invDir(0.0f);
+                active[k] = 0;
+                if (k < lanes && !occluded[k])
+                {
+                    origin = from[k];
+                    invDir = 1.0f / (to[k] - from[k]);
+                    active[k] = 1;
+                    ++remaining;
+                }
+
+                ox[k] = origin.x;
+                oy[k] = origin.y;
+                oz[k] = origin.z;
+                ix[k] = invDir.x;
+                iy[k] = invDir.y;
+                iz[k] = invDir.z;
+            }
+
+            std::uint32_t stack[kStackSize];
+            int top = 0;
+            stack[top++] = 0;
+
+            while (top > 0 && remaining > 0)
+            {
+                BVNode const& node = mNodes[stack[--top]];
+
+                int anyHit = 0;
+                for (int k = 0; k < kPacketSize; ++k)
+                {
+                    float x0 = (node.pMin.x - ox[k]) * ix[k];
+                    float x1 = (node.pMax.x - ox[k]) * ix[k];
+                    float y0 = (node.pMin.y - oy[k]) * iy[k];
+                    float y1 = (node.pMax.y - oy[k]) * iy[k];
+                    float z0 = (node.pMin.z - oz[k]) * iz[k];
+                    float z1 = (node.pMax.z - oz[k]) * iz[k];
+
+                    float tNear = std::max(std::max(std::min(x0, x1),
+                        std::min(y0, y1)), std::max(std::min(z0, z1), 0.0f));
+                    float tFar = std::min(std::min(std::max(x0, x1),
+                        std::max(y0, y1)), std::min(std::max(z0, z1), 1.0f));
+                    anyHit |= active[k] & (tNear <= tFar);
+                }
+
+                if (!anyHit)
+                {
+                    continue;
+                }
+
+                if (!node.isLeaf())
+                {
+                    stack[top++] = node.offset + 1;
+                    stack[top++] = node.offset;
+                    continue;
+                }
+
+                for (std::uint32_t i = node.offset;
+                    i < node.offset + node.count && remaining > 0; ++i)
+                {
+                    for (int k = 0; k < lanes; ++k)
+                    {
+                        if (!active[k])
+                        {
+                            continue;
+                        }
+
+                        float t;
+                        bool blocked;
+                        if (!mTriangles.empty())
+                        {
+                            atlas::math::Normal normal;
+                            blocked = intersectTriangle(&mTriangles[3 * i],
+                                from[k], to[k] - from[k], 1.0f, t, normal);
+                        }
+                        else
+                        {
+                            int axis;
+                            blocked = clipSegment(mBounds[i].pMin,
+                                mBounds[i].pMax, from[k],
+                                atlas::math::Vector(ix[k], iy[k], iz[k]),
+                                1.0f, t, axis);
+                        }
+
+                        if (blocked)
+                        {
+                            occluded[k] = 1;
+                            active[k] = 0;
+                            --remaining;
+                        }
+                    }
+                }
+            }
+        }
+
+        void BVH::buildNodes(std::vector<BBox> const& bounds)
+        {
+            std::uint32_t count = (std::uint32_t)bounds.size();
+            mNodes.clear();
+            mIndices.resize(count);
+            if (count == 0)
+            {
+                return;
+            }
+
+            std::vector<Box> boxes(bounds.begin(), bounds.end());
+            std::vector<atlas::math::Point> centroids(count);
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                centroids[i] = 0.5f * (bounds[i].pMin + bounds[i].pMax);
+                mIndices[i] = i;
+            }
+
+            // Node 1 is padding so that every pair of children starts on an
+            // even index and shares a cache line.
+            mNodes.resize(2);
+            mNodes[1] = BVNode();
+            setBounds(mNodes[1], Box());
+
+            std::uint32_t threads = std::thread::hardware_concurrency();
+            if (threads < 2 || count < 2 * kMinParallelBuild)
+            {
+                Builder builder(boxes, centroids, mIndices, mNodes, 0,
+                    nullptr);
+                builder.build(0, 0, count, 0);
+                return;
+            }
+
+            // Split the top of the tree here and hand every subtree below
+            // the threshold to its own task.
+            std::vector<Subtree> subtrees;
+            std::uint32_t deferSize =
+                std::max(kMinParallelBuild, count / (4 * threads));
+            Builder top(boxes, centroids, mIndices, mNodes, deferSize,
+                &subtrees);
+            top.build(0, 0, count, 0);
+
+            atlas::core::parallelFor(0, subtrees.size(), [&](std::size_t i)
+            {
+                Subtree& subtree = subtrees[i];
+                subtree.nodes.resize(1);
+                Builder builder(boxes, centroids, mIndices, subtree.nodes,
+                    0, nullptr);
+                builder.build(0, subtree.begin, subtree.end, subtree.depth);
+            });
+
+            // Splice every subtree in: its root replaces the placeholder and
+            // the rest is appended, with child offsets shifted to match.
+            for (auto const& subtree : subtrees)
+            {
+                std::uint32_t base = (std::uint32_t)mNodes.size() - 1;
+                for (std::size_t j = 0; j < subtree.nodes.size(); ++j)
+                {
+                    BVNode node = subtree.nodes[j];
+                    if (!node.isLeaf())
+                    {
+                        node.offset += base;
+                    }
+
+                    if (j == 0)
+                    {
+                        mNodes[subtree.node] = node;
+                    }
+                    else
+                    {
+                        mNodes.push_back(node);
+                    }
+                }
+            }
+        }
+
+        void BVH::refitNodes()
+        {
+            // Children always come after their parent, so a reverse sweep
+            // sees every child before the node that contains it.
+            for (std::size_t i = mNodes.size(); i-- > 0;)
+            {
+                if (i == 1)
+                {
+                    continue;
+                }
+
+                BVNode& node = mNodes[i];
+                Box box;
+                if (node.isLeaf())
+                {
+                    for (std::uint32_t p = node.offset;
+                        p < node.offset + node.count; ++p)
+                    {
+                        box.grow(Box(mBounds[p]));
+                    }
+                }
+                else
+                {
+                    box.grow(mNodes[node.offset].pMin);
+                    box.grow(mNodes[node.offset].pMax);
+                    box.grow(mNodes[node.offset + 1].pMin);
+                    box.grow(mNodes[node.offset + 1].pMax);
+                }
+
+                setBounds(node, box);
+            }
+        }
+    }
+}
@@ -0,0 +1,326 @@
+#include "atlas/utils/DistanceField.hpp"
+#include "atlas/core/MappedFile.hpp"
+#include "atlas/core/Parallel.hpp"
+#include "atlas/core/Log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace atlas
+{
+    namespace utils
+    {
+        namespace
+        {
+            const char kFieldMagic[8] = { 'A', 'T', 'L', 'A', 'S', 'S', 'D', 'F' };
+            const std::uint32_t kFieldVersion = 1;
+
+            struct FieldHeader
+            {
+                char magic[8];
+                std::uint32_t version;
+                std::uint32_t reserved;
+                std::uint64_t key;
+                std::int32_t resolution[3];
+                float origin[3];
+                float cellSize;
+                float band;
+            };
+        }
+
+        DistanceField::DistanceField() :
+            mOrigin(0.0f),
+            mCellSize(1.0f),
+            mBand(0.0f),
+            mResolution(0)
+        { }
+
+        void DistanceField::build(BBox const& domain, float cellSize,
+            float band,
+            std::function<float(atlas::math::Point const&)> const& distance,
+            std::size_t maxNodes)
+        {
+            clear();
+
+            atlas::math::Vector extent = domain.pMax - domain.pMin;
+            if (extent.x < 0.0f || extent.y < 0.0f || extent.z < 0.0f)
+            {
+                return;
+            }
+
+            // Coarsen the grid until it fits in the node budget.
+            float volume = (extent.x + cellSize) * (extent.y + cellSize) *
+                (extent.z + cellSize);
+            cellSize = std::max(cellSize,
+                std::cbrt(volume / (float)maxNodes));
+
+            mOrigin = domain.pMin;
+            mCellSize = cellSize;
+            mBand = band;
+            mResolution = glm::ivec3(glm::ceil(extent / cellSize)) + 1;
+
+            std::size_t sliceSize = (std::size_t)mResolution.x * mResolution.y;
+            mNodes.resize(sliceSize * mResolution.z);
+
+            atlas::core::parallelFor(0, mResolution.z, [&](std::size_t z)
+            {
+                glm::vec4* slice = &mNodes[z * sliceSize];
+                for (int y = 0; y < mResolution.y; ++y)
+                {
+                    for (int x = 0; x < mResolution.x; ++x)
+                    {
+                        atlas::math::Point p = mOrigin +
+                            atlas::math::Vector(x, y, (float)z) * mCellSize;
+                        float d = glm::clamp(distance(p), -band, band);
+                        slice[y * mResolution.x + x] = glm::vec4(0.0f, 0.0f, 0.0f, d);
+                    }
+                }
+            });
+
+            // Gradients by central differences, one-sided at the borders.
+            glm::ivec3 stride(1, mResolution.x, (int)sliceSize);
+            atlas::core::parallelFor(0, mResolution.z, [&](std::size_t z)
+            {
+                for (int y = 0; y < mResolution.y; ++y)
+                {
+                    for (int x = 0; x < mResolution.x; ++x)
+                    {
+                        glm::ivec3 cell(x, y, (int)z);
+                        std::size_t index = z * sliceSize + y * mResolution.x + x;
+
+                        atlas::math::Vector gradient;
+                        for (int a = 0; a < 3; ++a)
+                        {
+                            int lo = (cell[a] > 0) ? 1 : 0;
+                            int hi = (cell[a] < mResolution[a] - 1) ? 1 : 0;
+                            if (lo + hi == 0)
+                            {
+                                gradient[a] = 0.0f;
+                                continue;
+                            }
+
+                            float dLo = mNodes[index - lo * stride[a]].w;
+                            float dHi = mNodes[index + hi * stride[a]].w;
+                            gradient[a] = (dHi - dLo) / ((lo + hi) * mCellSize);
+                        }
+
+                        float length = glm::length(gradient);
+                        if (length > 0.0f)
+                        {
+                            gradient /= length;
+                        }
+
+                        // Only the gradient is written, as other slices
+                        // read the distance of this node at the same time.
+                        mNodes[index].x = gradient.x;
+                        mNodes[index].y = gradient.y;
+                        mNodes[index].z = gradient.z;
+                    }
+                }
+            });
+        }
+
+        void DistanceField::clear()
+        {
+            mNodes.clear();
+            mResolution = glm::ivec3(0);
+        }
+
+        bool DistanceField::empty() const
+        {
+            return mNodes.empty();
+        }
+
+        bool DistanceField::save(std::string const& filename,
+            std::uint64_t key) const
+        {
+            std::FILE* file = std::fopen(filename.c_str(), "wb");
+            if (!file)
+            {
+                ERROR_LOG("Could not open " + filename + " for writing.");
+                return false;
+            }
+
+            FieldHeader header = {};
+            std::memcpy(header.magic, kFieldMagic, sizeof(header.magic));
+            header.version = kFieldVersion;
+            header.key = key;
+            for (int a = 0; a < 3; ++a)
+            {
+                header.resolution[a] = mResolution[a];
+                header.origin[a] = mOrigin[a];
+            }
+            header.cellSize = mCellSize;
+            header.band = mBand;
+
+            std::fwrite(&header, sizeof(header), 1, file);
+            std::fwrite(mNodes.data(), sizeof(glm::vec4), mNodes.size(), file);
+
+            bool ok = !std::ferror(file);
+            std::fclose(file);
+            return ok;
+        }
+
+        bool DistanceField::load(std::string const& filename,
+            std::uint64_t key)
+        {
+            atlas::core::MappedFile file;
+            if (!file.open(filename) || file.size() < sizeof(FieldHeader))
+            {
+                return false;
+            }
+
+            FieldHeader header;
+            std::memcpy(&header, file.data(), sizeof(header));
+            if (std::memcmp(header.magic, kFieldMagic, sizeof(header.magic)) != 0 ||
+                header.version != kFieldVersion || header.key != key)
+            {
+                return false;
+            }
+
+            std::size_t count = (std::size_t)header.resolution[0] *
+                header.resolution[1] * header.resolution[2];
+            if (file.size() != sizeof(header) + count * sizeof(glm::vec4))
+            {
+                return false;
+            }
+
+            mResolution = glm::ivec3(header.resolution[0],
+                header.resolution[1], header.resolution[2]);
+            mOrigin = atlas::math::Point(header.origin[0], header.origin[1],
+                header.origin[2]);
+            mCellSize = header.cellSize;
+            mBand = header.band;
+            mNodes.resize(count);
+            std::memcpy(mNodes.data(), file.data() + sizeof(header),
+                count * sizeof(glm::vec4));
+            return true;
+        }
+
+        float DistanceField::sample(atlas::math::Point const& p) const
+        {
+            return lookup(p).w;
+        }
+
+        float DistanceField::sample(atlas::math::Point const& p,
+            atlas::math::Normal& gradient) const
+        {
+            glm::vec4 node = lookup(p);
+            gradient = atlas::math::Normal(node);
+
+            // Interpolation shortens the gradient near features.
+            float length = glm::length(gradient);
+            if (length > 0.0f)
+            {
+                gradient /= length;
+            }
+
+            return node.w;
+        }
+
+        glm::vec4 DistanceField::lookup(atlas::math::Point const& p) const
+        {
+            atlas::math::Vector g = (p - mOrigin) / mCellSize;
+            if (mNodes.empty() ||
+                g.x < 0.0f || g.y < 0.0f || g.z < 0.0f ||
+                g.x > mResolution.x - 1 || g.y > mResolution.y - 1 ||
+                g.z > mResolution.z - 1)
+            {
+                return glm::vec4(0.0f, 0.0f, 0.0f, mBand);
+            }
+
+            glm::ivec3 cell = glm::min(glm::ivec3(g), mResolution - 2);
+            cell = glm::max(cell, glm::ivec3(0));
+            atlas::math::Vector f = g - atlas::math::Vector(cell);
+
+            std::size_t sx = (mResolution.x > 1) ? 1 : 0;
+            std::size_t sy = (mResolution.y > 1) ? (std::size_t)mResolution.x : 0;
+            std::size_t sz = (mResolution.z > 1) ?
+                (std::size_t)mResolution.x * mResolution.y : 0;
+            std::size_t i = cell.x + cell.y * (std::size_t)mResolution.x +
+                cell.z * (std::size_t)mResolution.x * mResolution.y;
+
+            glm::vec4 x00 = glm::mix(mNodes[i], mNodes[i + sx], f.x);
+            glm::vec4 x10 = glm::mix(mNodes[i + sy], mNodes[i + sy + sx], f.x);
+            glm::vec4 x01 = glm::mix(mNodes[i + sz], mNodes[i + sz + sx], f.x);
+            glm::vec4 x11 = glm::mix(mNodes[i + sz + sy],
+                mNodes[i + sz + sy + sx], f.x);
+
+            return glm::mix(glm::mix(x00, x10, f.y), glm::mix(x01, x11, f.y),
+                f.z);
+        }
+
+        float DistanceField::distanceToBox(BBox const& box,
+            atlas::math::Point const& p)
+        {
+            atlas::math::Point center = 0.5f * (box.pMin + box.pMax);
+            atlas::math::Vector q = glm::abs(p - center) -
+                0.5f * (box.pMax - box.pMin);
+
+            float outside = glm::length(glm::max(q, 0.0f));
+            float inside = std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f);
+            return outside + inside;
+        }
+
+        float DistanceField::distanceToTriangle(atlas::math::Point const& a,
+            atlas::math::Point const& b, atlas::math::Point const& c,
+            atlas::math::Point const& p)
+        {
+            // Closest point by Voronoi regions, as in Ericson's Real-Time
+            // Collision Detection (5.1.5).
+            atlas::math::Vector ab = b - a;
+            atlas::math::Vector ac = c - a;
+            atlas::math::Vector ap = p - a;
+            atlas::math::Point closest;
+
+            float d1 = glm::dot(ab, ap);
+            float d2 = glm::dot(ac, ap);
+            atlas::math::Vector bp = p - b;
+            float d3 = glm::dot(ab, bp);
+            float d4 = glm::dot(ac, bp);
+            atlas::math::Vector cp = p - c;
+            float d5 = glm::dot(ab, cp);
+            float d6 = glm::dot(ac, cp);
+
+            float va = d3 * d6 - d5 * d4;
+            float vb = d5 * d2 - d1 * d6;
+            float vc = d1 * d4 - d3 * d2;
+
+            if (d1 <= 0.0f && d2 <= 0.0f)
+            {
+                closest = a;
+            }
+            else if (d3 >= 0.0f && d4 <= d3)
+            {
+                closest = b;
+            }
+            else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+            {
+                closest = a + ab * (d1 / (d1 - d3));
+            }
+            else if (d6 >= 0.0f && d5 <= d6)
+            {
+                closest = c;
+            }
+            else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+            {
+                closest = a + ac * (d2 / (d2 - d6));
+            }
+            else if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+            {
+                closest = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+            }
+            else
+            {
+                float denom = 1.0f / (va + vb + vc);
+                closest = a + ab * (vb * denom) + ac * (vc * denom);
+            }
+
+            float distance = glm::length(p - closest);
+            return (glm::dot(p - closest, glm::cross(ab, ac)) < 0.0f) ?
+                -distance : distance;
+        }
+    }
+}
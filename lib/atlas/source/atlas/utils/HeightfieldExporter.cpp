@@ -0,0 +1,424 @@
+#include "atlas/utils/HeightfieldExporter.hpp"
+#include "atlas/core/Log.hpp"
+#include "atlas/core/Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+    using atlas::math::Point;
+    using atlas::math::Vector;
+
+    // Number of vertices or faces encoded together in one block.
+    const std::size_t kBlockSize = 1 << 16;
+
+    // Upper bounds on the encoded size of one element.
+    const std::size_t kMaxVertexBytes = 160;
+    const std::size_t kMaxFaceBytes = 128;
+
+    char* writeUnsigned(char* out, std::uint64_t value)
+    {
+        char digits[20];
+        int count = 0;
+        do
+        {
+            digits[count++] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+
+        while (count > 0)
+        {
+            *out++ = digits[--count];
+        }
+        return out;
+    }
+
+    // Prints a float with at most six decimals, which is all the precision
+    // the exported meshes need, without going through the stream machinery.
+    char* writeFloat(char* out, float value)
+    {
+        if (!(std::fabs(value) < 1e9f))
+        {
+            return out + std::sprintf(out, "%g", value);
+        }
+
+        std::uint64_t fixed = (std::uint64_t)(std::fabs((double)value) * 1e6 + 0.5);
+        if (value < 0.0f && fixed != 0)
+        {
+            *out++ = '-';
+        }
+
+        out = writeUnsigned(out, fixed / 1000000);
+
+        std::uint32_t fraction = (std::uint32_t)(fixed % 1000000);
+        if (fraction != 0)
+        {
+            int width = 6;
+            while (fraction % 10 == 0)
+            {
+                fraction /= 10;
+                --width;
+            }
+
+            *out++ = '.';
+            for (int i = width - 1; i >= 0; --i)
+            {
+                out[i] = (char)('0' + fraction % 10);
+                fraction /= 10;
+            }
+            out += width;
+        }
+        return out;
+    }
+
+    char* writeBinary(char* out, const void* data, std::size_t size)
+    {
+        std::memcpy(out, data, size);
+        return out + size;
+    }
+
+    // One side of the skirt: the boundary vertices it hangs from and the
+    // direction it faces.
+    struct SkirtSide
+    {
+        std::vector<std::size_t> cells;
+        bool reversed;
+    };
+
+    // Encodes [0, count) in blocks. Each wave of blocks is formatted in
+    // parallel and then written to the file in order.
+    template <typename Encode>
+    bool writeBlocks(std::FILE* file, std::size_t count, std::size_t maxBytes,
+        Encode const& encode)
+    {
+        std::size_t blocks = (count + kBlockSize - 1) / kBlockSize;
+        std::size_t wave = 2 * std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::vector<char>> buffers(wave);
+
+        for (std::size_t first = 0; first < blocks; first += wave)
+        {
+            std::size_t last = std::min(blocks, first + wave);
+            atlas::core::parallelFor(first, last, [&](std::size_t block)
+            {
+                std::size_t begin = block * kBlockSize;
+                std::size_t end = std::min(count, begin + kBlockSize);
+
+                auto& buffer = buffers[block - first];
+                buffer.resize((end - begin) * maxBytes);
+                char* out = encode(buffer.data(), begin, end);
+                buffer.resize(out - buffer.data());
+            });
+
+            for (std::size_t block = first; block < last; ++block)
+            {
+                auto const& buffer = buffers[block - first];
+                if (std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+}
+
+namespace atlas
+{
+    namespace utils
+    {
+        struct HeightfieldExporter::HeightfieldExporterImpl
+        {
+            HeightfieldExporterImpl() :
+                busy(false)
+            { }
+
+            std::thread worker;
+            std::atomic<bool> busy;
+        };
+
+        HeightfieldExporter::HeightfieldExporter() :
+            mImpl(std::make_unique<HeightfieldExporterImpl>())
+        { }
+
+        HeightfieldExporter::~HeightfieldExporter()
+        {
+            wait();
+        }
+
+        bool HeightfieldExporter::write(std::string const& filename,
+            Heightfield const& field, HeightfieldFormat format, bool skirt,
+            float skirtBase)
+        {
+            std::size_t rows = field.rows;
+            std::size_t cols = field.cols;
+            if (rows < 2 || cols < 2 || field.positions.size() != rows * cols ||
+                (!field.normals.empty() && field.normals.size() != rows * cols))
+            {
+                ERROR_LOG("Cannot export an incomplete heightfield.");
+                return false;
+            }
+
+            bool hasNormals = !field.normals.empty();
+            auto const& positions = field.positions;
+            auto const& normals = field.normals;
+
+            // Walk the boundary of the grid one side at a time, keeping each
+            // side's inward neighbours to tell which way it faces.
+            std::vector<SkirtSide> sides;
+            std::vector<Vector> sideNormals;
+            if (skirt)
+            {
+                std::vector<std::size_t> edges[4], inner[4];
+                for (std::size_t c = 0; c < cols; ++c)
+                {
+                    edges[0].push_back(c);
+                    inner[0].push_back(cols + c);
+                    edges[2].push_back((rows - 1) * cols + (cols - 1 - c));
+                    inner[2].push_back((rows - 2) * cols + (cols - 1 - c));
+                }
+                for (std::size_t r = 0; r < rows; ++r)
+                {
+                    edges[1].push_back(r * cols + cols - 1);
+                    inner[1].push_back(r * cols + cols - 2);
+                    edges[3].push_back((rows - 1 - r) * cols);
+                    inner[3].push_back((rows - 1 - r) * cols + 1);
+                }
+
+                for (int s = 0; s < 4; ++s)
+                {
+                    std::size_t mid = edges[s].size() / 2;
+                    Vector outward = positions[edges[s][mid]] - positions[inner[s][mid]];
+                    outward.y = 0.0f;
+                    outward = glm::length(outward) > 0.0f ? glm::normalize(outward) : outward;
+
+                    Vector along = positions[edges[s][1]] - positions[edges[s][0]];
+                    Vector facing = glm::cross(along, Vector(0.0f, -1.0f, 0.0f));
+
+                    sides.push_back({ edges[s], glm::dot(facing, outward) < 0.0f });
+                    sideNormals.push_back(outward);
+                }
+            }
+
+            // Each skirt side has a top and a bottom copy of its vertices.
+            std::size_t gridVertices = rows * cols;
+            std::size_t gridFaces = (rows - 1) * (cols - 1);
+            std::size_t skirtVertices = 0, skirtFaces = 0;
+            std::vector<std::size_t> sideStart;
+            for (auto const& side : sides)
+            {
+                sideStart.push_back(gridVertices + skirtVertices);
+                skirtVertices += 2 * side.cells.size();
+                skirtFaces += side.cells.size() - 1;
+            }
+
+            std::FILE* file = std::fopen(filename.c_str(), "wb");
+            if (!file)
+            {
+                ERROR_LOG("Could not open " + filename + " for writing.");
+                return false;
+            }
+
+            bool ply = (format == HeightfieldFormat::PLY);
+            if (ply)
+            {
+                std::fprintf(file,
+                    "ply\nformat binary_little_endian 1.0\n"
+                    "element vertex %lu\n"
+                    "property float x\nproperty float y\nproperty float z\n",
+                    (unsigned long)(gridVertices + skirtVertices));
+                if (hasNormals)
+                {
+                    std::fprintf(file, "property float nx\nproperty float ny\nproperty float nz\n");
+                }
+                std::fprintf(file,
+                    "element face %lu\n"
+                    "property list uchar int vertex_indices\nend_header\n",
+                    (unsigned long)(gridFaces + skirtFaces));
+            }
+            else
+            {
+                std::fprintf(file, "# vertices: %lu\n# faces: %lu\n",
+                    (unsigned long)(gridVertices + skirtVertices),
+                    (unsigned long)(gridFaces + skirtFaces));
+            }
+
+            auto encodeVertex = [ply, hasNormals](char* out, Point const& p,
+                Vector const& n)
+            {
+                if (ply)
+                {
+                    out = writeBinary(out, &p[0], 3 * sizeof(float));
+                    if (hasNormals)
+                    {
+                        out = writeBinary(out, &n[0], 3 * sizeof(float));
+                    }
+                    return out;
+                }
+
+                *out++ = 'v';
+                for (int i = 0; i < 3; ++i)
+                {
+                    *out++ = ' ';
+                    out = writeFloat(out, p[i]);
+                }
+                *out++ = '\n';
+
+                if (hasNormals)
+                {
+                    *out++ = 'v';
+                    *out++ = 'n';
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        *out++ = ' ';
+                        out = writeFloat(out, n[i]);
+                    }
+                    *out++ = '\n';
+                }
+                return out;
+            };
+
+            auto encodeFace = [ply, hasNormals](char* out, std::uint32_t a,
+                std::uint32_t b, std::uint32_t c, std::uint32_t d)
+            {
+                std::uint32_t quad[4] = { a, b, c, d };
+                if (ply)
+                {
+                    *out++ = 4;
+                    return writeBinary(out, quad, sizeof(quad));
+                }
+
+                // OBJ indices start at one.
+                *out++ = 'f';
+                for (auto index : quad)
+                {
+                    *out++ = ' ';
+                    out = writeUnsigned(out, index + 1);
+                    if (hasNormals)
+                    {
+                        *out++ = '/';
+                        *out++ = '/';
+                        out = writeUnsigned(out, index + 1);
+                    }
+                }
+                *out++ = '\n';
+                return out;
+            };
+
+            Vector up(0.0f, 1.0f, 0.0f);
+            bool ok = writeBlocks(file, gridVertices, kMaxVertexBytes,
+                [&](char* out, std::size_t begin, std::size_t end)
+            {
+                for (std::size_t i = begin; i < end; ++i)
+                {
+                    out = encodeVertex(out, positions[i], hasNormals ? normals[i] : up);
+                }
+                return out;
+            });
+
+            for (std::size_t s = 0; ok && s < sides.size(); ++s)
+            {
+                auto const& cells = sides[s].cells;
+                ok = writeBlocks(file, cells.size(), 2 * kMaxVertexBytes,
+                    [&](char* out, std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t i = begin; i < end; ++i)
+                    {
+                        Point top = positions[cells[i]];
+                        Point bottom(top.x, skirtBase, top.z);
+                        out = encodeVertex(out, top, sideNormals[s]);
+                        out = encodeVertex(out, bottom, sideNormals[s]);
+                    }
+                    return out;
+                });
+            }
+
+            ok = ok && writeBlocks(file, gridFaces, kMaxFaceBytes,
+                [&](char* out, std::size_t begin, std::size_t end)
+            {
+                for (std::size_t q = begin; q < end; ++q)
+                {
+                    std::uint32_t r = (std::uint32_t)(q / (cols - 1));
+                    std::uint32_t c = (std::uint32_t)(q % (cols - 1));
+                    std::uint32_t i = r * (std::uint32_t)cols + c;
+                    out = encodeFace(out, i, i + (std::uint32_t)cols,
+                        i + (std::uint32_t)cols + 1, i + 1);
+                }
+                return out;
+            });
+
+            for (std::size_t s = 0; ok && s < sides.size(); ++s)
+            {
+                bool reversed = sides[s].reversed;
+                std::uint32_t start = (std::uint32_t)sideStart[s];
+                ok = writeBlocks(file, sides[s].cells.size() - 1, kMaxFaceBytes,
+                    [&](char* out, std::size_t begin, std::size_t end)
+                {
+                    for (std::size_t i = begin; i < end; ++i)
+                    {
+                        std::uint32_t top = start + 2 * (std::uint32_t)i;
+                        std::uint32_t nextTop = top + 2;
+                        out = reversed ?
+                            encodeFace(out, top, top + 1, nextTop + 1, nextTop) :
+                            encodeFace(out, top, nextTop, nextTop + 1, top + 1);
+                    }
+                    return out;
+                });
+            }
+
+            ok = std::fclose(file) == 0 && ok;
+            if (!ok)
+            {
+                ERROR_LOG("Could not write " + filename + ".");
+            }
+            return ok;
+        }
+
+        bool HeightfieldExporter::exportAsync(std::string const& filename,
+            Heightfield&& field, HeightfieldFormat format, bool skirt,
+            float skirtBase)
+        {
+            if (mImpl->busy)
+            {
+                return false;
+            }
+
+            wait();
+            mImpl->busy = true;
+
+            auto impl = mImpl.get();
+            mImpl->worker = std::thread(
+                [impl, filename, format, skirt, skirtBase,
+                field = std::move(field)]()
+            {
+                if (write(filename, field, format, skirt, skirtBase))
+                {
+                    INFO_LOG_V("Exported %lu vertices to %s.",
+                        (unsigned long)field.positions.size(), filename.c_str());
+                }
+                impl->busy = false;
+            });
+
+            return true;
+        }
+
+        bool HeightfieldExporter::isBusy() const
+        {
+            return mImpl->busy;
+        }
+
+        void HeightfieldExporter::wait()
+        {
+            if (mImpl->worker.joinable())
+            {
+                mImpl->worker.join();
+            }
+        }
+    }
+}
@@ -6,6 +6,10 @@ layout(location = 1) in vec3 Normal;
 layout(location = 2) in vec3 Color;
 layout(location = 3) in vec2 TextureCoords;
 
+// Offset (xyz) and scale (w) of an instance. Geometry drawn without
+// instancing leaves this disabled and gets the default (0, 0, 0, 1).
+layout(location = 4) in vec4 InstanceOffsetScale;
+
 uniform mat4 ModelViewProjection;
 uniform mat4 Model;
 
@@ -16,10 +20,11 @@ out vec2 FragmentTextureCoords;
 
 void main()
 {
-	gl_Position = ModelViewProjection * vec4(Position, 1.0);
+	vec3 position = InstanceOffsetScale.xyz + Position * InstanceOffsetScale.w;
+	gl_Position = ModelViewProjection * vec4(position, 1.0);
 	
 	FragmentColor = vec4(Color, 1.0);
-	FragmentWorldPosition = Model * vec4(Position, 1.0);
+	FragmentWorldPosition = Model * vec4(position, 1.0);
 	FragmentNormal = Normal;
 	FragmentTextureCoords = TextureCoords;
 }
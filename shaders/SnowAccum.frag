@@ -1,7 +1,7 @@
 #version 330 core
 
 in vec4 FragmentColor;
-in vec4 SnowMapCoord;
+in vec2 ExposureCoord;
 in vec3 FragmentNormal;
 in vec4 FragmentWorldPosition;
 in vec2 FragmentTextureCoords;
@@ -9,8 +9,8 @@ in vec2 FragmentTextureCoords;
 uniform vec3 CameraPosition;
 uniform vec3 LightPosition;
 
-uniform bool UseSnowMap;
-uniform sampler2DShadow SnowMap;
+uniform bool UseSkyExposure;
+uniform sampler2D SkyExposure;
 
 uniform bool UseNormalMap;
 uniform sampler2D NormalMap;
@@ -42,20 +42,15 @@ void main()
 	//return;
 
 
-	float snow = 1.0f;
-	if(UseSnowMap)
+	// Sheltered ground only shows the share of snow that can reach it.
+	float exposure = 1.0f;
+	if(UseSkyExposure)
 	{
-		snow = textureProj(SnowMap, SnowMapCoord);
+		exposure = texture(SkyExposure, ExposureCoord).r;
 	}
 
 	vec3 color = FragmentColor.rgb;
-	float alpha = min(1.0, FragmentColor.a);
-	if(snow < 0.1)
-	{
-		//color = (FragmentColor + 1.2*vec4(1.0, 1.0, 1.0, 1.0)) / 2.2;
-		color = vec3(1.0, 1.0, 1.0);
-		alpha = 1.0;
-	}
+	float alpha = min(1.0, FragmentColor.a) * exposure;
 
 
 	if(FragmentNormal != vec3(0.0, 0.0, 0.0))
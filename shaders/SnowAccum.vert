@@ -6,10 +6,11 @@ layout(location = 1) in vec3 Normal;
 layout(location = 3) in vec2 TextureCoords;
 
 uniform mat4 ModelViewProjection;
-uniform mat4 SkyMatrix;
+uniform float ExposureExtent;
+uniform vec2 ExposureCentre;
 
 out vec4 FragmentColor;
-out vec4 SnowMapCoord;
+out vec2 ExposureCoord;
 out vec3 FragmentNormal;
 out vec4 FragmentWorldPosition;
 out vec2 FragmentTextureCoords;
@@ -21,7 +22,7 @@ void main()
 	gl_Position = ModelViewProjection * vec4(PositionAlpha.xyz, 1.0);
 	
 	FragmentColor = vec4(1.0, 1.0, 1.0, PositionAlpha.a);
-	SnowMapCoord = SkyMatrix * vec4(PositionAlpha.xyz, 1.0);
+	ExposureCoord = (PositionAlpha.xz - ExposureCentre) / (2.0 * ExposureExtent) + 0.5;
 
 	FragmentNormal = Normal;
 	FragmentWorldPosition = vec4(PositionAlpha.xyz, 1.0);
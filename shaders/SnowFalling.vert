@@ -2,13 +2,21 @@
 #extension GL_ARB_explicit_attrib_location : require
 
 layout(location = 0) in vec3 Position;
-layout(location = 1) in vec3 Normal;
-layout(location = 2) in vec3 Color;
-layout(location = 3) in vec2 TextureCoords;
+layout(location = 4) in vec4 InstancePosition;
+layout(location = 5) in vec4 InstanceRotation;
 
 uniform mat4 ModelViewProjection;
 uniform mat4 Model;
 uniform mat4 SkyMatrix;
+uniform vec4 InstanceScale;
+uniform vec3 InstanceOrigin;
+
+// How the flakes are drawn: 0 rotated hexagons, 1 quads facing the camera
+// along its right and up, 2 points scaled by the projection.
+uniform int LodBand;
+uniform vec3 CameraRight;
+uniform vec3 CameraUp;
+uniform float PointScale;
 
 out vec4 FragmentColor;
 out vec4 FragmentWorldPosition;
@@ -16,14 +24,33 @@ out vec3 FragmentNormal;
 out vec2 FragmentTextureCoords;
 out vec4 SnowMapCoord;
 
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
 void main()
 {
-	gl_Position = ModelViewProjection * vec4(Position, 1.0);
+	// Place the unit hexagon, quad or point at the flake.
+	vec4 instance = InstancePosition * InstanceScale;
+	vec3 offset;
+	if(LodBand == 1)
+	{
+		offset = (CameraRight * Position.x + CameraUp * Position.y) * instance.w;
+	}
+	else
+	{
+		offset = rotate(normalize(InstanceRotation), Position * instance.w);
+	}
+	vec3 position = InstanceOrigin + instance.xyz + offset;
+
+	gl_Position = ModelViewProjection * vec4(position, 1.0);
+	gl_PointSize = max(2.0 * instance.w * PointScale / gl_Position.w, 1.0);
 	
-	FragmentColor = vec4(Color, 1.0);
-	FragmentWorldPosition = Model * vec4(Position, 1.0);
-	FragmentNormal = Normal;
-	FragmentTextureCoords = TextureCoords;
-	SnowMapCoord = SkyMatrix * vec4(Position, 1.0);
+	FragmentColor = vec4(1.0);
+	FragmentWorldPosition = Model * vec4(position, 1.0);
+	FragmentNormal = vec3(0.0);
+	FragmentTextureCoords = vec2(0.0);
+	SnowMapCoord = SkyMatrix * vec4(position, 1.0);
 
 }
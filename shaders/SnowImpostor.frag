@@ -0,0 +1,53 @@
+#version 330 core
+
+in vec3 WorldPosition;
+in float Angle;
+
+uniform vec2 Forward;
+uniform float Radius;
+uniform vec3 Drift;
+uniform float Time;
+uniform float DriftPeriod;
+uniform float TileSize;
+uniform float TileWidth;
+uniform vec2 BoxMin;
+uniform vec2 BoxMax;
+uniform float Level;
+uniform float Fade;
+
+uniform sampler2DArray Flakes;
+
+out vec4 FragColor;
+
+float sampleFlakes(vec2 coords)
+{
+	float level = floor(Level);
+	float lower = texture(Flakes, vec3(coords, level)).r;
+	float upper = texture(Flakes, vec3(coords, min(level + 1.0, float(textureSize(Flakes, 0).z - 1)))).r;
+	return mix(lower, upper, Level - level);
+}
+
+void main()
+{
+	// No snow falls outside the spawn box.
+	if(any(lessThan(WorldPosition.xz, BoxMin)) || any(greaterThan(WorldPosition.xz, BoxMax)))
+	{
+		discard;
+	}
+
+	// The flakes fall with the drift, and slide around the cylinder with
+	// the part of it along the surface. That part changes around the
+	// cylinder, so the slide is restarted every period from two phases half
+	// a period apart and blended to hide the restart.
+	float around = (Angle - atan(-Forward.y, -Forward.x)) * Radius;
+	float along = dot(Drift.xz, vec2(-sin(Angle), cos(Angle)));
+	vec2 coords = vec2(around / TileWidth, (WorldPosition.y - Drift.y * Time) / TileSize);
+
+	float phase0 = fract(Time / DriftPeriod);
+	float phase1 = fract(Time / DriftPeriod + 0.5);
+	float flakes0 = sampleFlakes(coords - vec2(along * phase0 * DriftPeriod / TileWidth, 0.0));
+	float flakes1 = sampleFlakes(coords - vec2(along * phase1 * DriftPeriod / TileWidth, 0.0) + vec2(0.5));
+	float flakes = mix(flakes0, flakes1, abs(1.0 - 2.0 * phase0));
+
+	FragColor = vec4(1.0, 1.0, 1.0, clamp(flakes * Fade, 0.0, 1.0));
+}
@@ -0,0 +1,28 @@
+#version 330 core
+#extension GL_ARB_explicit_attrib_location : require
+
+// Fraction of the way around the cylinder, and 0 at the bottom or 1 at the
+// top.
+layout(location = 0) in vec2 CylinderPosition;
+
+uniform mat4 ModelViewProjection;
+
+uniform vec3 Eye;
+uniform vec2 Forward;
+uniform float Radius;
+uniform float Bottom;
+uniform float Top;
+
+out vec3 WorldPosition;
+out float Angle;
+
+const float TwoPi = 6.28318531;
+
+void main()
+{
+	// Start and end behind the camera, so the seam is out of view.
+	Angle = atan(-Forward.y, -Forward.x) + CylinderPosition.x * TwoPi;
+	WorldPosition = vec3(Eye.x + Radius * cos(Angle), mix(Bottom, Top, CylinderPosition.y),
+		Eye.z + Radius * sin(Angle));
+	gl_Position = ModelViewProjection * vec4(WorldPosition, 1.0);
+}
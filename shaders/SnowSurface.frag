@@ -1,13 +0,0 @@
-#version 330 core
-
-in vec4 FragmentWorldPosition;
-
-void main()
-{
-    
-    if(FragmentWorldPosition.y > 0.105)
-    {
-        discard;
-    }
-    
-}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#version 330 core
+#extension GL_ARB_explicit_attrib_location : require
+
+// Sample coordinates in the tile, 0 to 64 along each side.
+layout(location = 0) in vec2 GridPosition;
+
+uniform mat4 ModelViewProjection;
+uniform mat4 Model;
+
+uniform sampler2D HeightMap;
+uniform float HeightScale;
+uniform float BaseHeight;
+uniform vec2 TileOrigin;
+uniform float TileSpacing;
+
+// Samples stepped over along the -x, +x, -z and +z edges to meet a coarser
+// neighbour, 1 where the neighbour is as fine or finer.
+uniform vec4 EdgeSteps;
+
+out vec4 FragmentColor;
+out vec4 FragmentWorldPosition;
+out vec3 FragmentNormal;
+out vec2 FragmentTextureCoords;
+
+const int LastSample = 64;
+
+float fetchHeight(ivec2 p)
+{
+	p = clamp(p, ivec2(0), ivec2(LastSample));
+	return texelFetch(HeightMap, p, 0).r * HeightScale + BaseHeight;
+}
+
+// Edge vertices are moved onto the line between the samples the coarser
+// neighbour has, so both tiles draw the same edge.
+float stitchedHeight(ivec2 p)
+{
+	int step = 1;
+	int along = 0;
+	if(p.x == 0) { step = int(EdgeSteps.x); along = 1; }
+	else if(p.x == LastSample) { step = int(EdgeSteps.y); along = 1; }
+	else if(p.y == 0) { step = int(EdgeSteps.z); }
+	else if(p.y == LastSample) { step = int(EdgeSteps.w); }
+
+	if(step <= 1)
+	{
+		return fetchHeight(p);
+	}
+
+	int t = p[along];
+	ivec2 a = p;
+	ivec2 b = p;
+	a[along] = (t / step) * step;
+	b[along] = min(a[along] + step, LastSample);
+	return mix(fetchHeight(a), fetchHeight(b), float(t - a[along]) / float(step));
+}
+
+void main()
+{
+	ivec2 p = ivec2(GridPosition);
+	vec3 position = vec3(TileOrigin.x + GridPosition.x * TileSpacing, stitchedHeight(p),
+		TileOrigin.y + GridPosition.y * TileSpacing);
+	gl_Position = ModelViewProjection * vec4(position, 1.0);
+
+	float dx = fetchHeight(p + ivec2(1, 0)) - fetchHeight(p - ivec2(1, 0));
+	float dz = fetchHeight(p + ivec2(0, 1)) - fetchHeight(p - ivec2(0, 1));
+	vec3 normal = normalize(vec3(-dx, 2.0 * TileSpacing, -dz));
+
+	// Grass on the flat, rock on the steep.
+	FragmentColor = vec4(mix(vec3(0.45, 0.42, 0.38), vec3(0.0, 0.7, 0.0), smoothstep(0.7, 0.9, normal.y)), 1.0);
+	FragmentWorldPosition = Model * vec4(position, 1.0);
+	FragmentNormal = normal;
+	FragmentTextureCoords = GridPosition / float(LastSample);
+}
@@ -0,0 +1,375 @@
+#include "DepositionLog.hpp"
+
+#include <atlas/core/Parallel.hpp>
+#include <algorithm>
+#include <cmath>
+
+// Deposits are stored in steps of 1/4096 of the largest single deposit.
+static const float kAmountStep = 0.005f / 4096.0f;
+
+static void writeVarint(std::vector<std::uint8_t> &data, std::uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        data.push_back((std::uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    data.push_back((std::uint8_t)value);
+}
+
+static std::uint32_t readVarint(const std::uint8_t *&data)
+{
+    std::uint32_t value = 0;
+    int shift = 0;
+    while (*data & 0x80)
+    {
+        value |= (std::uint32_t)(*data++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= (std::uint32_t)(*data++) << shift;
+    return value;
+}
+
+DepositionLog::DepositionLog(int gridSize, int tileSize, std::size_t keyframeBytes) :
+    m_GridSize(gridSize),
+    m_TileSize(tileSize),
+    m_TilesPerSide((gridSize + tileSize - 1) / tileSize),
+    m_KeyframeBytes(keyframeBytes),
+    m_BytesSinceKeyframe(0),
+    m_LatestTime(0.0f),
+    m_Origin(0)
+{
+}
+
+void DepositionLog::reset(float time, std::vector<glm::vec4> const &grid)
+{
+    m_Pending.clear();
+    m_Data.clear();
+    m_Batches.clear();
+    m_Keyframes.clear();
+    m_Scrolls.clear();
+    m_Origin = glm::ivec2(0);
+    m_LatestTime = time;
+    addKeyframe(time, grid);
+}
+
+float DepositionLog::record(std::uint32_t cell, float amount)
+{
+    std::uint32_t steps = (std::uint32_t)std::round(amount / kAmountStep);
+    if (steps == 0)
+    {
+        return 0.0f;
+    }
+
+    m_Pending.push_back({ cell, steps << 1 });
+    return steps * kAmountStep;
+}
+
+float DepositionLog::recordShift(std::uint32_t cell, float height)
+{
+    std::int32_t steps = (std::int32_t)std::round(height / kAmountStep);
+    if (steps == 0)
+    {
+        return 0.0f;
+    }
+
+    std::uint32_t zigzag = ((std::uint32_t)steps << 1) ^ (std::uint32_t)(steps >> 31);
+    m_Pending.push_back({ cell, (zigzag << 1) | 1 });
+    return steps * kAmountStep;
+}
+
+void DepositionLog::commit(float time, std::vector<glm::vec4> const &grid)
+{
+    m_LatestTime = time;
+    if (!m_Pending.empty())
+    {
+        // Sort by cell so the cells can be stored as small deltas. The sort
+        // is stable to keep the order of deposits on the same cell.
+        std::stable_sort(m_Pending.begin(), m_Pending.end(),
+            [](Event const &a, Event const &b) { return a.cell < b.cell; });
+
+        std::size_t offset = m_Data.size();
+        m_Batches.push_back({ time, offset });
+        writeVarint(m_Data, (std::uint32_t)m_Pending.size());
+
+        std::uint32_t prevCell = 0;
+        for (auto const &event : m_Pending)
+        {
+            writeVarint(m_Data, event.cell - prevCell);
+            writeVarint(m_Data, event.amount);
+            prevCell = event.cell;
+        }
+        m_Pending.clear();
+        m_BytesSinceKeyframe += m_Data.size() - offset;
+    }
+
+    if (m_Keyframes.empty() || m_BytesSinceKeyframe >= m_KeyframeBytes)
+    {
+        addKeyframe(time, grid);
+    }
+}
+
+void DepositionLog::scroll(float time, glm::ivec2 const &shift, std::vector<glm::vec4> const &grid)
+{
+    m_Origin += shift;
+
+    // Events not yet committed move with their cells, or go with them.
+    std::size_t kept = 0;
+    for (auto const &event : m_Pending)
+    {
+        int row = (int)(event.cell / m_GridSize) - shift.y;
+        int col = (int)(event.cell % m_GridSize) - shift.x;
+        if (row >= 0 && row < m_GridSize && col >= 0 && col < m_GridSize)
+        {
+            m_Pending[kept++] = { (std::uint32_t)(row * m_GridSize + col), event.amount };
+        }
+    }
+    m_Pending.resize(kept);
+
+    Scroll scroll;
+    scroll.time = time;
+    scroll.batch = m_Batches.size();
+    scroll.origin = m_Origin;
+    for (int row = 0; row < m_GridSize; ++row)
+    {
+        for (int col = 0; col < m_GridSize; ++col)
+        {
+            int fromRow = row + shift.y, fromCol = col + shift.x;
+            if (fromRow < 0 || fromRow >= m_GridSize || fromCol < 0 || fromCol >= m_GridSize)
+            {
+                int cell = row * m_GridSize + col;
+                scroll.cells.push_back((std::uint32_t)cell);
+                scroll.values.push_back(glm::vec2(grid[cell].y, grid[cell].w));
+            }
+        }
+    }
+
+    m_BytesSinceKeyframe += scroll.cells.size() * (sizeof(std::uint32_t) + sizeof(glm::vec2));
+    m_Scrolls.push_back(std::move(scroll));
+}
+
+void DepositionLog::addKeyframe(float time, std::vector<glm::vec4> const &grid)
+{
+    Keyframe keyframe;
+    keyframe.time = time;
+    keyframe.batch = m_Batches.size();
+    keyframe.scroll = m_Scrolls.size();
+    keyframe.origin = m_Origin;
+    keyframe.cells.resize(m_GridSize * m_GridSize);
+    for (std::size_t i = 0; i < keyframe.cells.size(); ++i)
+    {
+        keyframe.cells[i] = glm::vec2(grid[i].y, grid[i].w);
+    }
+
+    m_Keyframes.push_back(std::move(keyframe));
+    m_BytesSinceKeyframe = 0;
+}
+
+float DepositionLog::getStartTime() const
+{
+    return m_Keyframes.empty() ? 0.0f : m_Keyframes.front().time;
+}
+
+float DepositionLog::getLatestTime() const
+{
+    return m_LatestTime;
+}
+
+std::size_t DepositionLog::getSizeInBytes() const
+{
+    std::size_t size = m_Data.size() + m_Batches.size() * sizeof(Batch);
+    for (auto const &keyframe : m_Keyframes)
+    {
+        size += keyframe.cells.size() * sizeof(glm::vec2);
+    }
+    for (auto const &scroll : m_Scrolls)
+    {
+        size += scroll.cells.size() * (sizeof(std::uint32_t) + sizeof(glm::vec2));
+    }
+    return size;
+}
+
+int DepositionLog::getTileCount() const
+{
+    return m_TilesPerSide * m_TilesPerSide;
+}
+
+void DepositionLog::getTileBounds(int tile, int &firstRow, int &firstCol, int &endRow, int &endCol) const
+{
+    firstRow = (tile / m_TilesPerSide) * m_TileSize;
+    firstCol = (tile % m_TilesPerSide) * m_TileSize;
+    endRow = std::min(m_GridSize, firstRow + m_TileSize);
+    endCol = std::min(m_GridSize, firstCol + m_TileSize);
+}
+
+void DepositionLog::reconstruct(float time, std::vector<int> const &tiles, std::vector<glm::vec4> &grid) const
+{
+    if (m_Keyframes.empty())
+    {
+        return;
+    }
+
+    // Start from the last keyframe taken at or before the requested time.
+    auto keyframe = std::upper_bound(m_Keyframes.begin(), m_Keyframes.end(), time,
+        [](float t, Keyframe const &k) { return t < k.time; });
+    if (keyframe != m_Keyframes.begin())
+    {
+        --keyframe;
+    }
+
+    // Replay every batch up to and including the requested time.
+    auto endBatch = std::upper_bound(m_Batches.begin() + keyframe->batch, m_Batches.end(), time,
+        [](float t, Batch const &b) { return t < b.time; });
+    std::size_t begin = keyframe->batch < m_Batches.size() ? m_Batches[keyframe->batch].offset : m_Data.size();
+    std::size_t end = endBatch != m_Batches.end() ? endBatch->offset : m_Data.size();
+    std::size_t firstBatch = keyframe->batch;
+    std::size_t lastBatch = endBatch - m_Batches.begin();
+
+    // The scrolls after the keyframe; those up to the requested time are
+    // replayed before the batch they precede.
+    auto firstScroll = m_Scrolls.begin() + keyframe->scroll;
+
+    // Every cell only depends on its own deposits, so tiles are independent.
+    atlas::core::parallelFor(0, tiles.size(), [&](std::size_t t)
+    {
+        int firstRow, firstCol, endRow, endCol;
+        getTileBounds(tiles[t], firstRow, firstCol, endRow, endCol);
+        int tileCols = endCol - firstCol;
+
+        // Whether a cell of the tile was off the grid at the replayed time.
+        std::vector<char> absent((endRow - firstRow) * tileCols, 0);
+
+        // Maps a cell of the grid placed at the given origin to the grid as
+        // it is now, or returns -1 if it is outside the tile.
+        auto toTile = [&](std::uint32_t cell, glm::ivec2 const &origin)
+        {
+            int row = (int)(cell / m_GridSize) + origin.y - m_Origin.y;
+            int col = (int)(cell % m_GridSize) + origin.x - m_Origin.x;
+            if (row < firstRow || row >= endRow || col < firstCol || col >= endCol)
+            {
+                return -1;
+            }
+            return row * m_GridSize + col;
+        };
+
+        // Marks the cells of the tile that lie off the grid placed at the
+        // origin.
+        auto markAbsent = [&](glm::ivec2 const &origin)
+        {
+            for (int row = firstRow; row < endRow; ++row)
+            {
+                for (int col = firstCol; col < endCol; ++col)
+                {
+                    int r = row + m_Origin.y - origin.y, c = col + m_Origin.x - origin.x;
+                    if (r < 0 || r >= m_GridSize || c < 0 || c >= m_GridSize)
+                    {
+                        absent[(row - firstRow) * tileCols + col - firstCol] = 1;
+                    }
+                }
+            }
+        };
+
+        // Sets the cells a scroll brought in, or only those still waiting
+        // for their first values.
+        auto enter = [&](Scroll const &scroll, bool onlyAbsent)
+        {
+            for (std::size_t e = 0; e < scroll.cells.size(); ++e)
+            {
+                int cell = toTile(scroll.cells[e], scroll.origin);
+                if (cell < 0)
+                {
+                    continue;
+                }
+
+                char &flag = absent[(cell / m_GridSize - firstRow) * tileCols + cell % m_GridSize - firstCol];
+                if (!onlyAbsent || flag)
+                {
+                    grid[cell].y = scroll.values[e].x;
+                    grid[cell].w = scroll.values[e].y;
+                    flag = 0;
+                }
+            }
+        };
+
+        markAbsent(keyframe->origin);
+        for (int row = firstRow; row < endRow; ++row)
+        {
+            for (int col = firstCol; col < endCol; ++col)
+            {
+                if (absent[(row - firstRow) * tileCols + col - firstCol])
+                {
+                    continue;
+                }
+
+                int cell = row * m_GridSize + col;
+                int from = (row + m_Origin.y - keyframe->origin.y) * m_GridSize + col + m_Origin.x - keyframe->origin.x;
+                grid[cell].y = keyframe->cells[from].x;
+                grid[cell].w = keyframe->cells[from].y;
+            }
+        }
+
+        glm::ivec2 origin = keyframe->origin;
+        auto scroll = firstScroll;
+        const std::uint8_t *data = m_Data.data() + begin;
+        for (std::size_t b = firstBatch; b <= lastBatch; ++b)
+        {
+            for (; scroll != m_Scrolls.end() && scroll->batch == b && scroll->time <= time; ++scroll)
+            {
+                origin = scroll->origin;
+                markAbsent(origin);
+                enter(*scroll, false);
+            }
+            if (b == lastBatch || data >= m_Data.data() + end)
+            {
+                break;
+            }
+
+            std::uint32_t count = readVarint(data);
+            std::uint32_t cell = 0;
+            for (std::uint32_t e = 0; e < count; ++e)
+            {
+                cell += readVarint(data);
+                std::uint32_t amount = readVarint(data);
+
+                int target = toTile(cell, origin);
+                if (target < 0)
+                {
+                    continue;
+                }
+
+                if (amount & 1)
+                {
+                    std::uint32_t zigzag = amount >> 1;
+                    std::int32_t steps = (std::int32_t)(zigzag >> 1) ^ -(std::int32_t)(zigzag & 1);
+                    shift(grid[target], steps * kAmountStep);
+                }
+                else
+                {
+                    deposit(grid[target], (amount >> 1) * kAmountStep);
+                }
+            }
+        }
+
+        // Cells that came onto the grid later show as they came in.
+        for (; scroll != m_Scrolls.end() && std::find(absent.begin(), absent.end(), 1) != absent.end(); ++scroll)
+        {
+            enter(*scroll, true);
+        }
+    });
+}
+
+void DepositionLog::deposit(glm::vec4 &cell, float amount)
+{
+    cell.w += amount;
+
+    // Once the cell is fully covered the snow starts to pile up.
+    if (cell.w >= 1.0f)
+    {
+        cell.y += 0.3f * amount;
+    }
+}
+
+void DepositionLog::shift(glm::vec4 &cell, float height)
+{
+    cell.y += height;
+}
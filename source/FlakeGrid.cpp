@@ -0,0 +1,133 @@
+#include "FlakeGrid.hpp"
+#include <atlas/core/Parallel.hpp>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// Most cells the grid holds before the cells are made larger.
+static const std::size_t kMaxCells = std::size_t(1) << 22;
+
+// Cells summed by one task of the prefix sum.
+static const std::size_t kScanBlock = 4096;
+
+FlakeGrid::FlakeGrid(float cellSize) :
+    m_MinCellSize(cellSize),
+    m_CellSize(cellSize),
+    m_InvCellSize(1.0f / cellSize),
+    m_Origin(0.0f),
+    m_Resolution(1)
+{
+}
+
+float FlakeGrid::getCellSize() const
+{
+    return m_CellSize;
+}
+
+glm::ivec3 FlakeGrid::findCell(glm::vec3 const &position) const
+{
+    return glm::clamp(glm::ivec3(glm::floor((position - m_Origin) * m_InvCellSize)), glm::ivec3(0),
+        m_Resolution - 1);
+}
+
+void FlakeGrid::build(glm::vec3 const *positions, std::size_t count)
+{
+    m_Cells.resize(count);
+    m_Indices.resize(count);
+    m_Points.resize(count);
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Bounds of the flakes, a chunk per thread.
+    std::size_t chunks = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t chunkSize = (count + chunks - 1) / chunks;
+    std::vector<glm::vec3> los(chunks, positions[0]), his(chunks, positions[0]);
+    atlas::core::parallelFor(0, chunks, [&](std::size_t c)
+    {
+        for (std::size_t i = c * chunkSize; i < std::min(count, (c + 1) * chunkSize); ++i)
+        {
+            los[c] = glm::min(los[c], positions[i]);
+            his[c] = glm::max(his[c], positions[i]);
+        }
+    });
+
+    glm::vec3 lo = los[0], hi = his[0];
+    for (std::size_t c = 1; c < chunks; ++c)
+    {
+        lo = glm::min(lo, los[c]);
+        hi = glm::max(hi, his[c]);
+    }
+
+    m_Origin = lo;
+    m_CellSize = m_MinCellSize;
+    glm::vec3 extent = hi - lo;
+    float volume = (extent.x + m_CellSize) * (extent.y + m_CellSize) * (extent.z + m_CellSize);
+    if (volume / (m_CellSize * m_CellSize * m_CellSize) > kMaxCells)
+    {
+        m_CellSize = std::cbrt(volume / kMaxCells) * 1.01f;
+    }
+    m_InvCellSize = 1.0f / m_CellSize;
+    m_Resolution = glm::ivec3(glm::floor(extent * m_InvCellSize)) + 1;
+
+    std::size_t cells = (std::size_t)m_Resolution.x * m_Resolution.y * m_Resolution.z;
+    if (cells > m_Counts.size())
+    {
+        m_Counts = std::vector<std::atomic<std::uint32_t>>(cells);
+    }
+    m_Starts.resize(cells + 1);
+
+    atlas::core::parallelFor(0, cells, [&](std::size_t c)
+    {
+        m_Counts[c].store(0, std::memory_order_relaxed);
+    });
+
+    atlas::core::parallelFor(0, count, [&](std::size_t i)
+    {
+        glm::ivec3 cell = findCell(positions[i]);
+        m_Cells[i] = (std::uint32_t)(cell.x + (std::size_t)m_Resolution.x * (cell.y + (std::size_t)m_Resolution.y * cell.z));
+        m_Counts[m_Cells[i]].fetch_add(1, std::memory_order_relaxed);
+    });
+
+    // Exclusive prefix sum of the counts: every block is summed on its own,
+    // the block totals are summed in turn and then every block is filled in
+    // from its total. The counts are left as the cursors for the scatter.
+    std::size_t blocks = (cells + kScanBlock - 1) / kScanBlock;
+    std::vector<std::uint32_t> totals(blocks + 1, 0);
+    atlas::core::parallelFor(0, blocks, [&](std::size_t block)
+    {
+        std::uint32_t sum = 0;
+        for (std::size_t c = block * kScanBlock; c < std::min(cells, (block + 1) * kScanBlock); ++c)
+        {
+            sum += m_Counts[c].load(std::memory_order_relaxed);
+        }
+        totals[block + 1] = sum;
+    });
+
+    for (std::size_t block = 0; block < blocks; ++block)
+    {
+        totals[block + 1] += totals[block];
+    }
+
+    atlas::core::parallelFor(0, blocks, [&](std::size_t block)
+    {
+        std::uint32_t sum = totals[block];
+        for (std::size_t c = block * kScanBlock; c < std::min(cells, (block + 1) * kScanBlock); ++c)
+        {
+            m_Starts[c] = sum;
+            sum += m_Counts[c].load(std::memory_order_relaxed);
+            m_Counts[c].store(m_Starts[c], std::memory_order_relaxed);
+        }
+    });
+    m_Starts[cells] = (std::uint32_t)count;
+
+    // The order within a cell depends on the threads, so callers must not
+    // rely on it.
+    atlas::core::parallelFor(0, count, [&](std::size_t i)
+    {
+        std::uint32_t k = m_Counts[m_Cells[i]].fetch_add(1, std::memory_order_relaxed);
+        m_Indices[k] = (std::uint32_t)i;
+        m_Points[k] = positions[i];
+    });
+}
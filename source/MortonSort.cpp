@@ -0,0 +1,120 @@
+#include "MortonSort.hpp"
+#include <atlas/core/Parallel.hpp>
+#include <algorithm>
+#include <thread>
+
+// Bits of every axis of the cell, which makes the grid 1024^3.
+static const int kSortBits = 10;
+
+// Fewest points worth giving a thread of their own.
+static const std::size_t kMinSortChunk = 2048;
+
+// Spreads the low ten bits of a value out to every third bit.
+static std::uint32_t spreadBits(std::uint32_t v)
+{
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+MortonSort::MortonSort() :
+    m_Shift(-1)
+{
+}
+
+void MortonSort::start(glm::vec3 const *positions, std::size_t count, glm::vec3 const &centre, float extent)
+{
+    m_Keys.resize(count);
+    m_Order.resize(count);
+    m_ScratchKeys.resize(count);
+    m_ScratchOrder.resize(count);
+
+    float scale = (1 << kSortBits) / (2.0f * extent);
+    atlas::core::parallelFor(0, count, [&](std::size_t i)
+    {
+        glm::vec3 cell = glm::clamp((positions[i] - centre + extent) * scale, 0.0f, (float)((1 << kSortBits) - 1));
+        m_Keys[i] = spreadBits((std::uint32_t)cell.x) | (spreadBits((std::uint32_t)cell.y) << 1) |
+            (spreadBits((std::uint32_t)cell.z) << 2);
+        m_Order[i] = (std::uint32_t)i;
+    });
+    m_Shift = 0;
+}
+
+bool MortonSort::step()
+{
+    if (!isSorting())
+    {
+        return true;
+    }
+
+    // Every thread counts and scatters its own contiguous chunk, and the
+    // counts are summed digit by digit across chunks so the order is kept.
+    std::size_t count = m_Keys.size();
+    std::size_t chunks = std::max<std::size_t>(1, std::min<std::size_t>(std::thread::hardware_concurrency(),
+        count / kMinSortChunk));
+    std::size_t chunkSize = (count + chunks - 1) / chunks;
+    int shift = m_Shift;
+
+    m_Offsets.assign(chunks * 256, 0);
+    atlas::core::parallelFor(0, chunks, [&](std::size_t c)
+    {
+        std::size_t *histogram = &m_Offsets[c * 256];
+        for (std::size_t i = c * chunkSize; i < std::min(count, (c + 1) * chunkSize); ++i)
+        {
+            ++histogram[(m_Keys[i] >> shift) & 0xff];
+        }
+    });
+
+    // Nothing to move if every key has the same digit.
+    std::size_t sum = 0;
+    bool uniform = false;
+    for (int digit = 0; digit < 256; ++digit)
+    {
+        std::size_t start = sum;
+        for (std::size_t c = 0; c < chunks; ++c)
+        {
+            std::size_t n = m_Offsets[c * 256 + digit];
+            m_Offsets[c * 256 + digit] = sum;
+            sum += n;
+        }
+        uniform = uniform || sum - start == count;
+    }
+
+    if (!uniform)
+    {
+        atlas::core::parallelFor(0, chunks, [&](std::size_t c)
+        {
+            std::size_t *next = &m_Offsets[c * 256];
+            for (std::size_t i = c * chunkSize; i < std::min(count, (c + 1) * chunkSize); ++i)
+            {
+                std::size_t to = next[(m_Keys[i] >> shift) & 0xff]++;
+                m_ScratchKeys[to] = m_Keys[i];
+                m_ScratchOrder[to] = m_Order[i];
+            }
+        });
+
+        m_Keys.swap(m_ScratchKeys);
+        m_Order.swap(m_ScratchOrder);
+    }
+
+    m_Shift += 8;
+    return !isSorting();
+}
+
+void MortonSort::reset()
+{
+    m_Shift = -1;
+}
+
+bool MortonSort::isSorting() const
+{
+    return m_Shift >= 0 && m_Shift < 3 * kSortBits;
+}
+
+std::vector<std::uint32_t> const &MortonSort::getOrder() const
+{
+    return m_Order;
+}
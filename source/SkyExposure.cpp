@@ -0,0 +1,291 @@
+#include "SkyExposure.hpp"
+#include <atlas/core/Parallel.hpp>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <random>
+
+// Gravity used by Snow::computeAcceleration, for the direction flakes arrive from.
+static const float kGravity = 9.81f;
+
+// Half angle of the cone the rays of a cell are jittered in.
+static const float kJitterAngle = glm::radians(15.0f);
+
+// Rays start just above the ground and end well above any occluder.
+static const float kRayLift = 0.01f;
+static const float kRayLength = 40.0f;
+
+static const int kMaxRaysPerCell = 64;
+
+SkyExposure::SkyExposure(int resolution, float extent, int raysPerCell) :
+    m_Resolution(resolution),
+    m_RaysPerCell(std::min(raysPerCell, kMaxRaysPerCell)),
+    m_Extent(extent),
+    m_Exposure(resolution * resolution, 1.0f),
+    m_Dirty(resolution * resolution, 1),
+    m_Wind(0.0f),
+    m_Centre(0.0f),
+    m_BakeCentre(0.0f),
+    m_TextureCentre(0.0f),
+    m_Upload(false),
+    m_Done(false)
+{
+    glGenTextures(1, &m_Texture);
+    glBindTexture(GL_TEXTURE_2D, m_Texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, m_Resolution, m_Resolution, 0, GL_RED, GL_FLOAT, m_Exposure.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+SkyExposure::~SkyExposure()
+{
+    if (m_Worker.joinable())
+    {
+        m_Worker.join();
+    }
+    glDeleteTextures(1, &m_Texture);
+}
+
+void SkyExposure::invalidate(atlas::utils::BBox const &region)
+{
+    if (region.pMin.x > region.pMax.x || region.pMin.y > region.pMax.y || region.pMin.z > region.pMax.z)
+    {
+        return;
+    }
+
+    // A ray can drift sideways by at most the slope times the height it
+    // climbs before leaving the region.
+    float cellSize = 2.0f * m_Extent / m_Resolution;
+    float reach = std::max(region.pMax.y, 0.0f) * getMaxSlope(m_Wind) + cellSize;
+
+    for (int z = 0; z < m_Resolution; ++z)
+    {
+        for (int x = 0; x < m_Resolution; ++x)
+        {
+            float cx = m_Centre.x - m_Extent + (x + 0.5f) * cellSize;
+            float cz = m_Centre.y - m_Extent + (z + 0.5f) * cellSize;
+            float dx = std::max(std::max(region.pMin.x - cx, cx - region.pMax.x), 0.0f);
+            float dz = std::max(std::max(region.pMin.z - cz, cz - region.pMax.z), 0.0f);
+            if (dx * dx + dz * dz <= reach * reach)
+            {
+                m_Dirty[z * m_Resolution + x] = 1;
+            }
+        }
+    }
+}
+
+void SkyExposure::invalidateAll()
+{
+    std::fill(m_Dirty.begin(), m_Dirty.end(), 1);
+}
+
+void SkyExposure::update(std::vector<atlas::utils::BVH const *> const &occluders, glm::vec3 const &wind)
+{
+    if (m_Worker.joinable())
+    {
+        if (!m_Done)
+        {
+            return;
+        }
+
+        // The square may have moved while the bake ran.
+        m_Worker.join();
+        glm::ivec2 offset(glm::round((m_BakeCentre - m_Centre) * (m_Resolution / (2.0f * m_Extent))));
+        for (std::size_t i = 0; i < m_BakeCells.size(); ++i)
+        {
+            int x = m_BakeCells[i] % m_Resolution + offset.x;
+            int z = m_BakeCells[i] / m_Resolution + offset.y;
+            if (x >= 0 && x < m_Resolution && z >= 0 && z < m_Resolution)
+            {
+                m_Exposure[z * m_Resolution + x] = m_BakeValues[i];
+            }
+        }
+        m_Upload = true;
+    }
+
+    if (m_Upload)
+    {
+        glBindTexture(GL_TEXTURE_2D, m_Texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Resolution, m_Resolution, GL_RED, GL_FLOAT, m_Exposure.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        m_TextureCentre = m_Centre;
+        m_Upload = false;
+    }
+
+    // The rays follow the wind, so a new wind direction changes every cell.
+    if (glm::any(glm::notEqual(wind, m_Wind)))
+    {
+        m_Wind = wind;
+        invalidateAll();
+    }
+
+    m_BakeCells.clear();
+    for (int i = 0; i < m_Resolution * m_Resolution; ++i)
+    {
+        if (m_Dirty[i])
+        {
+            m_BakeCells.push_back(i);
+            m_Dirty[i] = 0;
+        }
+    }
+
+    if (m_BakeCells.empty())
+    {
+        return;
+    }
+
+    // The worker traces a copy so the scene is free to rebuild its own.
+    std::vector<atlas::utils::BVH> copies;
+    for (atlas::utils::BVH const *occluder : occluders)
+    {
+        if (!occluder->empty())
+        {
+            copies.push_back(*occluder);
+        }
+    }
+
+    m_BakeValues.resize(m_BakeCells.size());
+    m_BakeCentre = m_Centre;
+    m_Done = false;
+    m_Worker = std::thread(&SkyExposure::bake, this, std::move(copies), m_Wind, m_Centre);
+}
+
+bool SkyExposure::isBaking() const
+{
+    return m_Worker.joinable();
+}
+
+void SkyExposure::setCentre(glm::vec2 const &centre)
+{
+    float cellSize = 2.0f * m_Extent / m_Resolution;
+    glm::vec2 snapped = glm::round(centre / cellSize) * cellSize;
+    glm::ivec2 shift(glm::round((snapped - m_Centre) / cellSize));
+    if (shift == glm::ivec2(0))
+    {
+        return;
+    }
+    m_Centre = snapped;
+
+    std::vector<float> exposure(m_Exposure);
+    std::vector<char> dirty(m_Dirty);
+    for (int z = 0; z < m_Resolution; ++z)
+    {
+        for (int x = 0; x < m_Resolution; ++x)
+        {
+            int fromX = x + shift.x, fromZ = z + shift.y;
+            bool inside = fromX >= 0 && fromX < m_Resolution && fromZ >= 0 && fromZ < m_Resolution;
+            fromX = glm::clamp(fromX, 0, m_Resolution - 1);
+            fromZ = glm::clamp(fromZ, 0, m_Resolution - 1);
+
+            int cell = z * m_Resolution + x;
+            m_Exposure[cell] = exposure[fromZ * m_Resolution + fromX];
+            m_Dirty[cell] = inside ? dirty[fromZ * m_Resolution + fromX] : 1;
+        }
+    }
+    m_Upload = true;
+}
+
+glm::vec2 SkyExposure::getCentre() const
+{
+    return m_TextureCentre;
+}
+
+GLuint SkyExposure::getTexture() const
+{
+    return m_Texture;
+}
+
+float SkyExposure::getExtent() const
+{
+    return m_Extent;
+}
+
+float SkyExposure::sample(float x, float z) const
+{
+    // Texel centres sit half a cell in from the edges of the square.
+    float cellSize = 2.0f * m_Extent / m_Resolution;
+    glm::vec2 g = glm::clamp((glm::vec2(x, z) - m_Centre + m_Extent) / cellSize - 0.5f, glm::vec2(0.0f),
+        glm::vec2((float)(m_Resolution - 1)));
+    glm::ivec2 cell = glm::min(glm::ivec2(g), glm::ivec2(m_Resolution - 2));
+    glm::vec2 f = g - glm::vec2(cell);
+
+    std::size_t i = (std::size_t)cell.y * m_Resolution + cell.x;
+    float x0 = glm::mix(m_Exposure[i], m_Exposure[i + 1], f.x);
+    float x1 = glm::mix(m_Exposure[i + m_Resolution], m_Exposure[i + m_Resolution + 1], f.x);
+    return glm::mix(x0, x1, f.y);
+}
+
+void SkyExposure::bake(std::vector<atlas::utils::BVH> occluders, glm::vec3 wind, glm::vec2 centre)
+{
+    glm::vec3 source = getSourceDirection(wind);
+    glm::vec3 tangent = glm::normalize(glm::cross(std::abs(source.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f), source));
+    glm::vec3 bitangent = glm::cross(source, tangent);
+    float cellSize = 2.0f * m_Extent / m_Resolution;
+
+    atlas::core::parallelFor(0, m_BakeCells.size(), [&](std::size_t i)
+    {
+        int cell = m_BakeCells[i];
+        glm::vec3 origin(centre.x - m_Extent + (cell % m_Resolution + 0.5f) * cellSize, kRayLift,
+            centre.y - m_Extent + (cell / m_Resolution + 0.5f) * cellSize);
+
+        // Seeding by cell keeps a partial rebake consistent with its neighbours.
+        std::minstd_rand gen(cell + 1);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+        glm::vec3 from[kMaxRaysPerCell], to[kMaxRaysPerCell];
+        std::uint8_t occluded[kMaxRaysPerCell] = {};
+        for (int r = 0; r < m_RaysPerCell; ++r)
+        {
+            float angle = kJitterAngle * std::sqrt(uniform(gen));
+            float phi = glm::two_pi<float>() * uniform(gen);
+            glm::vec3 dir = std::cos(angle) * source +
+                std::sin(angle) * (std::cos(phi) * tangent + std::sin(phi) * bitangent);
+
+            from[r] = origin;
+            to[r] = origin + kRayLength * dir;
+        }
+
+        for (atlas::utils::BVH const &occluder : occluders)
+        {
+            occluder.occluded(from, to, m_RaysPerCell, occluded);
+        }
+
+        int open = 0;
+        for (int r = 0; r < m_RaysPerCell; ++r)
+        {
+            open += occluded[r] ? 0 : 1;
+        }
+        m_BakeValues[i] = (float)open / m_RaysPerCell;
+    });
+
+    m_Done = true;
+}
+
+glm::vec3 SkyExposure::getSourceDirection(glm::vec3 const &wind)
+{
+    // Flakes fall at their terminal velocity, which points along the sum of
+    // gravity and wind, so the snow reaching a cell comes from the opposite way.
+    glm::vec3 source = -glm::vec3(wind.x, wind.y - kGravity, wind.z);
+    if (glm::length(source) < 1e-4f)
+    {
+        return glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+
+    source = glm::normalize(source);
+    if (source.y < 0.1f)
+    {
+        // Wind strong enough to lift the flakes: still look at the sky.
+        glm::vec2 side(source.x, source.z);
+        side = (glm::length(side) > 0.0f) ? glm::normalize(side) * std::sqrt(1.0f - 0.01f) : side;
+        source = glm::vec3(side.x, 0.1f, side.y);
+    }
+    return source;
+}
+
+float SkyExposure::getMaxSlope(glm::vec3 const &wind)
+{
+    float tilt = std::acos(glm::clamp(getSourceDirection(wind).y, -1.0f, 1.0f)) + kJitterAngle;
+    return std::tan(std::min(tilt, glm::radians(89.0f)));
+}
@@ -1,24 +1,16 @@
 #include "Snow.hpp"
-#include "Shader.hpp"
-#include "SnowScene.hpp"
-#include <atlas/utils/Application.hpp>
 
-int Snow::amountSnow = 0;
+// Gravity, and the air drag per unit of mass and velocity.
+static const float kGravity = 9.81f;
+static const float kViscosity = 7.5f;
 
 Snow::Snow() :
-    m_size(0.0002)
+    m_size(0.0002),
+    mPosition(0.0f),
+    mVelocity(0.0f),
+    mAcceleration(0.0f),
+    mRotMat(1.0f)
 {
-    ++Snow::amountSnow;
-
-    m_NormDistr = std::normal_distribution<float>(0.0f, m_size * 18.0f);
-    m_UniDistr = std::uniform_real_distribution<float>(0.0f, (float)(2.0 * M_PI));
-}
-
-Snow::~Snow()
-{
-    auto currScene = atlas::utils::Application::getInstance().getCurrentScene();
-    ((SnowScene*)currScene)->getSnowAccum().refreshNearestVert(mPosition);
-    --Snow::amountSnow;
 }
 
 void Snow::setMass(float mass)
@@ -61,81 +53,23 @@ glm::vec3 Snow::getAccel() const
     return mAcceleration;
 }
 
-void Snow::updateGeometry(atlas::core::Time<> const &t)
+glm::vec3 Snow::computeAcceleration(glm::vec3 const &velocity, float mass,
+    glm::vec3 const &wind, glm::vec3 const &offset)
 {
-    glm::vec3 newPosition;
-    glm::vec3 newVelocity;
-
-    float deltaTime = t.deltaTime;
-
-    // Compute the new pos by Runge-Kutta Order 4.
-    glm::vec3 v1 = deltaTime * computeVelocity(0);
-    glm::vec3 v2 = deltaTime * computeVelocity(0.5 * deltaTime);
-    glm::vec3 v3 = deltaTime * computeVelocity(0.5 * deltaTime);
-    glm::vec3 v4 = deltaTime * computeVelocity(deltaTime);
-    newPosition = mPosition + (1.0f / 6.0f) * (v1 + 2.0f * v2 + 2.0f * v3 + v4);
-
-    // Compute the new velocity by Runge-Kutta Order 4.
-    glm::vec3 a1 = deltaTime * computeAcceleration(0, mVelocity);
-    glm::vec3 a2 = deltaTime * computeAcceleration(0.5 * deltaTime, mVelocity + 0.5f * a1);
-    glm::vec3 a3 = deltaTime * computeAcceleration(0.5 * deltaTime, mVelocity + 0.5f * a2);
-    glm::vec3 a4 = deltaTime * computeAcceleration(deltaTime, mVelocity + a3);
-    newVelocity = mVelocity + (1.0f / 6.0f) * (a1 + 2.0f * a2 + 2.0f * a3 + a4);
-
-    // Update acceleration so that we use it to compute velocity
-    // the next time we execute Runge-Kutta.
-    mAcceleration = (newVelocity - mVelocity) / deltaTime;
+    glm::vec3 gforce(0.0f, -kGravity * mass, 0.0f);
 
-    mPosition = newPosition;
-    mVelocity = newVelocity;
+    glm::vec3 f_Viscosity = -kViscosity * mass * velocity;
 
-    applyTransformations();
-}
-
-void Snow::applyTransformations()
-{
-    setModel(glm::mat4(1.0f));
-    transformGeometry(glm::translate(glm::mat4(1.0f), mPosition));
-}
-
-glm::vec3 Snow::computeVelocity(float deltaTime, glm::vec3 const &velocity)
-{
-    return velocity + mAcceleration * deltaTime;
-}
-
-glm::vec3 Snow::computeVelocity(float deltaTime)
-{
-    return computeVelocity(deltaTime, mVelocity);
-}
-
-glm::vec3 Snow::computeAcceleration(float deltaTime, glm::vec3 const &velocity)
-{
-    glm::vec3 pos = mPosition + velocity * deltaTime;
-    return computeAcceleration(pos, velocity);
-}
-
-glm::vec3 Snow::computeAcceleration(glm::vec3 const &pos, glm::vec3 const &velocity)
-{
-    const float g = 9.81;
-    glm::vec3 gforce(0.0f, -g * m_size, 0.0f);
-
-    const float viscosity_k = 7.5f;
-    glm::vec3 f_Viscosity = -viscosity_k * m_size * mVelocity;
-
-    glm::vec3 f_Wind = m_size * ((SnowScene*)atlas::utils::Application::getInstance().getCurrentScene())->getForceWind();
-
-    float radOffset = std::fabs(m_NormDistr(m_Gen));
-    float theta = m_UniDistr(m_Gen);
-    glm::vec3 offset = radOffset * glm::vec3(cos(theta), 0.0f, sin(theta));
+    glm::vec3 f_Wind = mass * wind;
 
     glm::vec3 nForce = gforce + f_Viscosity + f_Wind + offset;
 
-    return nForce / m_size;
+    return nForce / mass;
 }
 
-void Snow::setModel(glm::mat4 const &model)
+glm::vec3 Snow::computeTerminalVelocity(glm::vec3 const &wind)
 {
-    mModel = model;
+    return (wind - glm::vec3(0.0f, kGravity, 0.0f)) / kViscosity;
 }
 
 glm::mat4 Snow::getRotation() const
@@ -147,8 +81,3 @@ void Snow::setRotation(glm::mat4 const &rot)
 {
     mRotMat = rot;
 }
-
-int Snow::getSnowAmount()
-{
-    return Snow::amountSnow;
-}
@@ -1,14 +1,50 @@
 #include "SnowAccum.hpp"
 #include "Shader.hpp"
 #include "SnowScene.hpp"
+#include "SnowCheckpoint.hpp"
+#include "Surface.hpp"
+#include "Terrain.hpp"
 #include <atlas/utils/Application.hpp>
+#include <atlas/utils/Frustum.hpp>
 #include <atlas/utils/GUI.hpp>
 #include "Asset.hpp"
 #include <stb/stb_image.h>
 #include <glm/gtc/type_ptr.hpp>
 
+// Checkpoint sections written by the snow accumulation.
+static const std::uint32_t kTagHeights = checkpointTag("HPOS");
+static const std::uint32_t kTagNormals = checkpointTag("HNRM");
+
+// Cells per side of the accumulation grid, where it starts and how far
+// apart the cells are.
+static const int kGridSize = 51;
+static const float kGridOrigin = -10.0f;
+static const float kGridSpacing = 20.0f / (kGridSize - 1);
+
+// How far the empty surface sits above the ground.
+static const float kGroundOffset = 0.005f;
+
+// Distance from a landing flake within which cells take its snow, and how
+// much each of them takes.
+static const float kDepositRadius = 1.0f;
+static const float kDepositAmount = 0.005f;
+
+// Length of a fast-forward step, in seconds of snowfall.
+static const float kFastForwardStep = 10.0f;
+
+// Cells the grid scrolls by at a time.
+static const int kScrollCells = 4;
+
 SnowAccum::SnowAccum() :
-    m_snowAccum(true)
+    m_snowAccum(true),
+    m_Transport(51, 20.0f / 50, 8),
+    m_Log(51, 8, 51 * 51 * sizeof(glm::vec2)),
+    m_GroundRevision(0),
+    m_GridOrigin(kGridOrigin),
+    m_Inspect(false),
+    m_InspectTime(0.0f),
+    m_HistoryTime(0.0f),
+    m_ExportSkirt(true)
 {    
     // Define parameters for creating the snow surface.
     int k = 50;                // Number of divisions.
@@ -80,6 +116,12 @@ SnowAccum::SnowAccum() :
     } 
     
     mIndices.push_back(0xFFFFFFFF); // Restart primitive.
+
+    // Snow never moves below the bare surface.
+    m_Transport.setGround(m_alphaPos);
+
+    // Start the deposition history from the empty surface.
+    resetHistory(0.0f);
     
     // Define OpenGL buffers and generate vertex array.
     glGenVertexArrays(1, &m_VAO);
@@ -163,6 +205,21 @@ SnowAccum::~SnowAccum()
 
 void SnowAccum::renderGeometry(atlas::math::Matrix4 const &projection, atlas::math::Matrix4 const &view)
 {
+    // Rebake the exposure under anything that moved, and pick up finished bakes.
+    SnowScene *scene = (SnowScene *)atlas::utils::Application::getInstance().getCurrentScene();
+    atlas::utils::BBox changed;
+    if (scene->getSurface().takeChangedRegion(changed))
+    {
+        m_Exposure.invalidate(changed);
+    }
+    m_Exposure.update(scene->getSurface().getOccluders(), scene->getForceWind());
+
+    // Show the surface as it was at the inspected time.
+    if (m_Inspect)
+    {
+        updateHistory(projection * view * mModel);
+    }
+
     // Enable the shaders.
     mShaders[0].enableShaders();
 
@@ -171,25 +228,19 @@ void SnowAccum::renderGeometry(atlas::math::Matrix4 const &projection, atlas::ma
     const GLint mViewProj_UNIFORMLOC = glGetUniformLocation(mShaders[0].getShaderProgram(), "ModelViewProjection");
     glUniformMatrix4fv(mViewProj_UNIFORMLOC, 1, GL_FALSE, &m_ViewProj[0][0]);
 
-    // Set up the sky matrix for rendering the snow accumulation.
-    glm::mat4 viewSky = glm::lookAt(glm::vec3(0.0f, 15.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    glm::mat4 projSky = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 0.01f, 100.0f);
-    glm::mat4 matOffset = glm::mat4(
-        0.5f, 0.0f, 0.0f, 0.0f,
-        0.0f, 0.5f, 0.0f, 0.0f,
-        0.0f, 0.0f, 0.5f, 0.0f,
-        0.5f, 0.5f, 0.5f, 1.0f);
-    glm::mat4 matSky = matOffset * projSky * viewSky * mModel;
-    const GLint matSky_UNILOC = glGetUniformLocation(mShaders[0].getShaderProgram(), "SkyMatrix");
-    glUniformMatrix4fv(matSky_UNILOC, 1, GL_FALSE, &matSky[0][0]);
+    // Set the sky exposure baked for the ground under the scenery.
+    const GLint exposureExtent_UNILOC = glGetUniformLocation(mShaders[0].getShaderProgram(), "ExposureExtent");
+    glUniform1f(exposureExtent_UNILOC, m_Exposure.getExtent());
+    const GLint exposureCentre_UNILOC = glGetUniformLocation(mShaders[0].getShaderProgram(), "ExposureCentre");
+    glUniform2fv(exposureCentre_UNILOC, 1, value_ptr(m_Exposure.getCentre()));
 
     // Set texture uniforms for snow accumulation and normal map.
     glActiveTexture(GL_TEXTURE1);
-    GLint sceneSnowAccum_UNILOC = glGetUniformLocation(mShaders[0].getShaderProgram(), "SnowMap");
-    GLint sceneToggleAccum_UNILOC = glGetUniformLocation(mShaders[0].getShaderProgram(), "UseSnowMap");
+    GLint sceneSnowAccum_UNILOC = glGetUniformLocation(mShaders[0].getShaderProgram(), "SkyExposure");
+    GLint sceneToggleAccum_UNILOC = glGetUniformLocation(mShaders[0].getShaderProgram(), "UseSkyExposure");
     glUniform1i(sceneSnowAccum_UNILOC, 1);
     glUniform1i(sceneToggleAccum_UNILOC, m_snowAccum);
-    glBindTexture(GL_TEXTURE_2D, ((SnowScene *)atlas::utils::Application::getInstance().getCurrentScene())->getSnowFall().getSnowDepthTexture());
+    glBindTexture(GL_TEXTURE_2D, m_Exposure.getTexture());
 
     glActiveTexture(GL_TEXTURE2);
     GLint sceneNorm_UNILOC = glGetUniformLocation(mShaders[0].getShaderProgram(), "NormalMap");
@@ -221,6 +272,47 @@ void SnowAccum::renderGeometry(atlas::math::Matrix4 const &projection, atlas::ma
 }
 
 void SnowAccum::updateGeometry(atlas::core::Time<> const &t)
+{
+    SnowScene *scene = (SnowScene *)atlas::utils::Application::getInstance().getCurrentScene();
+
+    // Keep the cells on the ground as finer terrain is loaded under them.
+    Terrain const &terrain = scene->getSurface().getTerrain();
+    if (terrain.getRevision() != m_GroundRevision)
+    {
+        followGround(terrain);
+        m_GroundRevision = terrain.getRevision();
+    }
+
+    // Let the snow slide and drift.
+    moveSnow(t.totalTime);
+    updateNormals();
+
+    // Close this frame's batch of deposits.
+    m_Log.commit(t.totalTime, m_alphaPos);
+
+    // Update the vertex buffer data with the new alpha positions.
+    if (!m_Inspect)
+    {
+        uploadPositions(m_alphaPos);
+    }
+}
+
+void SnowAccum::moveSnow(double time)
+{
+    SnowScene *scene = (SnowScene *)atlas::utils::Application::getInstance().getCurrentScene();
+    WindField const &wind = scene->getWindField();
+    m_Transport.update(time, m_alphaPos,
+        [&wind](glm::vec3 const *points, std::size_t count, glm::vec3 *winds) { wind.sample(points, count, winds); },
+        [this](float x, float z) { return m_Exposure.sample(x, z); });
+    for (auto const &shift : m_Transport.getShifts())
+    {
+        glm::vec4 &cell = m_alphaPos[shift.cell];
+        m_PeakHeights[shift.cell] = std::max(m_PeakHeights[shift.cell], cell.y);
+        DepositionLog::shift(cell, m_Log.recordShift(shift.cell, shift.height));
+    }
+}
+
+void SnowAccum::updateNormals()
 {
     // Initialize normals with zero vectors.
     mNormals = std::vector<glm::vec3>(m_alphaPos.size(), glm::vec3(0.0, 0.0, 0.0));
@@ -260,23 +352,354 @@ void SnowAccum::updateGeometry(atlas::core::Time<> const &t)
         // Toggle flip for the next iteration.
         flip = !flip;
     }
+}
+
+void SnowAccum::fastForward(double time, float duration)
+{
+    SnowScene *scene = (SnowScene *)atlas::utils::Application::getInstance().getCurrentScene();
+    Terrain const &terrain = scene->getSurface().getTerrain();
+    if (terrain.getRevision() != m_GroundRevision)
+    {
+        followGround(terrain);
+        m_GroundRevision = terrain.getRevision();
+    }
 
+    // Flakes land in the square around each cell and cover every cell
+    // within reach, so the landings are counted on the grid and a border
+    // around it, then gathered from the squares in reach of each cell.
+    int border = (int)(kDepositRadius / kGridSpacing);
+    int side = kGridSize + 2 * border;
+    std::vector<float> rates;
+    computeLandingRates(rates, border);
+
+    std::vector<int> reach;
+    for (int row = -border; row <= border; ++row)
+    {
+        for (int col = -border; col <= border; ++col)
+        {
+            if ((row * row + col * col) * kGridSpacing * kGridSpacing <= kDepositRadius * kDepositRadius)
+            {
+                reach.push_back(row * side + col);
+            }
+        }
+    }
+
+    std::vector<int> landings(side * side);
+    for (float elapsed = 0.0f; elapsed < duration; elapsed += kFastForwardStep)
+    {
+        float step = std::min(kFastForwardStep, duration - elapsed);
+        for (int i = 0; i < side * side; ++i)
+        {
+            landings[i] = 0;
+            if (rates[i] > 0.0f)
+            {
+                std::poisson_distribution<int> count(rates[i] * step);
+                landings[i] = count(m_Random);
+            }
+        }
+
+        for (int row = 0; row < kGridSize; ++row)
+        {
+            for (int col = 0; col < kGridSize; ++col)
+            {
+                int centre = (row + border) * side + col + border;
+                int flakes = 0;
+                for (int offset : reach)
+                {
+                    flakes += landings[centre + offset];
+                }
+
+                if (flakes > 0)
+                {
+                    int cell = row * kGridSize + col;
+                    DepositionLog::deposit(m_alphaPos[cell], m_Log.record(cell, flakes * kDepositAmount));
+                    m_Transport.markDirty(cell);
+                }
+            }
+        }
+
+        // One transport pass and one batch of history per step.
+        double now = time + elapsed + step;
+        moveSnow(now);
+        m_Log.commit((float)now, m_alphaPos);
+    }
+
+    updateNormals();
+    if (!m_Inspect)
+    {
+        uploadPositions(m_alphaPos);
+    }
+}
+
+void SnowAccum::computeLandingRates(std::vector<float> &rates, int border) const
+{
+    SnowScene *scene = (SnowScene *)atlas::utils::Application::getInstance().getCurrentScene();
+    SnowfallGenerator const &generator = scene->getGenerator();
+    WindField const &wind = scene->getWindField();
+    glm::vec3 boxMin = generator.getBBoxMin(), boxMax = generator.getBBoxMax();
+    float boxArea = (boxMax.x - boxMin.x) * (boxMax.z - boxMin.z);
+    float flux = boxArea > 0.0f ? generator.getRate() / boxArea : 0.0f;
+
+    int side = kGridSize + 2 * border;
+    rates.assign(side * side, 0.0f);
+    for (int row = 0; row < side; ++row)
+    {
+        for (int col = 0; col < side; ++col)
+        {
+            float x = m_GridOrigin.x + (col - border) * kGridSpacing;
+            float z = m_GridOrigin.y + (row - border) * kGridSpacing;
+            int cell = glm::clamp(row - border, 0, kGridSize - 1) * kGridSize +
+                glm::clamp(col - border, 0, kGridSize - 1);
+            float height = m_alphaPos[cell].y;
+
+            // Follow the flakes back up to the spawn height at the speed the
+            // wind halfway up carries them. Only points whose flakes started
+            // inside the spawn box get any.
+            glm::vec3 velocity = Snow::computeTerminalVelocity(wind.sample(glm::vec3(x, 0.5f * (height + boxMax.y), z)));
+            if (velocity.y >= 0.0f || height >= boxMax.y)
+            {
+                continue;
+            }
+            float fallTime = (boxMax.y - height) / -velocity.y;
+            float startX = x - velocity.x * fallTime, startZ = z - velocity.z * fallTime;
+            if (startX < boxMin.x || startX > boxMax.x || startZ < boxMin.z || startZ > boxMax.z)
+            {
+                continue;
+            }
+
+            // Snow the scenery catches never reaches the ground under it.
+            rates[row * side + col] = flux * getCellArea() * m_Exposure.sample(x, z);
+        }
+    }
+}
+
+void SnowAccum::uploadPositions(std::vector<glm::vec4> const &positions)
+{
     glBindVertexArray(m_VAO);
     glBindBuffer(GL_ARRAY_BUFFER, m_AlphaBuffPos);
+    glBufferData(GL_ARRAY_BUFFER, 4 * positions.size() * sizeof(GLfloat), positions.data(), GL_DYNAMIC_DRAW);
+    glBindVertexArray(0);
+}
 
-    // Update the vertex buffer data with the new alpha positions.
-    glBufferData(GL_ARRAY_BUFFER, 4 * m_alphaPos.size() * sizeof(GLfloat), m_alphaPos.data(), GL_DYNAMIC_DRAW);
+bool SnowAccum::exportSurface(std::string const &filename, atlas::utils::HeightfieldFormat format, bool skirt)
+{
+    // Snapshot the grid so the simulation can keep running during the export.
+    atlas::utils::Heightfield field;
+    field.rows = 51;
+    field.cols = 51;
+    field.positions.resize(51 * 51);
+    field.normals.resize(51 * 51);
+    for (int i = 0; i < 51 * 51; ++i)
+    {
+        field.positions[i] = glm::vec3(m_alphaPos[i]);
+        float length = glm::length(mNormals[i]);
+        field.normals[i] = length > 0.0f ? mNormals[i] / length : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
 
-    glBindVertexArray(0);
+    return m_Exporter.exportAsync(filename, std::move(field), format, skirt, 0.0f);
+}
+
+void SnowAccum::followGround(Terrain const &terrain)
+{
+    // Logged as shifts, so the history replays the ground moving too.
+    for (int i = 0; i < kGridSize * kGridSize; ++i)
+    {
+        float ground = m_Transport.getGround(i);
+        float shift = m_Log.recordShift(i, terrain.getHeight(m_alphaPos[i].x, m_alphaPos[i].z) + kGroundOffset - ground);
+        if (shift != 0.0f)
+        {
+            DepositionLog::shift(m_alphaPos[i], shift);
+            m_PeakHeights[i] += shift;
+            m_Transport.setGround(i, ground + shift);
+            m_Transport.markDirty(i);
+        }
+    }
+
+    placeRim(terrain);
+}
+
+void SnowAccum::placeRim(Terrain const &terrain)
+{
+    // The solid rim around the grid holds no snow and is not logged. Its
+    // sides run along -z, +x, +z and -x in turn.
+    float size = (kGridSize - 1) * kGridSpacing;
+    for (int i = 0; i < 4 * kGridSize; ++i)
+    {
+        int side = i / kGridSize;
+        float along = (i % kGridSize) * kGridSpacing;
+        glm::vec2 offset = side == 0 ? glm::vec2(along, 0.0f) : side == 1 ? glm::vec2(size, along) :
+            side == 2 ? glm::vec2(size - along, size) : glm::vec2(0.0f, size - along);
+
+        glm::vec4 &rim = m_alphaPos[kGridSize * kGridSize + i];
+        rim.x = m_GridOrigin.x + offset.x;
+        rim.z = m_GridOrigin.y + offset.y;
+        rim.y = terrain.getHeight(rim.x, rim.z) + kGroundOffset;
+    }
+}
+
+void SnowAccum::setCentre(glm::vec2 const &centre)
+{
+    // Whole steps keep the cells on one lattice, so the snow is moved
+    // between cells and never resampled.
+    float step = kScrollCells * kGridSpacing;
+    glm::vec2 origin = glm::vec2(kGridOrigin) + glm::round(centre / step) * step;
+    glm::ivec2 shift(glm::round((origin - m_GridOrigin) / kGridSpacing));
+    if (shift == glm::ivec2(0))
+    {
+        return;
+    }
+    m_GridOrigin = origin;
+
+    SnowScene *scene = (SnowScene *)atlas::utils::Application::getInstance().getCurrentScene();
+    Terrain const &terrain = scene->getSurface().getTerrain();
+    std::vector<glm::vec4> cells(m_alphaPos.begin(), m_alphaPos.begin() + kGridSize * kGridSize);
+    std::vector<float> ground(kGridSize * kGridSize);
+    for (int i = 0; i < kGridSize * kGridSize; ++i)
+    {
+        ground[i] = m_Transport.getGround(i);
+    }
+    std::vector<float> peaks(m_PeakHeights);
+
+    for (int row = 0; row < kGridSize; ++row)
+    {
+        for (int col = 0; col < kGridSize; ++col)
+        {
+            int cell = row * kGridSize + col;
+            int fromRow = row + shift.y, fromCol = col + shift.x;
+            float x = m_GridOrigin.x + col * kGridSpacing, z = m_GridOrigin.y + row * kGridSpacing;
+            if (fromRow >= 0 && fromRow < kGridSize && fromCol >= 0 && fromCol < kGridSize)
+            {
+                int from = fromRow * kGridSize + fromCol;
+                m_alphaPos[cell] = glm::vec4(x, cells[from].y, z, cells[from].w);
+                m_Transport.setGround(cell, ground[from]);
+                m_PeakHeights[cell] = peaks[from];
+            }
+            else
+            {
+                float height = terrain.getHeight(x, z) + kGroundOffset;
+                m_alphaPos[cell] = glm::vec4(x, height, z, 0.0f);
+                m_Transport.setGround(cell, height);
+                m_PeakHeights[cell] = height;
+            }
+        }
+    }
+    placeRim(terrain);
+    m_Transport.markAllDirty();
+    m_Exposure.setCentre(m_GridOrigin + 0.5f * (kGridSize - 1) * kGridSpacing);
+
+    // The log replays the move, so the history survives it. Every rebuilt
+    // tile now shows other places.
+    m_Log.scroll(m_Log.getLatestTime(), shift, m_alphaPos);
+    m_History = m_alphaPos;
+    std::fill(m_TileValid.begin(), m_TileValid.end(), 0);
+    updateNormals();
+    if (!m_Inspect)
+    {
+        uploadPositions(m_alphaPos);
+    }
+}
+
+void SnowAccum::resetHistory(float time)
+{
+    m_Log.reset(time, m_alphaPos);
+    m_History = m_alphaPos;
+    m_PeakHeights.resize(51 * 51);
+    for (int i = 0; i < 51 * 51; ++i)
+    {
+        m_PeakHeights[i] = m_alphaPos[i].y;
+    }
+    m_TileValid.assign(m_Log.getTileCount(), 0);
+    m_InspectTime = m_HistoryTime = time;
+}
+
+void SnowAccum::updateHistory(glm::mat4 const &viewProj)
+{
+    // Moving to another time makes every rebuilt tile stale.
+    if (m_InspectTime != m_HistoryTime)
+    {
+        std::fill(m_TileValid.begin(), m_TileValid.end(), 0);
+        m_HistoryTime = m_InspectTime;
+    }
+
+    // Only rebuild the stale tiles that are in view, bounded by the highest
+    // the surface has been.
+    std::vector<int> tiles;
+    for (int tile = 0; tile < m_Log.getTileCount(); ++tile)
+    {
+        if (m_TileValid[tile])
+        {
+            continue;
+        }
+
+        int firstRow, firstCol, endRow, endCol;
+        m_Log.getTileBounds(tile, firstRow, firstCol, endRow, endCol);
+
+        float top = 0.0f;
+        for (int row = firstRow; row < endRow; ++row)
+        {
+            for (int col = firstCol; col < endCol; ++col)
+            {
+                top = std::max(top, std::max(m_alphaPos[row * 51 + col].y, m_PeakHeights[row * 51 + col]));
+            }
+        }
+
+        glm::vec3 lo(m_alphaPos[firstRow * 51 + firstCol].x, 0.0f, m_alphaPos[firstRow * 51 + firstCol].z);
+        glm::vec3 hi(m_alphaPos[(endRow - 1) * 51 + endCol - 1].x, top + 0.01f, m_alphaPos[(endRow - 1) * 51 + endCol - 1].z);
+        if (atlas::utils::isBoxVisible(viewProj, lo, hi))
+        {
+            tiles.push_back(tile);
+            m_TileValid[tile] = 1;
+        }
+    }
+
+    if (!tiles.empty())
+    {
+        m_Log.reconstruct(m_HistoryTime, tiles, m_History);
+        uploadPositions(m_History);
+    }
 }
 
 void SnowAccum::drawGui()
 {
-    ImGui::SetNextWindowSize(ImVec2(300, 100), ImGuiSetCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(300, 150), ImGuiSetCond_FirstUseEver);
 
     // Create an ImGui window for snow accumulation options.
     ImGui::Begin("Snow Accumulation Options");
     ImGui::Checkbox("Toggle Snow Accumulation", &m_snowAccum);
+
+    // Browse the surface at any past time.
+    if (ImGui::Checkbox("Inspect History", &m_Inspect))
+    {
+        if (m_Inspect)
+        {
+            std::fill(m_TileValid.begin(), m_TileValid.end(), 0);
+            m_InspectTime = m_HistoryTime = m_Log.getLatestTime();
+        }
+        else
+        {
+            uploadPositions(m_alphaPos);
+        }
+    }
+    if (m_Inspect)
+    {
+        ImGui::SliderFloat("History Time", &m_InspectTime, m_Log.getStartTime(), m_Log.getLatestTime());
+    }
+    ImGui::Text("History size: %.1f KB", m_Log.getSizeInBytes() / 1024.0f);
+
+    // Snow moving after it has landed.
+    m_Transport.drawGui();
+
+    // Export the surface for use in other tools.
+    ImGui::Checkbox("Export Skirt", &m_ExportSkirt);
+    if (ImGui::Button("Export PLY"))
+    {
+        exportSurface("snow_surface.ply", atlas::utils::HeightfieldFormat::PLY, m_ExportSkirt);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Export OBJ"))
+    {
+        exportSurface("snow_surface.obj", atlas::utils::HeightfieldFormat::OBJ, m_ExportSkirt);
+    }
     ImGui::End();
 }
 
@@ -284,38 +707,147 @@ void SnowAccum::drawGui()
 void SnowAccum::refreshNearestVert(glm::vec3 const &query)
 {
     // Define the maximum distance for updating alpha positions.
-    float distanceMax = 1.0;
+    float distanceMax = kDepositRadius;
     
     // Define a small constant k.
-    float k = 0.005f;
+    float k = kDepositAmount;
     
-    int i = 0;
-    
-    // Iterate through the alpha positions.
-    for (glm::vec4 &alphaPos : m_alphaPos)
+    // Iterate through the alpha positions of the grid.
+    for (int i = 0; i < 51 * 51; ++i)
     {
-        // Break the loop if we've processed all vertices.
-        if (i >= 51 * 51)
-        {
-            break;
-        }
-        
-        ++i;
+        glm::vec4 &alphaPos = m_alphaPos[i];
 
         // Calculate the Euclidean distance between the query point and alpha position.
         float dist = glm::length(query - glm::vec3(alphaPos));
 
         // Calculate the amount to increase alpha based on the distance.
-        // Ensure that the amount does not exceed 0.005f.
-        float amount = dist > distanceMax ? 0.0f : std::min(0.005f, k / dist);
+        // Ensure that the amount does not exceed the deposit amount.
+        float amount = dist > distanceMax ? 0.0f : std::min(kDepositAmount, k / dist);
+        if (amount <= 0.0f)
+        {
+            continue;
+        }
+
+        // Log the deposit and apply the amount that was recorded.
+        DepositionLog::deposit(alphaPos, m_Log.record(i, amount));
+        m_Transport.markDirty(i);
+    }
+}
+
+SnowAccum::Footprint SnowAccum::getFootprint(float x, float z) const
+{
+    float u = glm::clamp((x - m_GridOrigin.x) / kGridSpacing, 0.0f, (float)(kGridSize - 1));
+    float v = glm::clamp((z - m_GridOrigin.y) / kGridSpacing, 0.0f, (float)(kGridSize - 1));
+    int col = std::min((int)u, kGridSize - 2);
+    int row = std::min((int)v, kGridSize - 2);
+    float fx = u - col, fz = v - row;
+
+    Footprint footprint;
+    footprint.cells[0] = row * kGridSize + col;
+    footprint.cells[1] = footprint.cells[0] + 1;
+    footprint.cells[2] = footprint.cells[0] + kGridSize;
+    footprint.cells[3] = footprint.cells[2] + 1;
+    footprint.weights[0] = (1.0f - fx) * (1.0f - fz);
+    footprint.weights[1] = fx * (1.0f - fz);
+    footprint.weights[2] = (1.0f - fx) * fz;
+    footprint.weights[3] = fx * fz;
+    return footprint;
+}
+
+float SnowAccum::sampleHeight(float x, float z, glm::vec3 &normal) const
+{
+    Footprint footprint = getFootprint(x, z);
+    float h00 = m_alphaPos[footprint.cells[0]].y, h10 = m_alphaPos[footprint.cells[1]].y;
+    float h01 = m_alphaPos[footprint.cells[2]].y, h11 = m_alphaPos[footprint.cells[3]].y;
+
+    // The weights of the far cells are the fractions along each axis.
+    float fx = footprint.weights[1] + footprint.weights[3];
+    float fz = footprint.weights[2] + footprint.weights[3];
+    float dx = ((1.0f - fz) * (h10 - h00) + fz * (h11 - h01)) / kGridSpacing;
+    float dz = ((1.0f - fx) * (h01 - h00) + fx * (h11 - h10)) / kGridSpacing;
+    normal = glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+
+    return footprint.weights[0] * h00 + footprint.weights[1] * h10 +
+        footprint.weights[2] * h01 + footprint.weights[3] * h11;
+}
 
-        // Update the alpha position's w component.
-        alphaPos.w += amount;
+int SnowAccum::getCellCount() const
+{
+    return kGridSize * kGridSize;
+}
+
+glm::vec3 SnowAccum::getCellPosition(int cell) const
+{
+    return glm::vec3(m_alphaPos[cell]);
+}
+
+float SnowAccum::getCellArea() const
+{
+    return kGridSpacing * kGridSpacing;
+}
+
+float SnowAccum::getSnowDepth(int cell) const
+{
+    return std::max(m_alphaPos[cell].y - m_Transport.getGround(cell), 0.0f);
+}
 
-        // If alpha position's w component exceeds 1.0, increase the y component.
-        if (alphaPos.w >= 1.0f)
+void SnowAccum::removeSnow(std::vector<float> const &depths)
+{
+    for (int i = 0; i < kGridSize * kGridSize; ++i)
+    {
+        if (depths[i] > 0.0f)
         {
-            alphaPos.y += 0.3f * amount;
+            DepositionLog::shift(m_alphaPos[i], m_Log.recordShift(i, -depths[i]));
+            m_Transport.markDirty(i);
         }
     }
 }
+
+void SnowAccum::saveState(CheckpointWriter &writer) const
+{
+    writer.writeSection(kTagHeights, m_alphaPos);
+    writer.writeSection(kTagNormals, mNormals);
+}
+
+bool SnowAccum::checkState(CheckpointReader const &reader) const
+{
+    // The grid layout is fixed, so the saved arrays must match it exactly.
+    std::size_t heightCount, normalCount;
+    const void *heights = reader.findSection(kTagHeights, sizeof(glm::vec4), heightCount);
+    const void *normals = reader.findSection(kTagNormals, sizeof(glm::vec3), normalCount);
+    return heights && normals && heightCount == m_alphaPos.size() && normalCount == mNormals.size();
+}
+
+bool SnowAccum::loadState(CheckpointReader const &reader)
+{
+    if (!checkState(reader))
+    {
+        return false;
+    }
+
+    std::size_t heightCount, normalCount;
+    const void *heights = reader.findSection(kTagHeights, sizeof(glm::vec4), heightCount);
+    const void *normals = reader.findSection(kTagNormals, sizeof(glm::vec3), normalCount);
+
+    std::memcpy(m_alphaPos.data(), heights, heightCount * sizeof(glm::vec4));
+    std::memcpy(mNormals.data(), normals, normalCount * sizeof(glm::vec3));
+    m_Transport.markAllDirty();
+
+    // The grid may have been saved scrolled, with the ground under it.
+    SnowScene *scene = (SnowScene *)atlas::utils::Application::getInstance().getCurrentScene();
+    Terrain const &terrain = scene->getSurface().getTerrain();
+    m_GridOrigin = glm::vec2(m_alphaPos[0].x, m_alphaPos[0].z);
+    for (int i = 0; i < kGridSize * kGridSize; ++i)
+    {
+        m_Transport.setGround(i, terrain.getHeight(m_alphaPos[i].x, m_alphaPos[i].z) + kGroundOffset);
+    }
+    m_Exposure.setCentre(m_GridOrigin + 0.5f * (kGridSize - 1) * kGridSpacing);
+
+    // Upload the restored surface.
+    glBindVertexArray(m_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_AlphaBuffPos);
+    glBufferData(GL_ARRAY_BUFFER, 4 * m_alphaPos.size() * sizeof(GLfloat), m_alphaPos.data(), GL_DYNAMIC_DRAW);
+    glBindVertexArray(0);
+
+    return true;
+}
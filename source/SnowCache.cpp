@@ -0,0 +1,183 @@
+#include "SnowCache.hpp"
+
+#include <atlas/core/Log.hpp>
+#include <cstring>
+
+static const char kSnowCacheMagic[8] = { 'S', 'N', 'O', 'W', 'C', 'A', 'C', 'H' };
+static const std::uint64_t kFrameAlignment = 64;
+
+SnowCacheWriter::SnowCacheWriter() :
+    m_File(nullptr),
+    m_Offset(0)
+{
+}
+
+SnowCacheWriter::~SnowCacheWriter()
+{
+    close();
+}
+
+bool SnowCacheWriter::open(std::string const &filename)
+{
+    close();
+
+    m_File = std::fopen(filename.c_str(), "wb");
+    if (!m_File)
+    {
+        ERROR_LOG("Could not open " + filename + " for writing.");
+        return false;
+    }
+
+    m_Frames.clear();
+
+    // The header is written last, once the frame index is known.
+    SnowCacheHeader header = {};
+    std::fwrite(&header, sizeof(header), 1, m_File);
+    m_Offset = sizeof(header);
+    return true;
+}
+
+bool SnowCacheWriter::close()
+{
+    if (!m_File)
+    {
+        return false;
+    }
+
+    SnowCacheHeader header = {};
+    std::memcpy(header.magic, kSnowCacheMagic, sizeof(header.magic));
+    header.version = kSnowCacheVersion;
+    header.instanceSize = sizeof(SnowInstance);
+    header.frameCount = m_Frames.size();
+    header.indexOffset = m_Offset;
+
+    std::fwrite(m_Frames.data(), sizeof(SnowCacheFrame), m_Frames.size(), m_File);
+    std::fseek(m_File, 0, SEEK_SET);
+    std::fwrite(&header, sizeof(header), 1, m_File);
+
+    bool ok = !std::ferror(m_File);
+    std::fclose(m_File);
+    m_File = nullptr;
+    return ok;
+}
+
+bool SnowCacheWriter::isOpen() const
+{
+    return m_File != nullptr;
+}
+
+void SnowCacheWriter::appendFrame(float time, glm::vec3 const &origin, std::vector<SnowInstance> const &instances)
+{
+    if (!m_File)
+    {
+        return;
+    }
+
+    static const char padding[kFrameAlignment] = {};
+    std::uint64_t aligned = (m_Offset + kFrameAlignment - 1) & ~(kFrameAlignment - 1);
+    std::fwrite(padding, 1, aligned - m_Offset, m_File);
+    std::fwrite(instances.data(), sizeof(SnowInstance), instances.size(), m_File);
+
+    SnowCacheFrame frame = { aligned, (std::uint32_t)instances.size(), time, { origin.x, origin.y, origin.z }, 0.0f };
+    m_Frames.push_back(frame);
+    m_Offset = aligned + instances.size() * sizeof(SnowInstance);
+}
+
+std::size_t SnowCacheWriter::getFrameCount() const
+{
+    return m_Frames.size();
+}
+
+SnowCacheReader::SnowCacheReader() :
+    m_Header(nullptr),
+    m_Frames(nullptr)
+{
+}
+
+bool SnowCacheReader::open(std::string const &filename)
+{
+    close();
+
+    if (!m_File.open(filename))
+    {
+        return false;
+    }
+
+    const SnowCacheHeader *header = (const SnowCacheHeader *)m_File.data();
+    if (m_File.size() < sizeof(SnowCacheHeader) ||
+        std::memcmp(header->magic, kSnowCacheMagic, sizeof(header->magic)) != 0)
+    {
+        ERROR_LOG(filename + " is not a snow animation cache.");
+        m_File.close();
+        return false;
+    }
+
+    if (header->version != kSnowCacheVersion || header->instanceSize != sizeof(SnowInstance))
+    {
+        ERROR_LOG_V("Animation cache version %u is not supported (expected %u).",
+            header->version, kSnowCacheVersion);
+        m_File.close();
+        return false;
+    }
+
+    if (header->indexOffset + header->frameCount * sizeof(SnowCacheFrame) > m_File.size())
+    {
+        ERROR_LOG(filename + " is truncated.");
+        m_File.close();
+        return false;
+    }
+
+    m_Header = header;
+    m_Frames = (const SnowCacheFrame *)(m_File.data() + header->indexOffset);
+    return true;
+}
+
+void SnowCacheReader::close()
+{
+    m_File.close();
+    m_Header = nullptr;
+    m_Frames = nullptr;
+}
+
+bool SnowCacheReader::isOpen() const
+{
+    return m_Header != nullptr;
+}
+
+std::size_t SnowCacheReader::getFrameCount() const
+{
+    return m_Header ? (std::size_t)m_Header->frameCount : 0;
+}
+
+float SnowCacheReader::getFrameTime(std::size_t frame) const
+{
+    return frame < getFrameCount() ? m_Frames[frame].time : 0.0f;
+}
+
+glm::vec3 SnowCacheReader::getFrameOrigin(std::size_t frame) const
+{
+    if (frame >= getFrameCount())
+    {
+        return glm::vec3(0.0f);
+    }
+
+    return glm::vec3(m_Frames[frame].origin[0], m_Frames[frame].origin[1], m_Frames[frame].origin[2]);
+}
+
+SnowInstance const *SnowCacheReader::getFrame(std::size_t frame, std::size_t &count) const
+{
+    count = 0;
+    if (frame >= getFrameCount())
+    {
+        return nullptr;
+    }
+
+    SnowCacheFrame const &entry = m_Frames[frame];
+    if (entry.offset + (std::uint64_t)entry.count * sizeof(SnowInstance) > m_File.size())
+    {
+        return nullptr;
+    }
+
+    count = entry.count;
+    return (SnowInstance const *)(m_File.data() + entry.offset);
+}
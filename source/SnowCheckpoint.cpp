@@ -0,0 +1,186 @@
+#include "SnowCheckpoint.hpp"
+
+#include <atlas/core/Log.hpp>
+
+static const char kCheckpointMagic[8] = { 'S', 'N', 'O', 'W', 'C', 'K', 'P', 'T' };
+static const std::uint64_t kSectionAlignment = 64;
+
+CheckpointWriter::CheckpointWriter() :
+    m_File(nullptr),
+    m_Flags(0),
+    m_Offset(0)
+{
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    close();
+}
+
+bool CheckpointWriter::open(std::string const &filename, std::uint32_t flags)
+{
+    close();
+
+    m_File = std::fopen(filename.c_str(), "wb");
+    if (!m_File)
+    {
+        ERROR_LOG("Could not open " + filename + " for writing.");
+        return false;
+    }
+
+    m_Flags = flags;
+    m_Sections.clear();
+
+    // The header is written last, once the section table is known.
+    CheckpointHeader header = {};
+    std::fwrite(&header, sizeof(header), 1, m_File);
+    m_Offset = sizeof(header);
+    return true;
+}
+
+bool CheckpointWriter::close()
+{
+    if (!m_File)
+    {
+        return false;
+    }
+
+    // The table is aligned like the sections, so it can be read in place.
+    std::uint64_t aligned = pad();
+
+    CheckpointHeader header = {};
+    std::memcpy(header.magic, kCheckpointMagic, sizeof(header.magic));
+    header.version = kCheckpointVersion;
+    header.flags = m_Flags;
+    header.sectionCount = m_Sections.size();
+    header.tableOffset = aligned;
+
+    std::fwrite(m_Sections.data(), sizeof(CheckpointSection), m_Sections.size(), m_File);
+    std::fseek(m_File, 0, SEEK_SET);
+    std::fwrite(&header, sizeof(header), 1, m_File);
+
+    bool ok = !std::ferror(m_File);
+    std::fclose(m_File);
+    m_File = nullptr;
+    return ok;
+}
+
+std::uint64_t CheckpointWriter::pad()
+{
+    static const char padding[kSectionAlignment] = {};
+    std::uint64_t aligned = (m_Offset + kSectionAlignment - 1) & ~(kSectionAlignment - 1);
+    std::fwrite(padding, 1, aligned - m_Offset, m_File);
+    m_Offset = aligned;
+    return aligned;
+}
+
+std::uint32_t CheckpointWriter::getFlags() const
+{
+    return m_Flags;
+}
+
+void CheckpointWriter::writeSection(std::uint32_t tag, std::uint32_t elementSize, std::size_t count, const void *data)
+{
+    if (!m_File)
+    {
+        return;
+    }
+
+    // Pad up to the next boundary so the section can be used in place.
+    std::uint64_t aligned = pad();
+
+    CheckpointSection section = {};
+    section.tag = tag;
+    section.elementSize = elementSize;
+    section.count = count;
+    section.offset = aligned;
+    m_Sections.push_back(section);
+
+    // An empty vector may hand over a null pointer.
+    if (count > 0)
+    {
+        std::fwrite(data, elementSize, count, m_File);
+    }
+    m_Offset = aligned + (std::uint64_t)elementSize * count;
+}
+
+CheckpointReader::CheckpointReader() :
+    m_Header(nullptr)
+{
+}
+
+bool CheckpointReader::open(std::string const &filename)
+{
+    m_Header = nullptr;
+    m_Table.clear();
+
+    if (!m_File.open(filename))
+    {
+        return false;
+    }
+
+    const CheckpointHeader *header = (const CheckpointHeader *)m_File.data();
+    if (m_File.size() < sizeof(CheckpointHeader) ||
+        std::memcmp(header->magic, kCheckpointMagic, sizeof(header->magic)) != 0)
+    {
+        ERROR_LOG(filename + " is not a snow checkpoint.");
+        return false;
+    }
+
+    if (header->version != kCheckpointVersion)
+    {
+        ERROR_LOG_V("Checkpoint version %u is not supported (expected %u).",
+            header->version, kCheckpointVersion);
+        return false;
+    }
+
+    // Compared against the space left so a crafted header cannot wrap.
+    std::uint64_t size = m_File.size();
+    if (header->tableOffset > size ||
+        header->sectionCount > (size - header->tableOffset) / sizeof(CheckpointSection))
+    {
+        ERROR_LOG(filename + " is truncated.");
+        return false;
+    }
+
+    // Files written before the table was aligned have it anywhere, so it
+    // is copied out rather than read in place.
+    m_Header = header;
+    m_Table.resize((std::size_t)header->sectionCount);
+    std::memcpy(m_Table.data(), m_File.data() + header->tableOffset, m_Table.size() * sizeof(CheckpointSection));
+    return true;
+}
+
+std::uint32_t CheckpointReader::getFlags() const
+{
+    return m_Header ? m_Header->flags : 0;
+}
+
+const void *CheckpointReader::findSection(std::uint32_t tag, std::uint32_t elementSize, std::size_t &count) const
+{
+    count = 0;
+    if (!m_Header)
+    {
+        return nullptr;
+    }
+
+    for (CheckpointSection const &section : m_Table)
+    {
+        if (section.tag != tag)
+        {
+            continue;
+        }
+
+        std::uint64_t size = m_File.size();
+        if (section.elementSize != elementSize || elementSize == 0 || section.offset > size ||
+            section.count > (size - section.offset) / section.elementSize)
+        {
+            return nullptr;
+        }
+
+        count = (std::size_t)section.count;
+        return m_File.data() + section.offset;
+    }
+
+    return nullptr;
+}
@@ -1,241 +1,1042 @@
 #include "SnowFall.hpp"
+#include "SnowScene.hpp"
+#include "SnowCheckpoint.hpp"
+#include "Surface.hpp"
 #include "Shader.hpp"
+#include <atlas/core/Parallel.hpp>
+#include <atlas/core/Timer.hpp>
+#include <atlas/utils/Application.hpp>
 #include <atlas/utils/GUI.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <sstream>
+#include <thread>
 
-SnowFall::SnowFall()
+// Checkpoint sections written by the SnowFall.
+static const std::uint32_t kTagPositions = checkpointTag("FPOS");
+static const std::uint32_t kTagQuantizedPositions = checkpointTag("FPQ6");
+static const std::uint32_t kTagPositionBounds = checkpointTag("FPBB");
+static const std::uint32_t kTagVelocities = checkpointTag("FVEL");
+static const std::uint32_t kTagAccelerations = checkpointTag("FACC");
+static const std::uint32_t kTagMasses = checkpointTag("FMAS");
+static const std::uint32_t kTagRotations = checkpointTag("FROT");
+static const std::uint32_t kTagRandom = checkpointTag("FRNG");
+
+// Ranges covered by the quantized position and size of a SnowInstance.
+static const float kInstanceExtent = 16.0f;
+static const float kInstanceMaxSize = 0.1f;
+
+// Radius of the hexagon drawn for each flake, and the mass of a single
+// flake as it is spawned.
+static const float kFlakeRadius = 0.03f;
+static const float kFlakeMass = 0.0002f;
+
+// Heaviest clump flakes merge into, which is as large as an instance can be.
+static const float kMaxClumpMass = kFlakeMass * (kInstanceMaxSize / kFlakeRadius) *
+    (kInstanceMaxSize / kFlakeRadius) * (kInstanceMaxSize / kFlakeRadius);
+
+// Marks a flake that doesn't merge into another.
+static const std::uint32_t kNoPartner = 0xffffffff;
+
+// Marks a flake spawned after the spatial sort in progress took its keys.
+static const std::uint32_t kNewFlake = 0xffffffff;
+
+// Flakes are drawn as hexagons, as quads facing the camera further out,
+// and as points beyond. The quad has the area of the hexagon.
+static const int kBandCount = 3;
+static const float kQuadHalfSize = 0.806f;
+
+// Picks the band of a flake, only moving it to another band once it is
+// clearly past the edge so flakes near an edge do not flicker.
+static std::uint8_t selectBand(float distance, std::uint8_t band, float quadDistance, float pointDistance,
+    float margin)
+{
+    const float edges[] = { quadDistance, pointDistance };
+    while (band < kBandCount - 1 && distance > edges[band] + margin)
+    {
+        ++band;
+    }
+    while (band > 0 && distance < edges[band - 1] - margin)
+    {
+        --band;
+    }
+    return band;
+}
+
+// How far past the near field a simulated flake may drift before it is
+// settled, so flakes at its edge are not settled as soon as they spawn.
+static const float kNearMargin = 1.0f;
+
+// Steps a settled flake is walked down in, which are as long as the free
+// space around it within these limits.
+static const int kMaxSettleSteps = 500;
+static const float kMinSettleStep = 0.02f;
+static const float kMaxSettleStep = 0.5f;
+
+// Flakes tested against the frustum at once. The test is written over
+// plain arrays of this many so the compiler can turn it into vector code.
+static const int kCullBatch = 8;
+
+// Fewest flakes worth giving a thread of their own while culling.
+static const std::size_t kMinCullChunk = 16384;
+
+// Clumps are drawn and land with the radius of a ball of their mass.
+static float flakeRadius(float mass)
+{
+    return kFlakeRadius * std::cbrt(glm::max(mass, kFlakeMass) / kFlakeMass);
+}
+
+static std::int16_t quantizeSnorm(float value)
+{
+    return (std::int16_t)std::round(value * 32767.0f);
+}
+
+// A position stored as 16-bit steps across the bounding box of all flakes.
+struct QuantizedPosition
+{
+    std::uint16_t x, y, z, pad;
+};
+
+struct PositionBounds
+{
+    glm::vec3 origin;
+    glm::vec3 extent;
+};
+
+SnowFall::SnowFall() :
+    m_Shown(nullptr),
+    m_ShownCount(0),
+    m_ShownOrigin(0.0f),
+    m_CullEnabled(true),
+    m_CullTime(0.0f),
+    m_QuadDistance(6.0f),
+    m_PointDistance(18.0f),
+    m_LodMargin(0.5f),
+    m_Eye(0.0f, 0.0f, 20.0f),
+    m_DomainMin(-10.5f),
+    m_DomainMax(10.5f),
+    m_Wrap(false),
+    m_InstanceOrigin(0.0f),
+    m_NearField(false),
+    m_NearRadius(12.0f),
+    m_SettledCount(0),
+    m_SortEnabled(true),
+    m_SortInterval(60),
+    m_StepsSinceSort(0),
+    m_SortTime(0.0f),
+    m_SortElapsed(0.0f),
+    m_SortSteps(0),
+    m_SortStepCount(0),
+    m_ClumpEnabled(true),
+    m_Grid(2.0f * kInstanceMaxSize),
+    m_MergeCount(0),
+    m_ClumpTime(0.0f)
 {        
-    // Initialize snow map resolution and create a depth texture.
-    m_MapRes = 8192;
-    glGenTextures(1, &m_DepthTex);
-    glBindTexture(GL_TEXTURE_2D, m_DepthTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, m_MapRes, m_MapRes, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
-    
-    // Set texture parameters.
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-    const float borderShadow[] = { 2.0f, 2.0f, 2.0f, 2.0f };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderShadow);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    // Create and configure the framebuffer.
-    GLint currFBO;
-    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &currFBO);
-    glGenFramebuffers(1, &m_SnowFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, m_SnowFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_DepthTex, 0);
-    glClear(GL_DEPTH_BUFFER_BIT);
-
-    // Check framebuffer status.
-    GLenum FBOStat = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if (FBOStat != GL_FRAMEBUFFER_COMPLETE) {
-        fprintf(stderr, "glCheckFramebufferStatus: %x\n", FBOStat);
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // Build a unit hexagon that every flake is drawn from.
+    std::vector<glm::vec3> hexagonVertices;
+    for (int j = 0; j < 6; ++j)
+    {
+        float angle = static_cast<float>(j) * 60.0f * glm::pi<float>() / 180.0f;
+        hexagonVertices.push_back(glm::vec3(cos(angle), sin(angle), 0.0f));
+    }
+
+    // Then the quad, and the centre drawn as a point.
+    hexagonVertices.push_back(glm::vec3(-kQuadHalfSize, -kQuadHalfSize, 0.0f));
+    hexagonVertices.push_back(glm::vec3(kQuadHalfSize, -kQuadHalfSize, 0.0f));
+    hexagonVertices.push_back(glm::vec3(kQuadHalfSize, kQuadHalfSize, 0.0f));
+    hexagonVertices.push_back(glm::vec3(-kQuadHalfSize, kQuadHalfSize, 0.0f));
+    hexagonVertices.push_back(glm::vec3(0.0f));
+    const std::vector<GLuint> hexagonIndices = { 0, 1, 2, 0, 2, 3, 0, 3, 4, 0, 4, 5, 6, 7, 8, 6, 8, 9 };
 
     // Generate vertex arrays and buffers for snowfall geometry.
     glGenVertexArrays(1, &m_VAO);
     glGenBuffers(1, &m_PosBuff);
-    glGenBuffers(1, &m_ColBuff);
     glGenBuffers(1, &m_IdxBuff);
+    glGenBuffers(1, &m_InstBuff);
 
     glBindVertexArray(m_VAO);
 
-    // Buffer and set vertex attribute pointers for position and color.
+    // Buffer the hexagon and set the vertex attribute pointer for position.
     glBindBuffer(GL_ARRAY_BUFFER, m_PosBuff);
-    glBufferData(GL_ARRAY_BUFFER, 0, m_VertPos.data(), GL_DYNAMIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, 3 * hexagonVertices.size() * sizeof(GLfloat), hexagonVertices.data(), GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_ColBuff);
-    glBufferData(GL_ARRAY_BUFFER, 0, m_VertColors.data(), GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IdxBuff);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, hexagonIndices.size() * sizeof(GLuint), hexagonIndices.data(), GL_STATIC_DRAW);
 
-    glBindVertexArray(0);
+    // Per-flake position/size and rotation, advanced once per instance.
+    glBindBuffer(GL_ARRAY_BUFFER, m_InstBuff);
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 4, GL_SHORT, GL_TRUE, sizeof(SnowInstance), (GLvoid*)offsetof(SnowInstance, position));
+    glVertexAttribDivisor(4, 1);
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(5, 4, GL_SHORT, GL_TRUE, sizeof(SnowInstance), (GLvoid*)offsetof(SnowInstance, rotation));
+    glVertexAttribDivisor(5, 1);
 
-    // Load shaders for snow surface and falling snow.
-    std::vector<atlas::gl::ShaderUnit> su_Snow
+    glBindVertexArray(0);
+    m_InstanceCount = 0;
+    for (int band = 0; band < kBandCount; ++band)
     {
-        atlas::gl::ShaderUnit(generated::Shader::getShaderDirectory() + "/SnowSurface.vert", GL_VERTEX_SHADER),
-        atlas::gl::ShaderUnit(generated::Shader::getShaderDirectory() + "/SnowSurface.frag", GL_FRAGMENT_SHADER)
-    };
+        m_BandStarts[band] = 0;
+        m_BandCounts[band] = 0;
+    }
 
+    // Load shaders for falling snow.
     std::vector<atlas::gl::ShaderUnit> su
     {
         atlas::gl::ShaderUnit(generated::Shader::getShaderDirectory() + "/SnowFalling.vert", GL_VERTEX_SHADER),
         atlas::gl::ShaderUnit(generated::Shader::getShaderDirectory() + "/SnowFalling.frag", GL_FRAGMENT_SHADER)
     };
 
-    mShaders.push_back(atlas::gl::Shader(su_Snow));
     mShaders.push_back(atlas::gl::Shader(su));
 
     // Compile and link shaders.
     mShaders[0].compileShaders();
     mShaders[0].linkShaders();
-    mShaders[1].compileShaders();
-    mShaders[1].linkShaders();
 
-    // Initialize the snowflake size distribution.
-    m_SnowSizeDistr = std::normal_distribution<float>(0.0025f, 0.009f);
+    // Initialize the distributions for the random offset force.
+    m_OffsetDistr = std::normal_distribution<float>(0.0f, 0.0002f * 18.0f);
+    m_AngleDistr = std::uniform_real_distribution<float>(0.0f, (float)(2.0 * M_PI));
 }
 
 SnowFall::~SnowFall()
 {
 }
 
-void SnowFall::addSnow(std::unique_ptr<Snow> snowflake)
+void SnowFall::addSnow(Snow const &snowflake)
 {
-    m_Snowflakes.push_back(std::move(snowflake));
+    if (m_NearField)
+    {
+        SnowScene *scene = (SnowScene *)atlas::utils::Application::getInstance().getCurrentScene();
+        if (!isNear(snowflake.getPos(), scene->getCameraPosition(), 0.0f))
+        {
+            settle(snowflake.getPos(), snowflake.getMass());
+            return;
+        }
+    }
+
+    m_Positions.push_back(snowflake.getPos());
+    m_Velocities.push_back(snowflake.getVeloc());
+    m_Accelerations.push_back(snowflake.getAccel());
+    m_Masses.push_back(snowflake.getMass());
+    m_Rotations.push_back(glm::quat_cast(snowflake.getRotation()));
+    if (m_Sort.isSorting())
+    {
+        m_SortSources.push_back(kNewFlake);
+    }
 }
 
-void SnowFall::updateGeometry(atlas::core::Time<> const &t)
+int SnowFall::getSnowAmount() const
 {
-        // Clear previous vertex data.
-        m_VertPos.clear();
-        m_VertColors.clear();
-        mVertexIndices.clear();
+    return (int)m_Positions.size();
+}
 
-        int i = 0;
-        // Calculate hexagon vertices once.
-        std::vector<glm::vec3> hexagonVertices;
-        const float hexagonRadius = 0.03f; 
-        for (int j = 0; j < 6; ++j)
+void SnowFall::clear()
+{
+    m_Positions.clear();
+    m_Velocities.clear();
+    m_Accelerations.clear();
+    m_Masses.clear();
+    m_Rotations.clear();
+    m_Bands.clear();
+    m_Instances.clear();
+    m_InstanceBands.clear();
+    cancelSort();
+    showInstances(m_Instances.data(), 0, m_InstanceOrigin);
+}
+
+bool SnowFall::isNearFieldEnabled() const
+{
+    return m_NearField;
+}
+
+float SnowFall::getNearRadius() const
+{
+    return m_NearRadius;
+}
+
+bool SnowFall::isNear(glm::vec3 const &position, glm::vec3 const &camera, float margin) const
+{
+    glm::vec2 offset(position.x - camera.x, position.z - camera.z);
+    return glm::dot(offset, offset) < (m_NearRadius + margin) * (m_NearRadius + margin);
+}
+
+void SnowFall::settle(glm::vec3 position, float mass)
+{
+    SnowScene *scene = (SnowScene *)atlas::utils::Application::getInstance().getCurrentScene();
+    atlas::utils::DistanceField const &field = scene->getSurface().getDistanceField();
+    Terrain const &terrain = scene->getSurface().getTerrain();
+    WindField const &wind = scene->getWindField();
+    float radius = flakeRadius(mass);
+    ++m_SettledCount;
+
+    // Land on the scenery or the ground like a simulated flake would.
+    for (int step = 0; step < kMaxSettleSteps; ++step)
+    {
+        glm::vec3 gradient;
+        float distance = field.sample(position, gradient);
+        if (distance < radius)
+        {
+            position -= distance * gradient;
+            if (scene->getSnowVolume().isEnabled())
+            {
+                field.sample(position, gradient);
+                scene->getSnowVolume().deposit(position, gradient);
+                return;
+            }
+            break;
+        }
+
+        if (position.y < terrain.getHeight(position.x, position.z))
         {
-            float angle = static_cast<float>(j) * 60.0f * glm::pi<float>() / 180.0f;
-            float x = hexagonRadius * cos(angle);
-            float y = hexagonRadius * sin(angle);
-            hexagonVertices.push_back(glm::vec3(x, y, 0.0f));
+            break;
         }
 
-        // Inside the loop where you add snowflakes:
-        for (auto &snowFlake : m_Snowflakes)
+        glm::vec3 velocity = Snow::computeTerminalVelocity(wind.sample(position));
+        float speed = glm::length(velocity);
+        if (speed < 1e-3f)
         {
-            snowFlake->updateGeometry(t);
+            break;
+        }
+        position += velocity * (glm::clamp(distance - radius, kMinSettleStep, kMaxSettleStep) / speed);
+    }
+
+    scene->getSnowAccum().refreshNearestVert(position);
+}
+
+std::vector<SnowInstance> const &SnowFall::getInstances() const
+{
+    return m_Instances;
+}
+
+glm::vec3 SnowFall::getInstanceOrigin() const
+{
+    return m_InstanceOrigin;
+}
+
+void SnowFall::showInstances(SnowInstance const *instances, std::size_t count, glm::vec3 const &origin)
+{
+    m_Shown = instances;
+    m_ShownCount = count;
+    m_ShownOrigin = origin;
+}
 
-            // Calculate snowflake size using hexagonal distribution.
-            float snowflakeSize = m_SnowSizeDistr(m_Gen);
+void SnowFall::setDomain(glm::vec2 const &lo, glm::vec2 const &hi, bool wrap)
+{
+    m_DomainMin = lo;
+    m_DomainMax = hi;
+    m_Wrap = wrap;
+}
 
-            glm::vec3 snowflakePos = snowFlake->getPos();
+void SnowFall::cullInstances(glm::mat4 const &viewProj)
+{
+    atlas::core::Timer<float> timer;
+    timer.start();
 
-            for (const auto &vertex : hexagonVertices)
+    // The simulated flakes come with the bands picked on the last step.
+    // Anything else shown, like a cached frame, is banded by distance alone.
+    SnowInstance const *instances = m_Shown;
+    std::size_t count = m_ShownCount;
+    std::uint8_t const *bands =
+        instances == m_Instances.data() && count == m_InstanceBands.size() ? m_InstanceBands.data() : nullptr;
+
+    // The frustum planes, scaled to give the distance straight from the
+    // quantized positions and pushed out by the largest flake. With culling
+    // off every flake is inside.
+    float planeX[6], planeY[6], planeZ[6], planeW[6];
+    glm::mat4 rows = glm::transpose(viewProj);
+    glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2] };
+    for (int p = 0; p < 6; ++p)
+    {
+        float scale = m_CullEnabled ? 1.0f / glm::length(glm::vec3(planes[p])) : 0.0f;
+        planeX[p] = planes[p].x * scale * kInstanceExtent / 32767.0f;
+        planeY[p] = planes[p].y * scale * kInstanceExtent / 32767.0f;
+        planeZ[p] = planes[p].z * scale * kInstanceExtent / 32767.0f;
+        planeW[p] = (planes[p].w + glm::dot(glm::vec3(planes[p]), m_ShownOrigin)) * scale + kInstanceMaxSize;
+    }
+
+    glm::vec3 eye = (m_Eye - m_ShownOrigin) * (32767.0f / kInstanceExtent);
+    float quadDistance = m_QuadDistance * (32767.0f / kInstanceExtent);
+    float pointDistance = m_PointDistance * (32767.0f / kInstanceExtent);
+
+    // Every chunk packs its visible flakes to its own start with their
+    // bands, and the chunks are then scattered into one range per band.
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t chunk = std::max(kMinCullChunk, (count + threads - 1) / threads);
+    chunk = (chunk + kCullBatch - 1) / kCullBatch * kCullBatch;
+    std::size_t chunks = (count + chunk - 1) / chunk;
+    m_Visible.resize(count);
+    m_VisibleBands.resize(count);
+    m_CullCounts.assign((kBandCount + 1) * chunks, 0);
+    atlas::core::parallelFor(0, chunks, [&](std::size_t c)
+    {
+        std::size_t begin = c * chunk;
+        std::size_t end = std::min(begin + chunk, count);
+        SnowInstance *visible = &m_Visible[begin];
+        std::uint8_t *visibleBands = &m_VisibleBands[begin];
+        std::size_t *counts = &m_CullCounts[(kBandCount + 1) * c];
+        std::size_t found = 0;
+        for (std::size_t base = begin; base < end; base += kCullBatch)
+        {
+            // A short last batch repeats its last flake.
+            float x[kCullBatch], y[kCullBatch], z[kCullBatch];
+            int inside[kCullBatch], band[kCullBatch];
+            for (int k = 0; k < kCullBatch; ++k)
             {
-                glm::vec3 transformedVertex = snowflakePos + glm::vec3(glm::vec4(vertex, 0.0) * snowFlake->getRotation());
-                m_VertPos.push_back(transformedVertex);
-                m_VertColors.push_back(glm::vec3(1.0f, 1.0f, 1.0f)); // Color for the hexagonal snowflake
+                SnowInstance const &instance = instances[std::min(base + k, end - 1)];
+                x[k] = instance.position[0];
+                y[k] = instance.position[1];
+                z[k] = instance.position[2];
+                inside[k] = 1;
             }
 
-            // Define indices to create triangles for the hexagon.
-            const std::vector<GLuint> hexagonIndices = { 0, 1, 2, 0, 2, 3, 0, 3, 4, 0, 4, 5 };
-            GLuint baseIndex = 6 * i;
-            for (const auto &index : hexagonIndices)
+            for (int p = 0; p < 6; ++p)
             {
-                mVertexIndices.push_back(baseIndex + index);
+                for (int k = 0; k < kCullBatch; ++k)
+                {
+                    inside[k] &= planeX[p] * x[k] + planeY[p] * y[k] + planeZ[p] * z[k] + planeW[p] >= 0.0f;
+                }
             }
 
-            ++i;
+            for (int k = 0; k < kCullBatch && !bands; ++k)
+            {
+                float distance2 = (x[k] - eye.x) * (x[k] - eye.x) + (y[k] - eye.y) * (y[k] - eye.y) +
+                    (z[k] - eye.z) * (z[k] - eye.z);
+                band[k] = (distance2 > quadDistance * quadDistance) + (distance2 > pointDistance * pointDistance);
+            }
+
+            // Every flake is written, and only the visible ones are kept.
+            int batch = (int)std::min<std::size_t>(kCullBatch, end - base);
+            for (int k = 0; k < batch; ++k)
+            {
+                std::uint8_t flakeBand = bands ? bands[base + k] : (std::uint8_t)band[k];
+                visible[found] = instances[base + k];
+                visibleBands[found] = flakeBand;
+                counts[flakeBand] += inside[k];
+                found += inside[k];
+            }
         }
+        counts[kBandCount] = found;
+    });
 
+    // Turn the counts into where each chunk starts in each band, keeping
+    // the number each chunk found after them.
+    std::size_t drawn = 0;
+    for (int band = 0; band < kBandCount; ++band)
+    {
+        m_BandStarts[band] = drawn;
+        for (std::size_t c = 0; c < chunks; ++c)
+        {
+            std::size_t &slot = m_CullCounts[(kBandCount + 1) * c + band];
+            std::size_t found = slot;
+            slot = drawn;
+            drawn += found;
+        }
+        m_BandCounts[band] = (GLsizei)(drawn - m_BandStarts[band]);
+    }
 
-    glBindVertexArray(m_VAO);
+    m_Drawn.resize(drawn);
+    atlas::core::parallelFor(0, chunks, [&](std::size_t c)
+    {
+        std::size_t begin = c * chunk;
+        std::size_t *cursors = &m_CullCounts[(kBandCount + 1) * c];
+        std::size_t found = cursors[kBandCount];
+        for (std::size_t i = 0; i < found; ++i)
+        {
+            m_Drawn[cursors[m_VisibleBands[begin + i]]++] = m_Visible[begin + i];
+        }
+    });
 
-    // Buffer vertex data.
-    glBindBuffer(GL_ARRAY_BUFFER, m_PosBuff);
-    glBufferData(GL_ARRAY_BUFFER, 3 * m_VertPos.size() * sizeof(GLfloat), m_VertPos.data(), GL_DYNAMIC_DRAW);
+    // Orphan the old storage so the driver does not wait on the last draw.
+    glBindBuffer(GL_ARRAY_BUFFER, m_InstBuff);
+    glBufferData(GL_ARRAY_BUFFER, drawn * sizeof(SnowInstance), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, drawn * sizeof(SnowInstance), m_Drawn.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_ColBuff);
-    glBufferData(GL_ARRAY_BUFFER, 3 * m_VertColors.size() * sizeof(GLfloat), m_VertColors.data(), GL_DYNAMIC_DRAW);
+    m_InstanceCount = (GLsizei)drawn;
+    m_CullTime = timer.elapsed();
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IdxBuff);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mVertexIndices.size() * sizeof(GLint), mVertexIndices.data(), GL_DYNAMIC_DRAW);
+glm::vec3 SnowFall::computeOffset()
+{
+    float radOffset = std::fabs(m_OffsetDistr(m_Gen));
+    float theta = m_AngleDistr(m_Gen);
+    return radOffset * glm::vec3(cos(theta), 0.0f, sin(theta));
+}
 
-    glBindVertexArray(0);
+void SnowFall::sortBySpace()
+{
+    atlas::core::Timer<float> timer;
+    timer.start();
+
+    // Keys cover the instance extent around the instance origin, where the
+    // flakes are, even when the domain follows the camera. Every flake is
+    // tracked by its index at that point while the sort runs.
+    if (!m_Sort.isSorting())
+    {
+        if (++m_StepsSinceSort < m_SortInterval)
+        {
+            return;
+        }
+
+        m_Sort.start(m_Positions.data(), m_Positions.size(), m_InstanceOrigin, kInstanceExtent);
+        m_SortSources.resize(m_Positions.size());
+        for (std::size_t i = 0; i < m_SortSources.size(); ++i)
+        {
+            m_SortSources[i] = (std::uint32_t)i;
+        }
+        m_SortElapsed = timer.elapsed();
+        m_SortSteps = 1;
+        return;
+    }
 
-    // Remove snow that is below the threshold
-    m_Snowflakes.erase(std::remove_if(
-    m_Snowflakes.begin(), m_Snowflakes.end(),
-    [](const std::unique_ptr<Snow> &snowflake) {
-        return snowflake->getPos().y < 0;
-    }),
-    m_Snowflakes.end());
+    ++m_SortSteps;
+    if (!m_Sort.step())
+    {
+        m_SortElapsed += timer.elapsed();
+        return;
+    }
 
+    // Flakes removed since the keys were taken are left out of the order,
+    // and flakes spawned since go after the sorted ones as they are.
+    std::vector<std::uint32_t> const &sorted = m_Sort.getOrder();
+    m_SortTargets.assign(sorted.size(), kNewFlake);
+    for (std::size_t i = 0; i < m_SortSources.size(); ++i)
+    {
+        if (m_SortSources[i] != kNewFlake)
+        {
+            m_SortTargets[m_SortSources[i]] = (std::uint32_t)i;
+        }
+    }
+
+    m_SortOrder.clear();
+    for (std::uint32_t source : sorted)
+    {
+        if (m_SortTargets[source] != kNewFlake)
+        {
+            m_SortOrder.push_back(m_SortTargets[source]);
+        }
+    }
+    for (std::size_t i = 0; i < m_SortSources.size(); ++i)
+    {
+        if (m_SortSources[i] == kNewFlake)
+        {
+            m_SortOrder.push_back((std::uint32_t)i);
+        }
+    }
+
+    // The instances are rebuilt from these arrays every step, so the
+    // stream sent to the GPU follows the new order as well.
+    permute(m_Positions);
+    permute(m_Velocities);
+    permute(m_Accelerations);
+    permute(m_Masses);
+    permute(m_Rotations);
+    permute(m_Bands);
+
+    m_Sort.reset();
+    m_SortSources.clear();
+    m_StepsSinceSort = 0;
+    m_SortTime = m_SortElapsed + timer.elapsed();
+    m_SortStepCount = m_SortSteps;
 }
 
+template <typename T>
+void SnowFall::permute(std::vector<T> &values) const
+{
+    std::vector<T> sorted(values.size());
+    atlas::core::parallelFor(0, values.size(), [&](std::size_t i)
+    {
+        sorted[i] = values[m_SortOrder[i]];
+    });
+    values.swap(sorted);
+}
 
-void SnowFall::renderGeometry(atlas::math::Matrix4 const &projection, atlas::math::Matrix4 const &view)
+void SnowFall::cancelSort()
+{
+    m_Sort.reset();
+    m_SortSources.clear();
+}
+
+void SnowFall::moveFlake(std::size_t from, std::size_t to)
 {
-    // Render snow surface.
+    m_Positions[to] = m_Positions[from];
+    m_Velocities[to] = m_Velocities[from];
+    m_Accelerations[to] = m_Accelerations[from];
+    m_Masses[to] = m_Masses[from];
+    m_Rotations[to] = m_Rotations[from];
+    m_Bands[to] = m_Bands[from];
+    if (m_Sort.isSorting())
     {
-    // Store the current viewport.
-    GLint m_viewport[4];
-    glGetIntegerv(GL_VIEWPORT, m_viewport);
+        m_SortSources[to] = m_SortSources[from];
+    }
+}
 
-    // Enable the snow surface shader.
-    mShaders[0].enableShaders();
-    
-    // Bind the snow framebuffer and clear the depth buffer.
-    glBindFramebuffer(GL_FRAMEBUFFER, m_SnowFBO);
-    glClearDepth(1.0f);
-    glClear(GL_DEPTH_BUFFER_BIT);
-    glViewport(0, 0, m_MapRes, m_MapRes);
-    glEnable(GL_DEPTH_TEST);
-
-    // Enable polygon offset for shadow mapping.
-    glEnable(GL_POLYGON_OFFSET_FILL);
-
-    // Set up the view and projection matrices for the skybox.
-    glm::mat4 viewSky = glm::lookAt(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    glm::mat4 projSky = glm::ortho(-10.0f, 10.0f, -10.0f, 10.0f, 0.01f, 100.0f);            
-    glm::mat4 m_ViewProj = projSky * viewSky * mModel;
-
-    // Set shader uniforms.
-    const GLint MODEL_VIEW_PROJECTION_UNIFORM_LOCATION = glGetUniformLocation(mShaders[0].getShaderProgram(), "ModelViewProjection");
-    glUniformMatrix4fv(MODEL_VIEW_PROJECTION_UNIFORM_LOCATION, 1, GL_FALSE, &m_ViewProj[0][0]);
+void SnowFall::resizeFlakes(std::size_t count)
+{
+    m_Positions.resize(count);
+    m_Velocities.resize(count);
+    m_Accelerations.resize(count);
+    m_Masses.resize(count);
+    m_Rotations.resize(count);
+    m_Bands.resize(count);
+    if (m_Sort.isSorting())
+    {
+        m_SortSources.resize(count);
+    }
+}
 
-    const GLint MODEL_UNIFORM_LOCATION = glGetUniformLocation(mShaders[0].getShaderProgram(), "Model");
-    glUniformMatrix4fv(MODEL_UNIFORM_LOCATION, 1, GL_FALSE, &mModel[0][0]);
+void SnowFall::clump()
+{
+    atlas::core::Timer<float> timer;
+    timer.start();
 
-    // Bind vertex array and draw the snow surface.
-    glBindVertexArray(m_VAO);  
-    glDrawElements(GL_TRIANGLES, mVertexIndices.size(), GL_UNSIGNED_INT, (void *) 0);
-    glBindVertexArray(0);
+    std::size_t count = m_Positions.size();
+    m_Grid.build(m_Positions.data(), count);
 
-    // Disable the snow surface shader.
-    mShaders[0].disableShaders();
-    
-    // Disable polygon offset.
-    glPolygonOffset(0.0f, 0.0f);        
-    glDisable(GL_POLYGON_OFFSET_FILL);
+    // Every flake picks the nearest lower numbered flake it touches, so
+    // each touching pair is only looked at from one side.
+    m_Partners.resize(count);
+    atlas::core::parallelFor(0, count, [&](std::size_t i)
+    {
+        glm::vec3 position = m_Positions[i];
+        float radius = flakeRadius(m_Masses[i]);
+        float reach = radius + kInstanceMaxSize;
+        float nearest = 0.0f;
+        std::uint32_t partner = kNoPartner;
+        m_Grid.forEachNear(position, reach, [&](std::uint32_t j, glm::vec3 const &other)
+        {
+            float distance2 = glm::dot(other - position, other - position);
+            if (j >= i || distance2 >= reach * reach || m_Masses[i] + m_Masses[j] > kMaxClumpMass)
+            {
+                return;
+            }
+
+            float distance = std::sqrt(distance2);
+            if (distance < radius + flakeRadius(m_Masses[j]) &&
+                (partner == kNoPartner || distance < nearest || (distance == nearest && j < partner)))
+            {
+                nearest = distance;
+                partner = j;
+            }
+        });
+        m_Partners[i] = partner;
+    });
+
+    // Only merge into flakes that stay where they are on this step, so no
+    // chains form. Momentum is kept, and the clump sits at the centre of
+    // mass with the orientation of the flake it grew from.
+    m_MergeCount = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        std::uint32_t p = m_Partners[i];
+        if (p == kNoPartner)
+        {
+            continue;
+        }
+
+        float mass = m_Masses[p] + m_Masses[i];
+        if (m_Partners[p] != kNoPartner || mass > kMaxClumpMass)
+        {
+            m_Partners[i] = kNoPartner;
+            continue;
+        }
+
+        float weight = m_Masses[i] / mass;
+        m_Positions[p] = glm::mix(m_Positions[p], m_Positions[i], weight);
+        m_Velocities[p] = glm::mix(m_Velocities[p], m_Velocities[i], weight);
+        m_Accelerations[p] = glm::mix(m_Accelerations[p], m_Accelerations[i], weight);
+        m_Masses[p] = mass;
+        ++m_MergeCount;
+    }
+
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (m_Partners[i] != kNoPartner)
+        {
+            continue;
+        }
+
+        moveFlake(i, kept++);
+    }
+    resizeFlakes(kept);
+
+    m_ClumpTime = timer.elapsed();
+}
+
+void SnowFall::updateGeometry(atlas::core::Time<> const &t)
+{
+    float deltaTime = t.deltaTime;
+    SnowScene *scene = (SnowScene*)atlas::utils::Application::getInstance().getCurrentScene();
+
+    // Flakes added since the last step start out in the nearest band.
+    m_Bands.resize(m_Positions.size(), 0);
+
+    // Wind scatters the flakes, so every so often put them back in spatial
+    // order for the lookups below. The sort is spread over several steps.
+    if (m_SortEnabled)
+    {
+        sortBySpace();
+    }
+    else
+    {
+        cancelSort();
+    }
+
+    m_Winds.resize(m_Positions.size());
+    scene->getWindField().sample(m_Positions.data(), m_Positions.size(), m_Winds.data());
+
+    // Integrate every flake.
+    for (std::size_t i = 0; i < m_Positions.size(); ++i)
+    {
+        float mass = m_Masses[i];
+        glm::vec3 wind = m_Winds[i];
+        glm::vec3 velocity = m_Velocities[i];
+        glm::vec3 acceleration = m_Accelerations[i];
 
-    // Restore the original framebuffer and viewport.
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);     
-    glViewport(m_viewport[0], m_viewport[1], m_viewport[2], m_viewport[3]);
+        // Compute the new pos by Runge-Kutta Order 4.
+        glm::vec3 v1 = deltaTime * velocity;
+        glm::vec3 v2 = deltaTime * (velocity + acceleration * 0.5f * deltaTime);
+        glm::vec3 v3 = deltaTime * (velocity + acceleration * 0.5f * deltaTime);
+        glm::vec3 v4 = deltaTime * (velocity + acceleration * deltaTime);
+        glm::vec3 newPosition = m_Positions[i] + (1.0f / 6.0f) * (v1 + 2.0f * v2 + 2.0f * v3 + v4);
+
+        // Compute the new velocity by Runge-Kutta Order 4. Every stage draws
+        // a fresh random offset force.
+        glm::vec3 a1 = deltaTime * Snow::computeAcceleration(velocity, mass, wind, computeOffset());
+        glm::vec3 a2 = deltaTime * Snow::computeAcceleration(velocity, mass, wind, computeOffset());
+        glm::vec3 a3 = deltaTime * Snow::computeAcceleration(velocity, mass, wind, computeOffset());
+        glm::vec3 a4 = deltaTime * Snow::computeAcceleration(velocity, mass, wind, computeOffset());
+        glm::vec3 newVelocity = velocity + (1.0f / 6.0f) * (a1 + 2.0f * a2 + 2.0f * a3 + a4);
+
+        // Update acceleration so that we use it to compute velocity
+        // the next time we execute Runge-Kutta.
+        m_Accelerations[i] = (newVelocity - velocity) / deltaTime;
+        m_Positions[i] = newPosition;
+        m_Velocities[i] = newVelocity;
     }
 
-    // Render falling snow.
+    // Flakes leaving the domain through a side come back in through the
+    // opposite one, however far the domain moved since the last step.
+    glm::vec2 size = m_DomainMax - m_DomainMin;
+    if (m_Wrap && size.x > 0.0f && size.y > 0.0f)
     {
+        for (auto &position : m_Positions)
+        {
+            position.x -= size.x * std::floor((position.x - m_DomainMin.x) / size.x);
+            position.z -= size.y * std::floor((position.z - m_DomainMin.y) / size.y);
+        }
+    }
+    m_InstanceOrigin = glm::vec3(0.5f * (m_DomainMin.x + m_DomainMax.x), 0.0f, 0.5f * (m_DomainMin.y + m_DomainMax.y));
+
+    if (m_ClumpEnabled)
+    {
+        clump();
+    }
+
+    // Land every flake that touches the dome or a prop, projecting it onto
+    // the surface along the distance gradient.
+    atlas::utils::DistanceField const &field = scene->getSurface().getDistanceField();
+    m_Landed.resize(m_Positions.size());
+    for (std::size_t i = 0; i < m_Positions.size(); ++i)
+    {
+        glm::vec3 gradient;
+        float distance = field.sample(m_Positions[i], gradient);
+        m_Landed[i] = distance < flakeRadius(m_Masses[i]);
+        if (m_Landed[i])
+        {
+            m_Positions[i] -= distance * gradient;
+        }
+    }
+
+    // Pack the flakes into instances for drawing, and pick how each is
+    // drawn from its distance to the camera on the last frame.
+    m_Instances.resize(m_Positions.size());
+    m_InstanceBands.resize(m_Positions.size());
+    for (std::size_t i = 0; i < m_Positions.size(); ++i)
+    {
+        // The flakes were oriented by v * R, which is the inverse rotation.
+        glm::quat rotation = glm::conjugate(m_Rotations[i]);
+        glm::vec3 position = glm::clamp((m_Positions[i] - m_InstanceOrigin) / kInstanceExtent, -1.0f, 1.0f);
+
+        SnowInstance &instance = m_Instances[i];
+        instance.position[0] = quantizeSnorm(position.x);
+        instance.position[1] = quantizeSnorm(position.y);
+        instance.position[2] = quantizeSnorm(position.z);
+        instance.size = quantizeSnorm(flakeRadius(m_Masses[i]) / kInstanceMaxSize);
+        instance.rotation[0] = quantizeSnorm(rotation.x);
+        instance.rotation[1] = quantizeSnorm(rotation.y);
+        instance.rotation[2] = quantizeSnorm(rotation.z);
+        instance.rotation[3] = quantizeSnorm(rotation.w);
+
+        m_Bands[i] = selectBand(glm::distance(m_Positions[i], m_Eye), m_Bands[i], m_QuadDistance, m_PointDistance,
+            m_LodMargin);
+        m_InstanceBands[i] = m_Bands[i];
+    }
+    showInstances(m_Instances.data(), m_Instances.size(), m_InstanceOrigin);
+
+    // Remove snow that is below the threshold or has landed on something
+    // and deposit it on the ground, or on the scenery it landed on.
+    SnowAccum &accum = scene->getSnowAccum();
+    SnowVolume &volume = scene->getSnowVolume();
+    Terrain const &terrain = scene->getSurface().getTerrain();
+    glm::vec3 camera = scene->getCameraPosition();
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < m_Positions.size(); ++i)
+    {
+        bool below = m_Positions[i].y < terrain.getHeight(m_Positions[i].x, m_Positions[i].z);
+        if (m_Landed[i] && !below && volume.isEnabled())
+        {
+            glm::vec3 gradient;
+            field.sample(m_Positions[i], gradient);
+            volume.deposit(m_Positions[i], gradient);
+            continue;
+        }
+
+        if (below || m_Landed[i])
+        {
+            accum.refreshNearestVert(m_Positions[i]);
+            continue;
+        }
+
+        // Flakes that drift out of the near field are left to the impostor
+        // layers from here on.
+        if (m_NearField && !isNear(m_Positions[i], camera, kNearMargin))
+        {
+            settle(m_Positions[i], m_Masses[i]);
+            continue;
+        }
+
+        moveFlake(i, kept++);
+    }
+    resizeFlakes(kept);
+}
+
+void SnowFall::renderGeometry(atlas::math::Matrix4 const &projection, atlas::math::Matrix4 const &view)
+{
     // Enable the falling snow shader.
-    mShaders[1].enableShaders();
+    mShaders[0].enableShaders();
     
     // Set up the model-view-projection matrix for falling snow.
     glm::mat4 m_ViewProj = projection * view * mModel;
-    const GLint MODEL_VIEW_PROJECTION_UNIFORM_LOCATION = glGetUniformLocation(mShaders[1].getShaderProgram(), "ModelViewProjection");
+
+    // Only the flakes in view are uploaded and drawn, sorted into bands by
+    // their distance to the camera.
+    glm::mat4 modelView = view * mModel;
+    m_Eye = glm::vec3(glm::inverse(modelView)[3]);
+    cullInstances(m_ViewProj);
+
+    const GLint MODEL_VIEW_PROJECTION_UNIFORM_LOCATION = glGetUniformLocation(mShaders[0].getShaderProgram(), "ModelViewProjection");
     glUniformMatrix4fv(MODEL_VIEW_PROJECTION_UNIFORM_LOCATION, 1, GL_FALSE, &m_ViewProj[0][0]);      
 
-    // Bind vertex array and draw falling snow.
-    glBindVertexArray(m_VAO);        
-    glDrawElements(GL_TRIANGLES, mVertexIndices.size(), GL_UNSIGNED_INT, (void *) 0);
+    const GLint INSTANCE_SCALE_UNIFORM_LOCATION = glGetUniformLocation(mShaders[0].getShaderProgram(), "InstanceScale");
+    glUniform4f(INSTANCE_SCALE_UNIFORM_LOCATION, kInstanceExtent, kInstanceExtent, kInstanceExtent, kInstanceMaxSize);
+    glUniform3fv(glGetUniformLocation(mShaders[0].getShaderProgram(), "InstanceOrigin"), 1, &m_ShownOrigin[0]);
+
+    // Quads face the camera, and points are as large on screen as the flake.
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLuint program = mShaders[0].getShaderProgram();
+    glUniform3f(glGetUniformLocation(program, "CameraRight"), modelView[0][0], modelView[1][0], modelView[2][0]);
+    glUniform3f(glGetUniformLocation(program, "CameraUp"), modelView[0][1], modelView[1][1], modelView[2][1]);
+    glUniform1f(glGetUniformLocation(program, "PointScale"), 0.5f * viewport[3] * projection[1][1]);
+    const GLint LOD_BAND_UNIFORM_LOCATION = glGetUniformLocation(program, "LodBand");
+
+    // Bind vertex array and draw falling snow, one instanced draw per band
+    // with the instance data pointed at the band's range.
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glBindVertexArray(m_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_InstBuff);
+    for (int band = 0; band < kBandCount; ++band)
+    {
+        if (m_BandCounts[band] == 0)
+        {
+            continue;
+        }
+
+        std::size_t start = m_BandStarts[band] * sizeof(SnowInstance);
+        glVertexAttribPointer(4, 4, GL_SHORT, GL_TRUE, sizeof(SnowInstance),
+            (GLvoid*)(start + offsetof(SnowInstance, position)));
+        glVertexAttribPointer(5, 4, GL_SHORT, GL_TRUE, sizeof(SnowInstance),
+            (GLvoid*)(start + offsetof(SnowInstance, rotation)));
+        glUniform1i(LOD_BAND_UNIFORM_LOCATION, band);
+
+        if (band == 0)
+        {
+            glDrawElementsInstanced(GL_TRIANGLES, 12, GL_UNSIGNED_INT, (void *) 0, m_BandCounts[band]);
+        }
+        else if (band == 1)
+        {
+            glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, (void *)(12 * sizeof(GLuint)), m_BandCounts[band]);
+        }
+        else
+        {
+            glDrawArraysInstanced(GL_POINTS, 10, 1, m_BandCounts[band]);
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0); 
+    glDisable(GL_PROGRAM_POINT_SIZE);
 
     // Disable the falling snow shader.
-    mShaders[1].disableShaders();
+    mShaders[0].disableShaders();
+}
+
+void SnowFall::drawGui()
+{
+    ImGui::SetNextWindowSize(ImVec2(300, 320), ImGuiSetCond_FirstUseEver);
+
+    // Create an ImGui window for the falling snow options.
+    ImGui::Begin("Snow Fall Options");
+    ImGui::Checkbox("Spatial Sort", &m_SortEnabled);
+    ImGui::SliderInt("Sort Interval", &m_SortInterval, 1, 240);
+    ImGui::Text("Last sort %.3f ms over %d steps", m_SortTime * 1000.0f, m_SortStepCount);
+    ImGui::Checkbox("Clumping", &m_ClumpEnabled);
+    ImGui::Text("%d merges in %.3f ms", m_MergeCount, m_ClumpTime * 1000.0f);
+    ImGui::Checkbox("Frustum Culling", &m_CullEnabled);
+    ImGui::Text("%d of %d drawn, culled in %.3f ms", (int)m_InstanceCount, (int)m_ShownCount, m_CullTime * 1000.0f);
+    ImGui::SliderFloat("Quad Distance", &m_QuadDistance, 0.0f, 40.0f);
+    ImGui::SliderFloat("Point Distance", &m_PointDistance, 0.0f, 60.0f);
+    ImGui::SliderFloat("LOD Hysteresis", &m_LodMargin, 0.0f, 5.0f);
+    ImGui::Text("%d hexagons, %d quads, %d points", (int)m_BandCounts[0], (int)m_BandCounts[1], (int)m_BandCounts[2]);
+    ImGui::Checkbox("Near Field Only", &m_NearField);
+    ImGui::SliderFloat("Near Radius", &m_NearRadius, 2.0f, 30.0f);
+    ImGui::Text("%d flakes settled outside the near field", m_SettledCount);
+    ImGui::End();
+}
+
+void SnowFall::saveState(CheckpointWriter &writer) const
+{
+    if (writer.getFlags() & kCheckpointQuantized)
+    {
+        // Quantize the positions against their bounding box.
+        PositionBounds bounds = { glm::vec3(0.0f), glm::vec3(0.0f) };
+        if (!m_Positions.empty())
+        {
+            glm::vec3 lo = m_Positions[0], hi = m_Positions[0];
+            for (auto const &pos : m_Positions)
+            {
+                lo = glm::min(lo, pos);
+                hi = glm::max(hi, pos);
+            }
+            bounds.origin = lo;
+            bounds.extent = hi - lo;
+        }
+
+        glm::vec3 scale = 65535.0f / glm::max(bounds.extent, glm::vec3(1e-6f));
+        std::vector<QuantizedPosition> quantized(m_Positions.size());
+        for (std::size_t i = 0; i < m_Positions.size(); ++i)
+        {
+            glm::vec3 q = glm::round((m_Positions[i] - bounds.origin) * scale);
+            quantized[i] = { (std::uint16_t)q.x, (std::uint16_t)q.y, (std::uint16_t)q.z, 0 };
+        }
+
+        writer.writeValue(kTagPositionBounds, bounds);
+        writer.writeSection(kTagQuantizedPositions, quantized);
+    }
+    else
+    {
+        writer.writeSection(kTagPositions, m_Positions);
+    }
+
+    writer.writeSection(kTagVelocities, m_Velocities);
+    writer.writeSection(kTagAccelerations, m_Accelerations);
+    writer.writeSection(kTagMasses, m_Masses);
+    writer.writeSection(kTagRotations, m_Rotations);
+
+    // The random state is only available in its text form.
+    std::ostringstream random;
+    random << m_Gen << ' ' << m_OffsetDistr << ' ' << m_AngleDistr;
+    std::string text = random.str();
+    writer.writeSection(kTagRandom, 1, text.size(), text.data());
+}
+
+bool SnowFall::checkState(CheckpointReader const &reader) const
+{
+    // Every array has to be there with one entry per flake.
+    std::size_t count, n;
+    if (reader.getFlags() & kCheckpointQuantized)
+    {
+        PositionBounds bounds;
+        if (!reader.readValue(kTagPositionBounds, bounds) ||
+            !reader.findSection(kTagQuantizedPositions, sizeof(QuantizedPosition), count))
+        {
+            return false;
+        }
+    }
+    else if (!reader.findSection(kTagPositions, sizeof(glm::vec3), count))
+    {
+        return false;
     }
+
+    return reader.findSection(kTagVelocities, sizeof(glm::vec3), n) && n == count &&
+        reader.findSection(kTagAccelerations, sizeof(glm::vec3), n) && n == count &&
+        reader.findSection(kTagMasses, sizeof(float), n) && n == count &&
+        reader.findSection(kTagRotations, sizeof(glm::quat), n) && n == count;
 }
 
-GLuint SnowFall::getSnowDepthTexture() const
+bool SnowFall::loadState(CheckpointReader const &reader)
 {
-    return m_DepthTex;
-}
\ No newline at end of file
+    std::vector<glm::vec3> positions, velocities, accelerations;
+    std::vector<float> masses;
+    std::vector<glm::quat> rotations;
+
+    if (reader.getFlags() & kCheckpointQuantized)
+    {
+        PositionBounds bounds;
+        std::vector<QuantizedPosition> quantized;
+        if (!reader.readValue(kTagPositionBounds, bounds) ||
+            !reader.readSection(kTagQuantizedPositions, quantized))
+        {
+            return false;
+        }
+
+        glm::vec3 step = bounds.extent / 65535.0f;
+        positions.resize(quantized.size());
+        for (std::size_t i = 0; i < quantized.size(); ++i)
+        {
+            positions[i] = bounds.origin + step * glm::vec3(quantized[i].x, quantized[i].y, quantized[i].z);
+        }
+    }
+    else if (!reader.readSection(kTagPositions, positions))
+    {
+        return false;
+    }
+
+    if (!reader.readSection(kTagVelocities, velocities) ||
+        !reader.readSection(kTagAccelerations, accelerations) ||
+        !reader.readSection(kTagMasses, masses) ||
+        !reader.readSection(kTagRotations, rotations))
+    {
+        return false;
+    }
+
+    std::size_t count = positions.size();
+    if (velocities.size() != count || accelerations.size() != count ||
+        masses.size() != count || rotations.size() != count)
+    {
+        return false;
+    }
+
+    std::size_t textSize;
+    const char *text = (const char *)reader.findSection(kTagRandom, 1, textSize);
+    if (text)
+    {
+        std::istringstream random(std::string(text, textSize));
+        random >> m_Gen >> m_OffsetDistr >> m_AngleDistr;
+    }
+
+    m_Positions.swap(positions);
+    m_Velocities.swap(velocities);
+    m_Accelerations.swap(accelerations);
+    m_Masses.swap(masses);
+    m_Rotations.swap(rotations);
+    m_Bands.assign(count, 0);
+    cancelSort();
+    return true;
+}
@@ -0,0 +1,247 @@
+#include "SnowImpostor.hpp"
+#include "SnowScene.hpp"
+#include "Shader.hpp"
+#include <atlas/math/RandomGenerator.hpp>
+#include <atlas/utils/Application.hpp>
+#include <atlas/utils/GUI.hpp>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+
+// Side of the square of snow one copy of the texture covers, in metres,
+// and its resolution.
+static const float kTileSize = 6.0f;
+static const int kTextureSize = 512;
+
+// Flakes in the densest level, and the number of levels, each holding half
+// the flakes of the next.
+static const int kMaxFlakes = 8192;
+static const int kLevelCount = 10;
+
+// Radius of a single flake, as the SnowFall draws it.
+static const float kFlakeRadius = 0.03f;
+
+// Segments around the cylinders, and how far below the camera they reach.
+static const int kSegments = 128;
+static const float kLayerDepth = 100.0f;
+
+// Period over which the sideways drift is blended back to its start, which
+// bounds how far the drift can shear the texture around the cylinders.
+static const float kDriftPeriod = 4.0f;
+
+SnowImpostor::SnowImpostor() :
+    m_Time(0.0f),
+    m_LayerCount(4),
+    m_DensityScale(1.0f)
+{
+    createTexture();
+    createMesh();
+    loadAndCompileShaders();
+}
+
+SnowImpostor::~SnowImpostor()
+{
+    glDeleteTextures(1, &m_Texture);
+    glDeleteBuffers(1, &m_VertexBuffer);
+    glDeleteVertexArrays(1, &m_VAO);
+}
+
+void SnowImpostor::createTexture()
+{
+    // Flakes at random places in the tile, the first ones in every level.
+    atlas::math::RandomGenerator<float> random(11);
+    std::vector<glm::vec2> flakes(kMaxFlakes);
+    random.fillUniform(&flakes[0].x, 2 * kMaxFlakes, 0.0f, (float)kTextureSize);
+
+    float radius = kFlakeRadius / kTileSize * kTextureSize;
+    int reach = (int)std::ceil(radius + 1.0f);
+    std::vector<unsigned char> levels((std::size_t)kLevelCount * kTextureSize * kTextureSize, 0);
+    for (int level = 0; level < kLevelCount; ++level)
+    {
+        unsigned char *texels = &levels[(std::size_t)level * kTextureSize * kTextureSize];
+        int count = kMaxFlakes >> (kLevelCount - 1 - level);
+        for (int i = 0; i < count; ++i)
+        {
+            // Discs with a soft edge, wrapped so the tile repeats.
+            glm::vec2 centre = flakes[i];
+            for (int y = (int)centre.y - reach; y <= (int)centre.y + reach; ++y)
+            {
+                for (int x = (int)centre.x - reach; x <= (int)centre.x + reach; ++x)
+                {
+                    float distance = glm::length(glm::vec2(x + 0.5f, y + 0.5f) - centre);
+                    float coverage = glm::clamp(radius + 0.5f - distance, 0.0f, 1.0f);
+                    unsigned char &texel = texels[((y + kTextureSize) % kTextureSize) * kTextureSize +
+                        (x + kTextureSize) % kTextureSize];
+                    texel = std::max(texel, (unsigned char)(coverage * 255.0f));
+                }
+            }
+        }
+    }
+
+    glGenTextures(1, &m_Texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_Texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R8, kTextureSize, kTextureSize, kLevelCount, 0, GL_RED, GL_UNSIGNED_BYTE,
+        levels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void SnowImpostor::createMesh()
+{
+    // A unit cylinder as a strip: the fraction of the way around, and
+    // bottom or top.
+    std::vector<glm::vec2> vertices;
+    for (int i = 0; i <= kSegments; ++i)
+    {
+        vertices.push_back(glm::vec2((float)i / kSegments, 0.0f));
+        vertices.push_back(glm::vec2((float)i / kSegments, 1.0f));
+    }
+    m_VertexCount = (GLsizei)vertices.size();
+
+    glGenVertexArrays(1, &m_VAO);
+    glGenBuffers(1, &m_VertexBuffer);
+    glBindVertexArray(m_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_VertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), vertices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (GLvoid *)0);
+    glBindVertexArray(0);
+}
+
+void SnowImpostor::updateGeometry(atlas::core::Time<> const &t)
+{
+    m_Time = (float)t.totalTime;
+}
+
+void SnowImpostor::renderGeometry(atlas::math::Matrix4 const &projection, atlas::math::Matrix4 const &view)
+{
+    SnowScene *scene = (SnowScene *)atlas::utils::Application::getInstance().getCurrentScene();
+    SnowFall const &snowFall = scene->getSnowFall();
+    SnowfallGenerator const &generator = scene->getGenerator();
+    if (!snowFall.isNearFieldEnabled())
+    {
+        return;
+    }
+
+    // Flakes per cubic metre: the flakes spawned per second and square
+    // metre, over how fast they fall.
+    glm::vec3 boxMin = generator.getBBoxMin(), boxMax = generator.getBBoxMax();
+    glm::vec3 drift = Snow::computeTerminalVelocity(scene->getForceWind());
+    float area = (boxMax.x - boxMin.x) * (boxMax.z - boxMin.z);
+    float density = drift.y < 0.0f && area > 0.0f ? generator.getRate() / area / -drift.y : 0.0f;
+
+    // Shells from the edge of the near field out to the far corner of the
+    // spawn box.
+    glm::mat4 modelView = view * mModel;
+    glm::vec3 eye(glm::inverse(modelView)[3]);
+    float farthest = 0.0f;
+    for (int corner = 0; corner < 4; ++corner)
+    {
+        glm::vec2 p((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.z : boxMin.z);
+        farthest = std::max(farthest, glm::distance(p, glm::vec2(eye.x, eye.z)));
+    }
+    float nearRadius = snowFall.getNearRadius();
+    if (farthest <= nearRadius || density <= 0.0f)
+    {
+        return;
+    }
+    float slab = (farthest - nearRadius) / m_LayerCount;
+
+    // The way the camera faces, so the texture wraps around behind it.
+    glm::vec2 forward(-modelView[0][2], -modelView[2][2]);
+    forward = glm::length(forward) > 1e-4f ? glm::normalize(forward) : glm::vec2(1.0f, 0.0f);
+
+    mShaders[0].enableShaders();
+
+    GLuint program = mShaders[0].getShaderProgram();
+    glm::mat4 viewProj = projection * modelView;
+    glUniformMatrix4fv(glGetUniformLocation(program, "ModelViewProjection"), 1, GL_FALSE, &viewProj[0][0]);
+    glUniform3fv(glGetUniformLocation(program, "Eye"), 1, &eye[0]);
+    glUniform2fv(glGetUniformLocation(program, "Forward"), 1, &forward[0]);
+    glUniform3fv(glGetUniformLocation(program, "Drift"), 1, &drift[0]);
+    glUniform1f(glGetUniformLocation(program, "Time"), m_Time);
+    glUniform1f(glGetUniformLocation(program, "DriftPeriod"), kDriftPeriod);
+    glUniform1f(glGetUniformLocation(program, "TileSize"), kTileSize);
+    glUniform2f(glGetUniformLocation(program, "BoxMin"), boxMin.x, boxMin.z);
+    glUniform2f(glGetUniformLocation(program, "BoxMax"), boxMax.x, boxMax.z);
+    glUniform1f(glGetUniformLocation(program, "Bottom"), eye.y - kLayerDepth);
+    glUniform1f(glGetUniformLocation(program, "Top"), boxMax.y);
+    glUniform1i(glGetUniformLocation(program, "Flakes"), 0);
+    const GLint radius_UNILOC = glGetUniformLocation(program, "Radius");
+    const GLint tileWidth_UNILOC = glGetUniformLocation(program, "TileWidth");
+    const GLint level_UNILOC = glGetUniformLocation(program, "Level");
+    const GLint fade_UNILOC = glGetUniformLocation(program, "Fade");
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_Texture);
+    glBindVertexArray(m_VAO);
+
+    // The scene leaves blending on for everything, so put it back as found.
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDepthMask(GL_FALSE);
+
+    // Back to front, each shell in the middle of its slab.
+    float sparsest = (kMaxFlakes >> (kLevelCount - 1)) / (kTileSize * kTileSize);
+    for (int layer = m_LayerCount - 1; layer >= 0; --layer)
+    {
+        float radius = nearRadius + (layer + 0.5f) * slab;
+        float perArea = density * slab * m_DensityScale;
+        float level = std::min(std::log2(std::max(perArea / sparsest, 1.0f)), (float)(kLevelCount - 1));
+
+        // A whole number of tiles around, so the wrap behind the camera
+        // lines up.
+        float circumference = glm::two_pi<float>() * radius;
+        glUniform1f(radius_UNILOC, radius);
+        glUniform1f(tileWidth_UNILOC, circumference / std::max(std::round(circumference / kTileSize), 1.0f));
+        glUniform1f(level_UNILOC, level);
+
+        // Thinner than the sparsest level or denser than the densest, the
+        // flakes are made fainter or stronger to make up the difference.
+        glUniform1f(fade_UNILOC, perArea / (sparsest * std::exp2(level)));
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, m_VertexCount);
+    }
+
+    glDepthMask(GL_TRUE);
+    if (!blend)
+    {
+        glDisable(GL_BLEND);
+    }
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    mShaders[0].disableShaders();
+}
+
+void SnowImpostor::drawGui()
+{
+    ImGui::SetNextWindowSize(ImVec2(250, 80), ImGuiSetCond_FirstUseEver);
+
+    // Create an ImGui window for the far field snow options.
+    ImGui::Begin("Far Field Snow Options");
+    ImGui::SliderInt("Layers", &m_LayerCount, 1, 8);
+    ImGui::SliderFloat("Density Scale", &m_DensityScale, 0.1f, 4.0f);
+    ImGui::End();
+}
+
+// Load and compile shaders.
+void SnowImpostor::loadAndCompileShaders()
+{
+    std::vector<atlas::gl::ShaderUnit> shaderUnits
+    {
+        atlas::gl::ShaderUnit(generated::Shader::getShaderDirectory() + "/SnowImpostor.vert", GL_VERTEX_SHADER),
+        atlas::gl::ShaderUnit(generated::Shader::getShaderDirectory() + "/SnowImpostor.frag", GL_FRAGMENT_SHADER)
+    };
+
+    mShaders.push_back(atlas::gl::Shader(shaderUnits));
+
+    mShaders[0].compileShaders();
+    mShaders[0].linkShaders();
+}
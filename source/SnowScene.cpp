@@ -4,32 +4,51 @@
 #include "Surface.hpp"
 #include "SnowAccum.hpp"
 #include "Shader.hpp"
-#include "Snowball.hpp"
+#include "SnowCheckpoint.hpp"
 
 #include <atlas/core/GLFW.hpp>
+#include <atlas/core/Log.hpp>
+#include <atlas/core/Timer.hpp>
+#include <atlas/utils/Application.hpp>
 #include <atlas/utils/GUI.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+// Checkpoint section written by the scene itself.
+static const std::uint32_t kTagScene = checkpointTag("SCNE");
+
+// Longest frame a fast-forward makes up for, in seconds.
+static const double kMaxFastForwardFrame = 0.1;
+
+struct SceneState
+{
+    glm::vec3 forceDir;
+    glm::vec3 lightCoords;
+    double totalTime;
+};
+
 SnowScene::SnowScene() :
     m_snowPause(true),
+    m_FastForward(false),
+    m_FastForwardRate(3600.0f),
+    m_FollowCamera(false),
     mRow(5.0),
     mTheta(0.0),
-    m_LightCoords(-25.0f, 15.0f, -25.0f)
+    m_LightCoords(-25.0f, 15.0f, -25.0f),
+    m_QuantizeCheckpoint(false),
+    m_CacheFrame(0)
 {
     // Create SnowfallGenerator and set its bounding box.
     std::unique_ptr<SnowfallGenerator> snowfallGen = std::make_unique<SnowfallGenerator>();
     snowfallGen->setBBox(glm::vec3(-10.5f, 12.0f, -10.5f), glm::vec3(10.5f, 12.0f, 10.5f));
+    m_Generator = snowfallGen.get();
 
     // Create Surface.
     std::unique_ptr<Surface> platform = std::make_unique<Surface>();
-
-    // Create Snowballs.
-    // std::unique_ptr<Snowball> snowball = std::make_unique<Snowball>();
+    m_Surface = platform.get();
 
     // Add geometries to the vector.
     mGeometries.push_back(std::move(snowfallGen));
     mGeometries.push_back(std::move(platform));
-    // mGeometries.push_back(std::move(snowball));
 }
 
 SnowScene::~SnowScene()
@@ -109,17 +128,99 @@ void SnowScene::renderScene()
     // Render ImGui window for simulation parameters
     ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiSetCond_FirstUseEver);
     ImGui::Begin("Simulation Parameters");
-    ImGui::Text("Snow Particles: %d", Snow::getSnowAmount());    
+    ImGui::Text("Snow Particles: %d", m_SnowFall.getSnowAmount());    
 	ImGui::Checkbox("Snow Paused", &m_snowPause);
+
+    // Deposit hours of snow without the flakes, then pick the snowfall up
+    // again from a steady state.
+    if (ImGui::Checkbox("Fast Forward", &m_FastForward))
+    {
+        if (m_FastForward)
+        {
+            m_SnowFall.clear();
+        }
+        else
+        {
+            m_Generator->reseed(Snow::computeTerminalVelocity(m_forceDir));
+        }
+    }
+    ImGui::SliderFloat("Seconds per Second", &m_FastForwardRate, 60.0f, 7200.0f);
+    ImGui::Checkbox("Follow Camera", &m_FollowCamera);
     ImGui::SliderFloat3("Wind Direction", value_ptr(m_forceDir), -50.0f, 50.0f);
     ImGui::SliderFloat3("Light Coordinates", value_ptr(m_LightCoords), -25.0f, 25.0f);
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
                 1000.0f / ImGui::GetIO().Framerate,
                 ImGui::GetIO().Framerate);
+
+    // Record the rendered frames to an image sequence.
+    auto &application = atlas::utils::Application::getInstance();
+    bool capture = application.isCapturingFrames();
+    if (ImGui::Checkbox("Capture Frames", &capture))
+    {
+        if (capture)
+        {
+            application.startFrameCapture("snow_frame", atlas::gl::CaptureFormat::PNG);
+        }
+        else
+        {
+            application.stopFrameCapture();
+        }
+    }
+
+    // Save or restore the whole simulation.
+    ImGui::Checkbox("Quantize Checkpoint", &m_QuantizeCheckpoint);
+    if (ImGui::Button("Save Checkpoint"))
+    {
+        saveCheckpoint("snow.ckpt", m_QuantizeCheckpoint);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Load Checkpoint"))
+    {
+        loadCheckpoint("snow.ckpt");
+    }
+
+    // Record the falling snow to an animation cache or play one back.
+    bool record = m_CacheWriter.isOpen();
+    if (ImGui::Checkbox("Record Cache", &record))
+    {
+        if (record)
+        {
+            // The flakes shown may point into the cache being closed.
+            m_CacheReader.close();
+            auto const &instances = m_SnowFall.getInstances();
+            m_SnowFall.showInstances(instances.data(), instances.size(), m_SnowFall.getInstanceOrigin());
+            m_CacheWriter.open("snow.cache");
+        }
+        else
+        {
+            m_CacheWriter.close();
+        }
+    }
+    bool playback = m_CacheReader.isOpen();
+    if (ImGui::Checkbox("Play Cache", &playback))
+    {
+        if (playback)
+        {
+            m_CacheWriter.close();
+            m_CacheReader.open("snow.cache");
+            m_CacheFrame = 0;
+        }
+        else
+        {
+            m_CacheReader.close();
+            auto const &instances = m_SnowFall.getInstances();
+            m_SnowFall.showInstances(instances.data(), instances.size(), m_SnowFall.getInstanceOrigin());
+        }
+    }
+    if (m_CacheReader.isOpen() && m_CacheReader.getFrameCount() > 0)
+    {
+        ImGui::SliderInt("Cache Frame", &m_CacheFrame, 0, (int)m_CacheReader.getFrameCount() - 1);
+    }
     ImGui::End();
 
     // Render SnowFall geometry.
     m_SnowFall.renderGeometry(mProjection, view);
+    m_SnowFall.drawGui();
 
     // Render other geometries.
     for (auto &geometry : mGeometries)
@@ -132,6 +233,19 @@ void SnowScene::renderScene()
     m_SnowAccum.renderGeometry(mProjection, view);
     m_SnowAccum.drawGui();
 
+    // Render the snow resting on the scenery.
+    m_SnowVolume.renderGeometry(mProjection, view);
+    m_SnowVolume.drawGui();
+
+    // Render the snowballs.
+    m_Snowballs.renderGeometry(mProjection, view);
+    m_Snowballs.drawGui();
+
+    // Render the snow falling beyond the near field.
+    m_Impostor.renderGeometry(mProjection, view);
+    m_Impostor.drawGui();
+    m_WindField.drawGui();
+
     // Render ImGui.
     ImGui::Render();
 }
@@ -146,20 +260,92 @@ void SnowScene::updateScene(double time)
 
     atlas::utils::Gui::getInstance().update(mTime);
 
+    // Draw the cached frame instead of simulating while playing back.
+    if (m_CacheReader.isOpen())
+    {
+        int frameCount = (int)m_CacheReader.getFrameCount();
+        if (frameCount > 0)
+        {
+            if (!m_snowPause)
+            {
+                m_CacheFrame = (m_CacheFrame + 1) % frameCount;
+            }
+
+            std::size_t count;
+            SnowInstance const *instances = m_CacheReader.getFrame(m_CacheFrame, count);
+            m_SnowFall.showInstances(instances, count, m_CacheReader.getFrameOrigin(m_CacheFrame));
+        }
+        return;
+    }
+
     if (!m_snowPause)
     {
+        updateDomain();
+    }
+
+    if (!m_snowPause && m_FastForward)
+    {
+        // A slow frame is capped, so it cannot start a spiral of ever
+        // longer fast-forward frames.
+        float duration = (float)std::min(delta, kMaxFastForwardFrame) * m_FastForwardRate;
+        m_SnowAccum.fastForward(mTime.totalTime - delta, duration);
+        mTime.totalTime += duration - delta;
+        return;
+    }
+
+    if (!m_snowPause)
+    {
+        m_WindField.setBaseWind(m_forceDir);
+        m_WindField.setObstacles(&m_Surface->getDistanceField(), m_Surface->getGeometryKey());
+        m_WindField.update(mTime.totalTime);
+
         for (auto &geometry : mGeometries)
         {
             geometry->updateGeometry(mTime);
         }
         m_SnowFall.updateGeometry(mTime);
+        m_Snowballs.updateGeometry(mTime);
+        m_Impostor.updateGeometry(mTime);
         m_SnowAccum.updateGeometry(mTime);
+
+        if (m_CacheWriter.isOpen())
+        {
+            m_CacheWriter.appendFrame(mTime.totalTime, m_SnowFall.getInstanceOrigin(), m_SnowFall.getInstances());
+        }
     }
 }
 
-void SnowScene::addSnow(std::unique_ptr<Snow> snow)
+void SnowScene::updateDomain()
 {
-    m_SnowFall.addSnow(std::move(snow));
+    glm::vec3 lo = m_Generator->getBBoxMin(), hi = m_Generator->getBBoxMax();
+
+    // The box is set up over the origin, so the offset is where its centre
+    // goes: ahead of the camera, with the near side at the camera. The
+    // camera always looks at the origin.
+    glm::vec3 offset(0.0f);
+    if (m_FollowCamera)
+    {
+        glm::vec3 eye = getCameraPosition();
+        glm::vec2 forward(-eye.x, -eye.z);
+        forward = glm::length(forward) > 1e-4f ? glm::normalize(forward) : glm::vec2(0.0f);
+        glm::vec2 centre = glm::vec2(eye.x, eye.z) + 0.5f * (hi.x - lo.x) * forward;
+        offset = glm::vec3(centre.x, 0.0f, centre.y);
+    }
+
+    m_Generator->setOffset(offset);
+    lo = m_Generator->getBBoxMin();
+    hi = m_Generator->getBBoxMax();
+    m_SnowFall.setDomain(glm::vec2(lo.x, lo.z), glm::vec2(hi.x, hi.z), m_FollowCamera);
+
+    // The ground the snow lands on goes along.
+    glm::vec2 centre(offset.x, offset.z);
+    m_SnowAccum.setCentre(centre);
+    m_Surface->setSimulatedCentre(centre);
+}
+
+void SnowScene::addSnow(Snow const &snow)
+{
+    m_SnowFall.addSnow(snow);
 }
 
 SnowFall const &SnowScene::getSnowFall() const
@@ -167,16 +353,98 @@ SnowFall const &SnowScene::getSnowFall() const
     return m_SnowFall;
 }
 
+SnowfallGenerator const &SnowScene::getGenerator() const
+{
+    return *m_Generator;
+}
+
 SnowAccum &SnowScene::getSnowAccum()
 {
     return m_SnowAccum;
 }
 
+SnowVolume &SnowScene::getSnowVolume()
+{
+    return m_SnowVolume;
+}
+
+Surface &SnowScene::getSurface()
+{
+    return *m_Surface;
+}
+
 glm::vec3 SnowScene::getForceWind()
 {
     return m_forceDir;
 }
 
+WindField const &SnowScene::getWindField() const
+{
+    return m_WindField;
+}
+
+bool SnowScene::saveCheckpoint(std::string const &filename, bool quantize)
+{
+    CheckpointWriter writer;
+    if (!writer.open(filename, quantize ? kCheckpointQuantized : 0))
+    {
+        return false;
+    }
+
+    SceneState state = { m_forceDir, m_LightCoords, mTime.totalTime };
+    writer.writeValue(kTagScene, state);
+
+    m_Generator->saveState(writer);
+    m_SnowFall.saveState(writer);
+    m_SnowAccum.saveState(writer);
+
+    if (!writer.close())
+    {
+        ERROR_LOG("Could not write checkpoint " + filename + ".");
+        return false;
+    }
+
+    INFO_LOG_V("Saved %d snowflakes to %s.", m_SnowFall.getSnowAmount(), filename.c_str());
+    return true;
+}
+
+bool SnowScene::loadCheckpoint(std::string const &filename)
+{
+    atlas::core::Timer<float> timer;
+    timer.start();
+
+    CheckpointReader reader;
+    if (!reader.open(filename))
+    {
+        return false;
+    }
+
+    // Check every part before loading any, so a bad file leaves the scene
+    // as it was.
+    SceneState state;
+    if (!reader.readValue(kTagScene, state) ||
+        !m_Generator->checkState(reader) ||
+        !m_SnowFall.checkState(reader) ||
+        !m_SnowAccum.checkState(reader))
+    {
+        ERROR_LOG("Checkpoint " + filename + " is incomplete.");
+        return false;
+    }
+
+    m_Generator->loadState(reader);
+    m_SnowFall.loadState(reader);
+    m_SnowAccum.loadState(reader);
+
+    m_forceDir = state.forceDir;
+    m_LightCoords = state.lightCoords;
+    mTime.totalTime = state.totalTime;
+    m_SnowAccum.resetHistory(mTime.totalTime);
+
+    INFO_LOG_V("Loaded %d snowflakes from %s in %.2f ms.", m_SnowFall.getSnowAmount(),
+        filename.c_str(), timer.elapsed() * 1000.0f);
+    return true;
+}
+
 glm::vec3 SnowScene::getCameraPosition() const
 {
     return glm::vec3(20.0f * cos(mTheta), mRow, 20.0f * sin(mTheta));
@@ -0,0 +1,353 @@
+#include "SnowTransport.hpp"
+#include <atlas/core/Parallel.hpp>
+#include <atlas/utils/GUI.hpp>
+#include <algorithm>
+#include <cmath>
+
+// Fraction of the excess over the angle of repose moved across an edge per
+// pass. Each cell has four edges, so a quarter keeps the pass stable.
+static const float kSlideRate = 0.25f;
+
+// Wind speed at which snow starts to drift, and the fraction of the snow on
+// an exposed cell lifted per second for every m/s above it.
+static const float kDriftThreshold = 4.0f;
+static const float kDriftRate = 0.02f;
+
+// At most this much of a cell's snow leaves it in one pass.
+static const float kMaxDrift = 0.5f;
+
+// Height above the snow at which the wind is sampled.
+static const float kDriftHeight = 0.5f;
+
+// A tile whose cells all changed less than this is left alone until snow
+// lands on it or a neighbour changes again.
+static const float kSettled = 1e-5f;
+
+SnowTransport::SnowTransport(int gridSize, float spacing, int tileSize) :
+    m_GridSize(gridSize),
+    m_TileSize(tileSize),
+    m_TilesPerSide((gridSize + tileSize - 1) / tileSize),
+    m_Spacing(spacing),
+    m_Avalanche(true),
+    m_Drift(true),
+    m_ReposeAngle(35.0f),
+    m_Rate(10.0f),
+    m_PassTime(0.0),
+    m_Ground(gridSize * gridSize, 0.0f),
+    m_Dirty(m_TilesPerSide * m_TilesPerSide, 0),
+    m_Active(m_TilesPerSide * m_TilesPerSide, 0),
+    m_DriftX(gridSize * gridSize, 0.0f),
+    m_DriftZ(gridSize * gridSize, 0.0f)
+{
+    m_Heights[0].assign(gridSize * gridSize, 0.0f);
+    m_Heights[1].assign(gridSize * gridSize, 0.0f);
+}
+
+void SnowTransport::setGround(std::vector<glm::vec4> const &grid)
+{
+    for (int i = 0; i < m_GridSize * m_GridSize; ++i)
+    {
+        m_Ground[i] = grid[i].y;
+    }
+}
+
+void SnowTransport::setGround(int cell, float height)
+{
+    m_Ground[cell] = height;
+}
+
+float SnowTransport::getGround(int cell) const
+{
+    return m_Ground[cell];
+}
+
+void SnowTransport::markDirty(int cell)
+{
+    int row = cell / m_GridSize;
+    int col = cell % m_GridSize;
+    m_Dirty[(row / m_TileSize) * m_TilesPerSide + col / m_TileSize] = 1;
+}
+
+void SnowTransport::markAllDirty()
+{
+    std::fill(m_Dirty.begin(), m_Dirty.end(), 1);
+}
+
+void SnowTransport::update(double time, std::vector<glm::vec4> const &grid, WindSampler const &wind,
+    ExposureSampler const &exposure)
+{
+    m_Shifts.clear();
+    if ((!m_Avalanche && !m_Drift) || time - m_PassTime < 1.0 / m_Rate)
+    {
+        return;
+    }
+
+    // After a pause, catch up by at most two passes' worth of drift.
+    float dt = (float)std::min(time - m_PassTime, 2.0 / m_Rate);
+    m_PassTime = time;
+
+    collectTiles();
+    if (m_Tiles.empty())
+    {
+        return;
+    }
+
+    loadHeights(grid);
+    float *from = m_Heights[0].data();
+    float *to = m_Heights[1].data();
+    if (m_Drift)
+    {
+        drift(dt, grid, wind, exposure, from, to);
+        std::swap(from, to);
+    }
+    if (m_Avalanche)
+    {
+        slide(from, to);
+        std::swap(from, to);
+    }
+
+    storeShifts(grid, from);
+}
+
+std::vector<SnowTransport::Shift> const &SnowTransport::getShifts() const
+{
+    return m_Shifts;
+}
+
+void SnowTransport::drawGui()
+{
+    bool changed = ImGui::Checkbox("Avalanching", &m_Avalanche);
+    changed |= ImGui::Checkbox("Wind Drift", &m_Drift);
+    changed |= ImGui::SliderFloat("Angle of Repose", &m_ReposeAngle, 20.0f, 60.0f);
+    ImGui::SliderFloat("Transport Rate", &m_Rate, 1.0f, 30.0f);
+    ImGui::Text("Transport tiles: %d / %d", (int)m_Tiles.size(), m_TilesPerSide * m_TilesPerSide);
+
+    // Snow that settled under the old settings may move under the new ones.
+    if (changed)
+    {
+        markAllDirty();
+    }
+}
+
+void SnowTransport::collectTiles()
+{
+    // Snow leaving a dirty tile lands in its neighbours, so they take part.
+    m_Tiles.clear();
+    for (int tz = 0; tz < m_TilesPerSide; ++tz)
+    {
+        for (int tx = 0; tx < m_TilesPerSide; ++tx)
+        {
+            bool active = false;
+            for (int z = std::max(tz - 1, 0); z <= std::min(tz + 1, m_TilesPerSide - 1); ++z)
+            {
+                for (int x = std::max(tx - 1, 0); x <= std::min(tx + 1, m_TilesPerSide - 1); ++x)
+                {
+                    active = active || m_Dirty[z * m_TilesPerSide + x];
+                }
+            }
+
+            int tile = tz * m_TilesPerSide + tx;
+            m_Active[tile] = active ? 1 : 0;
+            if (active)
+            {
+                m_Tiles.push_back(tile);
+            }
+        }
+    }
+
+    std::fill(m_Dirty.begin(), m_Dirty.end(), 0);
+}
+
+void SnowTransport::loadHeights(std::vector<glm::vec4> const &grid)
+{
+    // The ring around a tile is read but never written, so it goes into
+    // both buffers.
+    for (int tile : m_Tiles)
+    {
+        int firstRow = (tile / m_TilesPerSide) * m_TileSize;
+        int firstCol = (tile % m_TilesPerSide) * m_TileSize;
+        int endRow = std::min(m_GridSize, firstRow + m_TileSize + 1);
+        int endCol = std::min(m_GridSize, firstCol + m_TileSize + 1);
+        for (int row = std::max(firstRow - 1, 0); row < endRow; ++row)
+        {
+            for (int col = std::max(firstCol - 1, 0); col < endCol; ++col)
+            {
+                int cell = row * m_GridSize + col;
+                m_Heights[0][cell] = m_Heights[1][cell] = grid[cell].y;
+            }
+        }
+    }
+}
+
+void SnowTransport::getOpenSides(int tile, bool &left, bool &right, bool &down, bool &up) const
+{
+    int tz = tile / m_TilesPerSide;
+    int tx = tile % m_TilesPerSide;
+    left = tx > 0 && m_Active[tile - 1];
+    right = tx < m_TilesPerSide - 1 && m_Active[tile + 1];
+    down = tz > 0 && m_Active[tile - m_TilesPerSide];
+    up = tz < m_TilesPerSide - 1 && m_Active[tile + m_TilesPerSide];
+}
+
+void SnowTransport::drift(float dt, std::vector<glm::vec4> const &grid, WindSampler const &wind,
+    ExposureSampler const &exposure, float const *from, float *to)
+{
+    // First how much snow every cell sends along each axis, which its
+    // neighbours in other tiles need as well.
+    atlas::core::parallelFor(0, m_Tiles.size(), [&](std::size_t t)
+    {
+        int tile = m_Tiles[t];
+        int firstRow = (tile / m_TilesPerSide) * m_TileSize;
+        int firstCol = (tile % m_TilesPerSide) * m_TileSize;
+        int endRow = std::min(m_GridSize, firstRow + m_TileSize);
+        int endCol = std::min(m_GridSize, firstCol + m_TileSize);
+
+        std::vector<glm::vec3> points(endCol - firstCol), winds(endCol - firstCol);
+        for (int row = firstRow; row < endRow; ++row)
+        {
+            int first = row * m_GridSize + firstCol;
+            for (int col = firstCol; col < endCol; ++col)
+            {
+                int cell = row * m_GridSize + col;
+                points[col - firstCol] = glm::vec3(grid[cell].x, from[cell] + kDriftHeight, grid[cell].z);
+            }
+            wind(points.data(), points.size(), winds.data());
+
+            for (int col = firstCol; col < endCol; ++col)
+            {
+                int cell = first + col - firstCol;
+                glm::vec2 w(winds[col - firstCol].x, winds[col - firstCol].z);
+                float speed = glm::length(w);
+                float spread = std::abs(w.x) + std::abs(w.y);
+                float depth = std::max(from[cell] - m_Ground[cell], 0.0f);
+
+                float lift = kDriftRate * std::max(speed - kDriftThreshold, 0.0f) * dt *
+                    exposure(grid[cell].x, grid[cell].z);
+                float amount = (spread > 0.0f) ? std::min(lift, kMaxDrift) * depth / spread : 0.0f;
+                m_DriftX[cell] = amount * w.x;
+                m_DriftZ[cell] = amount * w.y;
+            }
+        }
+    });
+
+    // Then move it downwind. Both cells of an edge compute the same flux
+    // across it, so what one loses the other gains exactly.
+    atlas::core::parallelFor(0, m_Tiles.size(), [&](std::size_t t)
+    {
+        int tile = m_Tiles[t];
+        int firstRow = (tile / m_TilesPerSide) * m_TileSize;
+        int firstCol = (tile % m_TilesPerSide) * m_TileSize;
+        int endRow = std::min(m_GridSize, firstRow + m_TileSize);
+        int endCol = std::min(m_GridSize, firstCol + m_TileSize);
+
+        bool left, right, down, up;
+        getOpenSides(tile, left, right, down, up);
+
+        float const *sx = m_DriftX.data();
+        float const *sz = m_DriftZ.data();
+        for (int row = firstRow; row < endRow; ++row)
+        {
+            float openDown = (row > firstRow || down) ? 1.0f : 0.0f;
+            float openUp = (row < endRow - 1 || up) ? 1.0f : 0.0f;
+            int below = (row > 0) ? -m_GridSize : 0;
+            int above = (row < m_GridSize - 1) ? m_GridSize : 0;
+
+            for (int col = firstCol; col < endCol; ++col)
+            {
+                int c = row * m_GridSize + col;
+                float openLeft = (col > firstCol || left) ? 1.0f : 0.0f;
+                float openRight = (col < endCol - 1 || right) ? 1.0f : 0.0f;
+                int l = (col > 0) ? c - 1 : c;
+                int r = (col < m_GridSize - 1) ? c + 1 : c;
+
+                float inLeft = std::max(sx[l], 0.0f) - std::max(-sx[c], 0.0f);
+                float outRight = std::max(sx[c], 0.0f) - std::max(-sx[r], 0.0f);
+                float inDown = std::max(sz[c + below], 0.0f) - std::max(-sz[c], 0.0f);
+                float outUp = std::max(sz[c], 0.0f) - std::max(-sz[c + above], 0.0f);
+
+                to[c] = from[c] + openLeft * inLeft - openRight * outRight +
+                    openDown * inDown - openUp * outUp;
+            }
+        }
+    });
+}
+
+void SnowTransport::slide(float const *from, float *to)
+{
+    float talus = std::tan(glm::radians(m_ReposeAngle)) * m_Spacing;
+    float const *ground = m_Ground.data();
+
+    // Snow moved from the first cell to the second. Swapping the cells
+    // negates it exactly, so both sides of an edge agree.
+    auto flux = [talus, ground, from](int a, int b)
+    {
+        float da = std::max(from[a] - ground[a], 0.0f);
+        float db = std::max(from[b] - ground[b], 0.0f);
+        return std::min(kSlideRate * std::max(from[a] - from[b] - talus, 0.0f), 0.25f * da) -
+            std::min(kSlideRate * std::max(from[b] - from[a] - talus, 0.0f), 0.25f * db);
+    };
+
+    atlas::core::parallelFor(0, m_Tiles.size(), [&](std::size_t t)
+    {
+        int tile = m_Tiles[t];
+        int firstRow = (tile / m_TilesPerSide) * m_TileSize;
+        int firstCol = (tile % m_TilesPerSide) * m_TileSize;
+        int endRow = std::min(m_GridSize, firstRow + m_TileSize);
+        int endCol = std::min(m_GridSize, firstCol + m_TileSize);
+
+        bool left, right, down, up;
+        getOpenSides(tile, left, right, down, up);
+
+        for (int row = firstRow; row < endRow; ++row)
+        {
+            float openDown = (row > firstRow || down) ? 1.0f : 0.0f;
+            float openUp = (row < endRow - 1 || up) ? 1.0f : 0.0f;
+            int below = (row > 0) ? -m_GridSize : 0;
+            int above = (row < m_GridSize - 1) ? m_GridSize : 0;
+
+            for (int col = firstCol; col < endCol; ++col)
+            {
+                int c = row * m_GridSize + col;
+                float openLeft = (col > firstCol || left) ? 1.0f : 0.0f;
+                float openRight = (col < endCol - 1 || right) ? 1.0f : 0.0f;
+                int l = (col > 0) ? c - 1 : c;
+                int r = (col < m_GridSize - 1) ? c + 1 : c;
+
+                to[c] = from[c] - openLeft * flux(c, l) - openRight * flux(c, r) -
+                    openDown * flux(c, c + below) - openUp * flux(c, c + above);
+            }
+        }
+    });
+}
+
+void SnowTransport::storeShifts(std::vector<glm::vec4> const &grid, float const *heights)
+{
+    for (int tile : m_Tiles)
+    {
+        int firstRow = (tile / m_TilesPerSide) * m_TileSize;
+        int firstCol = (tile % m_TilesPerSide) * m_TileSize;
+        int endRow = std::min(m_GridSize, firstRow + m_TileSize);
+        int endCol = std::min(m_GridSize, firstCol + m_TileSize);
+
+        float largest = 0.0f;
+        for (int row = firstRow; row < endRow; ++row)
+        {
+            for (int col = firstCol; col < endCol; ++col)
+            {
+                int cell = row * m_GridSize + col;
+                float height = heights[cell] - grid[cell].y;
+                if (height != 0.0f)
+                {
+                    m_Shifts.push_back({ cell, height });
+                    largest = std::max(largest, std::abs(height));
+                }
+            }
+        }
+
+        // Keep working on tiles that are still moving.
+        if (largest > kSettled)
+        {
+            m_Dirty[tile] = 1;
+        }
+    }
+}
@@ -0,0 +1,490 @@
+#include "SnowVolume.hpp"
+#include "Shader.hpp"
+#include <atlas/core/Parallel.hpp>
+#include <atlas/core/Timer.hpp>
+#include <atlas/utils/GUI.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+// Density added by one flake, out of 255 for a packed voxel. What doesn't
+// fit spills into the voxels above, up to this many of them.
+static const int kFlakeDensity = 24;
+static const int kMaxSpill = 8;
+
+// Density at which the surface is drawn.
+static const float kSurfaceDensity = 127.5f;
+
+// Brick coordinates are packed into 21 bits per axis for the hash.
+static const int kKeyBias = 1 << 20;
+
+// Voxels gathered per axis to mesh a brick, one more on either side.
+static const int kSampleSize = 10;
+
+// Cells meshed per axis, starting one before the brick.
+static const int kCellSize = 9;
+
+static const glm::vec3 kSnowColor(0.95f, 0.95f, 1.0f);
+
+const int SnowVolume::kBrickSize;
+const int SnowVolume::kBrickVoxels;
+
+static std::uint64_t brickKey(glm::ivec3 const &coord)
+{
+    return ((std::uint64_t)(coord.x + kKeyBias) << 42) | ((std::uint64_t)(coord.y + kKeyBias) << 21) |
+        (std::uint64_t)(coord.z + kKeyBias);
+}
+
+SnowVolume::SnowVolume(float voxelSize) :
+    m_VoxelSize(voxelSize),
+    m_Enabled(false),
+    m_Done(false),
+    m_BatchTime(0.0f),
+    m_MeshedBricks(0),
+    m_MeshTime(0.0f)
+{
+    loadAndCompileShaders();
+}
+
+SnowVolume::~SnowVolume()
+{
+    clear();
+}
+
+void SnowVolume::renderGeometry(atlas::math::Matrix4 const &projection, atlas::math::Matrix4 const &view)
+{
+    update();
+    if (m_Meshes.empty())
+    {
+        return;
+    }
+
+    mShaders[0].enableShaders();
+
+    const glm::mat4 mViewProj = projection * view * mModel;
+    const GLint mViewProj_UNIFORMLOC = glGetUniformLocation(mShaders[0].getShaderProgram(), "ModelViewProjection");
+    glUniformMatrix4fv(mViewProj_UNIFORMLOC, 1, GL_FALSE, &mViewProj[0][0]);
+    const GLint mModel_UNIFORMLOC = glGetUniformLocation(mShaders[0].getShaderProgram(), "Model");
+    glUniformMatrix4fv(mModel_UNIFORMLOC, 1, GL_FALSE, &mModel[0][0]);
+    glUniform1i(glGetUniformLocation(mShaders[0].getShaderProgram(), "UseDiffuseMap"), false);
+
+    // The meshes only carry positions and normals, so the colour and the
+    // instance transform come from constant attributes.
+    glVertexAttrib3f(2, kSnowColor.r, kSnowColor.g, kSnowColor.b);
+    glVertexAttrib4f(4, 0.0f, 0.0f, 0.0f, 1.0f);
+
+    for (BrickMesh const &mesh : m_Meshes)
+    {
+        if (mesh.indexCount > 0)
+        {
+            glBindVertexArray(mesh.vao);
+            glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, (void *)0);
+        }
+    }
+    glBindVertexArray(0);
+
+    mShaders[0].disableShaders();
+}
+
+void SnowVolume::drawGui()
+{
+    ImGui::SetNextWindowSize(ImVec2(300, 120), ImGuiSetCond_FirstUseEver);
+
+    // Create an ImGui window for the snow on the scenery.
+    ImGui::Begin("Snow Volume Options");
+    ImGui::Checkbox("Snow On Scenery", &m_Enabled);
+    ImGui::Text("%d bricks, %.1f KB", (int)m_Bricks.size(),
+        (m_Bricks.size() * sizeof(Brick) + m_Lookup.size() * 2 * sizeof(std::uint64_t)) / 1024.0f);
+    ImGui::Text("Last remesh: %d bricks in %.2f ms", m_MeshedBricks, m_MeshTime * 1000.0f);
+    if (ImGui::Button("Clear Snow"))
+    {
+        clear();
+    }
+    ImGui::End();
+}
+
+bool SnowVolume::isEnabled() const
+{
+    return m_Enabled;
+}
+
+void SnowVolume::deposit(glm::vec3 const &position, glm::vec3 const &normal)
+{
+    // Start half a voxel out from the surface so the snow rests on it.
+    glm::ivec3 voxel(glm::floor((position + 0.5f * m_VoxelSize * normal) / m_VoxelSize));
+
+    int amount = kFlakeDensity;
+    for (int step = 0; step < kMaxSpill && amount > 0; ++step, ++voxel.y)
+    {
+        glm::ivec3 coord(glm::floor(glm::vec3(voxel) / (float)kBrickSize));
+        glm::ivec3 local = voxel - coord * kBrickSize;
+        Brick &brick = m_Bricks[getBrick(coord)];
+
+        int index = local.x + kBrickSize * (local.y + kBrickSize * local.z);
+        int added = std::min(amount, 255 - (int)brick.density[index]);
+        if (added == 0)
+        {
+            continue;
+        }
+
+        brick.density[index] = (std::uint8_t)(brick.density[index] + added);
+        brick.occupancy[local.z] |= 1ull << (local.x + kBrickSize * local.y);
+        amount -= added;
+        touchVoxel(voxel);
+    }
+}
+
+void SnowVolume::clear()
+{
+    if (m_Worker.joinable())
+    {
+        m_Worker.join();
+    }
+    m_Jobs.clear();
+
+    for (BrickMesh const &mesh : m_Meshes)
+    {
+        if (mesh.vao)
+        {
+            glDeleteVertexArrays(1, &mesh.vao);
+            glDeleteBuffers(1, &mesh.vertexBuffer);
+            glDeleteBuffers(1, &mesh.indexBuffer);
+        }
+    }
+
+    m_Lookup.clear();
+    m_Bricks.clear();
+    m_Meshes.clear();
+    m_Dirty.clear();
+}
+
+SnowVolume::Brick *SnowVolume::findBrick(glm::ivec3 const &coord)
+{
+    auto it = m_Lookup.find(brickKey(coord));
+    return (it != m_Lookup.end()) ? &m_Bricks[it->second] : nullptr;
+}
+
+std::size_t SnowVolume::getBrick(glm::ivec3 const &coord)
+{
+    auto it = m_Lookup.find(brickKey(coord));
+    if (it != m_Lookup.end())
+    {
+        return it->second;
+    }
+
+    Brick brick;
+    brick.coord = coord;
+    std::fill(brick.occupancy, brick.occupancy + kBrickSize, 0);
+    std::fill(brick.density, brick.density + kBrickVoxels, 0);
+    brick.dirty = false;
+
+    m_Bricks.push_back(brick);
+    m_Meshes.push_back({ 0, 0, 0, 0 });
+    m_Lookup.emplace(brickKey(coord), m_Bricks.size() - 1);
+    return m_Bricks.size() - 1;
+}
+
+void SnowVolume::markDirty(std::size_t brick)
+{
+    if (!m_Bricks[brick].dirty)
+    {
+        m_Bricks[brick].dirty = true;
+        m_Dirty.push_back(brick);
+    }
+}
+
+void SnowVolume::touchVoxel(glm::ivec3 const &voxel)
+{
+    glm::ivec3 coord(glm::floor(glm::vec3(voxel) / (float)kBrickSize));
+    glm::ivec3 local = voxel - coord * kBrickSize;
+
+    // Neighbours read the voxels on the faces, edges and corners they share
+    // with the brick. The faces towards the lower corner are meshed by the
+    // brick on the other side, so that brick has to exist even if empty.
+    for (int dz = -1; dz <= 1; ++dz)
+    {
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                glm::ivec3 d(dx, dy, dz);
+                bool reads = true;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    reads = reads && (d[axis] == 0 || (d[axis] < 0 ? local[axis] == 0 : local[axis] == kBrickSize - 1));
+                }
+                if (!reads)
+                {
+                    continue;
+                }
+
+                int lower = (dx < 0) + (dy < 0) + (dz < 0);
+                bool owner = lower == 1 && dx <= 0 && dy <= 0 && dz <= 0;
+                if (d == glm::ivec3(0) || owner)
+                {
+                    markDirty(getBrick(coord + d));
+                }
+                else
+                {
+                    auto it = m_Lookup.find(brickKey(coord + d));
+                    if (it != m_Lookup.end())
+                    {
+                        markDirty(it->second);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void SnowVolume::update()
+{
+    if (m_Worker.joinable())
+    {
+        if (!m_Done)
+        {
+            return;
+        }
+
+        m_Worker.join();
+        for (MeshJob const &job : m_Jobs)
+        {
+            upload(job);
+        }
+        m_MeshedBricks = (int)m_Jobs.size();
+        m_MeshTime = m_BatchTime;
+        m_Jobs.clear();
+    }
+
+    if (m_Dirty.empty())
+    {
+        return;
+    }
+
+    // The worker meshes copies of the densities, so deposits can go on.
+    m_Jobs.resize(m_Dirty.size());
+    for (std::size_t i = 0; i < m_Dirty.size(); ++i)
+    {
+        m_Jobs[i].brick = m_Dirty[i];
+        m_Jobs[i].coord = m_Bricks[m_Dirty[i]].coord;
+        gatherSamples(m_Jobs[i]);
+        m_Bricks[m_Dirty[i]].dirty = false;
+    }
+    m_Dirty.clear();
+
+    m_Done = false;
+    m_Worker = std::thread(&SnowVolume::meshAll, this);
+}
+
+void SnowVolume::gatherSamples(MeshJob &job)
+{
+    Brick const *neighbours[27];
+    for (int i = 0; i < 27; ++i)
+    {
+        neighbours[i] = findBrick(job.coord + glm::ivec3(i % 3 - 1, (i / 3) % 3 - 1, i / 9 - 1));
+    }
+
+    job.samples.assign(kSampleSize * kSampleSize * kSampleSize, 0);
+    for (int z = 0; z < kSampleSize; ++z)
+    {
+        for (int y = 0; y < kSampleSize; ++y)
+        {
+            for (int x = 0; x < kSampleSize; ++x)
+            {
+                // Position in the 3x3x3 bricks around this one.
+                glm::ivec3 p = glm::ivec3(x, y, z) - 1 + kBrickSize;
+                glm::ivec3 b = p / kBrickSize;
+                glm::ivec3 local = p - b * kBrickSize;
+
+                Brick const *brick = neighbours[b.x + 3 * (b.y + 3 * b.z)];
+                if (brick && (brick->occupancy[local.z] >> (local.x + kBrickSize * local.y) & 1))
+                {
+                    job.samples[x + kSampleSize * (y + kSampleSize * z)] =
+                        brick->density[local.x + kBrickSize * (local.y + kBrickSize * local.z)];
+                }
+            }
+        }
+    }
+}
+
+void SnowVolume::meshBrick(MeshJob &job) const
+{
+    job.vertices.clear();
+    job.indices.clear();
+
+    auto sample = [&job](int x, int y, int z)
+    {
+        return (float)job.samples[(x + 1) + kSampleSize * ((y + 1) + kSampleSize * (z + 1))];
+    };
+
+    // One vertex per cell the surface passes through, at the average of
+    // where it crosses the edges of the cell.
+    const GLuint kNoVertex = std::numeric_limits<GLuint>::max();
+    std::vector<GLuint> cellVertex(kCellSize * kCellSize * kCellSize, kNoVertex);
+    auto cellIndex = [](int x, int y, int z)
+    {
+        return (x + 1) + kCellSize * ((y + 1) + kCellSize * (z + 1));
+    };
+
+    glm::vec3 origin = glm::vec3(job.coord * kBrickSize) + 0.5f;
+    for (int z = -1; z < kBrickSize; ++z)
+    {
+        for (int y = -1; y < kBrickSize; ++y)
+        {
+            for (int x = -1; x < kBrickSize; ++x)
+            {
+                float corners[8];
+                int inside = 0;
+                for (int c = 0; c < 8; ++c)
+                {
+                    corners[c] = sample(x + (c & 1), y + ((c >> 1) & 1), z + ((c >> 2) & 1));
+                    inside += corners[c] > kSurfaceDensity ? 1 : 0;
+                }
+                if (inside == 0 || inside == 8)
+                {
+                    continue;
+                }
+
+                glm::vec3 sum(0.0f), gradient(0.0f);
+                int crossings = 0;
+                for (int a = 0; a < 8; ++a)
+                {
+                    glm::vec3 pa((float)(a & 1), (float)((a >> 1) & 1), (float)((a >> 2) & 1));
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        int b = a | (1 << axis);
+                        if (b == a)
+                        {
+                            continue;
+                        }
+
+                        gradient[axis] += corners[b] - corners[a];
+                        if ((corners[a] > kSurfaceDensity) != (corners[b] > kSurfaceDensity))
+                        {
+                            glm::vec3 pb = pa;
+                            pb[axis] = 1.0f;
+                            float t = (kSurfaceDensity - corners[a]) / (corners[b] - corners[a]);
+                            sum += glm::mix(pa, pb, t);
+                            ++crossings;
+                        }
+                    }
+                }
+
+                // The density grows into the snow, so the normal points down it.
+                float length = glm::length(gradient);
+                glm::vec3 normal = (length > 0.0f) ? -gradient / length : glm::vec3(0.0f, 1.0f, 0.0f);
+                glm::vec3 position = (origin + glm::vec3(x, y, z) + sum / (float)crossings) * m_VoxelSize;
+
+                cellVertex[cellIndex(x, y, z)] = (GLuint)job.vertices.size();
+                job.vertices.push_back({ position, normal });
+            }
+        }
+    }
+
+    // A quad around every edge from a voxel of this brick that crosses the
+    // surface, joining the four cells that share the edge and facing out.
+    for (int z = 0; z < kBrickSize; ++z)
+    {
+        for (int y = 0; y < kBrickSize; ++y)
+        {
+            for (int x = 0; x < kBrickSize; ++x)
+            {
+                bool inside = sample(x, y, z) > kSurfaceDensity;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    glm::ivec3 e(0), u(0), v(0);
+                    e[axis] = 1;
+                    u[(axis + 1) % 3] = 1;
+                    v[(axis + 2) % 3] = 1;
+
+                    glm::ivec3 next = glm::ivec3(x, y, z) + e;
+                    if (inside == (sample(next.x, next.y, next.z) > kSurfaceDensity))
+                    {
+                        continue;
+                    }
+
+                    glm::ivec3 cells[4] =
+                    {
+                        glm::ivec3(x, y, z), glm::ivec3(x, y, z) - u,
+                        glm::ivec3(x, y, z) - u - v, glm::ivec3(x, y, z) - v
+                    };
+                    GLuint quad[4];
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        quad[c] = cellVertex[cellIndex(cells[c].x, cells[c].y, cells[c].z)];
+                    }
+
+                    if (inside)
+                    {
+                        job.indices.insert(job.indices.end(), { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] });
+                    }
+                    else
+                    {
+                        job.indices.insert(job.indices.end(), { quad[0], quad[2], quad[1], quad[0], quad[3], quad[2] });
+                    }
+                }
+            }
+        }
+    }
+}
+
+void SnowVolume::meshAll()
+{
+    atlas::core::Timer<float> timer;
+    timer.start();
+
+    atlas::core::parallelFor(0, m_Jobs.size(), [this](std::size_t i)
+    {
+        meshBrick(m_Jobs[i]);
+    });
+
+    m_BatchTime = timer.elapsed();
+    m_Done = true;
+}
+
+void SnowVolume::upload(MeshJob const &job)
+{
+    BrickMesh &mesh = m_Meshes[job.brick];
+    mesh.indexCount = (GLsizei)job.indices.size();
+    if (job.indices.empty())
+    {
+        return;
+    }
+
+    if (!mesh.vao)
+    {
+        glGenVertexArrays(1, &mesh.vao);
+        glGenBuffers(1, &mesh.vertexBuffer);
+        glGenBuffers(1, &mesh.indexBuffer);
+
+        glBindVertexArray(mesh.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid *)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (GLvoid *)offsetof(MeshVertex, normal));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+        glBindVertexArray(0);
+    }
+
+    glBindVertexArray(mesh.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, job.vertices.size() * sizeof(MeshVertex), job.vertices.data(), GL_DYNAMIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, job.indices.size() * sizeof(GLuint), job.indices.data(), GL_DYNAMIC_DRAW);
+    glBindVertexArray(0);
+}
+
+// Load and compile shaders.
+void SnowVolume::loadAndCompileShaders()
+{
+    std::vector<atlas::gl::ShaderUnit> shaderUnits
+    {
+        atlas::gl::ShaderUnit(generated::Shader::getShaderDirectory() + "/Scene.vert", GL_VERTEX_SHADER),
+        atlas::gl::ShaderUnit(generated::Shader::getShaderDirectory() + "/Scene.frag", GL_FRAGMENT_SHADER)
+    };
+
+    mShaders.push_back(atlas::gl::Shader(shaderUnits));
+
+    mShaders[0].compileShaders();
+    mShaders[0].linkShaders();
+}
@@ -0,0 +1,482 @@
+#include "Snowballs.hpp"
+#include "SnowScene.hpp"
+#include "Surface.hpp"
+#include "Shader.hpp"
+#include <atlas/core/Parallel.hpp>
+#include <atlas/core/Timer.hpp>
+#include <atlas/utils/Application.hpp>
+#include <atlas/utils/GUI.hpp>
+#include <glm/gtc/constants.hpp>
+#include <cmath>
+
+// Snow White.
+static const glm::vec3 kSnowballColor(243.0f / 255.0f, 245.0f / 255.0f, 240.0f / 255.0f);
+
+// Rings and segments of the sphere every ball is drawn with.
+static const int kSphereStacks = 12;
+static const int kSphereSlices = 20;
+
+// Most balls at once, and the size they start at and stop growing at.
+static const int kMaxBalls = 4000;
+static const float kStartRadius = 0.1f;
+static const float kMaxRadius = 0.6f;
+
+// Longest step taken at once, in seconds.
+static const float kMaxStep = 1.0f / 120.0f;
+
+static const float kGravity = 9.81f;
+static const float kRestitution = 0.2f;
+static const float kFriction = 0.8f;
+
+// How fast the snow slows a ball rolling through it, per second.
+static const float kRollingDrag = 0.3f;
+
+// Thickness of the layer a ball picks up as it rolls, and the volume of
+// ball made from a volume of loose snow.
+static const float kPickupDepth = 0.02f;
+static const float kPacking = 0.3f;
+
+// Half the size of the ground the balls stay on.
+static const float kGroundExtent = 10.0f;
+
+// Cell size of the grid of ball positions on the ground.
+static const float kGroundCellSize = 0.5f;
+
+static float ballVolume(float radius)
+{
+    return 4.0f / 3.0f * glm::pi<float>() * radius * radius * radius;
+}
+
+// Pushes a ball out of a surface it overlaps and applies the impulses of the
+// contact: the bounce along the normal and the friction at the contact
+// point, which turns sliding into rolling.
+static void resolveContact(glm::vec3 &position, glm::vec3 &velocity, glm::vec3 &spin, float radius,
+    glm::vec3 const &normal, float depth, float dt)
+{
+    position += normal * depth;
+
+    // The surface also holds the ball up against this step's gravity.
+    float impulse = kGravity * dt * std::max(normal.y, 0.0f);
+    float approach = glm::dot(velocity, normal);
+    if (approach < 0.0f)
+    {
+        velocity -= (1.0f + kRestitution) * approach * normal;
+        impulse -= (1.0f + kRestitution) * approach;
+    }
+
+    // Removing the slip of a solid sphere takes 2/7 of it off the centre;
+    // the rest is taken up by the spin.
+    glm::vec3 slip = velocity + glm::cross(spin, -radius * normal);
+    slip -= glm::dot(slip, normal) * normal;
+    glm::vec3 change = -2.0f / 7.0f * slip;
+    float length = glm::length(change);
+    if (length > kFriction * impulse)
+    {
+        change *= kFriction * impulse / length;
+    }
+
+    velocity += change;
+    spin -= 5.0f / (2.0f * radius) * glm::cross(normal, change);
+}
+
+Snowballs::Snowballs() :
+    m_Grid(2.0f * kMaxRadius),
+    m_GroundGrid(kGroundCellSize),
+    m_Random(7),
+    m_SpawnCount(200),
+    m_StepTime(0.0f)
+{
+    // A unit sphere, whose positions are also its normals.
+    std::vector<glm::vec3> vertices;
+    for (int stack = 0; stack <= kSphereStacks; ++stack)
+    {
+        float theta = glm::pi<float>() * stack / kSphereStacks;
+        for (int slice = 0; slice <= kSphereSlices; ++slice)
+        {
+            float phi = glm::two_pi<float>() * slice / kSphereSlices;
+            vertices.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta),
+                std::sin(theta) * std::sin(phi)));
+        }
+    }
+
+    std::vector<GLuint> indices;
+    for (int stack = 0; stack < kSphereStacks; ++stack)
+    {
+        for (int slice = 0; slice < kSphereSlices; ++slice)
+        {
+            GLuint a = stack * (kSphereSlices + 1) + slice;
+            GLuint b = a + kSphereSlices + 1;
+            indices.insert(indices.end(), { a, a + 1, b, b, a + 1, b + 1 });
+        }
+    }
+    m_IndexCount = (GLsizei)indices.size();
+
+    glGenVertexArrays(1, &m_VAO);
+    glGenBuffers(1, &m_VertexBuffer);
+    glGenBuffers(1, &m_IndexBuffer);
+    glGenBuffers(1, &m_InstanceBuffer);
+
+    glBindVertexArray(m_VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_VertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (GLvoid *)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (GLvoid *)0);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+    // Centre and radius of every ball, advanced once per instance.
+    glBindBuffer(GL_ARRAY_BUFFER, m_InstanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (GLvoid *)0);
+    glVertexAttribDivisor(4, 1);
+
+    glBindVertexArray(0);
+
+    loadAndCompileShaders();
+}
+
+Snowballs::~Snowballs()
+{
+}
+
+void Snowballs::spawn(int count)
+{
+    count = std::min(count, kMaxBalls - getCount());
+    if (count <= 0)
+    {
+        return;
+    }
+
+    std::vector<glm::vec3> places(count), pushes(count);
+    m_Random.fillUniform(&places[0].x, 3 * count, 0.0f, 1.0f);
+    m_Random.fillUniform(&pushes[0].x, 3 * count, -1.0f, 1.0f);
+    for (int i = 0; i < count; ++i)
+    {
+        float reach = kGroundExtent - 2.0f * kStartRadius;
+        m_Positions.push_back(glm::vec3(reach * (2.0f * places[i].x - 1.0f), 0.5f + 2.5f * places[i].y,
+            reach * (2.0f * places[i].z - 1.0f)));
+        m_Velocities.push_back(glm::vec3(3.0f * pushes[i].x, 0.0f, 3.0f * pushes[i].z));
+        m_Spins.push_back(glm::vec3(0.0f));
+        m_Radii.push_back(kStartRadius);
+    }
+}
+
+void Snowballs::clear()
+{
+    m_Positions.clear();
+    m_Velocities.clear();
+    m_Spins.clear();
+    m_Radii.clear();
+    m_Instances.clear();
+}
+
+int Snowballs::getCount() const
+{
+    return (int)m_Positions.size();
+}
+
+void Snowballs::updateGeometry(atlas::core::Time<> const &t)
+{
+    if (m_Positions.empty())
+    {
+        return;
+    }
+
+    atlas::core::Timer<float> timer;
+    timer.start();
+
+    SnowScene *scene = (SnowScene *)atlas::utils::Application::getInstance().getCurrentScene();
+    SnowAccum &accum = scene->getSnowAccum();
+    atlas::utils::DistanceField const &field = scene->getSurface().getDistanceField();
+
+    int steps = std::max(1, (int)std::ceil(t.deltaTime / kMaxStep));
+    for (int s = 0; s < steps; ++s)
+    {
+        step(t.deltaTime / steps, accum, field);
+    }
+
+    m_StepTime = timer.elapsed();
+
+    // Place a sphere at every ball for drawing.
+    m_Instances.resize(m_Positions.size());
+    for (std::size_t i = 0; i < m_Positions.size(); ++i)
+    {
+        m_Instances[i] = glm::vec4(m_Positions[i], m_Radii[i]);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_InstanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, m_Instances.size() * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, m_Instances.size() * sizeof(glm::vec4), m_Instances.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Snowballs::step(float dt, SnowAccum &accum, atlas::utils::DistanceField const &field)
+{
+    atlas::core::parallelFor(0, m_Positions.size(), [&](std::size_t i)
+    {
+        m_Velocities[i].y -= kGravity * dt;
+        m_Positions[i] += m_Velocities[i] * dt;
+    });
+
+    collideBalls();
+    collideScene(dt, accum, field);
+    pickUpSnow(dt, accum);
+}
+
+void Snowballs::collideBalls()
+{
+    std::size_t count = m_Positions.size();
+    m_Grid.build(m_Positions.data(), count);
+    m_PositionFixes.resize(count);
+    m_VelocityFixes.resize(count);
+
+    // Every ball works out its own half of each overlap from the state at
+    // the start of the pass, shared out by mass, so both sides of a pair
+    // agree and the momentum is kept.
+    atlas::core::parallelFor(0, count, [&](std::size_t i)
+    {
+        glm::vec3 position = m_Positions[i];
+        float radius = m_Radii[i];
+        float mass = ballVolume(radius);
+        glm::vec3 positionFix(0.0f), velocityFix(0.0f);
+        m_Grid.forEachNear(position, radius + kMaxRadius, [&](std::uint32_t j, glm::vec3 const &other)
+        {
+            glm::vec3 offset = position - other;
+            float reach = radius + m_Radii[j];
+            float distance2 = glm::dot(offset, offset);
+            if (j == i || distance2 >= reach * reach || distance2 == 0.0f)
+            {
+                return;
+            }
+
+            float distance = std::sqrt(distance2);
+            glm::vec3 normal = offset / distance;
+            float otherMass = ballVolume(m_Radii[j]);
+            float share = otherMass / (mass + otherMass);
+            positionFix += normal * (reach - distance) * share;
+
+            float approach = glm::dot(m_Velocities[i] - m_Velocities[j], normal);
+            if (approach < 0.0f)
+            {
+                velocityFix -= (1.0f + kRestitution) * approach * share * normal;
+            }
+        });
+        m_PositionFixes[i] = positionFix;
+        m_VelocityFixes[i] = velocityFix;
+    });
+
+    atlas::core::parallelFor(0, count, [&](std::size_t i)
+    {
+        m_Positions[i] += m_PositionFixes[i];
+        m_Velocities[i] += m_VelocityFixes[i];
+    });
+}
+
+void Snowballs::collideScene(float dt, SnowAccum const &accum, atlas::utils::DistanceField const &field)
+{
+    std::size_t count = m_Positions.size();
+    m_Grounded.resize(count);
+    m_Footprints.resize(count);
+
+    atlas::core::parallelFor(0, count, [&](std::size_t i)
+    {
+        glm::vec3 position = m_Positions[i], velocity = m_Velocities[i], spin = m_Spins[i];
+        float radius = m_Radii[i];
+
+        // Rest on the snow, measured along the normal of the heightfield.
+        glm::vec3 normal;
+        float height = accum.sampleHeight(position.x, position.z, normal);
+        float depth = radius - (position.y - height) * normal.y;
+        m_Grounded[i] = depth > 0.0f;
+        if (m_Grounded[i])
+        {
+            resolveContact(position, velocity, spin, radius, normal, depth, dt);
+            float drag = std::exp(-kRollingDrag * dt);
+            velocity = glm::dot(velocity, normal) * normal + drag * (velocity - glm::dot(velocity, normal) * normal);
+            spin *= drag;
+        }
+
+        // Bounce off the dome and the props.
+        glm::vec3 gradient;
+        float distance = field.sample(position, gradient);
+        if (distance < radius)
+        {
+            resolveContact(position, velocity, spin, radius, gradient, radius - distance, dt);
+        }
+
+        // Stay over the ground.
+        for (int axis = 0; axis < 3; axis += 2)
+        {
+            float limit = kGroundExtent - radius;
+            if (std::abs(position[axis]) > limit)
+            {
+                position[axis] = glm::clamp(position[axis], -limit, limit);
+                velocity[axis] *= -kRestitution;
+            }
+        }
+
+        // The footprint is taken where the ball ends up, which is where it
+        // is looked up from when the snow is picked up.
+        if (m_Grounded[i])
+        {
+            m_Footprints[i] = accum.getFootprint(position.x, position.z);
+        }
+
+        m_Positions[i] = position;
+        m_Velocities[i] = velocity;
+        m_Spins[i] = spin;
+    });
+}
+
+void Snowballs::pickUpSnow(float dt, SnowAccum &accum)
+{
+    std::size_t count = m_Positions.size();
+    int cells = accum.getCellCount();
+    float area = accum.getCellArea();
+    m_Requests.resize(count);
+    m_GroundPoints.resize(count);
+    m_CellShares.resize(cells);
+    m_CellDepths.resize(cells);
+
+    // Every ball on the snow asks for the layer under the strip it rolled
+    // over, spread over its footprint.
+    atlas::core::parallelFor(0, count, [&](std::size_t i)
+    {
+        m_GroundPoints[i] = glm::vec3(m_Positions[i].x, 0.0f, m_Positions[i].z);
+        m_Requests[i] = 0.0f;
+        if (m_Grounded[i] && m_Radii[i] < kMaxRadius)
+        {
+            glm::vec3 velocity = m_Velocities[i];
+            float speed = glm::length(glm::vec2(velocity.x, velocity.z));
+            m_Requests[i] = kPickupDepth * speed * dt * 2.0f * m_Radii[i];
+        }
+    });
+    bool any = false;
+    for (std::size_t i = 0; i < count && !any; ++i)
+    {
+        any = m_Requests[i] > 0.0f;
+    }
+    if (!any)
+    {
+        return;
+    }
+
+    // Every cell adds up what the balls around it ask of it and meets as
+    // much of that as its snow allows.
+    m_GroundGrid.build(m_GroundPoints.data(), count);
+    float spacing = std::sqrt(area);
+    atlas::core::parallelFor(0, cells, [&](std::size_t c)
+    {
+        glm::vec3 cell = accum.getCellPosition((int)c);
+        float asked = 0.0f;
+        m_GroundGrid.forEachNear(glm::vec3(cell.x, 0.0f, cell.z), spacing, [&](std::uint32_t j, glm::vec3 const &)
+        {
+            if (m_Requests[j] <= 0.0f)
+            {
+                return;
+            }
+
+            SnowAccum::Footprint const &footprint = m_Footprints[j];
+            for (int k = 0; k < 4; ++k)
+            {
+                if (footprint.cells[k] == (int)c)
+                {
+                    asked += m_Requests[j] * footprint.weights[k];
+                }
+            }
+        });
+
+        float depth = asked / area;
+        float available = accum.getSnowDepth((int)c);
+        m_CellShares[c] = depth > available ? available / depth : 1.0f;
+        m_CellDepths[c] = depth * m_CellShares[c];
+    });
+
+    // Every ball grows by what its cells could give it.
+    atlas::core::parallelFor(0, count, [&](std::size_t i)
+    {
+        if (m_Requests[i] <= 0.0f)
+        {
+            return;
+        }
+
+        SnowAccum::Footprint const &footprint = m_Footprints[i];
+        float gained = 0.0f;
+        for (int k = 0; k < 4; ++k)
+        {
+            gained += m_Requests[i] * footprint.weights[k] * m_CellShares[footprint.cells[k]];
+        }
+
+        float volume = ballVolume(m_Radii[i]) + kPacking * gained;
+        m_Radii[i] = std::min(std::cbrt(volume / ballVolume(1.0f)), kMaxRadius);
+    });
+
+    accum.removeSnow(m_CellDepths);
+}
+
+void Snowballs::renderGeometry(atlas::math::Matrix4 const &projection, atlas::math::Matrix4 const &view)
+{
+    if (m_Instances.empty())
+    {
+        return;
+    }
+
+    mShaders[0].enableShaders();
+
+    const glm::mat4 mViewProj = projection * view * mModel;
+    const GLint mViewProj_UNIFORMLOC = glGetUniformLocation(mShaders[0].getShaderProgram(), "ModelViewProjection");
+    glUniformMatrix4fv(mViewProj_UNIFORMLOC, 1, GL_FALSE, &mViewProj[0][0]);
+    const GLint mModel_UNIFORMLOC = glGetUniformLocation(mShaders[0].getShaderProgram(), "Model");
+    glUniformMatrix4fv(mModel_UNIFORMLOC, 1, GL_FALSE, &mModel[0][0]);
+    glUniform1i(glGetUniformLocation(mShaders[0].getShaderProgram(), "UseDiffuseMap"), false);
+
+    // The sphere only carries positions and normals, so the colour comes
+    // from a constant attribute.
+    glVertexAttrib3f(2, kSnowballColor.r, kSnowballColor.g, kSnowballColor.b);
+
+    glBindVertexArray(m_VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, m_IndexCount, GL_UNSIGNED_INT, (void *)0, (GLsizei)m_Instances.size());
+    glBindVertexArray(0);
+
+    mShaders[0].disableShaders();
+}
+
+void Snowballs::drawGui()
+{
+    ImGui::SetNextWindowSize(ImVec2(300, 100), ImGuiSetCond_FirstUseEver);
+
+    // Create an ImGui window for the snowballs.
+    ImGui::Begin("Snowball Options");
+    ImGui::SliderInt("Balls To Spawn", &m_SpawnCount, 1, 1000);
+    if (ImGui::Button("Spawn"))
+    {
+        spawn(m_SpawnCount);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Clear"))
+    {
+        clear();
+    }
+    ImGui::Text("%d balls, step %.2f ms", getCount(), m_StepTime * 1000.0f);
+    ImGui::End();
+}
+
+// Load and compile shaders.
+void Snowballs::loadAndCompileShaders()
+{
+    std::vector<atlas::gl::ShaderUnit> shaderUnits
+    {
+        atlas::gl::ShaderUnit(generated::Shader::getShaderDirectory() + "/Scene.vert", GL_VERTEX_SHADER),
+        atlas::gl::ShaderUnit(generated::Shader::getShaderDirectory() + "/Scene.frag", GL_FRAGMENT_SHADER)
+    };
+
+    mShaders.push_back(atlas::gl::Shader(shaderUnits));
+
+    mShaders[0].compileShaders();
+    mShaders[0].linkShaders();
+}
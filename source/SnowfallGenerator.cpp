@@ -3,29 +3,60 @@
 #include "SnowfallGenerator.hpp"
 #include "Snow.hpp"
 #include "SnowScene.hpp"
+#include "SnowCheckpoint.hpp"
 #include "Shader.hpp"
+#include "Surface.hpp"
 
 #include <atlas/utils/Application.hpp>
 #include <atlas/utils/GUI.hpp>
+#include <algorithm>
+
+// Checkpoint sections written by the generator.
+static const std::uint32_t kTagGenerator = checkpointTag("GACC");
+static const std::uint32_t kTagRandom = checkpointTag("GXRS");
+
+// To prevent excess snow for performance reasons.
+static const int kMaxSnow = 9000;
+
+struct GeneratorState
+{
+    float accumSnow;
+    int snowingRate;
+};
 
 SnowfallGenerator::SnowfallGenerator() :
+    m_Offset(0.0f),
+    m_Random(1),
     m_SnowingRate(100),
-    m_accumSnow(0.0f),
-    m_UniDistrVec(0.0f, 1.0f),
-    m_UniDistrAngle(0.0f, (float)(2.0 * M_PI))
+    m_accumSnow(0.0f)
 {    
 }
 
 // Set the bounding box for snow generation.
 void SnowfallGenerator::setBBox(glm::vec3 const &a, glm::vec3 const &b)
 {
-    m_BBoxA = a;
-    m_BBoxB = b;
+    m_BBoxA = glm::min(a, b);
+    m_BBoxB = glm::max(a, b);
+}
+
+void SnowfallGenerator::setOffset(glm::vec3 const &offset)
+{
+    m_Offset = offset;
+}
+
+glm::vec3 SnowfallGenerator::getBBoxMin() const
+{
+    return m_BBoxA + m_Offset;
+}
+
+glm::vec3 SnowfallGenerator::getBBoxMax() const
+{
+    return m_BBoxB + m_Offset;
+}
 
-    // Initialize random number distributions for bounding box dimensions.
-    m_UniDistrX = std::uniform_real_distribution<float>(std::min(a.x, b.x), std::max(a.x, b.x));
-    m_UniDistrY = std::uniform_real_distribution<float>(std::min(a.y, b.y), std::max(a.y, b.y));       
-    m_UniDistrZ = std::uniform_real_distribution<float>(std::min(a.z, b.z), std::max(a.z, b.z));         
+float SnowfallGenerator::getRate() const
+{
+    return (float)m_SnowingRate;
 }
 
 // Update the snow geometry.
@@ -44,34 +75,81 @@ void SnowfallGenerator::updateGeometry(atlas::core::Time<> const &t)
     auto currentScene = dynamic_cast<SnowScene*>(atlas::utils::Application::getInstance().getCurrentScene());
     if (!currentScene) return;
 
+    int room = std::max(kMaxSnow - currentScene->getSnowFall().getSnowAmount(), 0);
+    if (amountNewSnow > room)
+    {
+        // Display a message indicating the max snow rate has been exceeded.
+        std::cout << "Maximum snow rate exceeded!" << std::endl;
+        amountNewSnow = room;
+    }
+
+    if (amountNewSnow == 0)
+    {
+        return;
+    }
+
+    // Draw every variate for the new flakes in three bulk passes.
+    m_SpawnPositions.resize(amountNewSnow);
+    m_SpawnAxes.resize(amountNewSnow);
+    m_SpawnAngles.resize(amountNewSnow);
+    m_Random.fillUniform(&m_SpawnPositions[0].x, 3 * amountNewSnow, 0.0f, 1.0f);
+    m_Random.fillUnitSphere(m_SpawnAxes.data(), amountNewSnow);
+    m_Random.fillUniform(m_SpawnAngles.data(), amountNewSnow, 0.0f, glm::two_pi<float>());
+
     for (int i = 0; i < amountNewSnow; ++i)
     {
-        // To prevent excess snow for performance reasons
-        if (Snow::getSnowAmount() >= 9000)
+        Snow snow;
+        snow.setPos(m_BBoxA + m_Offset + m_SpawnPositions[i] * (m_BBoxB - m_BBoxA));
+        snow.setVeloc(glm::vec3(0.0f, 0.0f, 0.0f));
+        snow.setRotation(glm::rotate(glm::mat4(1.0f), m_SpawnAngles[i], m_SpawnAxes[i]));
+        
+        currentScene->addSnow(snow);
+    }
+}
+
+void SnowfallGenerator::reseed(glm::vec3 const &velocity)
+{
+    auto currentScene = dynamic_cast<SnowScene*>(atlas::utils::Application::getInstance().getCurrentScene());
+    if (!currentScene || velocity.y >= 0.0f)
+    {
+        return;
+    }
+
+    // As many flakes as are spawned while one falls to the ground.
+    Terrain const &terrain = currentScene->getSurface().getTerrain();
+    glm::vec3 centre = 0.5f * (m_BBoxA + m_BBoxB) + m_Offset;
+    float fallTime = std::max(m_BBoxB.y - terrain.getHeight(centre.x, centre.z), 0.0f) / -velocity.y;
+    int room = std::max(kMaxSnow - currentScene->getSnowFall().getSnowAmount(), 0);
+    int amount = std::min((int)(m_SnowingRate * fallTime), room);
+    if (amount == 0)
+    {
+        return;
+    }
+
+    // The spawn variates, plus how far along its fall each flake is.
+    m_SpawnPositions.resize(amount);
+    m_SpawnAxes.resize(amount);
+    m_SpawnAngles.resize(amount);
+    std::vector<float> ages(amount);
+    m_Random.fillUniform(&m_SpawnPositions[0].x, 3 * amount, 0.0f, 1.0f);
+    m_Random.fillUnitSphere(m_SpawnAxes.data(), amount);
+    m_Random.fillUniform(m_SpawnAngles.data(), amount, 0.0f, glm::two_pi<float>());
+    m_Random.fillUniform(ages.data(), amount, 0.0f, fallTime);
+
+    for (int i = 0; i < amount; ++i)
+    {
+        glm::vec3 position = m_BBoxA + m_Offset + m_SpawnPositions[i] * (m_BBoxB - m_BBoxA) + velocity * ages[i];
+        if (position.y < terrain.getHeight(position.x, position.z))
         {
-            // Display a message indicating the max snow rate has been exceeded.
-            std::cout << "Maximum snow rate exceeded!" << std::endl;
-            break;
+            continue;
         }
 
-        std::unique_ptr<Snow> snow = std::make_unique<Snow>();
-        snow->setPos(glm::vec3(m_UniDistrX(m_Gen), 
-                                         m_UniDistrY(m_Gen), 
-                                         m_UniDistrZ(m_Gen)));
-        snow->setVeloc(glm::vec3(0.0f, 0.0f, 0.0f));
+        Snow snow;
+        snow.setPos(position);
+        snow.setVeloc(velocity);
+        snow.setRotation(glm::rotate(glm::mat4(1.0f), m_SpawnAngles[i], m_SpawnAxes[i]));
 
-        float theta = acos(2.0 * m_UniDistrVec(m_Gen) - 1);
-        float phi = 2.0 * M_PI * m_UniDistrVec(m_Gen);  
-        
-        glm::vec3 rotVec = glm::vec3(sin(theta) * cos(phi), 
-                                             sin(theta) * sin(phi), 
-                                             cos(theta));
-    
-        float angTheta = m_UniDistrAngle(m_Gen);
-    
-        snow->setRotation(glm::rotate(glm::mat4(1.0f), angTheta, rotVec));
-        
-        currentScene->addSnow(std::move(snow));
+        currentScene->addSnow(snow);
     }
 }
 
@@ -84,3 +162,39 @@ void SnowfallGenerator::drawGui()
     ImGui::SliderInt("Snow/sec", &m_SnowingRate, 0, 800);
     ImGui::End();
 }
+
+void SnowfallGenerator::saveState(CheckpointWriter &writer) const
+{
+    GeneratorState state = { m_accumSnow, m_SnowingRate };
+    writer.writeValue(kTagGenerator, state);
+
+    writer.writeValue(kTagRandom, m_Random.getEngine().getState());
+}
+
+bool SnowfallGenerator::checkState(CheckpointReader const &reader) const
+{
+    GeneratorState state;
+    return reader.readValue(kTagGenerator, state);
+}
+
+bool SnowfallGenerator::loadState(CheckpointReader const &reader)
+{
+    GeneratorState state;
+    if (!reader.readValue(kTagGenerator, state))
+    {
+        return false;
+    }
+
+    m_accumSnow = state.accumSnow;
+    m_SnowingRate = state.snowingRate;
+
+    // Checkpoints from before the engine state was saved leave the
+    // generator where it is.
+    atlas::math::Xoshiro256::State random;
+    if (reader.readValue(kTagRandom, random))
+    {
+        m_Random.getEngine().setState(random);
+    }
+
+    return true;
+}
@@ -5,7 +5,34 @@
 #include <glm/gtc/matrix_transform.hpp> // For glm::lookAt, glm::ortho
 #include <glm/gtc/noise.hpp> // For glm::perlin
 #include <atlas/utils/GUI.hpp>
-#include <iostream>
+#include <atlas/core/Log.hpp>
+#include <atlas/core/Timer.hpp>
+
+// The distance field is cached here between runs.
+static const char *kFieldCacheFile = "surface.sdf";
+static const float kFieldCellSize = 0.1f;
+static const float kFieldBand = 0.5f;
+
+// Terrain tiles, made on first run from a heightmap if there is one, and
+// the spacing and relief of the heightmap in metres.
+static const char *kTerrainFile = "terrain.tiles";
+static const char *kHeightmapFiles[] = { "terrain.pgm", "terrain.r16" };
+static const float kTerrainSpacing = 1.0f;
+static const float kTerrainHeightScale = 200.0f;
+
+// Half size of the region simulated on the full resolution terrain.
+static const float kSimulatedExtent = 10.5f;
+
+// FNV-1a, used to tell whether the cached field matches the geometry.
+static std::uint64_t hashBytes(const void *data, std::size_t size, std::uint64_t hash)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
 
 // Define vertex colors for the surface (Grass Green).
 // Each row represents a vertex's color in RGB format.
@@ -44,17 +71,8 @@ GLfloat Surface::vertexNorm[][3] = {
     {0.0f, 1.0f, 0.0f}  // Vertex 3: Normal (0, 1, 0)
 };
 
-Surface::Surface()
+Surface::Surface(float domeRadius, float domeHeight, int domeLayers, float cubeSize)
 {
-    // Generate OpenGL buffers and bind vertex array
-    glGenVertexArrays(1, &m_VAO);
-    glGenBuffers(1, &m_PosBuff);
-    glGenBuffers(1, &m_NormBuff);
-    glGenBuffers(1, &m_ColBuff);
-    glGenBuffers(1, &m_TexCoordBuff);
-
-    glBindVertexArray(m_VAO);
-
     // Calculate Perlin noise for vertex positions
     // for (int i = 0; i < 4; ++i)
     // {
@@ -64,159 +82,271 @@ Surface::Surface()
     //     vertexPos[i][1] = noise * 0.2f; // Adjust the amplitude as needed
     // }
 
-    // Buffer and set vertex attribute pointers for position, normal, color
-    bufferAndSetAttribute(m_PosBuff, 0, 3, Surface::vertexPos, 12);
-    bufferAndSetAttribute(m_NormBuff, 1, 3, Surface::vertexNorm, 12);
-    bufferAndSetAttribute(m_ColBuff, 2, 3, Surface::vertexColors, 12);
+    // The ground quad, split from its strip order into two triangles.
+    std::vector<atlas::gl::BatchVertex> quadVertices;
+    for (int i = 0; i < 4; ++i)
+    {
+        quadVertices.push_back({
+            glm::vec3(vertexPos[i][0], vertexPos[i][1], vertexPos[i][2]),
+            glm::vec3(vertexNorm[i][0], vertexNorm[i][1], vertexNorm[i][2]),
+            glm::vec3(vertexColors[i][0], vertexColors[i][1], vertexColors[i][2]),
+            glm::vec2(texCoords[i][0], texCoords[i][1]) });
+    }
+    m_GroundMesh = m_Batch.addMesh(quadVertices, { 0, 1, 2, 2, 1, 3 });
 
-    // Buffer and set texture coordinates
-    bufferAndSetTextureCoords(m_TexCoordBuff, 3, 2, Surface::texCoords, 8);
+    //-------------------------------------------------------------------------
 
-    glBindVertexArray(0);
+    // Generate snowballs. Every cube of the dome is an instance of one
+    // indexed unit cube, moved and scaled by its instance attribute.
+    std::vector<atlas::gl::BatchVertex> cubeVertices;
+    std::vector<GLuint> cubeIndices;
 
-    //-------------------------------------------------------------------------
+    glm::vec3 ful(-0.5f,  0.5f,  0.5f);
+    glm::vec3 fur( 0.5f,  0.5f,  0.5f);
+    glm::vec3 fdl(-0.5f, -0.5f,  0.5f);
+    glm::vec3 fdr( 0.5f, -0.5f,  0.5f);
+    glm::vec3 bul(-0.5f,  0.5f, -0.5f);
+    glm::vec3 bur( 0.5f,  0.5f, -0.5f);
+    glm::vec3 bdl(-0.5f, -0.5f, -0.5f);
+    glm::vec3 bdr( 0.5f, -0.5f, -0.5f);
+
+    // Order: upper left, upper right, lower left, lower right
+    makeFace(ful, fur, fdl, fdr, cubeVertices, cubeIndices);  // front face
+    makeFace(bur, bul, bdr, bdl, cubeVertices, cubeIndices);  // back face
+    makeFace(bul, bur, ful, fur, cubeVertices, cubeIndices);  // top face
+    makeFace(bdr, bdl, fdr, fdl, cubeVertices, cubeIndices);  // bottom face
+    makeFace(bul, ful, bdl, fdl, cubeVertices, cubeIndices);  // left face
+    makeFace(fur, bur, fdr, bdr, cubeVertices, cubeIndices);  // right face
+
+    m_DomeMesh = m_Batch.addMesh(cubeVertices, cubeIndices, {});
+    setDome(domeRadius, domeHeight, domeLayers, cubeSize);
+
+    // The terrain replaces the ground quad.
+    for (const char *heightmap : kHeightmapFiles)
+    {
+        if (!std::ifstream(kTerrainFile) && std::ifstream(heightmap))
+        {
+            Terrain::convert(heightmap, kTerrainFile, kTerrainSpacing, kTerrainHeightScale);
+        }
+    }
+    if (m_Terrain.open(kTerrainFile))
+    {
+        m_Batch.setInstances(m_GroundMesh, {});
+        m_Batch.build();
+        m_Terrain.pinRegion(glm::vec2(-kSimulatedExtent), glm::vec2(kSimulatedExtent));
+    }
+
+    // Load shaders and compile/link them
+    loadAndCompileShaders();
+}
+
+std::size_t Surface::addProp(std::vector<atlas::gl::BatchVertex> const &vertices, std::vector<GLuint> const &indices,
+    std::vector<glm::vec4> const &instances)
+{
+    std::size_t mesh = m_Batch.addMesh(vertices, indices, instances);
+    m_Batch.build();
+
+    // Every instance adds its own copy of the triangles to collide with.
+    for (glm::vec4 const &instance : instances)
+    {
+        std::uint32_t base = (std::uint32_t)m_PropVertices.size();
+        for (atlas::gl::BatchVertex const &vertex : vertices)
+        {
+            m_PropVertices.push_back(glm::vec3(instance) + vertex.position * instance.w);
+        }
+        for (GLuint index : indices)
+        {
+            m_PropIndices.push_back(base + index);
+        }
+    }
+    m_PropBVH.build(m_PropVertices, m_PropIndices);
+    m_ChangedRegion = join(m_ChangedRegion, m_PropBVH.getGlobalVolume());
+    updateDistanceField();
 
-    // Generate snowballs. 
-    glGenVertexArrays(1, &m_Snowball_VAO);
-    glGenBuffers(1, &m_Snowball_PosBuff);
-    glGenBuffers(1, &m_Snowball_NormBuff);
-    glGenBuffers(1, &m_Snowball_ColBuff);
-    glGenBuffers(1, &m_Snowball_TexCoordBuff);
+    return mesh;
+}
 
-    std::vector<glm::vec3> snowball_vertexColors_vec;
-    std::vector<glm::vec2> snowball_texCoords_vec;
-    std::vector<glm::vec3> snowball_vertexPos_vec;
-    std::vector<glm::vec3> snowball_vertexNorm_vec;
+void Surface::setDome(float radius, float height, int layers, float cubeSize)
+{
+    m_DomeRadius = radius;
+    m_DomeHeight = height;
+    m_DomeLayers = layers;
+    m_CubeSize = cubeSize;
 
-    std::vector<glm::vec3> positions;
-    float domeRadius = 4.0f;
-    float domeHeight = 3.0f;
-    int numLayers = 15; // Number of layers
+    std::vector<glm::vec4> instances;
 
     // Generate dome-like top with layered circles
-    for (int layer = 0; layer < numLayers; ++layer) {
-        float layerHeight = domeHeight * (static_cast<float>(layer) / numLayers);
-        float layerRadius = domeRadius * glm::sqrt(1.0f - glm::pow(layerHeight / domeHeight, 2.0f));
+    for (int layer = 0; layer < layers; ++layer) {
+        float layerHeight = height * (static_cast<float>(layer) / layers);
+        float layerRadius = radius * glm::sqrt(1.0f - glm::pow(layerHeight / height, 2.0f));
 
         for (float angle = 0.0f; angle < glm::two_pi<float>(); angle += 0.1f) {
             float x = layerRadius * glm::cos(angle);
             float z = layerRadius * glm::sin(angle);
             float y = layerHeight;
 
-            positions.push_back(glm::vec3(x, y, z));
+            instances.push_back(glm::vec4(x, y, z, cubeSize));
         }
     }
 
-    for (glm::vec3 position : positions) {
-        Cube cubeData = populateCubeData(position, 0.5f);
-        snowball_vertexColors_vec.insert(snowball_vertexColors_vec.end(), cubeData.vertexColors.begin(), cubeData.vertexColors.end());
-        snowball_texCoords_vec.insert(snowball_texCoords_vec.end(), cubeData.texCoords.begin(), cubeData.texCoords.end());
-        snowball_vertexPos_vec.insert(snowball_vertexPos_vec.end(), cubeData.vertexPos.begin(), cubeData.vertexPos.end());
-        snowball_vertexNorm_vec.insert(snowball_vertexNorm_vec.end(), cubeData.vertexNorm.begin(), cubeData.vertexNorm.end());
+    m_Batch.setInstances(m_DomeMesh, instances);
+    m_Batch.build();
+
+    // The cubes are axis aligned, so their boxes are exact colliders.
+    m_ChangedRegion = join(m_ChangedRegion, m_DomeBVH.getGlobalVolume());
+    m_DomeBoxes.clear();
+    for (glm::vec4 const &instance : instances)
+    {
+        glm::vec3 center(instance);
+        m_DomeBoxes.push_back(atlas::utils::BBox(center - 0.5f * instance.w, center + 0.5f * instance.w));
     }
+    m_DomeBVH.build(m_DomeBoxes);
+    m_ChangedRegion = join(m_ChangedRegion, m_DomeBVH.getGlobalVolume());
+    updateDistanceField();
+}
+
+atlas::utils::DistanceField const &Surface::getDistanceField() const
+{
+    return m_Field;
+}
 
-    GLfloat snowball_vertexColors[snowball_vertexColors_vec.size()][3];
-    GLfloat snowball_texCoords[snowball_texCoords_vec.size()][2];
-    GLfloat snowball_vertexPos[snowball_vertexPos_vec.size()][3];
-    GLfloat snowball_vertexNorm[snowball_vertexNorm_vec.size()][3];
+std::uint64_t Surface::getGeometryKey() const
+{
+    return m_FieldKey;
+}
 
-    // Convert vectors to static arrays.
-    for (int i = 0; i < snowball_vertexColors_vec.size(); ++i) {
-        snowball_vertexColors[i][0] = snowball_vertexColors_vec[i].x;
-        snowball_vertexColors[i][1] = snowball_vertexColors_vec[i].y;
-        snowball_vertexColors[i][2] = snowball_vertexColors_vec[i].z;
-    }
+Terrain const &Surface::getTerrain() const
+{
+    return m_Terrain;
+}
+
+void Surface::setSimulatedCentre(glm::vec2 const &centre)
+{
+    m_Terrain.pinRegion(centre - kSimulatedExtent, centre + kSimulatedExtent);
+}
+
+std::vector<atlas::utils::BVH const *> Surface::getOccluders() const
+{
+    return { &m_DomeBVH, &m_PropBVH };
+}
 
-    for (int i = 0; i < snowball_texCoords_vec.size(); ++i) {
-        snowball_texCoords[i][0] = snowball_texCoords_vec[i].x;
-        snowball_texCoords[i][1] = snowball_texCoords_vec[i].y;
+bool Surface::takeChangedRegion(atlas::utils::BBox &region)
+{
+    if (m_ChangedRegion.pMin.x > m_ChangedRegion.pMax.x)
+    {
+        return false;
     }
 
-    for (int i = 0; i < snowball_vertexPos_vec.size(); ++i) {
-        snowball_vertexPos[i][0] = snowball_vertexPos_vec[i].x;
-        snowball_vertexPos[i][1] = snowball_vertexPos_vec[i].y;
-        snowball_vertexPos[i][2] = snowball_vertexPos_vec[i].z;
+    region = m_ChangedRegion;
+    m_ChangedRegion = atlas::utils::BBox();
+    return true;
+}
+
+void Surface::updateDistanceField()
+{
+    std::uint64_t key = 14695981039346656037ull;
+    key = hashBytes(m_DomeBoxes.data(), m_DomeBoxes.size() * sizeof(atlas::utils::BBox), key);
+    key = hashBytes(m_PropVertices.data(), m_PropVertices.size() * sizeof(glm::vec3), key);
+    key = hashBytes(m_PropIndices.data(), m_PropIndices.size() * sizeof(std::uint32_t), key);
+    key = hashBytes(&kFieldCellSize, sizeof(kFieldCellSize), key);
+    key = hashBytes(&kFieldBand, sizeof(kFieldBand), key);
+    m_FieldKey = key;
+
+    if (m_Field.load(kFieldCacheFile, key))
+    {
+        return;
     }
 
-    for (int i = 0; i < snowball_vertexNorm_vec.size(); ++i) {
-        snowball_vertexNorm[i][0] = snowball_vertexNorm_vec[i].x;
-        snowball_vertexNorm[i][1] = snowball_vertexNorm_vec[i].y;
-        snowball_vertexNorm[i][2] = snowball_vertexNorm_vec[i].z;
+    // Cover everything that can be collided with, plus the band.
+    atlas::utils::BBox domain;
+    for (atlas::utils::BBox const &box : m_DomeBoxes)
+    {
+        domain = join(domain, box);
+    }
+    for (glm::vec3 const &vertex : m_PropVertices)
+    {
+        domain = join(domain, atlas::utils::BBox(vertex));
     }
+    domain.expand(kFieldBand);
+
+    atlas::core::Timer<float> timer;
+    timer.start();
+    m_Field.build(domain, kFieldCellSize, kFieldBand,
+        [this](glm::vec3 const &p) { return distanceTo(p); });
+    m_Field.save(kFieldCacheFile, key);
+    INFO_LOG_V("Built surface distance field in %.2f s.", timer.elapsed());
+}
 
-    std::cout << "snowball_vertexColors_vec.size(): " << snowball_vertexColors_vec.size() << std::endl;
+float Surface::distanceTo(glm::vec3 const &p) const
+{
+    // Only primitives within the band can change the clamped distance.
+    float distance = kFieldBand;
+    atlas::utils::BBox query(p);
+    query.expand(kFieldBand);
 
-    glBindVertexArray(m_Snowball_VAO);
-    bufferAndSetAttribute(m_Snowball_PosBuff, 0, 3, snowball_vertexPos, snowball_vertexPos_vec.size() * 3);
-    bufferAndSetAttribute(m_Snowball_NormBuff, 1, 3, snowball_vertexNorm, snowball_vertexNorm_vec.size() * 3);
-    bufferAndSetAttribute(m_Snowball_ColBuff, 2, 3, snowball_vertexColors, snowball_vertexColors_vec.size() * 3);
-    bufferAndSetTextureCoords(m_Snowball_TexCoordBuff, 3, 2, snowball_texCoords, snowball_texCoords_vec.size() * 2);
+    m_DomeBVH.visit(query, [&](std::uint32_t i)
+    {
+        distance = std::min(distance, atlas::utils::DistanceField::distanceToBox(m_DomeBoxes[i], p));
+        return true;
+    });
 
-    glBindVertexArray(0);
+    // The closest prop triangle decides which side of the props we are on.
+    float propDistance = kFieldBand;
+    m_PropBVH.visit(query, [&](std::uint32_t i)
+    {
+        float d = atlas::utils::DistanceField::distanceToTriangle(m_PropVertices[m_PropIndices[3 * i]],
+            m_PropVertices[m_PropIndices[3 * i + 1]], m_PropVertices[m_PropIndices[3 * i + 2]], p);
+        if (std::abs(d) < std::abs(propDistance))
+        {
+            propDistance = d;
+        }
+        return true;
+    });
 
-    // Load shaders and compile/link them
-    loadAndCompileShaders();
+    return std::min(distance, propDistance);
 }
 
-Surface::Cube Surface::populateCubeData(glm::vec3 center, float length) {
-    Cube cubeData;
+void Surface::makeFace(glm::vec3 topLeft, glm::vec3 topRight, glm::vec3 bottomLeft, glm::vec3 bottomRight,
+    std::vector<atlas::gl::BatchVertex> &vertices, std::vector<GLuint> &indices)
+{
+    GLuint base = (GLuint)vertices.size();
 
-    float x = center.x; float y = center.y; float z = center.z;
-    float rad = length / 2.0f;
+    // Vertex normals and colors
+    glm::vec3 normal = glm::normalize(glm::cross(topRight - topLeft, bottomLeft - topLeft));
+    glm::vec3 color(0.95f, 0.96f, 0.94f);
 
-    glm::vec3 ful = glm::vec3(-rad+x,  rad+y,  rad+z);
-    glm::vec3 fur = glm::vec3( rad+x,  rad+y,  rad+z);
-    glm::vec3 fdl = glm::vec3(-rad+x, -rad+y,  rad+z);
-    glm::vec3 fdr = glm::vec3( rad+x, -rad+y,  rad+z);
-    glm::vec3 bul = glm::vec3(-rad+x,  rad+y, -rad+z);
-    glm::vec3 bur = glm::vec3( rad+x,  rad+y, -rad+z);
-    glm::vec3 bdl = glm::vec3(-rad+x, -rad+y, -rad+z);
-    glm::vec3 bdr = glm::vec3( rad+x, -rad+y, -rad+z);
+    // Vertex positions and texture coordinates
+    vertices.push_back({ topLeft, normal, color, glm::vec2(0.0f, 1.0f) });
+    vertices.push_back({ bottomLeft, normal, color, glm::vec2(0.0f, 0.0f) });
+    vertices.push_back({ bottomRight, normal, color, glm::vec2(1.0f, 0.0f) });
+    vertices.push_back({ topRight, normal, color, glm::vec2(1.0f, 1.0f) });
 
-    // Order: upper left, upper right, lower left, lower right
-    makeFace(ful, fur, fdl, fdr, cubeData);  // front face
-    makeFace(bur, bul, bdr, bdl, cubeData);  // back face
-    makeFace(bul, bur, ful, fur, cubeData);  // top face
-    makeFace(bdr, bdl, fdr, fdl, cubeData);  // bottom face
-    makeFace(bul, ful, bdl, fdl, cubeData);  // left face
-    makeFace(fur, bur, fdr, bdr, cubeData);  // right face
-
-    return cubeData;
+    // Two triangles per face.
+    const GLuint faceIndices[] = { 0, 1, 2, 2, 3, 0 };
+    for (GLuint index : faceIndices)
+    {
+        indices.push_back(base + index);
+    }
 }
 
-void Surface::makeFace(glm::vec3 topLeft, glm::vec3 topRight, glm::vec3 bottomLeft, glm::vec3 bottomRight, Surface::Cube &cubeData) {
-    // Vertex positions
-    cubeData.vertexPos.push_back(topLeft);
-    cubeData.vertexPos.push_back(bottomLeft);
-    cubeData.vertexPos.push_back(bottomRight);
-    cubeData.vertexPos.push_back(bottomRight);
-    cubeData.vertexPos.push_back(topRight);
-    cubeData.vertexPos.push_back(topLeft);
+void Surface::drawGui()
+{
+    ImGui::SetNextWindowSize(ImVec2(250, 130), ImGuiSetCond_FirstUseEver);
 
-    // Vertex normals
-    glm::vec3 normal = glm::normalize(glm::cross(topRight - topLeft, bottomLeft - topLeft));
-    cubeData.vertexNorm.push_back(normal);
-    cubeData.vertexNorm.push_back(normal);
-    cubeData.vertexNorm.push_back(normal);
-    cubeData.vertexNorm.push_back(normal);
-    cubeData.vertexNorm.push_back(normal);
-    cubeData.vertexNorm.push_back(normal);
-
-    // Vertex colors
-    cubeData.vertexColors.push_back(glm::vec3(0.95f, 0.96f, 0.94f));
-    cubeData.vertexColors.push_back(glm::vec3(0.95f, 0.96f, 0.94f));
-    cubeData.vertexColors.push_back(glm::vec3(0.95f, 0.96f, 0.94f));
-    cubeData.vertexColors.push_back(glm::vec3(0.95f, 0.96f, 0.94f));
-    cubeData.vertexColors.push_back(glm::vec3(0.95f, 0.96f, 0.94f));
-    cubeData.vertexColors.push_back(glm::vec3(0.95f, 0.96f, 0.94f));
-
-    // Texture coordinates
-    cubeData.texCoords.push_back(glm::vec2(0.0f, 1.0f));
-    cubeData.texCoords.push_back(glm::vec2(0.0f, 0.0f));
-    cubeData.texCoords.push_back(glm::vec2(1.0f, 0.0f));
-    cubeData.texCoords.push_back(glm::vec2(1.0f, 0.0f));
-    cubeData.texCoords.push_back(glm::vec2(1.0f, 1.0f));
-    cubeData.texCoords.push_back(glm::vec2(0.0f, 1.0f));
+    // Create an ImGui window for the dome options.
+    ImGui::Begin("Dome Options");
+    bool changed = ImGui::SliderFloat("Radius", &m_DomeRadius, 0.5f, 9.0f);
+    changed |= ImGui::SliderFloat("Height", &m_DomeHeight, 0.5f, 8.0f);
+    changed |= ImGui::SliderInt("Layers", &m_DomeLayers, 1, 60);
+    changed |= ImGui::SliderFloat("Cube Size", &m_CubeSize, 0.05f, 1.0f);
+    ImGui::End();
+
+    if (changed)
+    {
+        setDome(m_DomeRadius, m_DomeHeight, m_DomeLayers, m_CubeSize);
+    }
+
+    m_Terrain.drawGui();
 }
 
 // Atlas Util: Renders the surface using the specified projection and view matrices.
@@ -228,33 +358,12 @@ void Surface::renderGeometry(const atlas::math::Matrix4 &projection, const atlas
     const GLint mViewProj_UNIFORMLOC = glGetUniformLocation(mShaders[0].getShaderProgram(), "ModelViewProjection");
     glUniformMatrix4fv(mViewProj_UNIFORMLOC, 1, GL_FALSE, &mViewProj[0][0]);
 
-    glBindVertexArray(m_VAO);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glBindVertexArray(0);
-
-    glBindVertexArray(m_Snowball_VAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36000);
-    glBindVertexArray(0);
+    // The ground quad, the dome and any props in one submission.
+    m_Batch.draw();
 
     mShaders[0].disableShaders();
-}
 
-// Helper function to buffer and set vertex attribute pointers.
-void Surface::bufferAndSetAttribute(GLuint buffer, GLuint index, GLint size, const GLfloat data[][3], GLint dataSize)
-{
-    glBindBuffer(GL_ARRAY_BUFFER, buffer);
-    glBufferData(GL_ARRAY_BUFFER, dataSize * sizeof(GLfloat), data, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(index);
-    glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE, size * sizeof(GLfloat), (GLvoid *)0);
-}
-
-// Helper function to buffer and set texture coordinates.
-void Surface::bufferAndSetTextureCoords(GLuint buffer, GLuint index, GLint size, const GLfloat data[][2], GLint dataSize)
-{
-    glBindBuffer(GL_ARRAY_BUFFER, buffer);
-    glBufferData(GL_ARRAY_BUFFER, dataSize * sizeof(GLfloat), data, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(index);
-    glVertexAttribPointer(index, size, GL_FLOAT, GL_FALSE, size * sizeof(GLfloat), (GLvoid *)0);
+    m_Terrain.renderGeometry(projection, view);
 }
 
 // Load and compile shaders.
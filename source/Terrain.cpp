@@ -0,0 +1,757 @@
+#include "Terrain.hpp"
+#include "Shader.hpp"
+#include <atlas/core/Log.hpp>
+#include <atlas/core/MappedFile.hpp>
+#include <atlas/core/Parallel.hpp>
+#include <atlas/core/Timer.hpp>
+#include <atlas/utils/Frustum.hpp>
+#include <atlas/utils/GUI.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+// Quads along the side of a tile, and samples in a tile.
+static const int kTileQuads = 64;
+static const int kTileSamples = (kTileQuads + 1) * (kTileQuads + 1);
+
+// "STRN", and the version of the layout below.
+static const std::uint32_t kTerrainMagic = 0x4e525453;
+static const std::uint32_t kTerrainVersion = 1;
+
+// Tiles read by the worker in one go.
+static const std::size_t kMaxLoads = 16;
+
+// Frames a tile stays loaded after it was last needed, and how far past
+// the view distance it may be before it is dropped.
+static const std::uint64_t kKeepFrames = 300;
+static const float kDropDistance = 1.25f;
+
+// The file starts with this header, followed by the lowest and highest
+// sample of every tile and then the samples of every tile, each tile x
+// fastest. Tiles are stored by depth, then z, then x.
+struct TerrainHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::int32_t size;
+    std::int32_t depth;
+    float spacing;
+    float heightScale;
+    float baseHeight;
+    std::uint32_t reserved;
+};
+
+// A 16-bit heightmap read straight from its file.
+struct HeightmapImage
+{
+    const unsigned char *data;
+    int width, height;
+    int bytes;
+    std::uint32_t maxValue;
+    bool bigEndian;
+
+    std::uint16_t at(int x, int y) const
+    {
+        const unsigned char *p = data + ((std::size_t)y * width + x) * bytes;
+        std::uint32_t value = bytes == 1 ? p[0] : bigEndian ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+        return (std::uint16_t)(std::min(value, maxValue) * 65535u / maxValue);
+    }
+};
+
+// Reads the next number of a PGM header, skipping whitespace and comments.
+static bool readHeaderValue(const unsigned char *&p, const unsigned char *end, std::uint32_t &value)
+{
+    while (p < end && (std::isspace(*p) || *p == '#'))
+    {
+        if (*p == '#')
+        {
+            while (p < end && *p != '\n')
+            {
+                ++p;
+            }
+        }
+        else
+        {
+            ++p;
+        }
+    }
+
+    if (p == end || !std::isdigit(*p))
+    {
+        return false;
+    }
+
+    value = 0;
+    while (p < end && std::isdigit(*p))
+    {
+        value = value * 10 + (*p++ - '0');
+    }
+    return true;
+}
+
+static bool readHeightmap(atlas::core::MappedFile const &file, std::string const &filename, HeightmapImage &image)
+{
+    const unsigned char *p = file.data();
+    const unsigned char *end = p + file.size();
+    if (file.size() > 2 && p[0] == 'P' && p[1] == '5')
+    {
+        p += 2;
+        std::uint32_t width, height, maxValue;
+        if (!readHeaderValue(p, end, width) || !readHeaderValue(p, end, height) ||
+            !readHeaderValue(p, end, maxValue) || maxValue == 0 || maxValue > 65535 || p == end)
+        {
+            return false;
+        }
+
+        // A single whitespace character ends the header.
+        ++p;
+        image = { p, (int)width, (int)height, maxValue > 255 ? 2 : 1, maxValue, true };
+    }
+    else
+    {
+        // Anything else is taken as square little-endian RAW.
+        std::string extension = filename.substr(filename.find_last_of('.') + 1);
+        int side = (int)std::lround(std::sqrt(file.size() / 2.0));
+        if ((extension != "r16" && extension != "raw") || (std::size_t)side * side * 2 != file.size())
+        {
+            return false;
+        }
+        image = { p, side, side, 2, 65535, false };
+    }
+
+    return image.width > 1 && image.height > 1 &&
+        (std::size_t)(end - image.data) >= (std::size_t)image.width * image.height * image.bytes;
+}
+
+// Offset of a tile among all tiles, which are stored by depth.
+static std::size_t tileIndex(int depth, int x, int z)
+{
+    return ((std::size_t(1) << (2 * depth)) - 1) / 3 + ((std::size_t)z << depth) + x;
+}
+
+static std::size_t tileCount(int depth)
+{
+    return tileIndex(depth + 1, 0, 0);
+}
+
+Terrain::Terrain() :
+    m_Size(0),
+    m_Depth(0),
+    m_Spacing(1.0f),
+    m_HeightScale(0.0f),
+    m_BaseHeight(0.0f),
+    m_Origin(0.0f),
+    m_Frame(0),
+    m_Revision(0),
+    m_Done(false),
+    m_ViewDistance(1000.0f),
+    m_Detail(2.0f),
+    m_LoadedTiles(0)
+{
+    createMesh();
+    loadAndCompileShaders();
+}
+
+Terrain::~Terrain()
+{
+    close();
+}
+
+bool Terrain::convert(std::string const &heightmap, std::string const &filename, float spacing, float heightScale)
+{
+    atlas::core::MappedFile source;
+    HeightmapImage image;
+    if (!source.open(heightmap) || !readHeightmap(source, heightmap, image))
+    {
+        ERROR_LOG("Could not read heightmap " + heightmap + ".");
+        return false;
+    }
+
+    atlas::core::Timer<float> timer;
+    timer.start();
+
+    // Enough full resolution tiles to cover the heightmap, a power of two
+    // along each side. Samples past the heightmap repeat its edge.
+    int depth = 0;
+    while ((kTileQuads << depth) < std::max(image.width, image.height) - 1)
+    {
+        ++depth;
+    }
+
+    TerrainHeader header;
+    header.magic = kTerrainMagic;
+    header.version = kTerrainVersion;
+    header.size = (kTileQuads << depth) + 1;
+    header.depth = depth;
+    header.spacing = spacing;
+    header.heightScale = heightScale;
+    header.baseHeight = -image.at(image.width / 2, image.height / 2) * heightScale / 65535.0f;
+    header.reserved = 0;
+
+    std::ofstream out(filename, std::ios::binary);
+    std::vector<std::uint16_t> ranges(2 * tileCount(depth));
+    out.write((const char *)&header, sizeof(header));
+    out.write((const char *)ranges.data(), ranges.size() * sizeof(std::uint16_t));
+
+    // Every level takes every other sample of the one below, so edges
+    // shared between levels meet exactly. A row of tiles is made at a time.
+    std::vector<std::uint16_t> row;
+    for (int d = 0; d <= depth; ++d)
+    {
+        int tiles = 1 << d;
+        int step = 1 << (depth - d);
+        row.resize((std::size_t)tiles * kTileSamples);
+        for (int z = 0; z < tiles; ++z)
+        {
+            atlas::core::parallelFor(0, tiles, [&](std::size_t x)
+            {
+                std::uint16_t *samples = &row[x * kTileSamples];
+                std::uint16_t lo = 65535, hi = 0;
+                for (int j = 0; j <= kTileQuads; ++j)
+                {
+                    int y = std::min((z * kTileQuads + j) * step, image.height - 1);
+                    for (int i = 0; i <= kTileQuads; ++i)
+                    {
+                        std::uint16_t sample = image.at(std::min(((int)x * kTileQuads + i) * step, image.width - 1), y);
+                        samples[j * (kTileQuads + 1) + i] = sample;
+                        lo = std::min(lo, sample);
+                        hi = std::max(hi, sample);
+                    }
+                }
+
+                std::size_t index = tileIndex(d, (int)x, z);
+                ranges[2 * index] = lo;
+                ranges[2 * index + 1] = hi;
+            });
+            out.write((const char *)row.data(), row.size() * sizeof(std::uint16_t));
+        }
+    }
+
+    out.seekp(sizeof(header));
+    out.write((const char *)ranges.data(), ranges.size() * sizeof(std::uint16_t));
+    if (!out)
+    {
+        ERROR_LOG("Could not write terrain " + filename + ".");
+        return false;
+    }
+
+    INFO_LOG_V("Converted %dx%d heightmap to %d terrain levels in %.2f s.", image.width, image.height,
+        depth + 1, timer.elapsed());
+    return true;
+}
+
+bool Terrain::open(std::string const &filename)
+{
+    close();
+
+    m_File.open(filename, std::ios::binary);
+    TerrainHeader header;
+    if (!m_File.read((char *)&header, sizeof(header)) || header.magic != kTerrainMagic ||
+        header.version != kTerrainVersion || header.depth < 0 || header.depth > 15 ||
+        header.size != (kTileQuads << header.depth) + 1)
+    {
+        m_File.close();
+        return false;
+    }
+
+    std::vector<std::uint16_t> ranges(2 * tileCount(header.depth));
+    m_File.read((char *)ranges.data(), ranges.size() * sizeof(std::uint16_t));
+    m_File.seekg(0, std::ios::end);
+    std::size_t expected = sizeof(header) + ranges.size() * sizeof(std::uint16_t) +
+        tileCount(header.depth) * kTileSamples * sizeof(std::uint16_t);
+    if (!m_File || (std::size_t)m_File.tellg() != expected)
+    {
+        ERROR_LOG("Terrain " + filename + " is incomplete.");
+        m_File.close();
+        return false;
+    }
+
+    m_Filename = filename;
+    m_Size = header.size;
+    m_Depth = header.depth;
+    m_Spacing = header.spacing;
+    m_HeightScale = header.heightScale;
+    m_BaseHeight = header.baseHeight;
+    m_Ranges.swap(ranges);
+    m_Origin = glm::vec2(-0.5f * (m_Size - 1) * m_Spacing);
+    ++m_Revision;
+
+    INFO_LOG_V("Opened %d^2 terrain %s.", m_Size, filename.c_str());
+    return true;
+}
+
+void Terrain::close()
+{
+    if (m_Worker.joinable())
+    {
+        m_Worker.join();
+    }
+    m_Jobs.clear();
+
+    for (auto &entry : m_Tiles)
+    {
+        glDeleteTextures(1, &entry.second.texture);
+    }
+    m_Tiles.clear();
+    m_Requests.clear();
+    m_Pinned.clear();
+    m_Draw.clear();
+
+    if (m_File.is_open())
+    {
+        m_File.close();
+        m_Filename.clear();
+        m_Size = 0;
+        ++m_Revision;
+    }
+}
+
+bool Terrain::isOpen() const
+{
+    return m_Size > 0;
+}
+
+void Terrain::pinRegion(glm::vec2 const &lo, glm::vec2 const &hi)
+{
+    m_Pinned.clear();
+    if (!isOpen())
+    {
+        return;
+    }
+
+    // Full resolution tiles under the corners and everything between.
+    float span = kTileQuads * m_Spacing;
+    int tiles = 1 << m_Depth;
+    glm::ivec2 first = glm::clamp(glm::ivec2(glm::floor((lo - m_Origin) / span)), glm::ivec2(0), glm::ivec2(tiles - 1));
+    glm::ivec2 last = glm::clamp(glm::ivec2(glm::floor((hi - m_Origin) / span)), glm::ivec2(0), glm::ivec2(tiles - 1));
+    for (int z = first.y; z <= last.y; ++z)
+    {
+        for (int x = first.x; x <= last.x; ++x)
+        {
+            m_Pinned.push_back(makeKey(m_Depth, x, z));
+        }
+    }
+}
+
+std::uint64_t Terrain::makeKey(int depth, int x, int z)
+{
+    return ((std::uint64_t)depth << 48) | ((std::uint64_t)z << 24) | (std::uint64_t)x;
+}
+
+void Terrain::splitKey(std::uint64_t key, int &depth, int &x, int &z)
+{
+    depth = (int)(key >> 48);
+    z = (int)((key >> 24) & 0xffffff);
+    x = (int)(key & 0xffffff);
+}
+
+void Terrain::getTileBounds(std::uint64_t key, glm::vec3 &lo, glm::vec3 &hi) const
+{
+    int depth, x, z;
+    splitKey(key, depth, x, z);
+    float span = (kTileQuads << (m_Depth - depth)) * m_Spacing;
+    std::size_t index = tileIndex(depth, x, z);
+    lo = glm::vec3(m_Origin.x + x * span, m_Ranges[2 * index] * m_HeightScale / 65535.0f + m_BaseHeight,
+        m_Origin.y + z * span);
+    hi = glm::vec3(lo.x + span, m_Ranges[2 * index + 1] * m_HeightScale / 65535.0f + m_BaseHeight, lo.z + span);
+}
+
+void Terrain::renderGeometry(atlas::math::Matrix4 const &projection, atlas::math::Matrix4 const &view)
+{
+    if (!isOpen())
+    {
+        return;
+    }
+
+    ++m_Frame;
+    glm::mat4 viewProj = projection * view * mModel;
+    glm::vec3 eye(glm::inverse(view)[3]);
+
+    // Pick the tiles to draw, asking for the ones that are missing.
+    m_Draw.clear();
+    m_Requests.clear();
+    for (std::uint64_t key : m_Pinned)
+    {
+        request(key);
+    }
+    select(makeKey(0, 0, 0), viewProj, eye);
+    stitch();
+
+    stream(eye);
+    evict(eye);
+
+    mShaders[0].enableShaders();
+
+    GLuint program = mShaders[0].getShaderProgram();
+    glUniformMatrix4fv(glGetUniformLocation(program, "ModelViewProjection"), 1, GL_FALSE, &viewProj[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(program, "Model"), 1, GL_FALSE, &mModel[0][0]);
+    glUniform1i(glGetUniformLocation(program, "UseDiffuseMap"), false);
+    glUniform1i(glGetUniformLocation(program, "HeightMap"), 0);
+    glUniform1f(glGetUniformLocation(program, "HeightScale"), m_HeightScale);
+    glUniform1f(glGetUniformLocation(program, "BaseHeight"), m_BaseHeight);
+    const GLint tileOrigin_UNILOC = glGetUniformLocation(program, "TileOrigin");
+    const GLint tileSpacing_UNILOC = glGetUniformLocation(program, "TileSpacing");
+    const GLint edgeSteps_UNILOC = glGetUniformLocation(program, "EdgeSteps");
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindVertexArray(m_VAO);
+    for (DrawTile const &draw : m_Draw)
+    {
+        int depth, x, z;
+        splitKey(draw.key, depth, x, z);
+        float spacing = m_Spacing * (1 << (m_Depth - depth));
+        glUniform2f(tileOrigin_UNILOC, m_Origin.x + x * kTileQuads * spacing, m_Origin.y + z * kTileQuads * spacing);
+        glUniform1f(tileSpacing_UNILOC, spacing);
+        glUniform4fv(edgeSteps_UNILOC, 1, &draw.steps[0]);
+        glBindTexture(GL_TEXTURE_2D, m_Tiles[draw.key].texture);
+        glDrawElements(GL_TRIANGLES, m_IndexCount, GL_UNSIGNED_INT, (void *)0);
+    }
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    mShaders[0].disableShaders();
+}
+
+void Terrain::select(std::uint64_t key, glm::mat4 const &viewProj, glm::vec3 const &eye)
+{
+    auto found = m_Tiles.find(key);
+    if (found == m_Tiles.end())
+    {
+        request(key);
+        return;
+    }
+    found->second.lastUsed = m_Frame;
+
+    glm::vec3 lo, hi;
+    getTileBounds(key, lo, hi);
+    float distance = glm::distance(eye, glm::clamp(eye, lo, hi));
+    if (distance > m_ViewDistance || !atlas::utils::isBoxVisible(viewProj, lo, hi))
+    {
+        return;
+    }
+
+    // Split tiles that are near for their size, once all four children
+    // are there to replace them.
+    int depth, x, z;
+    splitKey(key, depth, x, z);
+    if (depth < m_Depth && distance < m_Detail * (hi.x - lo.x))
+    {
+        bool ready = true;
+        for (int child = 0; child < 4; ++child)
+        {
+            std::uint64_t childKey = makeKey(depth + 1, 2 * x + (child & 1), 2 * z + (child >> 1));
+            auto childTile = m_Tiles.find(childKey);
+            if (childTile == m_Tiles.end())
+            {
+                request(childKey);
+                ready = false;
+            }
+            else
+            {
+                childTile->second.lastUsed = m_Frame;
+            }
+        }
+
+        if (ready)
+        {
+            for (int child = 0; child < 4; ++child)
+            {
+                select(makeKey(depth + 1, 2 * x + (child & 1), 2 * z + (child >> 1)), viewProj, eye);
+            }
+            return;
+        }
+    }
+
+    m_Draw.push_back({ key, glm::vec4(1.0f) });
+}
+
+void Terrain::stitch()
+{
+    std::unordered_map<std::uint64_t, bool> drawn;
+    for (DrawTile const &draw : m_Draw)
+    {
+        drawn[draw.key] = true;
+    }
+
+    // An edge next to a coarser tile only keeps the samples that tile has.
+    // A finer neighbour matches this tile's edge itself.
+    static const int kOffsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+    for (DrawTile &draw : m_Draw)
+    {
+        int depth, x, z;
+        splitKey(draw.key, depth, x, z);
+        for (int edge = 0; edge < 4; ++edge)
+        {
+            int nx = x + kOffsets[edge][0], nz = z + kOffsets[edge][1];
+            if (nx < 0 || nz < 0 || nx >= (1 << depth) || nz >= (1 << depth))
+            {
+                continue;
+            }
+
+            for (int d = depth; d >= 0; --d, nx >>= 1, nz >>= 1)
+            {
+                if (drawn.count(makeKey(d, nx, nz)))
+                {
+                    draw.steps[edge] = (float)std::min(1 << (depth - d), kTileQuads);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void Terrain::request(std::uint64_t key)
+{
+    if (!m_Tiles.count(key))
+    {
+        m_Requests.push_back(key);
+    }
+}
+
+void Terrain::stream(glm::vec3 const &eye)
+{
+    if (m_Worker.joinable())
+    {
+        if (!m_Done)
+        {
+            return;
+        }
+
+        m_Worker.join();
+
+        // Rows of 65 samples are not four-byte aligned.
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        for (LoadJob &job : m_Jobs)
+        {
+            Tile &tile = m_Tiles[job.key];
+            tile.samples.swap(job.samples);
+            tile.lastUsed = m_Frame;
+
+            glGenTextures(1, &tile.texture);
+            glBindTexture(GL_TEXTURE_2D, tile.texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, kTileQuads + 1, kTileQuads + 1, 0, GL_RED, GL_UNSIGNED_SHORT,
+                tile.samples.data());
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        m_LoadedTiles += (int)m_Jobs.size();
+        m_Jobs.clear();
+        ++m_Revision;
+    }
+
+    std::sort(m_Requests.begin(), m_Requests.end());
+    m_Requests.erase(std::unique(m_Requests.begin(), m_Requests.end()), m_Requests.end());
+    m_Requests.erase(std::remove_if(m_Requests.begin(), m_Requests.end(),
+        [this](std::uint64_t key) { return m_Tiles.count(key) > 0; }), m_Requests.end());
+    if (m_Requests.empty())
+    {
+        return;
+    }
+
+    // Coarse tiles first, since everything finer waits on them, then the
+    // nearest.
+    std::vector<std::pair<float, std::uint64_t>> order;
+    for (std::uint64_t key : m_Requests)
+    {
+        glm::vec3 lo, hi;
+        getTileBounds(key, lo, hi);
+        order.push_back({ (float)(key >> 48) * 1e9f + glm::distance(eye, glm::clamp(eye, lo, hi)), key });
+    }
+    std::sort(order.begin(), order.end());
+
+    m_Jobs.resize(std::min(order.size(), kMaxLoads));
+    for (std::size_t i = 0; i < m_Jobs.size(); ++i)
+    {
+        m_Jobs[i].key = order[i].second;
+    }
+
+    m_Done = false;
+    m_Worker = std::thread(&Terrain::loadAll, this);
+}
+
+void Terrain::loadAll()
+{
+    std::size_t data = sizeof(TerrainHeader) + m_Ranges.size() * sizeof(std::uint16_t);
+    for (LoadJob &job : m_Jobs)
+    {
+        int depth, x, z;
+        splitKey(job.key, depth, x, z);
+        job.samples.resize(kTileSamples);
+        m_File.seekg(data + tileIndex(depth, x, z) * kTileSamples * sizeof(std::uint16_t));
+        m_File.read((char *)job.samples.data(), kTileSamples * sizeof(std::uint16_t));
+    }
+    m_File.clear();
+
+    m_Done = true;
+}
+
+void Terrain::evict(glm::vec3 const &eye)
+{
+    std::uint64_t root = makeKey(0, 0, 0);
+    for (auto it = m_Tiles.begin(); it != m_Tiles.end();)
+    {
+        glm::vec3 lo, hi;
+        getTileBounds(it->first, lo, hi);
+        bool stale = m_Frame - it->second.lastUsed > kKeepFrames ||
+            glm::distance(eye, glm::clamp(eye, lo, hi)) > kDropDistance * m_ViewDistance;
+        bool kept = it->first == root || std::find(m_Pinned.begin(), m_Pinned.end(), it->first) != m_Pinned.end();
+        if (stale && !kept)
+        {
+            glDeleteTextures(1, &it->second.texture);
+            it = m_Tiles.erase(it);
+            ++m_Revision;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+Terrain::Tile const *Terrain::findFinest(float u, float v, int &depth, int &x, int &z) const
+{
+    // From the full resolution up, as tiles can be loaded without their
+    // parents when they are pinned.
+    for (depth = m_Depth; depth >= 0; --depth)
+    {
+        int span = kTileQuads << (m_Depth - depth);
+        x = std::min((int)(u / span), (1 << depth) - 1);
+        z = std::min((int)(v / span), (1 << depth) - 1);
+        auto found = m_Tiles.find(makeKey(depth, x, z));
+        if (found != m_Tiles.end())
+        {
+            return &found->second;
+        }
+    }
+    return nullptr;
+}
+
+float Terrain::sampleTile(Tile const &tile, int depth, int x, int z, float u, float v, glm::vec3 *normal) const
+{
+    int step = 1 << (m_Depth - depth);
+    float s = u / step - x * kTileQuads, t = v / step - z * kTileQuads;
+    int i = glm::clamp((int)s, 0, kTileQuads - 1), j = glm::clamp((int)t, 0, kTileQuads - 1);
+    float fx = s - i, fz = t - j;
+
+    const std::uint16_t *row = &tile.samples[j * (kTileQuads + 1) + i];
+    float scale = m_HeightScale / 65535.0f;
+    float h00 = row[0] * scale, h10 = row[1] * scale;
+    float h01 = row[kTileQuads + 1] * scale, h11 = row[kTileQuads + 2] * scale;
+
+    if (normal)
+    {
+        float spacing = m_Spacing * step;
+        float dx = ((1.0f - fz) * (h10 - h00) + fz * (h11 - h01)) / spacing;
+        float dz = ((1.0f - fx) * (h01 - h00) + fx * (h11 - h10)) / spacing;
+        *normal = glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+    }
+
+    return glm::mix(glm::mix(h00, h10, fx), glm::mix(h01, h11, fx), fz) + m_BaseHeight;
+}
+
+float Terrain::getHeight(float x, float z) const
+{
+    glm::vec3 normal;
+    return getHeight(x, z, normal);
+}
+
+float Terrain::getHeight(float x, float z, glm::vec3 &normal) const
+{
+    normal = glm::vec3(0.0f, 1.0f, 0.0f);
+    if (!isOpen())
+    {
+        return 0.0f;
+    }
+
+    float u = glm::clamp((x - m_Origin.x) / m_Spacing, 0.0f, (float)(m_Size - 1));
+    float v = glm::clamp((z - m_Origin.y) / m_Spacing, 0.0f, (float)(m_Size - 1));
+    int depth, tx, tz;
+    Tile const *tile = findFinest(u, v, depth, tx, tz);
+    return tile ? sampleTile(*tile, depth, tx, tz, u, v, &normal) : 0.0f;
+}
+
+std::uint64_t Terrain::getRevision() const
+{
+    return m_Revision;
+}
+
+void Terrain::drawGui()
+{
+    ImGui::SetNextWindowSize(ImVec2(300, 130), ImGuiSetCond_FirstUseEver);
+
+    // Create an ImGui window for the terrain options.
+    ImGui::Begin("Terrain Options");
+    if (!isOpen())
+    {
+        ImGui::Text("No terrain loaded.");
+        ImGui::End();
+        return;
+    }
+
+    ImGui::SliderFloat("View Distance", &m_ViewDistance, 50.0f, 10000.0f);
+    ImGui::SliderFloat("Detail", &m_Detail, 0.5f, 8.0f);
+    std::size_t bytes = m_Tiles.size() * kTileSamples * sizeof(std::uint16_t) * 2;
+    ImGui::Text("%d tiles drawn, %d resident (%.1f MB)", (int)m_Draw.size(), (int)m_Tiles.size(),
+        bytes / (1024.0f * 1024.0f));
+    ImGui::Text("%d tiles loaded, %d waiting", m_LoadedTiles, (int)m_Requests.size());
+    ImGui::End();
+}
+
+void Terrain::createMesh()
+{
+    // One grid of sample coordinates shared by every tile.
+    std::vector<glm::vec2> vertices;
+    for (int j = 0; j <= kTileQuads; ++j)
+    {
+        for (int i = 0; i <= kTileQuads; ++i)
+        {
+            vertices.push_back(glm::vec2(i, j));
+        }
+    }
+
+    std::vector<GLuint> indices;
+    for (int j = 0; j < kTileQuads; ++j)
+    {
+        for (int i = 0; i < kTileQuads; ++i)
+        {
+            GLuint a = j * (kTileQuads + 1) + i;
+            GLuint b = a + kTileQuads + 1;
+            indices.insert(indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+    m_IndexCount = (GLsizei)indices.size();
+
+    glGenVertexArrays(1, &m_VAO);
+    glGenBuffers(1, &m_VertexBuffer);
+    glGenBuffers(1, &m_IndexBuffer);
+
+    glBindVertexArray(m_VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_VertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), vertices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (GLvoid *)0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+}
+
+// Load and compile shaders.
+void Terrain::loadAndCompileShaders()
+{
+    std::vector<atlas::gl::ShaderUnit> shaderUnits
+    {
+        atlas::gl::ShaderUnit(generated::Shader::getShaderDirectory() + "/Terrain.vert", GL_VERTEX_SHADER),
+        atlas::gl::ShaderUnit(generated::Shader::getShaderDirectory() + "/Scene.frag", GL_FRAGMENT_SHADER)
+    };
+
+    mShaders.push_back(atlas::gl::Shader(shaderUnits));
+
+    mShaders[0].compileShaders();
+    mShaders[0].linkShaders();
+}
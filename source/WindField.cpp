@@ -0,0 +1,327 @@
+#include "WindField.hpp"
+#include <atlas/core/Parallel.hpp>
+#include <atlas/utils/GUI.hpp>
+#include <glm/gtc/noise.hpp>
+#include <algorithm>
+#include <cmath>
+
+// Simulation time over which one grid is filled, which is also how long a
+// grid stays on screen before the next one replaces it.
+static const double kRegenerationPeriod = 0.25;
+
+// Longest step the solver takes when it falls behind, in seconds.
+static const double kMaxSolverStep = 0.1;
+
+// How fast the turbulence evolves, in noise cells per second.
+static const float kNoiseSpeed = 0.3f;
+
+// Step of the central differences taken for the curl, in noise cells.
+static const float kCurlStep = 0.01f;
+
+// Offsets that make the three components of the noise potential unrelated.
+static const glm::vec3 kPotentialOffsets[3] =
+{
+    glm::vec3(0.0f, 0.0f, 0.0f),
+    glm::vec3(31.416f, -47.853f, 12.793f),
+    glm::vec3(-19.521f, 73.109f, -55.367f)
+};
+
+WindField::WindField(glm::vec3 const &origin, glm::vec3 const &size, float cellSize) :
+    m_Origin(origin),
+    m_CellSize(cellSize),
+    m_Resolution(glm::max(glm::ivec3(glm::ceil(size / cellSize)) + 1, glm::ivec3(2))),
+    m_Dirty(true),
+    m_Building(false),
+    m_Ready(false),
+    m_FilledSlices(0),
+    m_StartTime(0.0),
+    m_Solver(origin, size),
+    m_Simulated(false),
+    m_SolverRate(20.0f),
+    m_SolveTime(0.0),
+    m_Obstacles(nullptr),
+    m_ObstacleKey(0),
+    m_Voxelized(false)
+{
+    m_Settings.baseWind = glm::vec3(0.0f);
+    m_Settings.strength = 2.0f;
+    m_Settings.scale = 8.0f;
+    m_Settings.time = 0.0;
+
+    std::size_t count = (std::size_t)m_Resolution.x * m_Resolution.y * m_Resolution.z;
+    m_Front.assign(count, glm::vec4(0.0f));
+    m_Back.assign(count, glm::vec4(0.0f));
+}
+
+void WindField::setBaseWind(glm::vec3 const &wind)
+{
+    if (glm::any(glm::notEqual(wind, m_Settings.baseWind)))
+    {
+        m_Settings.baseWind = wind;
+        m_Dirty = true;
+    }
+}
+
+void WindField::setTurbulence(float strength, float scale)
+{
+    m_Settings.strength = strength;
+    m_Settings.scale = scale;
+    m_Dirty = true;
+}
+
+void WindField::setObstacles(atlas::utils::DistanceField const *field, std::uint64_t key)
+{
+    if (field != m_Obstacles || key != m_ObstacleKey)
+    {
+        m_Obstacles = field;
+        m_ObstacleKey = key;
+        m_Voxelized = false;
+    }
+}
+
+void WindField::setSimulated(bool simulated)
+{
+    m_Simulated = simulated;
+}
+
+void WindField::addGust(WindGust const &gust)
+{
+    m_Settings.gusts.push_back(gust);
+    m_Dirty = true;
+}
+
+void WindField::clearGusts()
+{
+    m_Settings.gusts.clear();
+    m_Dirty = true;
+}
+
+std::vector<WindGust> const &WindField::getGusts() const
+{
+    return m_Settings.gusts;
+}
+
+void WindField::update(double time)
+{
+    updateGrid(time);
+
+    if (!m_Simulated || time - m_SolveTime < 1.0 / m_SolverRate)
+    {
+        return;
+    }
+
+    if (m_Obstacles && !m_Voxelized)
+    {
+        m_Solver.voxelize(*m_Obstacles);
+        m_Voxelized = true;
+    }
+
+    float dt = (float)std::min(time - m_SolveTime, kMaxSolverStep);
+    m_Solver.step(dt, [this](glm::vec3 const &p) { return glm::vec3(lookup(p)); });
+    m_SolveTime = time;
+}
+
+void WindField::updateGrid(double time)
+{
+    if (!m_Building)
+    {
+        if (!m_Dirty && !isAnimated())
+        {
+            return;
+        }
+
+        // The grid is shown once it is complete, so build it for that time.
+        m_Pending = m_Settings;
+        m_Pending.time = m_Ready ? time + kRegenerationPeriod : time;
+        m_StartTime = time;
+        m_FilledSlices = 0;
+        m_Building = true;
+        m_Dirty = false;
+    }
+
+    // Without a grid yet there is nothing to read meanwhile, so fill it all.
+    int target = m_Resolution.z;
+    if (m_Ready)
+    {
+        double progress = std::min((time - m_StartTime) / kRegenerationPeriod, 1.0);
+        target = std::max((int)std::ceil(progress * m_Resolution.z), m_FilledSlices + 1);
+        target = std::min(target, m_Resolution.z);
+    }
+
+    fillSlices(m_FilledSlices, target);
+    m_FilledSlices = target;
+
+    if (m_FilledSlices == m_Resolution.z)
+    {
+        std::swap(m_Front, m_Back);
+        m_Building = false;
+        m_Ready = true;
+    }
+}
+
+glm::vec3 WindField::sample(glm::vec3 const &p) const
+{
+    return m_Simulated ? m_Solver.sample(p) : glm::vec3(lookup(p));
+}
+
+void WindField::sample(glm::vec3 const *points, std::size_t count, glm::vec3 *winds) const
+{
+    if (m_Simulated)
+    {
+        m_Solver.sample(points, count, winds);
+        return;
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        winds[i] = glm::vec3(lookup(points[i]));
+    }
+}
+
+void WindField::drawGui()
+{
+    ImGui::SetNextWindowSize(ImVec2(300, 200), ImGuiSetCond_FirstUseEver);
+
+    // Create an ImGui window for the turbulence and gusts.
+    ImGui::Begin("Wind Options");
+    bool changed = ImGui::SliderFloat("Turbulence", &m_Settings.strength, 0.0f, 20.0f);
+    changed |= ImGui::SliderFloat("Turbulence Scale", &m_Settings.scale, 2.0f, 32.0f);
+
+    for (std::size_t i = 0; i < m_Settings.gusts.size(); ++i)
+    {
+        WindGust &gust = m_Settings.gusts[i];
+        ImGui::PushID((int)i);
+        ImGui::Text("Gust %d", (int)i);
+        changed |= ImGui::SliderFloat3("Center", &gust.center.x, -12.0f, 12.0f);
+        changed |= ImGui::SliderFloat("Radius", &gust.radius, 0.5f, 12.0f);
+        changed |= ImGui::SliderFloat3("Velocity", &gust.velocity.x, -50.0f, 50.0f);
+        changed |= ImGui::SliderFloat("Period", &gust.period, 0.0f, 10.0f);
+        if (ImGui::Button("Remove"))
+        {
+            m_Settings.gusts.erase(m_Settings.gusts.begin() + i);
+            changed = true;
+        }
+        ImGui::PopID();
+    }
+
+    if (ImGui::Button("Add Gust"))
+    {
+        m_Settings.gusts.push_back({ glm::vec3(0.0f, 6.0f, 0.0f), 4.0f, glm::vec3(10.0f, 0.0f, 0.0f), 2.0f });
+        changed = true;
+    }
+
+    // Flow around the scene geometry.
+    ImGui::Checkbox("Simulate Obstacles", &m_Simulated);
+    if (m_Simulated)
+    {
+        ImGui::SliderFloat("Solver Rate", &m_SolverRate, 5.0f, 60.0f);
+        int resolution = m_Solver.getResolution();
+        if (ImGui::SliderInt("Solver Resolution", &resolution, 16, 96))
+        {
+            m_Solver.setResolution(resolution);
+            m_Voxelized = false;
+        }
+        ImGui::Text("Solver step %.2f ms, %d iterations", m_Solver.getStepTime() * 1000.0f,
+            m_Solver.getIterations());
+    }
+    ImGui::End();
+
+    m_Dirty |= changed;
+}
+
+glm::vec3 WindField::evaluate(Settings const &settings, glm::vec3 const &p) const
+{
+    glm::vec3 wind = settings.baseWind;
+
+    if (settings.strength > 0.0f)
+    {
+        // Curl of a noise potential, which is divergence free, so the
+        // turbulence swirls without bunching the flakes up or thinning them out.
+        glm::vec3 u = p / settings.scale;
+        float t = (float)settings.time * kNoiseSpeed;
+        auto derivative = [&](int component, int axis)
+        {
+            glm::vec3 step(0.0f);
+            step[axis] = kCurlStep;
+            glm::vec3 q = u + kPotentialOffsets[component];
+            return (glm::simplex(glm::vec4(q + step, t)) -
+                glm::simplex(glm::vec4(q - step, t))) / (2.0f * kCurlStep);
+        };
+
+        glm::vec3 curl(derivative(2, 1) - derivative(1, 2),
+            derivative(0, 2) - derivative(2, 0),
+            derivative(1, 0) - derivative(0, 1));
+        wind += settings.strength * curl;
+    }
+
+    for (WindGust const &gust : settings.gusts)
+    {
+        float d2 = glm::length2(p - gust.center) / (gust.radius * gust.radius);
+        if (d2 >= 1.0f)
+        {
+            continue;
+        }
+
+        float falloff = (1.0f - d2) * (1.0f - d2);
+        float pulse = (gust.period > 0.0f) ?
+            0.5f - 0.5f * std::cos(glm::two_pi<float>() * (float)(settings.time / gust.period)) : 1.0f;
+        wind += falloff * pulse * gust.velocity;
+    }
+
+    return wind;
+}
+
+void WindField::fillSlices(int begin, int end)
+{
+    std::size_t sliceSize = (std::size_t)m_Resolution.x * m_Resolution.y;
+    atlas::core::parallelFor(begin, end, [&](std::size_t z)
+    {
+        glm::vec4 *slice = &m_Back[z * sliceSize];
+        for (int y = 0; y < m_Resolution.y; ++y)
+        {
+            for (int x = 0; x < m_Resolution.x; ++x)
+            {
+                glm::vec3 p = m_Origin + glm::vec3(x, y, (float)z) * m_CellSize;
+                slice[y * m_Resolution.x + x] = glm::vec4(evaluate(m_Pending, p), 0.0f);
+            }
+        }
+    });
+}
+
+bool WindField::isAnimated() const
+{
+    if (m_Settings.strength > 0.0f)
+    {
+        return true;
+    }
+
+    for (WindGust const &gust : m_Settings.gusts)
+    {
+        if (gust.period > 0.0f)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+glm::vec4 WindField::lookup(glm::vec3 const &p) const
+{
+    // Points outside take the wind at the nearest border.
+    glm::vec3 g = glm::clamp((p - m_Origin) / m_CellSize, glm::vec3(0.0f),
+        glm::vec3(m_Resolution - 1));
+    glm::ivec3 cell = glm::min(glm::ivec3(g), m_Resolution - 2);
+    glm::vec3 f = g - glm::vec3(cell);
+
+    std::size_t sy = (std::size_t)m_Resolution.x;
+    std::size_t sz = (std::size_t)m_Resolution.x * m_Resolution.y;
+    std::size_t i = cell.x + cell.y * sy + cell.z * sz;
+
+    // Every corner is a full vec4, so each blend is one 4-wide operation.
+    glm::vec4 x00 = glm::mix(m_Front[i], m_Front[i + 1], f.x);
+    glm::vec4 x10 = glm::mix(m_Front[i + sy], m_Front[i + sy + 1], f.x);
+    glm::vec4 x01 = glm::mix(m_Front[i + sz], m_Front[i + sz + 1], f.x);
+    glm::vec4 x11 = glm::mix(m_Front[i + sz + sy], m_Front[i + sz + sy + 1], f.x);
+
+    return glm::mix(glm::mix(x00, x10, f.y), glm::mix(x01, x11, f.y), f.z);
+}
@@ -0,0 +1,752 @@
+#include "WindSolver.hpp"
+#include <atlas/core/Parallel.hpp>
+#include <atlas/core/Timer.hpp>
+#include <algorithm>
+#include <cmath>
+
+// How quickly the flow is pulled back towards the ambient wind, per second.
+// Slow enough that a wake survives for a few metres behind an obstacle.
+static const float kRelaxRate = 0.5f;
+
+// The pressure solve stops at this residual relative to the divergence, or
+// after this many iterations; the warm start keeps the count low.
+static const float kTolerance = 1e-2f;
+static const int kMaxIterations = 20;
+
+namespace
+{
+    enum FaceKind : std::uint8_t
+    {
+        kFluidFace,
+        kWallFace,
+        kOpenFace
+    };
+
+    // Barrier for the threads of one step. Waiters sleep on a condition
+    // variable, so a slow slab does not burn the cores the other workers of
+    // the application need.
+    class Barrier
+    {
+        public:
+
+            explicit Barrier(int count) :
+                m_Count(count),
+                m_Waiting(0),
+                m_Generation(0)
+            {
+            }
+
+            void wait()
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                unsigned generation = m_Generation;
+                if (++m_Waiting == m_Count)
+                {
+                    m_Waiting = 0;
+                    ++m_Generation;
+                    lock.unlock();
+                    m_Released.notify_all();
+                    return;
+                }
+
+                m_Released.wait(lock, [this, generation] { return m_Generation != generation; });
+            }
+
+        private:
+
+            int m_Count;
+            int m_Waiting;
+            unsigned m_Generation;
+            std::mutex m_Mutex;
+            std::condition_variable m_Released;
+    };
+
+    glm::ivec3 unitAxis(int axis)
+    {
+        glm::ivec3 e(0);
+        e[axis] = 1;
+        return e;
+    }
+
+    // Trilinear lookup in a grid of the given size, in grid coordinates,
+    // clamped to the border.
+    template <typename T>
+    T interpolate(T const *data, glm::ivec3 const &size, glm::vec3 g)
+    {
+        g = glm::clamp(g, glm::vec3(0.0f), glm::vec3(size - 1));
+        glm::ivec3 c = glm::min(glm::ivec3(g), size - 2);
+        glm::vec3 f = g - glm::vec3(c);
+
+        std::size_t sy = (std::size_t)size.x;
+        std::size_t sz = (std::size_t)size.x * size.y;
+        std::size_t i = c.x + c.y * sy + c.z * sz;
+
+        T x00 = glm::mix(data[i], data[i + 1], f.x);
+        T x10 = glm::mix(data[i + sy], data[i + sy + 1], f.x);
+        T x01 = glm::mix(data[i + sz], data[i + sz + 1], f.x);
+        T x11 = glm::mix(data[i + sz + sy], data[i + sz + sy + 1], f.x);
+        return glm::mix(glm::mix(x00, x10, f.y), glm::mix(x01, x11, f.y), f.z);
+    }
+}
+
+class WindSolver::Step
+{
+    public:
+
+        Step(WindSolver &solver, float dt, std::function<glm::vec3(glm::vec3 const &)> const &ambient, int threads) :
+            m_Solver(solver),
+            m_Dt(dt),
+            m_Ambient(ambient),
+            m_Threads(threads),
+            m_Barrier(threads),
+            m_Partials(3 * threads, 0.0),
+            m_Zero(solver.m_Cells.x, 0.0f),
+            m_Iterations(0)
+        {
+        }
+
+        void run(int thread)
+        {
+            int begin = m_Solver.m_Cells.z * thread / m_Threads;
+            int end = m_Solver.m_Cells.z * (thread + 1) / m_Threads;
+
+            sampleAmbient(begin, end);
+            m_Barrier.wait();
+
+            // The last thread also owns the z faces on the far side.
+            int faceEnd = (thread == m_Threads - 1) ? end + 1 : end;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                advect(axis, begin, (axis == 2) ? faceEnd : end);
+            }
+            m_Barrier.wait();
+
+            project(thread, begin, end);
+
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                applyPressure(axis, begin, (axis == 2) ? faceEnd : end);
+            }
+            m_Barrier.wait();
+
+            bake(begin, end);
+        }
+
+        int getIterations() const
+        {
+            return m_Iterations;
+        }
+
+    private:
+
+        std::size_t cell(int i, int j, int k) const
+        {
+            glm::ivec3 const &n = m_Solver.m_Cells;
+            return (std::size_t)i + (std::size_t)n.x * ((std::size_t)j + (std::size_t)n.y * k);
+        }
+
+        void sampleAmbient(int begin, int end)
+        {
+            glm::ivec3 const &n = m_Solver.m_Cells;
+            for (int k = begin; k < end; ++k)
+            {
+                for (int j = 0; j < n.y; ++j)
+                {
+                    for (int i = 0; i < n.x; ++i)
+                    {
+                        glm::vec3 p = m_Solver.m_Origin + (glm::vec3(i, j, k) + 0.5f) * m_Solver.m_CellSize;
+                        m_Solver.m_Ambient[cell(i, j, k)] = glm::vec4(m_Ambient(p), 0.0f);
+                    }
+                }
+            }
+        }
+
+        // Semi-Lagrangian advection of one face array, traced back through
+        // the cell centred velocity baked at the end of the last step.
+        void advect(int axis, int begin, int end)
+        {
+            glm::ivec3 const &n = m_Solver.m_Cells;
+            glm::ivec3 e = unitAxis(axis);
+            glm::ivec3 d = n + e;
+            glm::vec3 half = 0.5f * glm::vec3(e);
+
+            float const *faces = m_Solver.m_Faces[axis].data();
+            float *advected = m_Solver.m_Advected[axis].data();
+            std::uint8_t const *kinds = m_Solver.m_FaceKinds[axis].data();
+            glm::vec4 const *velocity = m_Solver.m_Velocity.data();
+            glm::vec4 const *ambient = m_Solver.m_Ambient.data();
+
+            // Velocities in cells per step.
+            float scale = m_Dt / m_Solver.m_CellSize;
+            float relax = 1.0f - std::exp(-kRelaxRate * m_Dt);
+
+            for (int k = begin; k < end; ++k)
+            {
+                for (int j = 0; j < d.y; ++j)
+                {
+                    std::size_t row = (std::size_t)d.x * ((std::size_t)j + (std::size_t)d.y * k);
+                    for (int i = 0; i < d.x; ++i)
+                    {
+                        std::size_t index = row + i;
+                        if (kinds[index] == kWallFace)
+                        {
+                            advected[index] = 0.0f;
+                            continue;
+                        }
+
+                        // Ambient wind at the face, from the cells beside it.
+                        glm::ivec3 c1(i, j, k);
+                        glm::ivec3 a0 = glm::clamp(c1 - e, glm::ivec3(0), n - 1);
+                        glm::ivec3 a1 = glm::min(c1, n - 1);
+                        float target = 0.5f * (ambient[cell(a0.x, a0.y, a0.z)][axis] +
+                            ambient[cell(a1.x, a1.y, a1.z)][axis]);
+
+                        // Faces on the open sides take the ambient wind.
+                        if (kinds[index] == kOpenFace)
+                        {
+                            advected[index] = target;
+                            continue;
+                        }
+
+                        // Trace back along the flow, in the coordinates of the
+                        // cell centres. At the solver rate the wind moves less
+                        // than a cell per step, so one Euler step will do.
+                        glm::vec3 x = glm::vec3(c1) - half;
+                        glm::vec3 from = x - scale * glm::vec3(interpolate(velocity, n, x));
+
+                        float value = interpolate(faces, d, from + half);
+                        advected[index] = value + relax * (target - value);
+                    }
+                }
+            }
+        }
+
+        // Applies the pressure Laplacian to one row of the search direction.
+        // The search direction is zero in solid cells, so their neighbours
+        // are summed without looking at them, and the rows past the open
+        // sides read as zero, so only the ends of the row need care.
+        void laplacian(float const *s, float *out, int j, int k) const
+        {
+            glm::ivec3 const &n = m_Solver.m_Cells;
+            std::size_t sy = (std::size_t)n.x;
+            std::size_t sz = (std::size_t)n.x * n.y;
+            std::size_t c = cell(0, j, k);
+
+            float const *row = s + c;
+            float const *below = (j > 0) ? row - sy : m_Zero.data();
+            float const *above = (j < n.y - 1) ? row + sy : m_Zero.data();
+            float const *behind = (k > 0) ? row - sz : m_Zero.data();
+            float const *ahead = (k < n.z - 1) ? row + sz : m_Zero.data();
+            float const *diagonal = m_Solver.m_Diagonal.data() + c;
+            std::uint8_t const *solid = m_Solver.m_Solid.data() + c;
+
+            for (int i = 0; i < n.x; ++i)
+            {
+                float left = (i > 0) ? row[i - 1] : 0.0f;
+                float right = (i < n.x - 1) ? row[i + 1] : 0.0f;
+                float sum = diagonal[i] * row[i] - left - right - below[i] - above[i] - behind[i] - ahead[i];
+                out[c + i] = solid[i] ? 0.0f : sum;
+            }
+        }
+
+        // Sums the partials of one reduction. Every thread adds them in the
+        // same order, so all of them take the same decisions.
+        double reduce(int slot) const
+        {
+            double sum = 0.0;
+            for (int t = 0; t < m_Threads; ++t)
+            {
+                sum += m_Partials[slot * m_Threads + t];
+            }
+            return sum;
+        }
+
+        double reduceMax(int slot) const
+        {
+            double result = 0.0;
+            for (int t = 0; t < m_Threads; ++t)
+            {
+                result = std::max(result, m_Partials[slot * m_Threads + t]);
+            }
+            return result;
+        }
+
+        // Solves for the pressure that removes the divergence of the
+        // advected flow, by conjugate gradients with a Jacobi preconditioner.
+        void project(int thread, int begin, int end)
+        {
+            glm::ivec3 const &n = m_Solver.m_Cells;
+            glm::ivec3 dx = n + unitAxis(0), dy = n + unitAxis(1);
+            float const *u = m_Solver.m_Advected[0].data();
+            float const *v = m_Solver.m_Advected[1].data();
+            float const *w = m_Solver.m_Advected[2].data();
+            std::uint8_t const *solid = m_Solver.m_Solid.data();
+            float const *inverse = m_Solver.m_InverseDiagonal.data();
+            float *p = m_Solver.m_Pressure.data();
+            float *r = m_Solver.m_Residual.data();
+            float *s = m_Solver.m_Search.data();
+            float *q = m_Solver.m_Product.data();
+            float *z = m_Solver.m_Preconditioned.data();
+            std::size_t first = cell(0, 0, begin);
+            std::size_t last = cell(0, 0, end);
+
+            // The warm start needs the old pressure of the neighbouring
+            // slabs, so it is applied through the search vector.
+            for (std::size_t c = first; c < last; ++c)
+            {
+                s[c] = p[c];
+            }
+            m_Barrier.wait();
+
+            double rz = 0.0, bMax = 0.0;
+            for (int k = begin; k < end; ++k)
+            {
+                for (int j = 0; j < n.y; ++j)
+                {
+                    std::size_t c = cell(0, j, k);
+                    std::size_t fu = (std::size_t)dx.x * ((std::size_t)j + (std::size_t)dx.y * k);
+                    std::size_t fv = (std::size_t)dy.x * ((std::size_t)j + (std::size_t)dy.y * k);
+                    std::size_t fw = c;
+                    std::size_t sv = (std::size_t)n.x;
+                    std::size_t sw = (std::size_t)n.x * n.y;
+                    laplacian(s, q, j, k);
+                    for (int i = 0; i < n.x; ++i, ++c, ++fu, ++fv, ++fw)
+                    {
+                        if (solid[c])
+                        {
+                            r[c] = z[c] = 0.0f;
+                            continue;
+                        }
+
+                        float divergence = u[fu + 1] - u[fu] + v[fv + sv] - v[fv] + w[fw + sw] - w[fw];
+                        r[c] = -divergence - q[c];
+                        z[c] = r[c] * inverse[c];
+                        rz += (double)r[c] * z[c];
+                        bMax = std::max(bMax, (double)std::abs(divergence));
+                    }
+                }
+            }
+            m_Partials[thread] = rz;
+            m_Partials[m_Threads + thread] = bMax;
+            m_Barrier.wait();
+
+            rz = reduce(0);
+            double tolerance = kTolerance * reduceMax(1);
+            m_Barrier.wait();
+
+            for (std::size_t c = first; c < last; ++c)
+            {
+                s[c] = z[c];
+            }
+            m_Barrier.wait();
+
+            int iteration = 0;
+            while (iteration < kMaxIterations && rz > 0.0)
+            {
+                ++iteration;
+
+                double sq = 0.0;
+                for (int k = begin; k < end; ++k)
+                {
+                    for (int j = 0; j < n.y; ++j)
+                    {
+                        std::size_t c = cell(0, j, k);
+                        laplacian(s, q, j, k);
+                        float rowSum = 0.0f;
+                        for (int i = 0; i < n.x; ++i)
+                        {
+                            rowSum += s[c + i] * q[c + i];
+                        }
+                        sq += rowSum;
+                    }
+                }
+                m_Partials[thread] = sq;
+                m_Barrier.wait();
+
+                float alpha = (float)(rz / reduce(0));
+                double rzNext = 0.0, rMax = 0.0;
+                for (std::size_t c = first; c < last; ++c)
+                {
+                    p[c] += alpha * s[c];
+                    r[c] -= alpha * q[c];
+                    z[c] = r[c] * inverse[c];
+                    rzNext += (double)r[c] * z[c];
+                    rMax = std::max(rMax, (double)std::abs(r[c]));
+                }
+                m_Partials[m_Threads + thread] = rzNext;
+                m_Partials[2 * m_Threads + thread] = rMax;
+                m_Barrier.wait();
+
+                double beta = reduce(1) / rz;
+                rz = reduce(1);
+                if (reduceMax(2) <= tolerance)
+                {
+                    break;
+                }
+
+                for (std::size_t c = first; c < last; ++c)
+                {
+                    s[c] = z[c] + (float)beta * s[c];
+                }
+                m_Barrier.wait();
+            }
+
+            if (thread == 0)
+            {
+                m_Iterations = iteration;
+            }
+            m_Barrier.wait();
+        }
+
+        void applyPressure(int axis, int begin, int end)
+        {
+            glm::ivec3 const &n = m_Solver.m_Cells;
+            glm::ivec3 e = unitAxis(axis);
+            glm::ivec3 d = n + e;
+            float *advected = m_Solver.m_Advected[axis].data();
+            std::uint8_t const *kinds = m_Solver.m_FaceKinds[axis].data();
+            float const *p = m_Solver.m_Pressure.data();
+            std::size_t stride = (axis == 0) ? 1 : (axis == 1) ? (std::size_t)n.x : (std::size_t)n.x * n.y;
+
+            for (int k = begin; k < end; ++k)
+            {
+                for (int j = 0; j < d.y; ++j)
+                {
+                    std::size_t index = (std::size_t)d.x * ((std::size_t)j + (std::size_t)d.y * k);
+                    for (int i = 0; i < d.x; ++i, ++index)
+                    {
+                        if (kinds[index] == kWallFace)
+                        {
+                            continue;
+                        }
+
+                        int along = (axis == 0) ? i : (axis == 1) ? j : k;
+                        if (kinds[index] == kFluidFace)
+                        {
+                            std::size_t c1 = cell(i, j, k);
+                            advected[index] -= p[c1] - p[c1 - stride];
+                        }
+                        else if (along == 0)
+                        {
+                            // Outside the open sides the pressure is zero.
+                            advected[index] -= p[cell(i, j, k)];
+                        }
+                        else
+                        {
+                            glm::ivec3 c0 = glm::ivec3(i, j, k) - e;
+                            advected[index] += p[cell(c0.x, c0.y, c0.z)];
+                        }
+                    }
+                }
+            }
+        }
+
+        void bake(int begin, int end)
+        {
+            glm::ivec3 const &n = m_Solver.m_Cells;
+            glm::ivec3 dx = n + unitAxis(0), dy = n + unitAxis(1);
+            float const *u = m_Solver.m_Advected[0].data();
+            float const *v = m_Solver.m_Advected[1].data();
+            float const *w = m_Solver.m_Advected[2].data();
+            std::size_t sv = (std::size_t)n.x;
+            std::size_t sw = (std::size_t)n.x * n.y;
+
+            for (int k = begin; k < end; ++k)
+            {
+                for (int j = 0; j < n.y; ++j)
+                {
+                    std::size_t c = cell(0, j, k);
+                    std::size_t fu = (std::size_t)dx.x * ((std::size_t)j + (std::size_t)dx.y * k);
+                    std::size_t fv = (std::size_t)dy.x * ((std::size_t)j + (std::size_t)dy.y * k);
+                    for (int i = 0; i < n.x; ++i, ++c, ++fu, ++fv)
+                    {
+                        glm::vec4 velocity(0.0f);
+                        if (!m_Solver.m_Solid[c])
+                        {
+                            velocity.x = 0.5f * (u[fu] + u[fu + 1]);
+                            velocity.y = 0.5f * (v[fv] + v[fv + sv]);
+                            velocity.z = 0.5f * (w[c] + w[c + sw]);
+                        }
+                        m_Solver.m_Velocity[c] = velocity;
+                    }
+                }
+            }
+        }
+
+        WindSolver &m_Solver;
+        float m_Dt;
+        std::function<glm::vec3(glm::vec3 const &)> const &m_Ambient;
+        int m_Threads;
+        Barrier m_Barrier;
+
+        // Three reductions of one partial per thread.
+        std::vector<double> m_Partials;
+
+        // Stands in for the rows past the open sides.
+        std::vector<float> m_Zero;
+        int m_Iterations;
+};
+
+WindSolver::WindSolver(glm::vec3 const &origin, glm::vec3 const &size, int resolution) :
+    m_Origin(origin),
+    m_Size(size),
+    m_Resolution(resolution),
+    m_StepTime(0.0f),
+    m_Iterations(0),
+    m_Work(nullptr),
+    m_Generation(0),
+    m_Running(0),
+    m_Stopping(false)
+{
+    resize();
+}
+
+WindSolver::~WindSolver()
+{
+    stopWorkers();
+}
+
+void WindSolver::setResolution(int resolution)
+{
+    if (resolution != m_Resolution)
+    {
+        m_Resolution = resolution;
+        resize();
+    }
+}
+
+int WindSolver::getResolution() const
+{
+    return m_Resolution;
+}
+
+void WindSolver::voxelize(atlas::utils::DistanceField const &field)
+{
+    glm::ivec3 n = m_Cells;
+    auto index = [n](glm::ivec3 const &c)
+    {
+        return (std::size_t)c.x + (std::size_t)n.x * ((std::size_t)c.y + (std::size_t)n.y * c.z);
+    };
+    auto isInside = [n](glm::ivec3 const &c)
+    {
+        return c.x >= 0 && c.x < n.x && c.y >= 0 && c.y < n.y && c.z >= 0 && c.z < n.z;
+    };
+
+    atlas::core::parallelFor(0, n.z, [&](std::size_t k)
+    {
+        for (int j = 0; j < n.y; ++j)
+        {
+            for (int i = 0; i < n.x; ++i)
+            {
+                glm::vec3 p = m_Origin + (glm::vec3(i, j, (float)k) + 0.5f) * m_CellSize;
+                bool solid = p.y < 0.0f || (!field.empty() && field.sample(p) < 0.0f);
+                m_Solid[index(glm::ivec3(i, j, (int)k))] = solid ? 1 : 0;
+            }
+        }
+    });
+
+    // The bottom of the domain and solid cells are walls; past the other
+    // sides the pressure is zero.
+    auto isWall = [&](glm::ivec3 const &c)
+    {
+        return c.y < 0 || (isInside(c) && m_Solid[index(c)]);
+    };
+
+    atlas::core::parallelFor(0, n.z, [&](std::size_t k)
+    {
+        for (int j = 0; j < n.y; ++j)
+        {
+            for (int i = 0; i < n.x; ++i)
+            {
+                glm::ivec3 c(i, j, (int)k);
+                int count = 0;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    count += isWall(c - unitAxis(axis)) ? 0 : 1;
+                    count += isWall(c + unitAxis(axis)) ? 0 : 1;
+                }
+
+                // Solid cells keep a unit diagonal so they stay at zero.
+                float diagonal = m_Solid[index(c)] ? 1.0f : (float)std::max(count, 1);
+                m_Diagonal[index(c)] = diagonal;
+                m_InverseDiagonal[index(c)] = 1.0f / diagonal;
+            }
+        }
+    });
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        glm::ivec3 e = unitAxis(axis);
+        glm::ivec3 d = n + e;
+        std::vector<std::uint8_t> &kinds = m_FaceKinds[axis];
+        atlas::core::parallelFor(0, d.z, [&](std::size_t k)
+        {
+            for (int j = 0; j < d.y; ++j)
+            {
+                for (int i = 0; i < d.x; ++i)
+                {
+                    glm::ivec3 c1(i, j, (int)k);
+                    glm::ivec3 c0 = c1 - e;
+                    FaceKind kind = kFluidFace;
+                    if (isWall(c0) || isWall(c1))
+                    {
+                        kind = kWallFace;
+                    }
+                    else if (!isInside(c0) || !isInside(c1))
+                    {
+                        kind = kOpenFace;
+                    }
+                    kinds[i + (std::size_t)d.x * (j + (std::size_t)d.y * k)] = kind;
+                }
+            }
+        });
+    }
+
+    std::fill(m_Pressure.begin(), m_Pressure.end(), 0.0f);
+    std::fill(m_Search.begin(), m_Search.end(), 0.0f);
+}
+
+void WindSolver::step(float dt, std::function<glm::vec3(glm::vec3 const &)> const &ambient)
+{
+    atlas::core::Timer<float> timer;
+    timer.start();
+
+    // One thread per core runs every phase on its own slab of z slices.
+    // The workers are kept between steps and only restarted when the
+    // number of slabs changes.
+    int threads = (int)std::min<unsigned>(std::max(1u, std::thread::hardware_concurrency()),
+        (unsigned)m_Cells.z);
+    if ((int)m_Workers.size() != threads - 1)
+    {
+        stopWorkers();
+        startWorkers(threads - 1);
+    }
+
+    Step work(*this, dt, ambient, threads);
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Work = &work;
+        m_Running = threads - 1;
+        ++m_Generation;
+    }
+    m_Wake.notify_all();
+
+    work.run(0);
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Done.wait(lock, [this] { return m_Running == 0; });
+        m_Work = nullptr;
+    }
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        std::swap(m_Faces[axis], m_Advected[axis]);
+    }
+
+    m_Iterations = work.getIterations();
+    m_StepTime = timer.elapsed();
+}
+
+void WindSolver::startWorkers(int count)
+{
+    for (int t = 0; t < count; ++t)
+    {
+        m_Workers.emplace_back(&WindSolver::workerLoop, this, t + 1, m_Generation);
+    }
+}
+
+void WindSolver::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+    m_Wake.notify_all();
+
+    for (auto &worker : m_Workers)
+    {
+        worker.join();
+    }
+    m_Workers.clear();
+    m_Stopping = false;
+}
+
+void WindSolver::workerLoop(int thread, unsigned generation)
+{
+    for (;;)
+    {
+        Step *work;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Wake.wait(lock, [this, generation] { return m_Stopping || m_Generation != generation; });
+            if (m_Stopping)
+            {
+                return;
+            }
+            generation = m_Generation;
+            work = m_Work;
+        }
+
+        work->run(thread);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (--m_Running == 0)
+        {
+            m_Done.notify_one();
+        }
+    }
+}
+
+glm::vec3 WindSolver::sample(glm::vec3 const &p) const
+{
+    return glm::vec3(interpolate(m_Velocity.data(), m_Cells, (p - m_Origin) / m_CellSize - 0.5f));
+}
+
+void WindSolver::sample(glm::vec3 const *points, std::size_t count, glm::vec3 *winds) const
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        winds[i] = glm::vec3(interpolate(m_Velocity.data(), m_Cells, (points[i] - m_Origin) / m_CellSize - 0.5f));
+    }
+}
+
+float WindSolver::getStepTime() const
+{
+    return m_StepTime;
+}
+
+int WindSolver::getIterations() const
+{
+    return m_Iterations;
+}
+
+void WindSolver::resize()
+{
+    float longest = std::max(m_Size.x, std::max(m_Size.y, m_Size.z));
+    m_CellSize = longest / m_Resolution;
+    m_Cells = glm::max(glm::ivec3(glm::ceil(m_Size / m_CellSize)), glm::ivec3(2));
+
+    std::size_t count = (std::size_t)m_Cells.x * m_Cells.y * m_Cells.z;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        glm::ivec3 d = m_Cells + unitAxis(axis);
+        std::size_t faces = (std::size_t)d.x * d.y * d.z;
+        m_Faces[axis].assign(faces, 0.0f);
+        m_Advected[axis].assign(faces, 0.0f);
+        m_FaceKinds[axis].assign(faces, kFluidFace);
+    }
+
+    m_Solid.assign(count, 0);
+    m_Diagonal.assign(count, 1.0f);
+    m_InverseDiagonal.assign(count, 1.0f);
+    m_Pressure.assign(count, 0.0f);
+    m_Residual.assign(count, 0.0f);
+    m_Search.assign(count, 0.0f);
+    m_Product.assign(count, 0.0f);
+    m_Preconditioned.assign(count, 0.0f);
+    m_Ambient.assign(count, glm::vec4(0.0f));
+    m_Velocity.assign(count, glm::vec4(0.0f));
+
+    // Without scene geometry there is still the ground.
+    voxelize(atlas::utils::DistanceField());
+}
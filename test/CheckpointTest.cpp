@@ -0,0 +1,188 @@
+#include "SnowCheckpoint.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Writes a checkpoint, checks that every section and the table are aligned
+// and that the sections read back unchanged, then damages the file in ways
+// a reader must refuse. Returns nonzero if any check fails.
+
+static const char *kFilename = "CheckpointTest.snap";
+
+static const std::uint32_t kTagBytes = checkpointTag("BYTE");
+static const std::uint32_t kTagFloats = checkpointTag("FLTS");
+static const std::uint32_t kTagValue = checkpointTag("VALU");
+static const std::uint32_t kTagEmpty = checkpointTag("EMPT");
+
+static int gFailures = 0;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        std::printf("FAILED: %s\n", what);
+        ++gFailures;
+    }
+}
+
+static std::vector<char> readFile()
+{
+    std::vector<char> bytes;
+    if (std::FILE *file = std::fopen(kFilename, "rb"))
+    {
+        char buffer[4096];
+        std::size_t read;
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            bytes.insert(bytes.end(), buffer, buffer + read);
+        }
+        std::fclose(file);
+    }
+    return bytes;
+}
+
+static void writeFile(std::vector<char> const &bytes)
+{
+    if (std::FILE *file = std::fopen(kFilename, "wb"))
+    {
+        std::fwrite(bytes.data(), 1, bytes.size(), file);
+        std::fclose(file);
+    }
+}
+
+// Whether a reader accepts the file and finds the float section in it.
+static bool readsFloats()
+{
+    CheckpointReader reader;
+    std::vector<float> floats;
+    return reader.open(kFilename) && reader.readSection(kTagFloats, floats);
+}
+
+int main()
+{
+    // Sizes that leave every section, and the end of the last one, off the
+    // 64 byte boundaries.
+    std::vector<std::uint8_t> bytes = { 1, 2, 3 };
+    std::vector<float> floats(13);
+    for (std::size_t i = 0; i < floats.size(); ++i)
+    {
+        floats[i] = 0.5f * i - 2.0f;
+    }
+    double value = 3.25;
+
+    CheckpointWriter writer;
+    check(writer.open(kFilename, kCheckpointQuantized), "the writer opens the file");
+    writer.writeSection(kTagBytes, bytes);
+    writer.writeSection(kTagFloats, floats);
+    writer.writeValue(kTagValue, value);
+    writer.writeSection(kTagEmpty, std::vector<std::uint32_t>());
+    check(writer.close(), "the writer closes the file");
+
+    std::vector<char> file = readFile();
+    CheckpointHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    check(header.sectionCount == 4, "the header counts the sections");
+    check(header.tableOffset % 64 == 0, "the section table is aligned");
+    check(header.tableOffset + header.sectionCount * sizeof(CheckpointSection) == file.size(),
+        "the section table ends the file");
+
+    bool aligned = true;
+    for (std::uint64_t s = 0; s < header.sectionCount; ++s)
+    {
+        CheckpointSection section;
+        std::memcpy(&section, file.data() + header.tableOffset + s * sizeof(section), sizeof(section));
+        aligned = aligned && section.offset % 64 == 0;
+    }
+    check(aligned, "every section is aligned");
+
+    {
+        CheckpointReader reader;
+        check(reader.open(kFilename), "the reader opens the file");
+        check(reader.getFlags() == kCheckpointQuantized, "the flags read back");
+
+        std::vector<std::uint8_t> readBytes;
+        std::vector<float> readFloats;
+        std::vector<std::uint32_t> readEmpty(5);
+        double readValue = 0.0;
+        check(reader.readSection(kTagBytes, readBytes) && readBytes == bytes, "the bytes read back");
+        check(reader.readSection(kTagFloats, readFloats) && readFloats == floats, "the floats read back");
+        check(reader.readValue(kTagValue, readValue) && readValue == value, "the value reads back");
+        check(reader.readSection(kTagEmpty, readEmpty) && readEmpty.empty(), "the empty section reads back");
+
+        std::size_t count;
+        check(reader.findSection(kTagFloats, 4, count) &&
+            (reinterpret_cast<std::uintptr_t>(reader.findSection(kTagFloats, 4, count)) % 64) == 0,
+            "sections are aligned in memory");
+
+        std::vector<std::uint16_t> wrongSize;
+        check(!reader.readSection(kTagFloats, wrongSize), "a section of other elements is refused");
+        check(!reader.readSection(checkpointTag("NONE"), wrongSize), "a missing section is refused");
+        check(!reader.readValue(kTagBytes, readValue), "an array is not read as a value");
+    }
+
+    // Damaged copies of the file.
+    std::vector<char> damaged = file;
+    damaged[0] = 'X';
+    writeFile(damaged);
+    check(!readsFloats(), "a file with another magic is refused");
+
+    damaged = file;
+    damaged.resize(40);
+    writeFile(damaged);
+    check(!readsFloats(), "a file shorter than the header is refused");
+
+    damaged = file;
+    damaged.resize(header.tableOffset + sizeof(CheckpointSection));
+    writeFile(damaged);
+    check(!readsFloats(), "a file with the table cut short is refused");
+
+    damaged = file;
+    CheckpointHeader bad = header;
+    bad.version = kCheckpointVersion + 1;
+    std::memcpy(damaged.data(), &bad, sizeof(bad));
+    writeFile(damaged);
+    check(!readsFloats(), "a file of another version is refused");
+
+    // Offsets and counts chosen to wrap a sum past the end of the file.
+    damaged = file;
+    bad = header;
+    bad.tableOffset = ~std::uint64_t(0) - 8;
+    std::memcpy(damaged.data(), &bad, sizeof(bad));
+    writeFile(damaged);
+    check(!readsFloats(), "a table past the end is refused");
+
+    damaged = file;
+    bad = header;
+    bad.sectionCount = ~std::uint64_t(0) / sizeof(CheckpointSection) + 2;
+    std::memcpy(damaged.data(), &bad, sizeof(bad));
+    writeFile(damaged);
+    check(!readsFloats(), "a table too long for the file is refused");
+
+    damaged = file;
+    CheckpointSection section;
+    std::size_t entry = header.tableOffset + sizeof(CheckpointSection);
+    std::memcpy(&section, damaged.data() + entry, sizeof(section));
+    section.count = ~std::uint64_t(0) / 4 + 1;
+    std::memcpy(damaged.data() + entry, &section, sizeof(section));
+    writeFile(damaged);
+    check(!readsFloats(), "a section too long for the file is refused");
+
+    damaged = file;
+    section.count = floats.size();
+    section.offset = ~std::uint64_t(0) - 16;
+    std::memcpy(damaged.data() + entry, &section, sizeof(section));
+    writeFile(damaged);
+    check(!readsFloats(), "a section past the end is refused");
+
+    std::remove(kFilename);
+
+    if (gFailures > 0)
+    {
+        std::printf("%d checks failed\n", gFailures);
+        return 1;
+    }
+
+    std::printf("All checkpoint checks passed\n");
+    return 0;
+}
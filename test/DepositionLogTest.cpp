@@ -0,0 +1,158 @@
+#include "DepositionLog.hpp"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Records random deposits and shifts on a grid that scrolls now and then,
+// and checks that rebuilding any past time matches the grid as it was then,
+// with cells that were off the grid showing as they came in, and that quiet
+// frames add nothing to the log. Returns nonzero if any check fails.
+
+static const int kGridSize = 51;
+static const int kTileSize = 8;
+
+static int gFailures = 0;
+
+static void check(bool condition, const char *what, float time)
+{
+    if (!condition)
+    {
+        std::printf("FAILED: %s (time %.1f)\n", what, time);
+        ++gFailures;
+    }
+}
+
+// Height of the bare ground at a cell, in cells from where the history
+// started.
+static float groundAt(glm::ivec2 const &cell)
+{
+    return 0.1f * (float)(((cell.x * 7 + cell.y * 13) % 11 + 11) % 11);
+}
+
+// Moves the grid like SnowAccum::setCentre, with bare ground coming in.
+static void scroll(std::vector<glm::vec4> &grid, glm::ivec2 const &shift, glm::ivec2 const &origin)
+{
+    std::vector<glm::vec4> old(grid);
+    for (int row = 0; row < kGridSize; ++row)
+    {
+        for (int col = 0; col < kGridSize; ++col)
+        {
+            int fromRow = row + shift.y, fromCol = col + shift.x;
+            bool inside = fromRow >= 0 && fromRow < kGridSize && fromCol >= 0 && fromCol < kGridSize;
+            grid[row * kGridSize + col] = inside ? old[fromRow * kGridSize + fromCol] :
+                glm::vec4(0.0f, groundAt(origin + glm::ivec2(col, row)), 0.0f, 0.0f);
+        }
+    }
+}
+
+struct Snapshot
+{
+    float time;
+    glm::ivec2 origin;
+    std::vector<glm::vec4> grid;
+};
+
+int main()
+{
+    DepositionLog log(kGridSize, kTileSize, 2048);
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> anyCell(0, kGridSize * kGridSize - 1);
+    std::uniform_int_distribution<int> anyShift(-4, 4);
+    std::uniform_real_distribution<float> amount(0.0f, 0.005f);
+
+    glm::ivec2 origin(0);
+    std::vector<glm::vec4> grid(kGridSize * kGridSize);
+    for (int row = 0; row < kGridSize; ++row)
+    {
+        for (int col = 0; col < kGridSize; ++col)
+        {
+            grid[row * kGridSize + col] = glm::vec4(0.0f, groundAt(glm::ivec2(col, row)), 0.0f, 0.0f);
+        }
+    }
+    log.reset(0.0f, grid);
+
+    std::vector<Snapshot> snapshots;
+    snapshots.push_back({ 0.0f, origin, grid });
+
+    for (int frame = 1; frame <= 300; ++frame)
+    {
+        float time = 0.1f * frame;
+
+        // Every fourth frame is quiet, and must not add to the log.
+        bool quiet = frame % 4 == 0;
+        for (int d = 0; !quiet && d < 40; ++d)
+        {
+            int cell = anyCell(gen);
+            DepositionLog::deposit(grid[cell], log.record(cell, amount(gen)));
+        }
+        for (int s = 0; !quiet && s < 10; ++s)
+        {
+            int cell = anyCell(gen);
+            DepositionLog::shift(grid[cell], log.recordShift(cell, amount(gen) - 0.0025f));
+        }
+
+        // Scroll with this frame's events still open, which must move with
+        // their cells. The grid at the last commit moves the same way.
+        if (frame % 17 == 0)
+        {
+            glm::ivec2 shift(anyShift(gen), anyShift(gen));
+            origin += shift;
+            scroll(grid, shift, origin);
+            scroll(snapshots.back().grid, shift, origin);
+            snapshots.back().origin = origin;
+            log.scroll(log.getLatestTime(), shift, grid);
+        }
+
+        std::size_t size = log.getSizeInBytes();
+        log.commit(time, grid);
+        snapshots.push_back({ time, origin, grid });
+        if (quiet && frame % 17 != 0)
+        {
+            check(log.getSizeInBytes() == size, "a quiet frame adds nothing to the log", time);
+        }
+        check(log.getLatestTime() == time, "the latest time follows the commits", time);
+    }
+
+    std::vector<int> tiles(log.getTileCount());
+    for (int tile = 0; tile < log.getTileCount(); ++tile)
+    {
+        tiles[tile] = tile;
+    }
+
+    for (auto const &snapshot : snapshots)
+    {
+        std::vector<glm::vec4> rebuilt(kGridSize * kGridSize, glm::vec4(-1.0f));
+        log.reconstruct(snapshot.time, tiles, rebuilt);
+
+        bool same = true, bare = true;
+        for (int row = 0; row < kGridSize; ++row)
+        {
+            for (int col = 0; col < kGridSize; ++col)
+            {
+                glm::vec4 const &cell = rebuilt[row * kGridSize + col];
+                glm::ivec2 at = origin + glm::ivec2(col, row) - snapshot.origin;
+                if (at.x >= 0 && at.x < kGridSize && at.y >= 0 && at.y < kGridSize)
+                {
+                    glm::vec4 const &then = snapshot.grid[at.y * kGridSize + at.x];
+                    same = same && cell.y == then.y && cell.w == then.w;
+                }
+                else
+                {
+                    bare = bare && cell.y == groundAt(origin + glm::ivec2(col, row)) && cell.w == 0.0f;
+                }
+            }
+        }
+        check(same, "cells on the grid match the past grid", snapshot.time);
+        check(bare, "cells off the grid show as they came in", snapshot.time);
+    }
+
+    if (gFailures > 0)
+    {
+        std::printf("%d checks failed\n", gFailures);
+        return 1;
+    }
+
+    std::printf("All deposition log checks passed\n");
+    return 0;
+}
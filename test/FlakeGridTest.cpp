@@ -0,0 +1,110 @@
+#include "FlakeGrid.hpp"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Builds the grid over random flakes and checks every query against a brute
+// force search: every flake within the radius is visited once, with its own
+// position, and queries among the flakes visit none further than a cell past
+// the cube. Queries outside the flakes visit the nearest cells instead.
+// Returns nonzero if any check fails.
+
+static int gFailures = 0;
+
+static void check(bool condition, const char *what, const char *layout)
+{
+    if (!condition)
+    {
+        std::printf("FAILED: %s (%s)\n", what, layout);
+        ++gFailures;
+    }
+}
+
+static void checkQueries(FlakeGrid const &grid, std::vector<glm::vec3> const &points, glm::vec3 const &lo,
+    glm::vec3 const &hi, float radius, const char *layout)
+{
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<float> x(lo.x, hi.x), y(lo.y, hi.y), z(lo.z, hi.z);
+
+    bool complete = true, once = true, positions = true, bounded = true;
+    float reach = radius + grid.getCellSize();
+    glm::vec3 first(points[0]), last(points[0]);
+    for (auto const &p : points)
+    {
+        first = glm::min(first, p);
+        last = glm::max(last, p);
+    }
+    for (int q = 0; q < 200; ++q)
+    {
+        glm::vec3 centre(x(gen), y(gen), z(gen));
+        bool inside = glm::all(glm::greaterThanEqual(centre, first)) && glm::all(glm::lessThanEqual(centre, last));
+        std::vector<int> visits(points.size(), 0);
+        grid.forEachNear(centre, radius, [&](std::uint32_t index, glm::vec3 const &p)
+        {
+            ++visits[index];
+            positions = positions && p == points[index];
+            glm::vec3 d = glm::abs(p - centre);
+            bounded = bounded && (!inside || (d.x <= reach && d.y <= reach && d.z <= reach));
+        });
+
+        for (std::size_t i = 0; i < points.size(); ++i)
+        {
+            once = once && visits[i] <= 1;
+            complete = complete && (glm::distance(points[i], centre) > radius || visits[i] == 1);
+        }
+    }
+
+    check(complete, "every flake within the radius is visited", layout);
+    check(once, "no flake is visited twice", layout);
+    check(positions, "flakes are visited with their positions", layout);
+    check(bounded, "no flake is visited from further than a cell past the cube", layout);
+}
+
+int main()
+{
+    std::mt19937 gen(5);
+    FlakeGrid grid(0.25f);
+
+    // Flakes in a small box, queried from inside and around it.
+    std::uniform_real_distribution<float> near(-2.0f, 2.0f);
+    std::vector<glm::vec3> points(5000);
+    for (auto &p : points)
+    {
+        p = glm::vec3(near(gen), near(gen) + 3.0f, near(gen));
+    }
+    grid.build(points.data(), points.size());
+    check(grid.getCellSize() == 0.25f, "a small box keeps the cell size", "box");
+    checkQueries(grid, points, glm::vec3(-3.0f, 0.0f, -3.0f), glm::vec3(3.0f, 6.0f, 3.0f), 0.3f, "box");
+    checkQueries(grid, points, glm::vec3(-3.0f, 0.0f, -3.0f), glm::vec3(3.0f, 6.0f, 3.0f), 1.0f, "box");
+
+    // Flakes spread so far that the cells are made larger.
+    std::uniform_real_distribution<float> far(-400.0f, 400.0f);
+    for (auto &p : points)
+    {
+        p = glm::vec3(far(gen), near(gen), far(gen));
+    }
+    grid.build(points.data(), points.size());
+    check(grid.getCellSize() > 0.25f, "a large box gets larger cells", "spread");
+    checkQueries(grid, points, glm::vec3(-400.0f, -2.0f, -400.0f), glm::vec3(400.0f, 2.0f, 400.0f), 20.0f, "spread");
+
+    // Every flake in the same place.
+    std::vector<glm::vec3> stacked(100, glm::vec3(1.0f, 2.0f, 3.0f));
+    grid.build(stacked.data(), stacked.size());
+    checkQueries(grid, stacked, glm::vec3(0.5f, 1.5f, 2.5f), glm::vec3(1.5f, 2.5f, 3.5f), 0.6f, "stacked");
+
+    // No flakes at all.
+    grid.build(nullptr, 0);
+    bool visited = false;
+    grid.forEachNear(glm::vec3(0.0f), 1.0f, [&](std::uint32_t, glm::vec3 const &) { visited = true; });
+    check(!visited, "an empty grid visits nothing", "empty");
+
+    if (gFailures > 0)
+    {
+        std::printf("%d checks failed\n", gFailures);
+        return 1;
+    }
+
+    std::printf("All flake grid checks passed\n");
+    return 0;
+}
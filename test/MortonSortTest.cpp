@@ -0,0 +1,120 @@
+#include "MortonSort.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Sorts random points and checks that the order is a permutation along the
+// Morton curve, with points in the same cell kept in their original order.
+// Returns nonzero if any check fails.
+
+static int gFailures = 0;
+
+static void check(bool condition, const char *what, std::size_t count)
+{
+    if (!condition)
+    {
+        std::printf("FAILED: %s (%zu points)\n", what, count);
+        ++gFailures;
+    }
+}
+
+// Key of a point, interleaving the bits of its cell one at a time.
+static std::uint32_t referenceKey(glm::vec3 const &p, glm::vec3 const &centre, float extent)
+{
+    glm::vec3 cell = glm::clamp((p - centre + extent) * (1024.0f / (2.0f * extent)), 0.0f, 1023.0f);
+    glm::uvec3 c(cell);
+    std::uint32_t key = 0;
+    for (int bit = 0; bit < 10; ++bit)
+    {
+        key |= ((c.x >> bit) & 1u) << (3 * bit);
+        key |= ((c.y >> bit) & 1u) << (3 * bit + 1);
+        key |= ((c.z >> bit) & 1u) << (3 * bit + 2);
+    }
+    return key;
+}
+
+static void checkSort(std::vector<glm::vec3> const &points, glm::vec3 const &centre, float extent)
+{
+    MortonSort sort;
+    check(!sort.isSorting(), "a new sort is idle", points.size());
+
+    sort.start(points.data(), points.size(), centre, extent);
+    int passes = 0;
+    while (!sort.step())
+    {
+        ++passes;
+        check(sort.isSorting(), "a sort in progress reports it", points.size());
+    }
+    check(passes == 3, "the sort takes four passes", points.size());
+    check(!sort.isSorting(), "a finished sort is idle", points.size());
+
+    std::vector<std::uint32_t> expected(points.size());
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+        expected[i] = (std::uint32_t)i;
+    }
+    std::stable_sort(expected.begin(), expected.end(), [&](std::uint32_t a, std::uint32_t b)
+    {
+        return referenceKey(points[a], centre, extent) < referenceKey(points[b], centre, extent);
+    });
+
+    std::vector<std::uint32_t> order = sort.getOrder();
+    check(order == expected, "the order follows the curve and is stable", points.size());
+
+    std::sort(order.begin(), order.end());
+    bool permutation = order.size() == points.size();
+    for (std::size_t i = 0; permutation && i < order.size(); ++i)
+    {
+        permutation = order[i] == i;
+    }
+    check(permutation, "the order is a permutation", points.size());
+}
+
+int main()
+{
+    std::mt19937 gen(3);
+    glm::vec3 centre(1.0f, -2.0f, 0.5f);
+    float extent = 16.0f;
+
+    // Some points fall outside the cube and are clamped to its faces.
+    std::uniform_real_distribution<float> coordinate(-20.0f, 20.0f);
+    for (std::size_t count : { 0, 1, 2, 1000, 100000 })
+    {
+        std::vector<glm::vec3> points(count);
+        for (auto &p : points)
+        {
+            p = centre + glm::vec3(coordinate(gen), coordinate(gen), coordinate(gen));
+        }
+        checkSort(points, centre, extent);
+    }
+
+    // Many points per cell, so stability decides most of the order.
+    std::uniform_int_distribution<int> cell(0, 3);
+    std::vector<glm::vec3> clustered(5000);
+    for (auto &p : clustered)
+    {
+        p = centre + glm::vec3((float)cell(gen), (float)cell(gen), (float)cell(gen)) * 8.0f;
+    }
+    checkSort(clustered, centre, extent);
+
+    // Every key the same, which skips the scatter of every pass.
+    checkSort(std::vector<glm::vec3>(3000, centre), centre, extent);
+
+    // A reset drops the sort in progress.
+    MortonSort sort;
+    sort.start(clustered.data(), clustered.size(), centre, extent);
+    sort.step();
+    sort.reset();
+    check(!sort.isSorting() && sort.step(), "a reset sort is idle", clustered.size());
+
+    if (gFailures > 0)
+    {
+        std::printf("%d checks failed\n", gFailures);
+        return 1;
+    }
+
+    std::printf("All Morton sort checks passed\n");
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include <atlas/math/RandomGenerator.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Checks xoshiro256** and splitmix64 against the reference outputs, and the
+// bulk fills of RandomGenerator against the moments and distribution of the
+// uniform, normal and unit sphere variates they stand for. Returns nonzero
+// if any check fails.
+
+using namespace atlas::math;
+
+static int gFailures = 0;
+
+static void check(bool condition, const char *what, const char *type)
+{
+    if (!condition)
+    {
+        std::printf("FAILED: %s (%s)\n", what, type);
+        ++gFailures;
+    }
+}
+
+static void checkEngine()
+{
+    // First outputs of the reference implementations.
+    Xoshiro256 engine;
+    engine.setState({ { 1, 2, 3, 4 } });
+    bool reference = engine() == 11520ull && engine() == 0ull && engine() == 1509978240ull &&
+        engine() == 1215971899390074240ull;
+    check(reference, "xoshiro256** matches the reference", "engine");
+
+    std::uint64_t x = 0;
+    check(Xoshiro256::splitMix(x) == 0xE220A8397B1DCDAFull, "splitmix64 matches the reference", "engine");
+
+    // Restoring the state repeats the sequence.
+    Xoshiro256 seeded(42);
+    Xoshiro256::State state = seeded.getState();
+    std::uint64_t first = seeded(), second = seeded();
+    seeded.setState(state);
+    check(seeded() == first && seeded() == second, "a restored state repeats the sequence", "engine");
+}
+
+template <typename GenType>
+static void checkUniform(const char *type)
+{
+    RandomGenerator<GenType> random(7);
+
+    // Not a multiple of the lanes, so the last partial group is written.
+    const std::size_t count = 200003;
+    std::vector<GenType> values(count + 1, GenType(-100));
+    random.fillUniform(values.data(), count, GenType(-2), GenType(3));
+
+    bool inRange = true;
+    double sum = 0.0, squares = 0.0;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        inRange = inRange && values[i] >= GenType(-2) && values[i] < GenType(3);
+        sum += values[i];
+        squares += (double)values[i] * values[i];
+    }
+    double mean = sum / count;
+    double variance = squares / count - mean * mean;
+
+    check(inRange, "uniform values are in range", type);
+    check(values[count] == GenType(-100), "uniform fill stops at the count", type);
+    check(std::abs(mean - 0.5) < 0.02, "uniform mean", type);
+    check(std::abs(variance - 25.0 / 12.0) < 0.03, "uniform variance", type);
+}
+
+// Standard normal distribution function.
+static double normalCdf(double x)
+{
+    return 0.5 * std::erfc(-x / std::sqrt(2.0));
+}
+
+template <typename GenType>
+static void checkNormal(const char *type)
+{
+    RandomGenerator<GenType> random(11);
+    const std::size_t count = 1000001;
+    std::vector<GenType> values(count);
+    random.fillNormal(values.data(), count, GenType(1), GenType(2));
+
+    double sum = 0.0, squares = 0.0, fourth = 0.0;
+    bool finite = true;
+    for (auto value : values)
+    {
+        finite = finite && std::isfinite((double)value);
+        double z = (value - 1.0) / 2.0;
+        sum += z;
+        squares += z * z;
+        fourth += z * z * z * z;
+    }
+    check(finite, "normal values are finite", type);
+    check(std::abs(sum / count) < 0.005, "normal mean", type);
+    check(std::abs(squares / count - 1.0) < 0.01, "normal variance", type);
+    check(std::abs(fourth / count - 3.0) < 0.05, "normal kurtosis", type);
+
+    // The distribution function, including past the base layer of the
+    // ziggurat at 3.44, which only the tail method reaches.
+    bool matches = true;
+    for (double x : { -4.0, -3.5, -2.0, -1.0, -0.3, 0.0, 0.7, 1.5, 2.5, 3.5, 4.0 })
+    {
+        std::size_t below = 0;
+        for (auto value : values)
+        {
+            below += ((value - 1.0) / 2.0 < x) ? 1 : 0;
+        }
+        double expected = normalCdf(x);
+        double tolerance = 4.0 * std::sqrt(expected * (1.0 - expected) / count) + 1e-6;
+        matches = matches && std::abs((double)below / count - expected) < tolerance;
+    }
+    check(matches, "normal distribution function", type);
+
+    // The single draw and the bulk fill agree.
+    double single = 0.0, singleSquares = 0.0;
+    for (int i = 0; i < 200000; ++i)
+    {
+        double z = random.getRandomNormal(GenType(0), GenType(1));
+        single += z;
+        singleSquares += z * z;
+    }
+    check(std::abs(single / 200000) < 0.01 && std::abs(singleSquares / 200000 - 1.0) < 0.02,
+        "single normal draws", type);
+}
+
+template <typename GenType>
+static void checkSphere(const char *type)
+{
+    RandomGenerator<GenType> random(13);
+    const std::size_t count = 300007;
+    std::vector<glm::tvec3<GenType, glm::defaultp>> directions(count);
+    random.fillUnitSphere(directions.data(), count);
+
+    bool unit = true;
+    glm::dvec3 sum(0.0), squares(0.0);
+    for (auto const &d : directions)
+    {
+        unit = unit && std::abs(glm::length(d) - GenType(1)) < GenType(1e-4);
+        sum += glm::dvec3(d);
+        squares += glm::dvec3(d) * glm::dvec3(d);
+    }
+
+    // Every coordinate of a uniform direction is uniform in [-1, 1].
+    glm::dvec3 mean = sum / (double)count;
+    glm::dvec3 variance = squares / (double)count;
+    check(unit, "sphere directions have unit length", type);
+    check(glm::all(glm::lessThan(glm::abs(mean), glm::dvec3(0.01))), "sphere mean", type);
+    check(glm::all(glm::lessThan(glm::abs(variance - 1.0 / 3.0), glm::dvec3(0.01))), "sphere variance", type);
+}
+
+template <typename GenType>
+static void checkAll(const char *type)
+{
+    checkUniform<GenType>(type);
+    checkNormal<GenType>(type);
+    checkSphere<GenType>(type);
+
+    // The same seed gives the same fills.
+    RandomGenerator<GenType> a(99), b(99);
+    std::vector<GenType> x(37), y(37);
+    a.fillNormal(x.data(), x.size(), GenType(0), GenType(1));
+    b.fillNormal(y.data(), y.size(), GenType(0), GenType(1));
+    check(x == y, "fills are repeatable", type);
+}
+
+int main()
+{
+    checkEngine();
+    checkAll<float>("float");
+    checkAll<double>("double");
+
+    if (gFailures > 0)
+    {
+        std::printf("%d checks failed\n", gFailures);
+        return 1;
+    }
+
+    std::printf("All random generator checks passed\n");
+    return 0;
+}
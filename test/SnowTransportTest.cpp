@@ -0,0 +1,136 @@
+#include "SnowTransport.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Runs sliding and drifting passes over random snow on a slope and checks
+// that they only move snow around: the total is kept, no cell is dug below
+// the ground, and tiles away from the dirty ones are left alone. Returns
+// nonzero if any check fails.
+
+static const int kGridSize = 51;
+static const int kTileSize = 8;
+static const float kSpacing = 0.2f;
+
+static int gFailures = 0;
+
+static void check(bool condition, const char *what, const char *wind)
+{
+    if (!condition)
+    {
+        std::printf("FAILED: %s (%s)\n", what, wind);
+        ++gFailures;
+    }
+}
+
+static double totalHeight(std::vector<glm::vec4> const &grid)
+{
+    double total = 0.0;
+    for (int i = 0; i < kGridSize * kGridSize; ++i)
+    {
+        total += grid[i].y;
+    }
+    return total;
+}
+
+static void checkPasses(glm::vec3 const &windVelocity, const char *name)
+{
+    std::mt19937 gen(17);
+    std::uniform_real_distribution<float> depth(0.0f, 0.05f);
+    std::uniform_int_distribution<int> anyCell(0, kGridSize * kGridSize - 1);
+
+    // Ground rising along x, with a thin random cover and a few tall piles
+    // that are far steeper than the angle of repose.
+    std::vector<glm::vec4> grid(kGridSize * kGridSize);
+    std::vector<float> ground(kGridSize * kGridSize);
+    for (int row = 0; row < kGridSize; ++row)
+    {
+        for (int col = 0; col < kGridSize; ++col)
+        {
+            int cell = row * kGridSize + col;
+            ground[cell] = 0.3f * col * kSpacing;
+            grid[cell] = glm::vec4(col * kSpacing, ground[cell] + depth(gen), row * kSpacing, 1.0f);
+        }
+    }
+    for (int p = 0; p < 20; ++p)
+    {
+        grid[anyCell(gen)].y += 1.0f;
+    }
+
+    SnowTransport transport(kGridSize, kSpacing, kTileSize);
+    transport.setGround(grid);
+    for (int i = 0; i < kGridSize * kGridSize; ++i)
+    {
+        transport.setGround(i, ground[i]);
+    }
+
+    auto wind = [&windVelocity](glm::vec3 const *, std::size_t count, glm::vec3 *winds)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            winds[i] = windVelocity;
+        }
+    };
+    auto exposure = [](float x, float) { return 0.5f + 0.1f * x; };
+
+    // A single dirty cell in the middle tile only lets the tiles around it
+    // take part in the first pass.
+    int middle = (kGridSize / 2) * kGridSize + kGridSize / 2;
+    transport.markDirty(middle);
+    transport.update(0.1, grid, wind, exposure);
+
+    bool contained = true;
+    int middleTile = (kGridSize / 2) / kTileSize;
+    for (auto const &shift : transport.getShifts())
+    {
+        int tileRow = (shift.cell / kGridSize) / kTileSize;
+        int tileCol = (shift.cell % kGridSize) / kTileSize;
+        contained = contained && std::abs(tileRow - middleTile) <= 1 && std::abs(tileCol - middleTile) <= 1;
+    }
+    check(contained, "only the tiles around a dirty one move snow", name);
+
+    double before = totalHeight(grid);
+    bool moved = false, aboveGround = true, kept = true;
+    transport.markAllDirty();
+    for (int pass = 0; pass < 50; ++pass)
+    {
+        double start = totalHeight(grid);
+        transport.update(0.2 + 0.1 * pass, grid, wind, exposure);
+        for (auto const &shift : transport.getShifts())
+        {
+            grid[shift.cell].y += shift.height;
+            moved = true;
+        }
+
+        for (int i = 0; i < kGridSize * kGridSize; ++i)
+        {
+            aboveGround = aboveGround && grid[i].y >= ground[i] - 1e-5f;
+        }
+        kept = kept && std::abs(totalHeight(grid) - start) <= 1e-4;
+    }
+
+    check(moved, "the passes move snow", name);
+    check(aboveGround, "no cell is dug below the ground", name);
+    check(kept, "every pass keeps the total", name);
+    check(std::abs(totalHeight(grid) - before) <= 1e-3, "the total is kept over many passes", name);
+}
+
+int main()
+{
+    // Too weak to lift the snow, so only sliding moves it.
+    checkPasses(glm::vec3(1.0f, 0.0f, 0.0f), "calm");
+
+    // Strong enough to drift the snow across the tiles.
+    checkPasses(glm::vec3(12.0f, 0.0f, -5.0f), "windy");
+
+    if (gFailures > 0)
+    {
+        std::printf("%d checks failed\n", gFailures);
+        return 1;
+    }
+
+    std::printf("All snow transport checks passed\n");
+    return 0;
+}
@@ -0,0 +1,254 @@
+#include <atlas/math/Solvers.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Checks the std::array and batched solvers against the std::vector ones,
+// and all of them against equations with known roots. Returns nonzero if
+// any check fails.
+
+using namespace atlas::math;
+
+static int gFailures = 0;
+
+static void check(bool condition, const char *what, const char *type, int degree, int equation)
+{
+    if (!condition)
+    {
+        std::printf("FAILED: %s (%s, degree %d, equation %d)\n", what, type, degree, equation);
+        ++gFailures;
+    }
+}
+
+// The three forms of the solver for every degree.
+template <typename GenType, int Degree>
+struct Solver;
+
+template <typename GenType>
+struct Solver<GenType, 2>
+{
+    static int solve(std::vector<GenType> &c, std::vector<GenType> &r)
+    {
+        return solveQuadric<GenType>(c, r);
+    }
+
+    static int solve(std::array<GenType, 3> const &c, std::array<GenType, 2> &r)
+    {
+        return solveQuadric<GenType>(c, r);
+    }
+
+    static void solve(std::array<SolverLanes<GenType>, 3> const &c, std::array<SolverLanes<GenType>, 2> &r,
+        std::array<int, kSolverLanes> &counts)
+    {
+        solveQuadrics<GenType>(c, r, counts);
+    }
+};
+
+template <typename GenType>
+struct Solver<GenType, 3>
+{
+    static int solve(std::vector<GenType> &c, std::vector<GenType> &r)
+    {
+        return solveCubic<GenType>(c, r);
+    }
+
+    static int solve(std::array<GenType, 4> const &c, std::array<GenType, 3> &r)
+    {
+        return solveCubic<GenType>(c, r);
+    }
+
+    static void solve(std::array<SolverLanes<GenType>, 4> const &c, std::array<SolverLanes<GenType>, 3> &r,
+        std::array<int, kSolverLanes> &counts)
+    {
+        solveCubics<GenType>(c, r, counts);
+    }
+};
+
+template <typename GenType>
+struct Solver<GenType, 4>
+{
+    static int solve(std::vector<GenType> &c, std::vector<GenType> &r)
+    {
+        return solveQuartic<GenType>(c, r);
+    }
+
+    static int solve(std::array<GenType, 5> const &c, std::array<GenType, 4> &r)
+    {
+        return solveQuartic<GenType>(c, r);
+    }
+
+    static void solve(std::array<SolverLanes<GenType>, 5> const &c, std::array<SolverLanes<GenType>, 4> &r,
+        std::array<int, kSolverLanes> &counts)
+    {
+        solveQuartics<GenType>(c, r, counts);
+    }
+};
+
+// The coefficients, lowest degree first, of the polynomial with the given
+// roots.
+static std::vector<double> fromRoots(std::vector<double> const &roots)
+{
+    std::vector<double> coeffs(1, 1.0);
+    for (double root : roots)
+    {
+        std::vector<double> next(coeffs.size() + 1, 0.0);
+        for (std::size_t i = 0; i < coeffs.size(); ++i)
+        {
+            next[i + 1] += coeffs[i];
+            next[i] -= root * coeffs[i];
+        }
+        coeffs = next;
+    }
+    return coeffs;
+}
+
+// Whether the polynomial is close enough to zero at x: the residual is
+// measured in double, relative to the size of the terms at x.
+template <typename GenType>
+static bool isRoot(std::vector<GenType> const &coeffs, GenType x, double tolerance)
+{
+    double value = 0.0, scale = 0.0;
+    for (int i = (int)coeffs.size() - 1; i >= 0; --i)
+    {
+        value = value * x + coeffs[i];
+        scale = scale * std::abs((double)x) + std::abs((double)coeffs[i]);
+    }
+    return std::abs(value) <= tolerance * std::max(scale, 1.0);
+}
+
+template <typename GenType, int Degree>
+static void checkSolvers(const char *type, std::vector<std::vector<double>> const &known, double residual,
+    double distance)
+{
+    // The equations with known roots first, then random ones with the
+    // leading coefficient kept away from zero.
+    std::vector<std::vector<GenType>> equations;
+    for (auto const &roots : known)
+    {
+        std::vector<double> coeffs = fromRoots(roots);
+        equations.push_back(std::vector<GenType>(coeffs.begin(), coeffs.end()));
+    }
+
+    std::default_random_engine random(7);
+    std::uniform_real_distribution<double> coefficient(-10.0, 10.0);
+    for (int i = 0; i < 64 * kSolverLanes; ++i)
+    {
+        std::vector<GenType> coeffs(Degree + 1);
+        for (auto &c : coeffs)
+        {
+            c = (GenType)coefficient(random);
+        }
+        coeffs[Degree] += coeffs[Degree] < 0 ? GenType(-1) : GenType(1);
+        equations.push_back(coeffs);
+    }
+
+    for (std::size_t start = 0; start < equations.size(); start += kSolverLanes)
+    {
+        // A batch of equations, the last one repeated to fill the lanes.
+        std::array<SolverLanes<GenType>, Degree + 1> laneCoeffs;
+        std::array<SolverLanes<GenType>, Degree> laneRoots;
+        std::array<int, kSolverLanes> laneCounts;
+        for (int k = 0; k < kSolverLanes; ++k)
+        {
+            std::size_t e = std::min(start + k, equations.size() - 1);
+            for (int i = 0; i <= Degree; ++i)
+            {
+                laneCoeffs[i][k] = equations[e][i];
+            }
+        }
+        Solver<GenType, Degree>::solve(laneCoeffs, laneRoots, laneCounts);
+
+        for (int k = 0; k < kSolverLanes && start + k < equations.size(); ++k)
+        {
+            int e = (int)(start + k);
+            std::vector<GenType> coeffs = equations[e];
+            std::vector<GenType> roots(Degree, GenType(0));
+            int count = Solver<GenType, Degree>::solve(coeffs, roots);
+
+            std::array<GenType, Degree + 1> arrayCoeffs;
+            std::array<GenType, Degree> arrayRoots;
+            std::copy(coeffs.begin(), coeffs.end(), arrayCoeffs.begin());
+            int arrayCount = Solver<GenType, Degree>::solve(arrayCoeffs, arrayRoots);
+
+            // All three run the same operations, so they agree exactly.
+            check(count >= 0 && count <= Degree, "root count in range", type, Degree, e);
+            check(arrayCount == count, "array root count matches vector", type, Degree, e);
+            check(laneCounts[k] == count, "batched root count matches vector", type, Degree, e);
+            for (int i = 0; i < std::min(count, Degree); ++i)
+            {
+                check(arrayRoots[i] == roots[i], "array root matches vector", type, Degree, e);
+                check(laneRoots[i][k] == roots[i], "batched root matches vector", type, Degree, e);
+                check(isRoot(coeffs, roots[i], residual), "residual within bound", type, Degree, e);
+            }
+
+            // Repeated roots may be reported once or more, so look for every
+            // known root rather than comparing the lists.
+            if (e < (int)known.size())
+            {
+                for (double root : known[e])
+                {
+                    bool found = false;
+                    for (int i = 0; i < std::min(count, Degree); ++i)
+                    {
+                        found = found || std::abs(roots[i] - root) <= distance * std::max(std::abs(root), 1.0);
+                    }
+                    check(found, "known root found", type, Degree, e);
+                }
+            }
+        }
+    }
+}
+
+template <typename GenType>
+static void checkAll(const char *type, double residual, double distance)
+{
+    checkSolvers<GenType, 2>(type, {
+        { 1.0, 2.0 },
+        { -3.0, 0.5 },
+        { 0.0, 4.0 },
+        { 2.0, 2.0 }
+    }, residual, distance);
+
+    // Cubics with a term in x^2, which the depressed cubic's q depends on.
+    checkSolvers<GenType, 3>(type, {
+        { 1.0, 2.0, 3.0 },
+        { -1.0, 0.5, 4.0 },
+        { -2.0, -1.0, 5.0 },
+        { 0.0, 1.0, -3.0 },
+        { 3.0, 3.0, -1.0 }
+    }, residual, distance);
+
+    // Quartics with four known roots. Roots that sum to zero with one of
+    // them at zero leave no absolute term after the substitution, which
+    // takes the r == 0 branch.
+    checkSolvers<GenType, 4>(type, {
+        { 1.0, 2.0, 3.0, 4.0 },
+        { -2.0, -1.0, 1.0, 3.0 },
+        { -4.0, 0.5, 1.5, 2.5 },
+        { 0.0, 1.0, 2.0, -3.0 },
+        { 0.0, -1.0, -2.0, 3.0 },
+        { -3.0, -1.0, 1.0, 3.0 },
+        { 1.0, 1.0, 2.0, 5.0 }
+    }, residual, distance);
+}
+
+int main()
+{
+    // Single precision loses digits to cancellation when the cubic has a
+    // single real root, and repeated roots are only found to about the
+    // square root of the precision.
+    checkAll<float>("float", 1e-2, 1e-3);
+    checkAll<double>("double", 1e-10, 1e-6);
+
+    if (gFailures > 0)
+    {
+        std::printf("%d checks failed\n", gFailures);
+        return 1;
+    }
+
+    std::printf("All solver checks passed\n");
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <atlas/core/Parallel.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+// Checks that every block of a job runs exactly once, for jobs started from
+// one thread, from inside another job and from several threads at once.
+// Returns nonzero if any check fails.
+
+using atlas::core::ThreadPool;
+
+static int gFailures = 0;
+
+static void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        std::printf("FAILED: %s\n", what);
+        ++gFailures;
+    }
+}
+
+// Runs a job of the given size and checks that each block ran once.
+static bool runOnce(ThreadPool &pool, std::size_t blocks)
+{
+    std::vector<std::atomic<int>> counts(blocks);
+    for (auto &count : counts)
+    {
+        count = 0;
+    }
+
+    pool.run(blocks, [&](std::size_t b)
+    {
+        ++counts[b];
+    });
+
+    for (auto const &count : counts)
+    {
+        if (count != 1)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void checkSingle(ThreadPool &pool)
+{
+    bool ok = true;
+    for (std::size_t blocks = 0; blocks < 64; ++blocks)
+    {
+        ok = runOnce(pool, blocks) && ok;
+    }
+    check(ok, "every block of a job runs once");
+}
+
+static void checkNested(ThreadPool &pool)
+{
+    const std::size_t outer = 16, inner = 32;
+    std::vector<std::atomic<int>> counts(outer * inner);
+    for (auto &count : counts)
+    {
+        count = 0;
+    }
+
+    pool.run(outer, [&](std::size_t o)
+    {
+        pool.run(inner, [&](std::size_t i)
+        {
+            ++counts[o * inner + i];
+        });
+    });
+
+    bool ok = true;
+    for (auto const &count : counts)
+    {
+        ok = ok && count == 1;
+    }
+    check(ok, "every block of a nested job runs once");
+}
+
+static void checkConcurrent(ThreadPool &pool)
+{
+    const int submitters = 4, jobs = 200;
+    std::atomic<int> failures(0);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < submitters; ++t)
+    {
+        threads.emplace_back([&pool, &failures, t]()
+        {
+            for (int j = 0; j < jobs; ++j)
+            {
+                if (!runOnce(pool, 2 + (std::size_t)(j + t) % 31))
+                {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    check(failures == 0, "every block of concurrent jobs runs once");
+}
+
+// The second job starts while the first one still holds a block, so it only
+// reaches the workers if concurrent submitters share them.
+static void checkShared(ThreadPool &pool)
+{
+    std::atomic<bool> started(false), release(false);
+    std::thread blocker([&]()
+    {
+        pool.run(2, [&](std::size_t)
+        {
+            started = true;
+            while (!release)
+            {
+                std::this_thread::yield();
+            }
+        });
+    });
+    while (!started)
+    {
+        std::this_thread::yield();
+    }
+
+    std::vector<std::thread::id> ids(pool.getThreadCount() * 4);
+    pool.run(ids.size(), [&](std::size_t b)
+    {
+        ids[b] = std::this_thread::get_id();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+    release = true;
+    blocker.join();
+
+    bool helped = false;
+    for (auto const &id : ids)
+    {
+        helped = helped || id != std::this_thread::get_id();
+    }
+    check(helped, "a second submitter shares the workers");
+}
+
+static void checkParallelFor()
+{
+    const std::size_t count = 1000;
+    std::vector<std::atomic<int>> counts(count);
+    for (auto &c : counts)
+    {
+        c = 0;
+    }
+
+    atlas::core::parallelFor(0, count, [&](std::size_t i)
+    {
+        ++counts[i];
+    });
+
+    bool ok = true;
+    for (auto const &c : counts)
+    {
+        ok = ok && c == 1;
+    }
+    check(ok, "parallelFor visits every index once");
+}
+
+int main()
+{
+    // The shared pool has no workers on a single core machine, so the
+    // checks use a pool of their own.
+    ThreadPool pool(4);
+    checkSingle(pool);
+    checkNested(pool);
+    checkConcurrent(pool);
+    checkShared(pool);
+    checkParallelFor();
+
+    if (gFailures > 0)
+    {
+        std::printf("%d checks failed\n", gFailures);
+        return 1;
+    }
+
+    std::printf("All thread pool checks passed\n");
+    return 0;
+}